@@ -0,0 +1,335 @@
+#include "coreir.h"
+#include "coreir-lib/cgralib.h"
+#include "coreir-sim/simulator.h"
+#include "coreir-sim/compiledsim.h"
+#include "cxxopts.hpp"
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <random>
+#include <set>
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+//Synthetic designs for measuring the simulation engines. Every design is
+//parameterized by a size and builds a fresh module named after it, so the
+//results of two commits can be matched by name.
+
+typedef std::chrono::steady_clock Clock;
+
+double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now()-start).count();
+}
+
+//Assigning a double to a json goes through a NaN branch in json.hpp that
+//gcc -O2 reports as -Wmaybe-uninitialized, so fill in the number directly
+json number(double v) {
+  json j(json::value_t::number_float);
+  j.get_ref<json::number_float_t&>() = v;
+  return j;
+}
+
+//Balanced tree of coreir.add over leaves inputs, registered at the output
+Module* adderTree(Context* c, uint leaves) {
+  uint n = 16;
+  Module* m = c->getGlobal()->newModuleDecl("AdderTree" + to_string(leaves),c->Record({
+    {"in",c->BitIn()->Arr(n)->Arr(leaves)},
+    {"out",c->Bit()->Arr(n)}
+  }));
+  ModuleDef* def = m->newModuleDef();
+    vector<string> level;
+    for (uint i=0; i<leaves; ++i) level.push_back("self.in." + to_string(i));
+    uint id = 0;
+    while (level.size()>1) {
+      vector<string> next;
+      for (uint i=0; i+1<level.size(); i+=2) {
+        string add = "add" + to_string(id++);
+        def->addInstance(add,"coreir.add",{{"width",c->argInt(n)}});
+        def->connect(level[i],add + ".in0");
+        def->connect(level[i+1],add + ".in1");
+        next.push_back(add + ".out");
+      }
+      if (level.size()%2) next.push_back(level.back());
+      level = next;
+    }
+    def->addInstance("r","coreir.reg",{{"width",c->argInt(n)}});
+    def->connect(level[0],"r.in");
+    def->connect("r.out","self.out");
+  m->setDef(def);
+  return m;
+}
+
+//length registers in a row
+Module* regChain(Context* c, uint length) {
+  uint n = 16;
+  Module* m = c->getGlobal()->newModuleDecl("RegChain" + to_string(length),c->Record({
+    {"in",c->BitIn()->Arr(n)},
+    {"out",c->Bit()->Arr(n)}
+  }));
+  ModuleDef* def = m->newModuleDef();
+    string prev = "self.in";
+    for (uint i=0; i<length; ++i) {
+      string r = "r" + to_string(i);
+      def->addInstance(r,"coreir.reg",{{"width",c->argInt(n)}});
+      def->connect(prev,r + ".in");
+      prev = r + ".out";
+    }
+    def->connect(prev,"self.out");
+  m->setDef(def);
+  return m;
+}
+
+//3x3 stencil over an image of width imageWidth
+Module* linebuffer(Context* c, uint imageWidth) {
+  Module* m = c->getGlobal()->newModuleDecl("Linebuffer" + to_string(imageWidth),c->Record({
+    {"in",c->BitIn()->Arr(16)},
+    {"out",c->Bit()->Arr(16)->Arr(3)->Arr(3)}
+  }));
+  ModuleDef* def = m->newModuleDef();
+    def->addInstance("lb","cgralib.Linebuffer",{
+      {"stencil_width",c->argInt(3)},
+      {"stencil_height",c->argInt(3)},
+      {"image_width",c->argInt(imageWidth)},
+      {"bitwidth",c->argInt(16)}
+    });
+    def->connect("self.in","lb.in");
+    def->connect("lb.out","self.out");
+  m->setDef(def);
+  return m;
+}
+
+//numOps random binary prims over the inputs, earlier ops and numOps/8
+//registers that are fed back from random ops
+Module* randomDag(Context* c, uint numOps) {
+  uint n = 16;
+  uint numIns = 4;
+  uint numRegs = std::max(1u,numOps/8);
+  Module* m = c->getGlobal()->newModuleDecl("RandomDag" + to_string(numOps),c->Record({
+    {"in",c->BitIn()->Arr(n)->Arr(numIns)},
+    {"out",c->Bit()->Arr(n)}
+  }));
+  std::mt19937 rng(numOps);
+  vector<string> ops = {"add","sub","xor","and","or","mul","dshl","dlshr"};
+  ModuleDef* def = m->newModuleDef();
+    vector<string> values;
+    for (uint i=0; i<numIns; ++i) values.push_back("self.in." + to_string(i));
+    for (uint i=0; i<numRegs; ++i) {
+      string r = "r" + to_string(i);
+      def->addInstance(r,"coreir.reg",{{"width",c->argInt(n)}},{{"init",c->argInt(i)}});
+      values.push_back(r + ".out");
+    }
+    for (uint i=0; i<numOps; ++i) {
+      string op = "op" + to_string(i);
+      def->addInstance(op,"coreir." + ops[rng()%ops.size()],{{"width",c->argInt(n)}});
+      //Mostly recent values, so the DAG is deep as well as wide
+      uint window = std::min((uint) values.size(),32u);
+      def->connect(values[values.size()-1-rng()%window],op + ".in0");
+      def->connect(values[rng()%values.size()],op + ".in1");
+      values.push_back(op + ".out");
+    }
+    for (uint i=0; i<numRegs; ++i) {
+      def->connect(values[numIns+numRegs+rng()%numOps],"r" + to_string(i) + ".in");
+    }
+    def->connect(values.back(),"self.out");
+  m->setDef(def);
+  return m;
+}
+
+//count copies of a small tile (multiply-accumulate and a mux) in a row
+Module* tiles(Context* c, uint count) {
+  uint n = 16;
+  Namespace* g = c->getGlobal();
+  Module* tile = g->hasModule("BenchTile") ? g->getModule("BenchTile") : nullptr;
+  if (!tile) {
+    tile = g->newModuleDecl("BenchTile",c->Record({
+      {"in",c->BitIn()->Arr(n)},
+      {"x",c->BitIn()->Arr(n)},
+      {"out",c->Bit()->Arr(n)}
+    }));
+    ModuleDef* def = tile->newModuleDef();
+      def->addInstance("r","coreir.reg",{{"width",c->argInt(n)}});
+      def->addInstance("mul","coreir.mul",{{"width",c->argInt(n)}});
+      def->addInstance("add","coreir.add",{{"width",c->argInt(n)}});
+      def->addInstance("lt","coreir.ult",{{"width",c->argInt(n)}});
+      def->addInstance("mux","coreir.mux",{{"width",c->argInt(n)}});
+      def->connect("self.in","mul.in0");
+      def->connect("self.x","mul.in1");
+      def->connect("mul.out","add.in0");
+      def->connect("r.out","add.in1");
+      def->connect("add.out","lt.in0");
+      def->connect("self.x","lt.in1");
+      def->connect("add.out","mux.in0");
+      def->connect("self.x","mux.in1");
+      def->connect("lt.out","mux.sel");
+      def->connect("mux.out","r.in");
+      def->connect("r.out","self.out");
+    tile->setDef(def);
+  }
+  Module* m = g->newModuleDecl("Tiles" + to_string(count),c->Record({
+    {"in",c->BitIn()->Arr(n)},
+    {"out",c->Bit()->Arr(n)}
+  }));
+  ModuleDef* def = m->newModuleDef();
+    string prev = "self.in";
+    for (uint i=0; i<count; ++i) {
+      string t = "t" + to_string(i);
+      def->addInstance(t,tile);
+      def->connect(prev,t + ".in");
+      def->connect("self.in",t + ".x");
+      prev = t + ".out";
+    }
+    def->connect(prev,"self.out");
+  m->setDef(def);
+  return m;
+}
+
+struct Design {
+  string family;
+  std::function<Module*(Context*,uint)> build;
+  vector<uint> sizes;
+  vector<uint> quickSizes;
+};
+
+//Runs sim for at least minSeconds (in batches of doubling size) with
+//random inputs. Returns {cycles, seconds}
+std::pair<uint64_t,double> measure(Simulator* sim, double minSeconds) {
+  SimGraph* g = sim->getGraph();
+  std::mt19937_64 rng(1);
+  vector<vector<uint64_t>> stimulus(64,vector<uint64_t>(g->inputs.size()));
+  for (auto& cycle : stimulus) {
+    for (auto& v : cycle) v = rng();
+  }
+  //Warm up (and settle the initial state)
+  sim->eval();
+  uint64_t cycles = 0;
+  uint64_t batch = 1;
+  double seconds = 0;
+  Clock::time_point start = Clock::now();
+  while (seconds<minSeconds) {
+    for (uint64_t i=0; i<batch; ++i) {
+      const vector<uint64_t>& ins = stimulus[(cycles+i)%stimulus.size()];
+      for (uint in=0; in<ins.size(); ++in) sim->setInput(in,ins[in]);
+      sim->step();
+    }
+    //Outputs are computed lazily by some engines
+    for (uint out=0; out<g->outputs.size(); ++out) sim->getOutput(out);
+    cycles += batch;
+    batch *= 2;
+    seconds = secondsSince(start);
+  }
+  return {cycles,seconds};
+}
+
+//Ratios against the results of another run (matched by design and engine)
+void compare(const json& results, string baselineFile) {
+  std::ifstream fin(baselineFile);
+  ASSERT(fin.is_open(),"Cannot open baseline " + baselineFile);
+  json baseline = json::parse(fin);
+  std::map<string,double> base;
+  for (auto& r : baseline["results"]) {
+    base[r["design"].get<string>() + " " + r["engine"].get<string>()] = r["cycles_per_sec"].get<double>();
+  }
+  cout << endl << "Speedup over " << baselineFile;
+  if (baseline.count("commit")) cout << " (" << baseline["commit"].get<string>() << ")";
+  cout << endl;
+  for (auto& r : results["results"]) {
+    string key = r["design"].get<string>() + " " + r["engine"].get<string>();
+    if (!base.count(key)) continue;
+    cout << "  " << key << ": " << r["cycles_per_sec"].get<double>()/base[key] << "x" << endl;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  cxxopts::Options options("simbench", "measures the simulation engines on synthetic designs");
+  options.add_options()
+    ("h,help","help")
+    ("o,output","JSON results: <file>.json",cxxopts::value<std::string>())
+    ("e,engines","engines to measure: '<engine>,<engine>,...'",cxxopts::value<std::string>()->default_value("interp,compiled,bitparallel,threaded,hier"))
+    ("d,designs","design families to run: '<family>,<family>,...' (default: all)",cxxopts::value<std::string>())
+    ("t,time","minimum seconds of simulation per measurement",cxxopts::value<std::string>()->default_value("0.2"))
+    ("c,cache","directory for compiled simulations (default: $COREIR_SIM_CACHE or ~/.cache/coreir-sim)",cxxopts::value<std::string>())
+    ("b,baseline","print the speedup over an earlier result file: <file>.json",cxxopts::value<std::string>())
+    ("commit","label stored with the results (like a commit hash)",cxxopts::value<std::string>())
+    ("q,quick","small designs only");
+  options.parse(argc,argv);
+  if (options.count("h")) {
+    cout << options.help() << endl;
+    return 0;
+  }
+
+  vector<string> engines = splitString<vector<string>>(options["e"].as<string>(),',');
+  std::set<string> families;
+  if (options.count("d")) {
+    for (auto f : splitString<vector<string>>(options["d"].as<string>(),',')) families.insert(f);
+  }
+  double minSeconds = std::stod(options["t"].as<string>());
+  string cacheDir = options.count("c") ? options["c"].as<string>() : defaultSimCacheDir();
+  bool quick = options.count("q");
+
+  vector<Design> designs = {
+    {"adder_tree",adderTree,{16,256,4096},{16,64}},
+    {"reg_chain",regChain,{16,256,4096},{16,64}},
+    {"linebuffer",linebuffer,{16,64,256,1024},{16,64}},
+    {"random_dag",randomDag,{64,512,4096},{64,256}},
+    {"tiles",tiles,{16,256,4096},{16,64}}
+  };
+
+  json results;
+  if (options.count("commit")) results["commit"] = options["commit"].as<string>();
+  results["threads"] = defaultNumThreads();
+  results["min_seconds"] = number(minSeconds);
+  results["results"] = json::array();
+
+  Context* c = newContext();
+  CoreIRLoadLibrary_cgralib(c);
+  for (auto& design : designs) {
+    if (!families.empty() && !families.count(design.family)) continue;
+    for (auto size : quick ? design.quickSizes : design.sizes) {
+      string name = design.family + "/" + to_string(size);
+      Clock::time_point start = Clock::now();
+      Module* top = design.build(c,size);
+      double irSeconds = secondsSince(start);
+      //Runs the generators and flattens
+      start = Clock::now();
+      SimGraph graph(top);
+      double elabSeconds = secondsSince(start);
+      for (auto engine : engines) {
+        start = Clock::now();
+        Simulator* sim = engine=="compiled" ? new CompiledSimulator(&graph,cacheDir) : newSimulator(&graph,engine);
+        double setupSeconds = secondsSince(start);
+        auto run = measure(sim,minSeconds);
+        double cps = run.first/run.second;
+        json r;
+        r["design"] = name;
+        r["engine"] = engine;
+        r["nodes"] = graph.nodes.size();
+        r["nets"] = graph.slots.size();
+        r["ir_seconds"] = number(irSeconds);
+        r["elaborate_seconds"] = number(elabSeconds);
+        r["setup_seconds"] = number(setupSeconds);
+        r["cycles"] = run.first;
+        r["seconds"] = number(run.second);
+        r["cycles_per_sec"] = number(cps);
+        //Stimuli per second (each lane simulates one)
+        r["lane_cycles_per_sec"] = number(cps*sim->getNumLanes());
+        results["results"].push_back(r);
+        cout << name << " " << engine << ": " << graph.nodes.size() << " nodes, ";
+        cout << "elaborate " << elabSeconds << "s, setup " << setupSeconds << "s, ";
+        cout << cps << " cycles/s" << endl;
+        delete sim;
+      }
+    }
+  }
+  deleteContext(c);
+
+  if (options.count("o")) {
+    string outfile = options["o"].as<string>();
+    std::ofstream fout(outfile);
+    ASSERT(fout.is_open(),"Cannot open " + outfile);
+    fout << results.dump(2) << endl;
+  }
+  if (options.count("b")) compare(results,options["b"].as<string>());
+  return 0;
+}
@@ -0,0 +1,81 @@
+#ifndef COMBDEPTH_HPP_
+#define COMBDEPTH_HPP_
+
+#include "coreir.h"
+
+namespace CoreIR {
+
+//A combinational path: its depth in levels and the ports it goes through
+//from where it starts to where it ends, like
+//{"self","in"},{"add","in0"},{"add","out"},{"r","in"}
+//Paths through submodules list the ports inside them ({"sub","add","out"}).
+struct CombPath {
+  int depth = -1;
+  vector<SelectPath> path;
+};
+
+//Combinational timing of a module as seen by the modules instantiating it.
+//Ports are named like the nodes of a CombGraph ("data.out"). Pairs without
+//a combinational path have no entry.
+struct CombTiming {
+  //Input port -> output port -> deepest path between them
+  map<string,map<string,CombPath>> arcs;
+  //Output port -> deepest path from inside (registers, constants)
+  map<string,CombPath> launch;
+  //Input port -> deepest path to a register or memory inside
+  map<string,CombPath> capture;
+  //Deepest path that starts and ends inside
+  CombPath internal;
+};
+
+namespace Passes {
+
+//Levelizes the combinational logic of every module between its ports,
+//registers and memories. Every leaf instance adds its delay (in levels) to
+//the paths through it: coreir ops from a table that can be set per op and
+//width, other cells from their {"timing":{"delay":n}} metadata (or
+//{"timing":{"sequential":true}} for registers and memories).
+//Submodules are summarized bottom up by their CombTiming, so nothing has to
+//be flattened. Paths through combinational loops (see combloops) are cut
+//somewhere in the loop. Results are computed on demand, so delays can be
+//changed later.
+class CombDepth : public InstanceGraphPass {
+  struct ModuleInfo;
+  unordered_map<Module*,ModuleInfo*> infos;
+  unordered_map<string,int> opDelays;
+  map<std::pair<string,uint>,int> widthDelays;
+  public :
+    static std::string ID;
+    CombDepth();
+    ~CombDepth() { releaseMemory();}
+    bool runOnInstanceGraphNode(InstanceGraphNode& node) override;
+    void releaseMemory() override;
+    void print() override;
+
+    //Delay of the coreir op ("add", "mux", ...) of every width or of width.
+    //Ops default to 1 level and the wiring (const, slice, concat, ...) to 0
+    void setDelay(string op, int delay);
+    void setDelay(string op, uint width, int delay);
+    //Delay of the combinational leaf instance inst
+    int getDelay(Instance* inst);
+
+    //m needs a definition
+    const CombTiming& getTiming(Module* m);
+    //Depth of the deepest path of m, with its inputs arriving at level 0
+    int getDepth(Module* m);
+    CombPath getCriticalPath(Module* m);
+    //Deepest path to every endpoint of m (outputs, register and memory
+    //inputs, deepest paths inside submodules), deepest first, at most k
+    vector<CombPath> getWorstPaths(Module* m, uint k=10);
+    //Level at which port (of self or of an instance, or a select of one)
+    //of m settles or -1 if no path reaches it
+    int getArrival(Module* m, SelectPath port);
+    //If paths of m were cut at a combinational loop
+    bool hasLoops(Module* m);
+  private :
+    ModuleInfo* analyze(Module* m);
+};
+
+}
+}
+#endif
@@ -0,0 +1,74 @@
+#ifndef COMBGRAPH_HPP_
+#define COMBGRAPH_HPP_
+
+#include "coreir.h"
+
+namespace CoreIR {
+
+//Port level directed graph of a module definition for the combinational
+//analyses. Every port of self and of the instances is a node, split into
+//fields until each node is only an input or only an output ("data.in" and
+//"data.out" of a cgralib PE). Clock ports are left out. Every connection,
+//bulk or between selects, is an edge from the node containing its driving
+//side to the node containing the read side (built from DirectedModule).
+//Edges through instances are up to the analyses.
+class CombGraph {
+  public :
+    struct Node {
+      //{"add","out"} or {"self","in"}
+      SelectPath path;
+      //nullptr for the ports of self
+      Instance* inst;
+      //Path within the instance or module ("data.out")
+      string port;
+      //Drives nets (an output of an instance or an input of self)
+      bool driver;
+    };
+  private :
+    Module* m;
+    vector<Node> nodes;
+    unordered_map<string,uint> nodeIndex;
+    //Sorted by name
+    vector<Instance*> insts;
+    unordered_map<Instance*,vector<uint>> instNodes;
+    vector<uint> selfNodes;
+    vector<vector<uint>> succs;
+    vector<vector<uint>> preds;
+  public :
+    explicit CombGraph(Module* m);
+    Module* getModule() { return m;}
+    uint getNumNodes() { return nodes.size();}
+    const Node& getNode(uint n) { return nodes[n];}
+    //Node containing path (a port or a select of one) or -1 if there is
+    //none (like for clocks)
+    int findNode(const SelectPath& path);
+    const vector<Instance*>& getInstances() { return insts;}
+    const vector<uint>& getSelfNodes() { return selfNodes;}
+    const vector<uint>& getInstanceNodes(Instance* inst) { return instNodes.at(inst);}
+    //Connection edges (sorted, without duplicates)
+    const vector<uint>& getSuccs(uint n) { return succs[n];}
+    const vector<uint>& getPreds(uint n) { return preds[n];}
+  private :
+    void addNodes(Instance* inst, SelectPath path, string port, Type* t);
+};
+
+//Timing metadata of the leaf cell inst, taken from the instance, its module
+//or its generator (in that order), like {"timing":{"delay":1}} or
+//{"timing":{"sequential":true}}. Null if none of them has the key.
+json cellTiming(Instance* inst, string key);
+
+//Registers and memories (coreir.reg and cells with sequential timing
+//metadata) start and end paths instead of passing values through
+bool isSequentialCell(Instance* inst);
+
+//The module with a definition inst stands for (nullptr for leaf cells)
+Module* combDefModule(Instance* inst);
+
+//Strongly connected components of the graph given by succs. Returns the
+//component of every node. Components are numbered in the order they are
+//completed, which is a reverse topological order.
+vector<int> strongComponents(const vector<vector<uint>>& succs, uint& numComps);
+
+}
+
+#endif
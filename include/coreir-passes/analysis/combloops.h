@@ -0,0 +1,40 @@
+#ifndef COMBLOOPS_HPP_
+#define COMBLOOPS_HPP_
+
+#include "coreir.h"
+#include <set>
+
+namespace CoreIR {
+namespace Passes {
+
+//Finds the combinational loops of every module with Tarjan's strongly
+//connected components over its CombGraph. Registers and memories break
+//loops. Submodules are summarized bottom up by which of their outputs
+//depend combinationally on which inputs, so loops through the ports of
+//instances are found without flattening.
+class CombLoops : public InstanceGraphPass {
+  struct ModuleInfo;
+  unordered_map<Module*,ModuleInfo*> infos;
+  public :
+    static std::string ID;
+    CombLoops() : InstanceGraphPass(ID,"Finds combinational loops",true) {}
+    ~CombLoops() { releaseMemory();}
+    bool runOnInstanceGraphNode(InstanceGraphNode& node) override;
+    void releaseMemory() override;
+    void print() override;
+
+    //Loops of m itself (not of its submodules), each as the ports around it
+    //in order, like {"not","in"},{"not","out"}. m needs a definition.
+    const vector<vector<SelectPath>>& getLoops(Module* m);
+    //If m or any module below it has a loop
+    bool hasLoops(Module* m);
+    //Input port -> output ports of m depending on it combinationally
+    //(ports are named like the nodes of a CombGraph)
+    const map<string,std::set<string>>& getDependencies(Module* m);
+  private :
+    ModuleInfo* analyze(Module* m);
+};
+
+}
+}
+#endif
@@ -0,0 +1,37 @@
+#ifndef EMITCACHE_HPP_
+#define EMITCACHE_HPP_
+
+#include "coreir.h"
+#include <atomic>
+
+namespace CoreIR {
+
+//On disk cache of emitted module text.
+//Entries live in <dir>/<backend>-<hash> where hash is the moduleEmitHash of the module.
+//lookup/store are safe to call from multiple threads (and processes) at once.
+class EmitCache {
+  std::string dir;
+  std::string backend;
+  std::atomic<uint> hits;
+  std::atomic<uint> misses;
+  public :
+    EmitCache(std::string dir, std::string backend);
+
+    //key is normally moduleEmitHash(m)
+    //Returns true and fills text if a module with this key was emitted before
+    bool lookup(uint64_t key, std::string& text);
+    void store(uint64_t key, const std::string& text);
+
+    uint getHits() { return hits;}
+    uint getMisses() { return misses;}
+  private :
+    std::string entryName(uint64_t key);
+};
+
+//Writes text to filename unless the file already has exactly this content.
+//Leaving unchanged files alone lets downstream tools skip them.
+//Returns true if the file was (re)written
+bool writeFileIfChanged(std::string filename, const std::string& text);
+
+}
+#endif
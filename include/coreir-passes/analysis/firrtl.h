@@ -3,22 +3,50 @@
 
 #include "coreir.h"
 #include <ostream>
+#include "emitcache.h"
 
 using namespace CoreIR;
 namespace CoreIR {
+
+struct FModule;
+
 namespace Passes {
 
+//Collects an FModule per InstanceGraph node. The port declarations are built
+//here (with one cached layout per type), the body of each module is rendered
+//in writeToStream, one buffer per module in parallel.
 class Firrtl : public InstanceGraphPass {
   unordered_map<Instantiable*,string> nameMap;
-  vector<string> fmods;
+  //In InstanceGraph order
+  vector<FModule*> fmods;
+  //FIRRTL type string per (type,noWidths)
+  std::map<std::pair<Type*,bool>,string> typeLayouts;
+  uint numThreads = 0;
+  EmitCache* cache = nullptr;
   public :
     static std::string ID;
     Firrtl() : InstanceGraphPass(ID,"Creates Firrtl representation of IR",true) {}
+    ~Firrtl() { releaseMemory(); delete cache;}
     bool runOnInstanceGraphNode(InstanceGraphNode& node) override;
     void setAnalysisInfo() override {
       addDependency("strongverify");
     }
+    void releaseMemory() override;
+
+    //Number of threads used for rendering (0 means one per core)
+    void setNumThreads(uint n) { numThreads = n;}
+
+    //Reuse the text of modules that were emitted before (keyed by moduleEmitHash)
+    void setCacheDir(std::string dir) {
+      delete cache;
+      cache = new EmitCache(dir,ID);
+    }
+    EmitCache* getCache() { return cache;}
     void writeToStream(std::ostream& os);
+  private :
+    string type2firrtl(Type* t, bool noWidths);
+    //Renders fmod (or fetches it from the cache)
+    void renderModule(FModule* fmod, std::ostream& os);
 };
 
 }
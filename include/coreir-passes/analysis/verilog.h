@@ -4,24 +4,51 @@
 #include "coreir.h"
 #include <ostream>
 #include "vmodule.hpp"
+#include "emitcache.h"
 
 using namespace CoreIR;
 namespace CoreIR {
 namespace Passes {
 
+//Collects a VModule per InstanceGraph node. The verilog text itself is only
+//rendered in writeToStream/writeToFiles, one buffer per module in parallel.
 class Verilog : public InstanceGraphPass {
-  unordered_map<Instantiable*,VModule*> modMap;
+  VModuleMap modMap;
   unordered_set<Instantiable*> external;
+  uint numThreads = 0;
+  EmitCache* cache = nullptr;
   public :
     static std::string ID;
     Verilog() : InstanceGraphPass(ID,"Creates Verilog representation of IR",true) {}
+    ~Verilog() { releaseMemory(); delete cache;}
     bool runOnInstanceGraphNode(InstanceGraphNode& node) override;
     void setAnalysisInfo() override {
       addDependency("strongverify");
       addDependency("verifyflattenedtypes");
     }
-    
+    void releaseMemory() override;
+
+    //Number of threads used for rendering (0 means one per core)
+    void setNumThreads(uint n) { numThreads = n;}
+
+    //Reuse the text of modules that were emitted before (keyed by moduleEmitHash)
+    void setCacheDir(std::string dir) {
+      delete cache;
+      cache = new EmitCache(dir,ID);
+    }
+    EmitCache* getCache() { return cache;}
+
+    //Streams all modules (sorted by name) to os
     void writeToStream(std::ostream& os);
+
+    //Writes every module with a definition to <dir>/<modulename>.v
+    //Files whose content did not change are not touched
+    void writeToFiles(std::string dir);
+  private :
+    //Renders vmod (or fetches it from the cache)
+    void renderModule(VModule* vmod, std::ostream& os);
+    //Modules sorted by verilog name
+    vector<VModule*> getSortedModules(bool isExternal);
 };
 
 }
@@ -1,6 +1,8 @@
 #ifndef VMODULE_HPP_
 #define VMODULE_HPP_
 
+#include <set>
+#include <ostream>
 
 //What I need to represent
 //
@@ -14,6 +16,9 @@
 //
 //Expr = string
 //     | Wire
+//
+//Statements are not stored. They are rendered straight out of the ModuleDef
+//into a stream so a module's text only ever exists once (in its output buffer)
 
 
 using namespace CoreIR; //TODO get rid of this
@@ -50,16 +55,20 @@ class VWire {
     string getName() { return name;}
 };
 
+class VModule;
+typedef unordered_map<Instantiable*,VModule*> VModuleMap;
 
 class VModule {
   string modname;
-  unordered_map<string,VWire> ports;
-  unordered_set<string> params;
+  //Ports in record field order
+  vector<VWire> ports;
+  std::set<string> params;
   unordered_map<string,string> paramDefaults;
 
   Generator* gen = nullptr;
-  
-  vector<string> stmts;
+  //Module whose definition gets rendered (null if defined externally)
+  Module* mod = nullptr;
+
   public:
     VModule(string modname, Type* t) {
       this->modname = modname;
@@ -70,6 +79,7 @@ class VModule {
       if (jmeta.count("verilog") && jmeta["verilog"].count("prefix")) {
         modname = jmeta["verilog"]["prefix"].get<string>() + m->getName();
       }
+      if (m->hasDef()) mod = m;
 
       this->addparams(m->getConfigParams());
       for (auto amap : m->getDefaultConfigArgs()) {
@@ -84,22 +94,29 @@ class VModule {
       this->addparams(g->getGenParams());
       this->addparams(g->getConfigParams());
     }
-    void addStmt(string stmt) { stmts.push_back(stmt); }
+    const string& getName() { return modname;}
+    Module* getModule() { return mod;}
+    bool isExternal() { return mod==nullptr;}
     string toCommentString() {
       return "//Module: " + modname + " defined externally";
     }
-    string toString();
-    string toInstanceString(Instance* inst);
+
+    //Renders the whole module definition into os.
+    //Only reads the IR so it is safe to render different modules concurrently
+    void writeToStream(std::ostream& os, const VModuleMap& modMap);
+    void writeInstance(std::ostream& os, Instance* inst);
   private :
-    void Type2Ports(Type* t,unordered_map<string,VWire>& ports) {
-      for (auto rmap : cast<RecordType>(t)->getRecord()) {
-        ports.emplace(rmap.first,VWire(rmap.first,rmap.second));
+    void Type2Ports(Type* t,vector<VWire>& ports) {
+      RecordType* rt = cast<RecordType>(t);
+      auto record = rt->getRecord();
+      for (auto field : rt->getFields()) {
+        ports.push_back(VWire(field,record.at(field)));
       }
     }
-    void addparams(Params ps) { 
+    void addparams(Params ps) {
       for (auto p : ps) {
         ASSERT(params.count(p.first)==0,"NYI Cannot have duplicate params");
-        params.insert(p.first); 
+        params.insert(p.first);
       }
     }
 };
@@ -11,6 +11,8 @@
 #include "analysis/strongverify.h"
 #include "analysis/verifyflattenedtypes.h"
 #include "analysis/createinstancemap.h"
+#include "analysis/combdepth.h"
+#include "analysis/combloops.h"
 
 //Transform passes
 #include "transform/flatten.h"
@@ -19,6 +21,13 @@
 #include "transform/removebulkconnections.h"
 #include "transform/liftclockports.h"
 #include "transform/wireclocks.h"
+#include "transform/constfold.h"
+#include "transform/cse.h"
+#include "transform/deadlogic.h"
+#include "transform/dedup.h"
+#include "transform/prune.h"
+#include "transform/bitblast.h"
+#include "transform/pipeline.h"
 
 
 //TODO Macrofy this
@@ -35,6 +44,8 @@ namespace CoreIR {
     pm.addPass(new Passes::WeakVerify());
     pm.addPass(new Passes::StrongVerify());
     pm.addPass(new Passes::VerifyFlattenedTypes());
+    pm.addPass(new Passes::CombDepth());
+    pm.addPass(new Passes::CombLoops());
     
     //Transform
     pm.addPass(new Passes::Flatten());
@@ -43,6 +54,14 @@ namespace CoreIR {
     pm.addPass(new Passes::RemoveBulkConnections());
     pm.addPass(new Passes::LiftClockPorts("liftclockports-coreir",c->Named("coreir.clkIn")));
     pm.addPass(new Passes::WireClocks("wireclocks-coreir",c->Named("coreir.clkIn")));
+    pm.addPass(new Passes::ConstFold());
+    pm.addPass(new Passes::CSE());
+    pm.addPass(new Passes::DeadLogic("deadlogic",false));
+    pm.addPass(new Passes::DeadLogic("deadlogic-ports",true));
+    pm.addPass(new Passes::Dedup());
+    pm.addPass(new Passes::Prune());
+    pm.addPass(new Passes::BitBlast());
+    pm.addPass(new Passes::Pipeline());
   }
 }
 
@@ -0,0 +1,22 @@
+#ifndef BITBLAST_HPP_
+#define BITBLAST_HPP_
+
+#include "coreir.h"
+
+namespace CoreIR {
+namespace Passes {
+
+//Replaces the definition of every flattened module (instances of coreir
+//primitives only) by 1 bit coreir and/not/const/reg instances: the module
+//is lowered to an Aig (see lowerToAig), cleaned up and lifted back.
+//Modules that instantiate anything else are left alone.
+class BitBlast : public ModulePass {
+  public :
+    static std::string ID;
+    BitBlast() : ModulePass(ID,"Lowers flattened modules to 1 bit and/not gates") {}
+    bool runOnModule(Module* m) override;
+};
+
+}
+}
+#endif
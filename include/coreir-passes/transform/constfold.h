@@ -0,0 +1,24 @@
+#ifndef CONSTFOLD_HPP_
+#define CONSTFOLD_HPP_
+
+#include "coreir.h"
+
+namespace CoreIR {
+namespace Passes {
+
+//Propagates constants through the coreir primitives bit by bit. Primitives
+//whose output is fully constant (including registers that can only ever
+//hold their init value) become a single coreir.const, constants that are no
+//longer read are removed and identities (x&~0, x|0, x+0, x*1, mux with a
+//constant select, ...) are replaced by wires.
+//Only primitives up to 64 bits wide are folded.
+class ConstFold : public ModulePass {
+  public :
+    static std::string ID;
+    ConstFold() : ModulePass(ID,"Propagates and folds constants through the coreir primitives and removes identities") {}
+    bool runOnModule(Module* m) override;
+};
+
+}
+}
+#endif
@@ -0,0 +1,23 @@
+#ifndef CSE_HPP_
+#define CSE_HPP_
+
+#include "coreir.h"
+
+namespace CoreIR {
+namespace Passes {
+
+//Common subexpression elimination over the combinational coreir primitives
+//(ops, const, slice and concat). Instances with the same primitive, args
+//and drivers are merged into one, visiting them in topological order so
+//that whole duplicated cones merge. The operands of add, mul, and, or, xor
+//and eq are compared in either order.
+class CSE : public ModulePass {
+  public :
+    static std::string ID;
+    CSE() : ModulePass(ID,"Merges combinational primitives with the same args and drivers") {}
+    bool runOnModule(Module* m) override;
+};
+
+}
+}
+#endif
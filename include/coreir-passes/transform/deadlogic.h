@@ -0,0 +1,50 @@
+#ifndef DEADLOGIC_HPP_
+#define DEADLOGIC_HPP_
+
+#include "coreir.h"
+
+namespace CoreIR {
+namespace Passes {
+
+//Removes the instances whose outputs cannot reach an output of their
+//module or an instance that has to stay (cgralib IOs, declarations without
+//a definition and modules containing those). coreir.term counts as a
+//reader of nothing. The instances are removed in bulk.
+//With removePorts, ports of the modules below the top that nothing reads
+//(inputs unused inside, outputs unused by every instance) are removed as
+//well. Modules are visited bottom up, so logic that only fed a removed
+//input is removed from the parents. Outputs only read by logic that is
+//dead in the modules above count as unused, so one run reaches a fixed
+//point.
+class DeadLogic : public InstanceGraphPass {
+  bool removePorts;
+  //Modules that have to stay even if nothing reads them
+  unordered_map<Module*,bool> sideEffects;
+  //Nets of a module definition and the ones live logic reads
+  struct Liveness {
+    std::shared_ptr<BitNets> nets;
+    vector<bool> liveNets;
+  };
+  //Modules above the current one (with removePorts)
+  unordered_map<ModuleDef*,Liveness> above;
+  unordered_map<Module*,InstanceGraphNode*> nodes;
+  public :
+    DeadLogic(std::string name, bool removePorts) : InstanceGraphPass(name,"Removes logic that does not reach an output" + string(removePorts ? " and unused ports" : "")), removePorts(removePorts) {}
+    bool runOnInstanceGraphNode(InstanceGraphNode& node) override;
+    void releaseMemory() override {
+      sideEffects.clear();
+      above.clear();
+      nodes.clear();
+    }
+  private :
+    bool removable(Instance* inst);
+    bool hasSideEffects(Module* m);
+    vector<bool> findLive(BitNets& nets, const vector<string>* outputs, vector<bool>& liveNets);
+    Liveness& getLiveness(ModuleDef* def);
+    //Output field of m is read by live logic above (or m is the top)
+    bool isRead(Module* m, string field);
+};
+
+}
+}
+#endif
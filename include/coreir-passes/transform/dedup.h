@@ -0,0 +1,25 @@
+#ifndef DEDUP_HPP_
+#define DEDUP_HPP_
+
+#include "coreir.h"
+
+namespace CoreIR {
+namespace Passes {
+
+//Merges structurally identical modules of every namespace. Modules are
+//visited children first, so instances of duplicates are already redirected
+//to their representative when the parents are hashed. Modules with the same
+//structural hash (type, config params, instance refs and args and the
+//connections, ignoring instance names) are confirmed with Module::isEqual.
+//Only duplicates in the namespaces the pass runs on are deleted, and
+//modules that are not instantiated anywhere (tops) are kept.
+class Dedup : public NamespacePass {
+  public :
+    static std::string ID;
+    Dedup() : NamespacePass(ID,"Merges structurally identical modules") {}
+    bool runOnNamespace(Namespace* ns) override;
+};
+
+}
+}
+#endif
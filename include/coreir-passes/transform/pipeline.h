@@ -0,0 +1,61 @@
+#ifndef PIPELINE_HPP_
+#define PIPELINE_HPP_
+
+#include "coreir.h"
+
+namespace CoreIR {
+namespace Passes {
+
+//Pipelines modules to a target combinational depth (in the levels of
+//combdepth). The target is the one given to the pass or the
+//{"timing":{"target":n}} metadata of a module, which takes precedence.
+//Modules are visited bottom up and not flattened: every instance gets a lag,
+//the cycles all its ports are delayed by, as small as its inputs allow and
+//one more if a path through it would get deeper than the target. Registers
+//(coreir.reg) are inserted on every connection between instances of
+//different lags, so reconvergent paths stay balanced. Plain registers
+//(without en, clr or rst and with init 0) are moved instead of adding
+//latency: one whose input already got a register earlier on is removed.
+//Registers and memories in feedback loops keep their lags.
+//Latency added to a submodule is balanced in the modules instantiating it.
+//Modules without a coreir.clkIn input are left alone, and so are modules
+//with an instance in a feedback loop of a module above them, as latency
+//would change the cycles of the loop (they only report missed targets).
+class Pipeline : public InstanceGraphPass {
+  int target;
+  unordered_map<Module*,map<string,int>> latencies;
+  //Modules with paths still deeper than their target
+  unordered_set<Module*> missed;
+  //Instances in feedback loops of the modules above the current one
+  unordered_map<Module*,unordered_set<Instance*>> loops;
+  public :
+    static std::string ID;
+    explicit Pipeline(int target=-1) : InstanceGraphPass(ID,"Inserts registers to meet a combinational depth"), target(target) {}
+    bool runOnInstanceGraphNode(InstanceGraphNode& node) override;
+    void setAnalysisInfo() override {
+      addDependency("constructInstanceGraph");
+      addDependency("combdepth");
+    }
+    void releaseMemory() override {
+      latencies.clear();
+      missed.clear();
+      loops.clear();
+    }
+    void print() override;
+
+    //Target depth of the modules without metadata (-1 for none)
+    void setTarget(int depth) { target = depth;}
+    //Cycles added by the last run to every output port of m (ports named
+    //like the nodes of a CombGraph)
+    const map<string,int>& getAddedLatency(Module* m);
+    //False if the last run left paths of m deeper than its target (inside
+    //a loop, a submodule or a single cell)
+    bool metTarget(Module* m) { return !missed.count(m);}
+  private :
+    bool inParentLoop(Module* m, unordered_map<Instantiable*,InstanceGraphNode*>& nodes, unordered_set<Module*>& visited);
+    bool pipeline(Module* m);
+};
+
+}
+}
+#endif
@@ -0,0 +1,21 @@
+#ifndef PRUNE_HPP_
+#define PRUNE_HPP_
+
+#include "coreir.h"
+
+namespace CoreIR {
+namespace Passes {
+
+//Deletes the modules of the namespace that are not reachable from the top
+//of the context (Context::setTop), and the modules generated by its
+//generators that are not reachable either. Generators themselves are kept.
+class Prune : public NamespacePass {
+  public :
+    static std::string ID;
+    Prune() : NamespacePass(ID,"Deletes the modules not reachable from the top") {}
+    bool runOnNamespace(Namespace* ns) override;
+};
+
+}
+}
+#endif
@@ -0,0 +1,67 @@
+#ifndef BITPARALLELSIM_HPP_
+#define BITPARALLELSIM_HPP_
+
+#include "simulator.h"
+
+namespace CoreIR {
+namespace Sim {
+
+//Simulates 64 independent stimuli at once. Every net is stored bit sliced:
+//one uint64_t per bit of the net, where bit l of the word is the value in
+//lane l. Bitwise ops, muxes, reductions, adds, subtracts, compares, shifts
+//and multiplies are evaluated for all lanes with word wide logic ops.
+//Divides, remainders and memories with per lane addresses fall back to
+//evaluating each lane with PrimOps.
+class BitParallelSimulator : public Simulator {
+  //Word 0 is always 0 (undriven bits)
+  vector<uint64_t> words;
+  //First word of every slot
+  vector<uint> slotWords;
+  //Per node and input, the word of every bit
+  vector<vector<vector<uint>>> inWords;
+  //Per top level output, the word of every bit
+  vector<vector<uint>> outWords;
+  //Bit sliced memory contents (depth*width words per memory)
+  vector<vector<uint64_t>> mems;
+  //Linebuffers advance in every lane at once
+  vector<uint> memPtrs;
+  vector<uint> memCounts;
+  uint64_t cycle = 0;
+  bool dirty = true;
+  //Next register values during the clock edge
+  vector<uint64_t> regNext;
+  //Operands of every node, gathered from their words before the node is
+  //evaluated (the inputs of node n start at opndFirst[n])
+  vector<uint64_t> opndWords;
+  vector<uint> opndFirst;
+  //Temporaries of the ops (twice the widest op)
+  vector<uint64_t> scratch;
+  public :
+    static const uint numLanes = 64;
+
+    explicit BitParallelSimulator(SimGraph* g);
+    void setInput(uint idx, uint64_t v) override;
+    uint64_t getOutput(uint idx) override { return getOutputLane(idx,0);}
+    uint64_t getSlot(uint slot) override { return getSlotLane(slot,0);}
+    void eval() override;
+    void step(uint n=1) override;
+    uint64_t getCycle() override { return cycle;}
+    void reset() override;
+    void getState(SimState& s) override;
+    void setState(const SimState& s) override;
+
+    uint getNumLanes() override { return numLanes;}
+    void setInputLane(uint idx, uint lane, uint64_t v) override;
+    uint64_t getOutputLane(uint idx, uint lane) override;
+    uint64_t getSlotLane(uint slot, uint lane);
+  private :
+    //Points opnds at the first num inputs of node nid
+    void gather(uint nid, uint num, const uint64_t** opnds);
+    void evalOp(const SimNode& n, uint nid);
+    void evalMem(const SimNode& n, uint nid);
+};
+
+}//Sim namespace
+}//CoreIR namespace
+
+#endif //BITPARALLELSIM_HPP_
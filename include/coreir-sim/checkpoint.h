@@ -0,0 +1,22 @@
+#ifndef CHECKPOINT_HPP_
+#define CHECKPOINT_HPP_
+
+#include "simulator.h"
+
+namespace CoreIR {
+namespace Sim {
+
+//Checkpoints hold the state of a simulation (cycle, inputs, registers and
+//memories) in a compact binary file. Combinational values are not stored;
+//they are settled again after loading.
+//A checkpoint can only be loaded into a simulator of the same design, which
+//is checked with SimGraph::getHash(). Any engine can load a checkpoint
+//written by any other (multi-lane engines save lane 0 and load into every
+//lane), so many experiments can be forked from one warm state.
+void saveCheckpoint(Simulator* sim, string filename);
+void loadCheckpoint(Simulator* sim, string filename);
+
+}//Sim namespace
+}//CoreIR namespace
+
+#endif //CHECKPOINT_HPP_
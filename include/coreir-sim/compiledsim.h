@@ -0,0 +1,61 @@
+#ifndef COMPILEDSIM_HPP_
+#define COMPILEDSIM_HPP_
+
+#include "simulator.h"
+
+namespace CoreIR {
+namespace Sim {
+
+//Emits straight line C++ for a SimGraph. Nodes are evaluated in level order
+//with every net in a fixed width local. The code only depends on <stdint.h>.
+//Exported (extern "C"), with the arguments taken from a SimState:
+//  void coreir_sim_eval(uint64_t* slots, uint64_t* const* mems, unsigned* ptrs, unsigned* counts, uint64_t* tmp)
+//  void coreir_sim_clock(uint64_t* slots, uint64_t* const* mems, unsigned* ptrs, unsigned* counts, uint64_t* tmp)
+//  unsigned coreir_sim_num_slots, coreir_sim_num_nodes
+//tmp holds the next register values during the clock edge (one per seq node)
+void writeSimCode(SimGraph* g, std::ostream& os);
+
+//$COREIR_SIM_CACHE, $XDG_CACHE_HOME/coreir-sim or ~/.cache/coreir-sim
+string defaultSimCacheDir();
+
+//Compiled code engine. The generated code is compiled with $CXX (c++ by
+//default) into a shared object which is dlopened. Shared objects are cached
+//in cacheDir by the hash of the design, so the compiler only runs the first
+//time a design is simulated. cacheDir is created only accessible by the
+//user, and it and the shared object have to belong to the user and not be
+//writable by others (asserts otherwise).
+//Every eval() evaluates every combinational node, so this pays off once a
+//good fraction of the design changes each cycle.
+class CompiledSimulator : public Simulator {
+  typedef void (*SimFun)(uint64_t*, uint64_t* const*, unsigned*, unsigned*, uint64_t*);
+  SimState state;
+  vector<uint64_t*> memData;
+  vector<uint64_t> regNext;
+  void* handle = nullptr;
+  SimFun evalFun = nullptr;
+  SimFun clockFun = nullptr;
+  bool dirty = true;
+  bool cached = false;
+  string libName;
+  public :
+    explicit CompiledSimulator(SimGraph* g, string cacheDir=defaultSimCacheDir());
+    ~CompiledSimulator();
+    void setInput(uint idx, uint64_t v) override;
+    uint64_t getOutput(uint idx) override;
+    uint64_t getSlot(uint slot) override { eval(); return state.slots[slot];}
+    void eval() override;
+    void step(uint n=1) override;
+    uint64_t getCycle() override { return state.cycle;}
+    void reset() override;
+    void getState(SimState& s) override;
+    void setState(const SimState& s) override;
+
+    //True if the shared object came from the cache
+    bool wasCached() { return cached;}
+    string getLibName() { return libName;}
+};
+
+}//Sim namespace
+}//CoreIR namespace
+
+#endif //COMPILEDSIM_HPP_
@@ -0,0 +1,45 @@
+#ifndef EQUIVALENCE_HPP_
+#define EQUIVALENCE_HPP_
+
+#include "simulator.h"
+
+namespace CoreIR {
+namespace Sim {
+
+struct EquivOptions {
+  //Cycles to simulate from reset in every lane
+  uint cycles = 1000;
+  //Seed of the random stimulus
+  uint64_t seed = 1;
+  //Bit-parallel lanes are filled with independent stimuli, so each run
+  //checks 64 stimuli. More runs use more seeds
+  uint runs = 1;
+};
+
+struct EquivResult {
+  bool equivalent = true;
+  //Set when the interfaces cannot be matched
+  string error;
+  //First mismatch (earliest cycle, then the lowest lane and output)
+  uint64_t cycle = 0;
+  //Output of a (like {"self","out","0"} or {"io1"} for cgralib.IO pins)
+  SelectPath output;
+  uint64_t valueA = 0;
+  uint64_t valueB = 0;
+  //Inputs of a for the failing stimulus, up to and including cycle
+  //(trace[cycle][idx], same order as the inputs of the SimGraph of a)
+  Trace stimulus;
+};
+
+//Checks that a and b behave the same by driving both with the same random
+//stimulus (see BitParallelSimulator) from reset and comparing the outputs
+//every cycle. Inputs and outputs are matched by name. Names also match
+//their flattened form (in.0.x matches in_0_x, see flattentypes), so a
+//module can be checked against itself after flatten/flattentypes.
+//Every input and output has to have a match of the same width.
+EquivResult checkEquivalence(Module* a, Module* b, EquivOptions opts=EquivOptions());
+
+}//Sim namespace
+}//CoreIR namespace
+
+#endif //EQUIVALENCE_HPP_
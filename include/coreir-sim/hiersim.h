@@ -0,0 +1,113 @@
+#ifndef HIERSIM_HPP_
+#define HIERSIM_HPP_
+
+#include "simulator.h"
+
+namespace CoreIR {
+namespace Sim {
+
+//An input of a primitive in every instance of its module
+struct HierInput {
+  //True if instance k reads the slots instance 0 reads plus k (like the
+  //nets inside the module do). Then in is the input of instance 0 and
+  //perInst is empty, otherwise perInst has the input of every instance.
+  bool shared = false;
+  SimInput in;
+  vector<SimInput> perInst;
+};
+
+//A primitive Instance of a module definition, elaborated once for all the
+//instances of the module. The state is a struct of arrays indexed by the
+//instance: output o of instance k is in slot outs[o]+k and the memory of
+//instance k is mem+k.
+struct HierNode {
+  //Node of instance 0 in the SimGraph (kind, op, width, init, ...)
+  const SimNode* proto;
+  uint module;
+  vector<HierInput> ins;
+  vector<uint> outs;
+  uint mem = 0;
+};
+
+//A module definition and the primitives in it
+struct HierModule {
+  ModuleDef* def;
+  uint numInsts = 0;
+  vector<uint> nodes;
+};
+
+//Instances of a HierNode that run together: the ones at the same level.
+//Ops whose operands are all whole slots over consecutive instances run a
+//kernel over the batch, so a module instantiated n times costs n iterations
+//of a tight loop per primitive instead of n separate nodes.
+struct SimBatch {
+  uint node;
+  //Instances in order[first,first+size) (ascending)
+  uint first;
+  uint size;
+  //Kernels: per operand, the slot of the first instance if the operand
+  //slots of the instances are consecutive, otherwise -1 (the slots are in
+  //opnds). Other batches evaluate instance by instance.
+  bool kernel = false;
+  int base[3] = {-1,-1,-1};
+  vector<uint> opnds[3];
+};
+
+//Shares the nodes and the evaluation code across the instances of a module
+//(see HierNode and SimBatch). Slots and memories are renumbered to the
+//struct of arrays layout. Registers of the same Instance are clocked
+//together the same way.
+class HierSimulator : public Simulator {
+  //Slots and memories are in the renumbered order
+  SimState state;
+  vector<HierModule> modules;
+  vector<HierNode> nodes;
+  vector<SimInput> outputs;
+  //Slot/memory of g -> slot/memory of state
+  vector<uint> slotMap;
+  vector<uint> memMap;
+  vector<uint> order;
+  //Combinational batches in level order
+  vector<SimBatch> batches;
+  //Registers of every instance, one batch per HierNode
+  vector<SimBatch> regBatches;
+  //HierNodes of memories
+  vector<uint> mems;
+  vector<uint64_t> regNext;
+  //Operands of kernels that have to be gathered
+  vector<uint64_t> gathered[3];
+  bool dirty = true;
+  public :
+    explicit HierSimulator(SimGraph* g);
+    void setInput(uint idx, uint64_t v) override;
+    uint64_t getOutput(uint idx) override;
+    uint64_t getSlot(uint slot) override { eval(); return state.slots[slotMap[slot]];}
+    void eval() override;
+    void step(uint n=1) override;
+    uint64_t getCycle() override { return state.cycle;}
+    void reset() override;
+    void getState(SimState& s) override;
+    void setState(const SimState& s) override;
+
+    const vector<HierModule>& getModules() { return modules;}
+    const vector<HierNode>& getNodes() { return nodes;}
+    const vector<SimBatch>& getBatches() { return batches;}
+    //Modules, nodes, batches and the instances evaluated by kernels
+    void printBatches(std::ostream& os);
+  private :
+    void elaborate();
+    void buildBatches(const vector<uint>& instOf, const vector<uint>& nodeOf);
+    void setKernel(SimBatch& b);
+    uint64_t read(const HierInput& in, uint k) {
+      return readInput(in.shared ? in.in : in.perInst[k],state.slots.data() + (in.shared ? k : 0));
+    }
+    void evalInst(const HierNode& h, uint k);
+    uint64_t clockInst(const HierNode& h, uint k);
+    void evalBatch(const SimBatch& b);
+    void clockBatch(const SimBatch& b, uint64_t* next);
+};
+
+}//Sim namespace
+}//CoreIR namespace
+
+#endif //HIERSIM_HPP_
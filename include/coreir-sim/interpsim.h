@@ -0,0 +1,57 @@
+#ifndef INTERPSIM_HPP_
+#define INTERPSIM_HPP_
+
+#include "simulator.h"
+
+namespace CoreIR {
+namespace Sim {
+
+//Event driven interpreter. Only nodes downstream of nets that changed are
+//evaluated, in level order so every node is evaluated at most once per eval()
+class InterpSimulator : public Simulator {
+  SimState state;
+  //Dirty nodes per level
+  vector<vector<uint>> buckets;
+  vector<char> queued;
+  bool pending = false;
+  uint64_t numEvals = 0;
+  //Profiling
+  uint profileInterval = 0;
+  bool counting = false;
+  SimProfile profile;
+  vector<uint64_t> regsBefore;
+  public :
+    explicit InterpSimulator(SimGraph* g);
+    void setInput(uint idx, uint64_t v) override;
+    uint64_t getOutput(uint idx) override;
+    uint64_t getSlot(uint slot) override { eval(); return state.slots[slot];}
+    void eval() override;
+    void step(uint n=1) override;
+    uint64_t getCycle() override { return state.cycle;}
+    void reset() override;
+    void getState(SimState& s) override;
+    void setState(const SimState& s) override;
+    void setProfiling(uint interval) override;
+    void getProfile(SimProfile& p) override { p = profile;}
+
+    //Number of node evaluations so far
+    uint64_t getNumEvals() { return numEvals;}
+  private :
+    void updateCounting() {
+      counting = profileInterval && state.cycle%profileInterval==0;
+    }
+    void schedule(uint nid) {
+      if (queued[nid]) return;
+      queued[nid] = 1;
+      buckets[g->nodes[nid].level].push_back(nid);
+      pending = true;
+    }
+    void scheduleReaders(uint slot) {
+      for (auto nid : g->readers[slot]) schedule(nid);
+    }
+};
+
+}//Sim namespace
+}//CoreIR namespace
+
+#endif //INTERPSIM_HPP_
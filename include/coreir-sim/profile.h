@@ -0,0 +1,24 @@
+#ifndef PROFILE_HPP_
+#define PROFILE_HPP_
+
+#include "simulator.h"
+
+namespace CoreIR {
+namespace Sim {
+
+//Writes the counts of a profile (see Simulator::setProfiling) into the
+//design as MetaData under "activity", replacing earlier counts:
+//  Instances of primitives: {"evals":<n>,"cycles":<n>}
+//  Ports driving a net (like add0.out, or self.in for top level inputs):
+//    {"toggles":<n>,"cycles":<n>}
+//Instances inside a module that is instantiated several times are shared by
+//every use, so their counts (cycles included) are summed over the uses.
+void annotateActivity(SimGraph* g, const SimProfile& p);
+
+//The Wireable driving a slot of g
+Wireable* getSlotWireable(SimGraph* g, uint slot);
+
+}//Sim namespace
+}//CoreIR namespace
+
+#endif //PROFILE_HPP_
@@ -0,0 +1,136 @@
+#ifndef SIMGRAPH_HPP_
+#define SIMGRAPH_HPP_
+
+#include "coreir.h"
+
+namespace CoreIR {
+namespace Sim {
+
+//Bits [srcLo,srcLo+len) of slot end up in bits [dstLo,dstLo+len) of a value
+struct Segment {
+  uint slot;
+  uint srcLo;
+  uint len;
+  uint dstLo;
+};
+
+//A value read by a node or by the outside world (top level outputs)
+//Undriven bits read as 0
+struct SimInput {
+  uint width = 0;
+  vector<Segment> segs;
+  //Slot if the value is exactly bits [0,width) of one slot, otherwise -1
+  int direct = -1;
+};
+
+//Every net driven by a primitive output or a top level input gets a slot.
+//A slot holds up to 64 bits packed in a uint64_t.
+struct SimSlot {
+  uint width;
+  //Hierarchical name of the driver (<inst path>.<port> or self.<port>)
+  string name;
+  //Node driving this slot or -1 for top level inputs
+  int driver;
+};
+
+//  NK_Op: Combinational coreir op (including mux)
+//  NK_Const: coreir.const, cgralib.Const
+//  NK_Reg: coreir.reg, cgralib.Reg. The out slot holds the state.
+//  NK_Mem: cgralib.Mem
+enum NodeKind {NK_Op, NK_Const, NK_Reg, NK_Mem};
+
+struct SimNode {
+  NodeKind kind;
+  PrimOps::Op op = PrimOps::OP_none;
+  //Width of the operands (or of the register/memory words)
+  uint width = 0;
+  //Ops: operands in port order
+  //Regs: in, en, clr, rst
+  //Mems: addr, wdata, wen
+  vector<SimInput> ins;
+  //Number of leading ins the outputs depend on combinationally
+  uint numCombIns = 0;
+  //Ops/Consts/Regs: out
+  //Mems: rdata, empty, full
+  vector<uint> outs;
+  //Const value or register init
+  uint64_t value = 0;
+  //Which of the optional register ports exist
+  bool en=false, clr=false, rst=false;
+  //Memories
+  uint depth = 0;
+  bool linebuffer = false;
+  uint mem = 0;
+  //Hierarchical instance name
+  string path;
+  //The instance in the definition of its parent module. Instances of modules
+  //that are instantiated several times share this.
+  Instance* inst = nullptr;
+  //Length of the longest combinational path to this node (0 for nodes that
+  //only depend on inputs, state or nothing)
+  uint level = 0;
+  bool isSeq() const { return kind==NK_Reg || kind==NK_Mem;}
+};
+
+//Flat simulation graph of a Module. Elaboration walks the hierarchy (no need
+//to flatten first), resolves all connections down to bits and removes the
+//primitives that are only wiring (slice, concat, passthrough, term, cgralib.IO).
+//Every port has to be at most 64 bits wide. cgralib.IO pins in input mode
+//become top level inputs and the others top level outputs (named by the
+//instance path).
+class SimGraph {
+  Module* top;
+  public :
+    vector<SimNode> nodes;
+    vector<SimSlot> slots;
+
+    //Top level inputs (one per Bit/Array of Bit in the type of top)
+    vector<uint> inputs;
+    vector<string> inputNames;
+    //Top level outputs
+    vector<SimInput> outputs;
+    vector<string> outputNames;
+
+    //Nodes that can be evaluated combinationally (Ops, Consts, Mems) in
+    //topological order
+    vector<uint> combOrder;
+    //Regs and Mems
+    vector<uint> seqNodes;
+    //Per slot, the nodes that depend on it combinationally
+    vector<vector<uint>> readers;
+    uint numLevels = 0;
+    uint numMems = 0;
+
+    //Runs the generators needed
+    explicit SimGraph(Module* top);
+    Module* getTop() { return top;}
+
+    //Top level port names are relative to self (like "in.0")
+    //Returns -1 if there is no such input/output/slot
+    int getInput(string name);
+    int getOutput(string name);
+    int getSlot(string name);
+
+    //Stable hash of the design (every module definition in the hierarchy)
+    uint64_t getHash() { return hash;}
+  private :
+    unordered_map<string,uint> inputMap;
+    unordered_map<string,uint> outputMap;
+    unordered_map<string,uint> slotMap;
+    uint64_t hash = 0;
+};
+
+//Reads in from slots
+inline uint64_t readInput(const SimInput& in, const uint64_t* slots) {
+  if (in.direct>=0) return slots[in.direct];
+  uint64_t v = 0;
+  for (auto& seg : in.segs) {
+    v |= ((slots[seg.slot]>>seg.srcLo) & PrimOps::mask(seg.len)) << seg.dstLo;
+  }
+  return v;
+}
+
+}//Sim namespace
+}//CoreIR namespace
+
+#endif //SIMGRAPH_HPP_
@@ -0,0 +1,131 @@
+#ifndef SIMULATOR_HPP_
+#define SIMULATOR_HPP_
+
+#include "coreir.h"
+#include "simgraph.h"
+
+namespace CoreIR {
+namespace Sim {
+
+//State of the word level engines
+struct SimState {
+  //One value per slot. Registers keep their state in their out slot
+  vector<uint64_t> slots;
+  //Contents of every memory
+  vector<vector<uint64_t>> mems;
+  //Linebuffer memories: next word to write and number of words written (up to depth)
+  vector<uint> memPtrs;
+  vector<uint> memCounts;
+  uint64_t cycle = 0;
+
+  SimState() {}
+  explicit SimState(SimGraph* g) { reset(g);}
+  //Registers are set to their init values, memories to 0. Inputs are kept
+  void reset(SimGraph* g);
+};
+
+//Activity counts of a simulation (see Simulator::setProfiling)
+struct SimProfile {
+  //Number of cycles counted
+  uint64_t cycles = 0;
+  //Per slot, number of bits that flipped
+  vector<uint64_t> toggles;
+  //Per node, number of evaluations (sequential nodes count their clock edges)
+  vector<uint64_t> evals;
+
+  SimProfile() {}
+  explicit SimProfile(SimGraph* g) { clear(g);}
+  void clear(SimGraph* g);
+  //Adds the toggles and evals of p (not the cycles)
+  void merge(const SimProfile& p);
+};
+
+//Reference semantics of the nodes, shared by the word level engines
+//Computes the outputs of the combinational node n into slots (memories are
+//read from s). Returns if any of them changed
+bool evalNode(const SimNode& n, uint64_t* slots, const SimState& s);
+inline bool evalNode(const SimNode& n, SimState& s) {
+  return evalNode(n,s.slots.data(),s);
+}
+
+//Clock edge of the sequential node n reading its inputs from slots.
+//Registers return their next value without committing it. Memories are
+//written to s right away (nothing reads memory contents during the edge).
+uint64_t clockNode(const SimNode& n, const uint64_t* slots, SimState& s);
+
+//Clocks every register and memory. All next values are computed before any
+//is committed. The register slots that changed and the memory nodes (whose
+//outputs need to be evaluated again) are appended to changedSlots/touchedNodes.
+void clockEdge(SimGraph* g, SimState& s, vector<uint>* changedSlots=nullptr, vector<uint>* touchedNodes=nullptr);
+
+//Common interface of the simulation engines.
+//There is a single implicit clock: step() clocks every register and memory
+//(clk ports are ignored and rst is applied at the clock edge).
+//A cycle is: set the inputs, step(), read the outputs.
+class Simulator {
+  protected :
+    SimGraph* g;
+  public :
+    explicit Simulator(SimGraph* g) : g(g) {}
+    virtual ~Simulator() {}
+    SimGraph* getGraph() { return g;}
+
+    //Indices into the inputs/outputs/slots of the SimGraph
+    virtual void setInput(uint idx, uint64_t v)=0;
+    virtual uint64_t getOutput(uint idx)=0;
+    virtual uint64_t getSlot(uint slot)=0;
+
+    //Settles the combinational logic
+    virtual void eval()=0;
+    //Settles the combinational logic, clocks and settles again (n times)
+    virtual void step(uint n=1)=0;
+    virtual uint64_t getCycle()=0;
+    //Back to the initial state (cycle 0, registers at init, memories 0)
+    //Inputs are kept
+    virtual void reset()=0;
+
+    //Full state (every slot, memory contents and cycle) after eval()
+    virtual void getState(SimState& s)=0;
+    //Continues from s, which has to come from the same design. The
+    //combinational logic is settled again from the inputs and registers
+    virtual void setState(const SimState& s)=0;
+
+    //Engines that simulate several independent stimuli at once have a lane
+    //per stimulus. setInput sets every lane and getOutput/getSlot read lane 0.
+    //Likewise getState reads lane 0 and setState sets every lane.
+    virtual uint getNumLanes() { return 1;}
+    virtual void setInputLane(uint idx, uint lane, uint64_t v);
+    virtual uint64_t getOutputLane(uint idx, uint lane);
+
+    //Activity profiling: counts the bit flips of every net and the
+    //evaluations of every node during every interval'th cycle (1 is every
+    //cycle, 0 turns profiling off). Turning it on clears the counts.
+    //Engines that cannot profile (compiled, bitparallel) assert.
+    virtual void setProfiling(uint interval);
+    virtual void getProfile(SimProfile& p);
+
+    //Top level ports relative to self (like "in.0") or any slot name
+    void setValue(string name, uint64_t v);
+    uint64_t getValue(string name);
+};
+
+//Values of the top level inputs or outputs of every cycle: trace[cycle][idx]
+typedef vector<vector<uint64_t>> Trace;
+
+//Runs every stimulus from reset and returns the outputs of every cycle.
+//The outputs of a cycle are read after its inputs are set and before the
+//clock edge. Stimuli are run getNumLanes() at a time.
+vector<Trace> simulateBatch(Simulator* sim, const vector<Trace>& stimuli);
+
+//engine is one of:
+//  interp: event driven interpreter
+//  compiled: compiled code (see CompiledSimulator)
+//  bitparallel: 64 stimuli at once (see BitParallelSimulator)
+//  threaded: partitioned across defaultNumThreads() threads (see ThreadedSimulator)
+//  hier: code shared by the instances of a module (see HierSimulator)
+Simulator* newSimulator(SimGraph* g, string engine="interp");
+
+}//Sim namespace
+}//CoreIR namespace
+
+#endif //SIMULATOR_HPP_
@@ -0,0 +1,113 @@
+#ifndef THREADEDSIM_HPP_
+#define THREADEDSIM_HPP_
+
+#include "simulator.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace CoreIR {
+namespace Sim {
+
+//Sense reversing barrier. Waiters spin (then yield) on an atomic generation
+//counter, so passing the barrier needs no locks.
+class SpinBarrier {
+  uint n;
+  std::atomic<uint> count;
+  std::atomic<uint> generation;
+  public :
+    explicit SpinBarrier(uint n=1) : n(n), count(0), generation(0) {}
+    //Only while nobody is waiting
+    void setSize(uint size) { n = size;}
+    void wait();
+};
+
+//Partitions are cut at register boundaries: each one owns a set of
+//sequential nodes and top level outputs and evaluates the combinational
+//cones feeding them into private slots. Nodes shared by several cones are
+//evaluated by each of them, so partitions never wait on each other within
+//a cycle. A cycle is
+//  eval: copy inputs/register outputs in, evaluate the cones, publish the
+//        nodes this partition owns to the shared state
+//  barrier
+//  clock: compute and commit the next state of the owned sequential nodes
+//  barrier
+//Every partition computes exactly what the serial engines compute, so the
+//results do not depend on the number of threads.
+struct SimPartition {
+  //Combinational nodes in topological order
+  vector<uint> nodes;
+  vector<uint> seqNodes;
+  //Slots read from the shared state (top level inputs and register outputs)
+  vector<uint> sources;
+  //Slots written back to the shared state (each slot has a single owner)
+  vector<uint> owned;
+  //Nodes also evaluated by another partition
+  uint numShared = 0;
+  //Time spent evaluating (not waiting at barriers)
+  double seconds = 0;
+};
+
+class ThreadedSimulator : public Simulator {
+  SimState state;
+  vector<SimPartition> parts;
+  //Private slots of every partition
+  vector<vector<uint64_t>> partSlots;
+  vector<vector<uint64_t>> partNext;
+  bool dirty = true;
+  //Profiling: every partition counts into its own profile (the evaluations
+  //it does and the slots and registers it owns). Top level inputs are
+  //counted in profile.
+  uint profileInterval = 0;
+  SimProfile profile;
+  vector<SimProfile> partProfiles;
+
+  //Commands for the worker threads. Partition 0 runs on the calling thread
+  enum Command {CMD_eval, CMD_step, CMD_quit};
+  vector<std::thread> workers;
+  SpinBarrier barrier;
+  std::mutex cmdMutex;
+  std::condition_variable cmdCond;
+  Command cmd = CMD_eval;
+  uint cmdCycles = 0;
+  uint64_t cmdGen = 0;
+  public :
+    //numThreads 0 uses defaultNumThreads(). There are never more partitions
+    //than sequential nodes and outputs.
+    explicit ThreadedSimulator(SimGraph* g, uint numThreads=0);
+    ~ThreadedSimulator();
+    void setInput(uint idx, uint64_t v) override;
+    uint64_t getOutput(uint idx) override;
+    uint64_t getSlot(uint slot) override { eval(); return state.slots[slot];}
+    void eval() override;
+    void step(uint n=1) override;
+    uint64_t getCycle() override { return state.cycle;}
+    void reset() override;
+    void getState(SimState& s) override;
+    void setState(const SimState& s) override;
+    //Nodes shared by several partitions count one evaluation per partition
+    void setProfiling(uint interval) override;
+    void getProfile(SimProfile& p) override;
+
+    const vector<SimPartition>& getPartitions() { return parts;}
+    //max/mean of the per partition evaluation time (1 is perfectly balanced)
+    double getImbalance();
+    //Nodes, shared nodes and time of every partition
+    void printImbalance(std::ostream& os);
+  private :
+    void partition(uint numParts);
+    void run(uint p, Command c, uint cycles);
+    bool counting(uint64_t cycle) {
+      return profileInterval && cycle%profileInterval==0;
+    }
+    void evalPhase(uint p, bool count);
+    void clockPhase(uint p, bool count);
+    void worker(uint p);
+    void command(Command c, uint cycles);
+};
+
+}//Sim namespace
+}//CoreIR namespace
+
+#endif //THREADEDSIM_HPP_
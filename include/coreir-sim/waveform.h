@@ -0,0 +1,117 @@
+#ifndef WAVEFORM_HPP_
+#define WAVEFORM_HPP_
+
+#include "simulator.h"
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+namespace CoreIR {
+namespace Sim {
+
+//  WF_VCD: Value change dump text
+//  WF_Block: Binary blocks of varint encoded value changes. Every block
+//    starts with the value of every signal and an index at the end of the
+//    file gives the first cycle and offset of each block, so a late cycle
+//    can be read without decoding the blocks before it (see WaveformReader)
+enum WaveFormat {WF_VCD, WF_Block};
+
+struct WaveOptions {
+  //Only signals under one of these paths (empty: every signal).
+  //Nets are named by instance path and port ({"lb","mem_1","rdata"}) and the
+  //top level ports are under "self".
+  vector<SelectPath> scopes;
+  //Cycle ranges [first,second) to record (empty: every cycle)
+  vector<std::pair<uint64_t,uint64_t>> windows;
+  WaveFormat format = WF_VCD;
+  //WF_Block: cycles per block
+  uint blockCycles = 1024;
+};
+
+//A recorded signal: a net of the SimGraph or a top level output
+struct WaveSignal {
+  //Instance path of the scope (empty for the top)
+  vector<string> scope;
+  string name;
+  uint width;
+  //Slot or -1 for top level outputs
+  int slot;
+  int output;
+};
+
+//A sample of the signals at a cycle. snapshot samples have every signal,
+//the others only the signals that changed since the previous sample.
+struct WaveEvent {
+  uint64_t cycle;
+  bool snapshot;
+  vector<std::pair<uint,uint64_t>> changes;
+};
+
+class WaveSink;
+
+//Streams the value changes of a simulation to a file. sample() only diffs
+//the values against the previous sample; formatting and (buffered) file IO
+//happen on a writer thread. At most a bounded number of samples is queued.
+class WaveformWriter {
+  Simulator* sim;
+  WaveOptions opts;
+  vector<WaveSignal> signals;
+  vector<uint64_t> last;
+  bool inWindow = false;
+  WaveSink* sink;
+
+  std::thread writer;
+  std::mutex queueMutex;
+  std::condition_variable queueCond;
+  std::deque<WaveEvent> queue;
+  bool closing = false;
+  bool closed = false;
+  public :
+    WaveformWriter(Simulator* sim, string filename, WaveOptions opts=WaveOptions());
+    ~WaveformWriter();
+    //Records the values at sim->getCycle(). Call once per cycle (after
+    //setting the inputs, like simulateBatch)
+    void sample();
+    //Writes everything queued and closes the file
+    void close();
+    const vector<WaveSignal>& getSignals() { return signals;}
+  private :
+    bool selected(const vector<string>& path);
+    void push(WaveEvent&& e);
+    void writerLoop();
+};
+
+//Reads files written with WF_Block
+class WaveformReader {
+  std::ifstream fin;
+  vector<string> names;
+  vector<uint> widths;
+  //First cycle, last cycle and offset of every block
+  struct Block {
+    uint64_t first;
+    uint64_t last;
+    uint64_t offset;
+    uint64_t size;
+  };
+  vector<Block> blocks;
+  public :
+    explicit WaveformReader(string filename);
+    //Full names (scope and name joined with .)
+    const vector<string>& getNames() { return names;}
+    const vector<uint>& getWidths() { return widths;}
+    //-1 if there is no such signal
+    int getSignal(string name);
+    uint64_t getFirstCycle();
+    uint64_t getLastCycle();
+    uint getNumBlocks() { return blocks.size();}
+    //Values of every signal at cycle (the last recorded values for cycles
+    //outside the recorded windows). Only the block containing cycle is read
+    vector<uint64_t> valuesAt(uint64_t cycle);
+};
+
+}//Sim namespace
+}//CoreIR namespace
+
+#endif //WAVEFORM_HPP_
@@ -7,6 +7,11 @@
 //Also should create coreir/ to put all these files in to be consistent
 #include "../src/ir/context.hpp"
 #include "../src/ir/directedview.hpp"
+#include "../src/ir/parallel.hpp"
+#include "../src/ir/primops.hpp"
+#include "../src/ir/structuralhash.hpp"
+#include "../src/ir/bitnets.hpp"
+#include "../src/ir/aig.hpp"
 #include "passmanager.h"
 #include "passes.h"
 #include "instancegraph.h"
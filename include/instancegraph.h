@@ -7,6 +7,11 @@
 namespace CoreIR {
 
 class InstanceGraphNode;
+
+//Adds every module and generator instantiated (transitively) by top, and
+//top itself, to reachable. Crosses namespaces.
+void addReachable(Module* top, std::unordered_set<Instantiable*>& reachable);
+
 class InstanceGraph {
   std::unordered_map<Instantiable*,InstanceGraphNode*> nodeMap;
   //std::unordered_map<Instantiable*,InstanceGraphNode*> externalNodeMap;
@@ -29,6 +29,8 @@ class Pass {
     void addDependency(string name) { dependencies.push_back(name);}
     Context* getContext();
     std::string getName() { return name;}
+    //See PassManager::setTopOnly
+    bool inScope(Instantiable* i);
     virtual void print() {}
     
     template<typename T>
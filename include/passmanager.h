@@ -21,6 +21,10 @@ class PassManager {
   
   vector<string> passLog;
   bool verbose = false;
+
+  //See setTopOnly
+  bool topOnly = false;
+  std::unordered_set<Instantiable*> scope;
   public:
     typedef vector<std::string> PassOrder;
     explicit PassManager(Context* c);
@@ -34,9 +38,20 @@ class PassManager {
     bool run(PassOrder order, vector<string> namespaceName={"global"});
 
     void setVerbosity(bool v) { verbose = v;}
+    
+    //Restricts module and instance graph passes (and the modules emitted by
+    //coreirjson) to the modules and generators reachable from the top of
+    //the context. Does nothing if the context has no top.
+    void setTopOnly(bool t);
+    bool isTopOnly() { return topOnly;}
+    //If passes should visit i (always true without topOnly)
+    bool inScope(Instantiable* i) {
+      return !topOnly || !c->hasTop() || scope.count(i)>0;
+    }
     void printLog();
     void printPassChoices();
 
+    bool hasPass(std::string ID) { return passMap.count(ID)>0;}
     Pass* getAnalysisPass(std::string ID) {
       assert(passMap.count(ID));
       return passMap[ID];
@@ -47,6 +62,8 @@ class PassManager {
 
     friend class Pass;
     bool runPass(Pass* p);
+    //Recomputes the modules reachable from the top
+    void updateScope();
     bool runNamespacePass(Pass* p);
     bool runModulePass(Pass* p);
     bool runInstanceGraphPass(Pass* p);
@@ -0,0 +1,111 @@
+#include "coreir.h"
+#include "cxxopts.hpp"
+#include <dlfcn.h>
+#include <fstream>
+
+#include "coreir-sim/equivalence.h"
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+//Loads the external libs into c
+void loadLibs(Context* c, string libs, vector<void*>& libHandles) {
+  vector<string> files = splitString<vector<string>>(libs,',');
+  for (auto file : files) {
+    vector<string> f1parse = splitString<vector<string>>(file,'/');
+    string libfile = f1parse[f1parse.size()-1];
+    vector<string> f2parse = splitRef(libfile);
+    ASSERT(f2parse[1]=="so" || f2parse[1]=="dylib","Bad file: " + file);
+    string libname = f2parse[0].substr(10,f2parse[0].length()-10);
+    void* libHandle = dlopen(file.c_str(),RTLD_LAZY);
+    ASSERT(libHandle,"Cannot open file: " + file);
+    string funname = "ExternalLoadLibrary_"+libname;
+    LoadLibrary_t* loadLib = (LoadLibrary_t*) dlsym(libHandle,funname.c_str());
+    ASSERT(loadLib,"Cannot load symbol " + funname);
+    ASSERT(loadLib(c),"NS is null in file " + file);
+    libHandles.push_back(libHandle);
+  }
+}
+
+Module* loadTop(Context* c, string filename) {
+  Module* top;
+  if (!loadFromFile(c,filename,&top)) {
+    c->die();
+  }
+  ASSERT(top,"No top in " + filename);
+  return top;
+}
+
+int main(int argc, char *argv[]) {
+  int argc_copy = argc;
+  cxxopts::Options options("coreir-equiv", "checks that two designs behave the same with random simulation");
+  options.add_options()
+    ("h,help","help")
+    ("a,first","first design: <file>.json",cxxopts::value<std::string>())
+    ("b,second","second design: <file>.json (default: the first design)",cxxopts::value<std::string>())
+    ("p,passes","passes to run on the second design first: '<pass>,<pass>,...'",cxxopts::value<std::string>())
+    ("l,load_libs","external libs: '<path/libname0.so>,<path/libname1.so>,<path/libname2.so>,...'",cxxopts::value<std::string>())
+    ("n,cycles","cycles per run (default: 1000)",cxxopts::value<int>())
+    ("r,runs","runs of 64 random stimuli each (default: 1)",cxxopts::value<int>())
+    ("s,seed","random seed (default: 1)",cxxopts::value<int>())
+    ("w,write","on a mismatch, write the failing stimulus for coreir-sim -s: <file>",cxxopts::value<std::string>())
+    ;
+  options.parse(argc,argv);
+
+  if (options.count("h") || argc_copy==1) {
+    cout << options.help() << endl;
+    return 0;
+  }
+  ASSERT(options.count("a"),"No first design specified");
+  string fileA = options["a"].as<string>();
+  string fileB = options.count("b") ? options["b"].as<string>() : fileA;
+
+  //Each design gets its own context, so the passes only change the second
+  Context* ca = newContext();
+  Context* cb = newContext();
+  vector<void*> libHandles;
+  if (options.count("l")) {
+    loadLibs(ca,options["l"].as<string>(),libHandles);
+    loadLibs(cb,options["l"].as<string>(),libHandles);
+  }
+  Module* a = loadTop(ca,fileA);
+  Module* b = loadTop(cb,fileB);
+  if (options.count("p")) {
+    cb->runPasses(splitString<vector<string>>(options["p"].as<string>(),','));
+  }
+
+  EquivOptions opts;
+  if (options.count("n")) opts.cycles = options["n"].as<int>();
+  if (options.count("r")) opts.runs = options["r"].as<int>();
+  if (options.count("s")) opts.seed = options["s"].as<int>();
+  EquivResult res = checkEquivalence(a,b,opts);
+  if (res.equivalent) {
+    cout << "Equivalent over " << opts.runs*64 << " random stimuli of " << opts.cycles << " cycles" << endl;
+  }
+  else if (res.error!="") {
+    cout << "Cannot compare: " << res.error << endl;
+  }
+  else {
+    string out = join(res.output.begin(),res.output.end(),string("."));
+    cout << "Mismatch in cycle " << res.cycle << " on " << out << ": ";
+    cout << res.valueA << " (" << fileA << ") != " << res.valueB << " (" << fileB << ")" << endl;
+    if (options.count("w")) {
+      string wfile = options["w"].as<string>();
+      std::ofstream fout(wfile);
+      ASSERT(fout.is_open(),"Cannot open file: " + wfile);
+      fout << "# Mismatch in cycle " << res.cycle << " on " << out << endl;
+      SimGraph g(a);
+      for (auto& cycle : res.stimulus) {
+        for (uint idx=0; idx<cycle.size(); ++idx) {
+          fout << (idx ? " " : "") << g.inputNames[idx] << "=" << cycle[idx];
+        }
+        fout << endl;
+      }
+    }
+  }
+
+  deleteContext(ca);
+  deleteContext(cb);
+  for (auto handle : libHandles) dlclose(handle);
+  return res.equivalent ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+#include "coreir.h"
+#include "cxxopts.hpp"
+#include <dlfcn.h>
+#include <fstream>
+
+#include "coreir-sim/simulator.h"
+#include "coreir-sim/checkpoint.h"
+#include "coreir-sim/profile.h"
+#include "coreir-sim/compiledsim.h"
+#include "coreir-sim/threadedsim.h"
+#include "coreir-sim/hiersim.h"
+#include "coreir-sim/waveform.h"
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+//Stimulus files have one line per cycle of space separated <input>=<value>
+//(decimal or 0x hex). Inputs keep their value until they are set again.
+//Empty lines and lines starting with # are skipped.
+bool parseStimulus(string line, vector<std::pair<string,uint64_t>>& assigns) {
+  assigns.clear();
+  for (auto tok : splitString<vector<string>>(line,' ')) {
+    if (tok=="") continue;
+    auto kv = splitString<vector<string>>(tok,'=');
+    ASSERT(kv.size()==2,"Bad stimulus: " + tok);
+    assigns.push_back({kv[0],std::stoull(kv[1],nullptr,0)});
+  }
+  return true;
+}
+
+void printOutputs(Simulator* sim) {
+  SimGraph* g = sim->getGraph();
+  cout << sim->getCycle() << ":";
+  for (uint i=0; i<g->outputs.size(); ++i) {
+    cout << " " << g->outputNames[i] << "=" << sim->getOutput(i);
+  }
+  cout << endl;
+}
+
+//The most active nets and nodes
+void printProfile(SimGraph* g, const SimProfile& p, uint num) {
+  cout << "Activity over " << p.cycles << " counted cycles" << endl;
+  vector<uint> slots(g->slots.size());
+  for (uint i=0; i<slots.size(); ++i) slots[i] = i;
+  std::stable_sort(slots.begin(),slots.end(),[&](uint a, uint b) { return p.toggles[a]>p.toggles[b];});
+  cout << "Toggles:" << endl;
+  for (uint i=0; i<std::min(num,(uint) slots.size()); ++i) {
+    cout << "  " << g->slots[slots[i]].name << ": " << p.toggles[slots[i]] << endl;
+  }
+  vector<uint> nodes(g->nodes.size());
+  for (uint i=0; i<nodes.size(); ++i) nodes[i] = i;
+  std::stable_sort(nodes.begin(),nodes.end(),[&](uint a, uint b) { return p.evals[a]>p.evals[b];});
+  cout << "Evaluations:" << endl;
+  for (uint i=0; i<std::min(num,(uint) nodes.size()); ++i) {
+    cout << "  " << g->nodes[nodes[i]].path << ": " << p.evals[nodes[i]] << endl;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int argc_copy = argc;
+  cxxopts::Options options("coreir-sim", "simulates the top module of a coreir design");
+  options.add_options()
+    ("h,help","help")
+    ("i,input","input file: <file>.json",cxxopts::value<std::string>())
+    ("l,load_libs","external libs: '<path/libname0.so>,<path/libname1.so>,<path/libname2.so>,...'",cxxopts::value<std::string>())
+    ("e,engine","simulation engine: <interp|compiled|bitparallel|threaded|hier>",cxxopts::value<std::string>()->default_value("interp"))
+    ("t,threads","threads for the threaded engine (default: all cores)",cxxopts::value<int>())
+    ("c,cache","directory for compiled simulations (default: $COREIR_SIM_CACHE or ~/.cache/coreir-sim)",cxxopts::value<std::string>())
+    ("s,stimulus","stimulus file: one line of '<input>=<value> ...' per cycle",cxxopts::value<std::string>())
+    ("n,cycles","number of cycles to run (default: one per stimulus line)",cxxopts::value<int>())
+    ("w,waves","waveform file: <file>.vcd or <file>.cwav (indexed block format)",cxxopts::value<std::string>())
+    ("f,filter","only dump signals under these paths: '<inst.inst>,<inst>,self,...'",cxxopts::value<std::string>())
+    ("load","start from a checkpoint of the same design: <file>",cxxopts::value<std::string>())
+    ("save","checkpoint the state after the last cycle: <file>",cxxopts::value<std::string>())
+    ("p,profile","count net toggles and node evaluations every <n>th cycle (interp and threaded engines)",cxxopts::value<int>())
+    ("a,annotate","with -p, save the design with the counts as metadata: <file>.json",cxxopts::value<std::string>())
+    ("q,quiet","only print the outputs after the last cycle")
+    ;
+  options.parse(argc,argv);
+
+  if (options.count("h") || argc_copy==1) {
+    cout << options.help() << endl;
+    return 0;
+  }
+
+  Context* c = newContext();
+  vector<void*> libHandles;
+  if (options.count("l")) {
+    vector<string> files = splitString<vector<string>>(options["l"].as<string>(),',');
+    for (auto file : files) {
+      vector<string> f1parse = splitString<vector<string>>(file,'/');
+      string libfile = f1parse[f1parse.size()-1];
+      vector<string> f2parse = splitRef(libfile);
+      ASSERT(f2parse[1]=="so" || f2parse[1]=="dylib","Bad file: " + file);
+      string libname = f2parse[0].substr(10,f2parse[0].length()-10);
+      void* libHandle = dlopen(file.c_str(),RTLD_LAZY);
+      ASSERT(libHandle,"Cannot open file: " + file);
+      string funname = "ExternalLoadLibrary_"+libname;
+      LoadLibrary_t* loadLib = (LoadLibrary_t*) dlsym(libHandle,funname.c_str());
+      ASSERT(loadLib,"Cannot load symbol " + funname);
+      ASSERT(loadLib(c),"NS is null in file " + file);
+      libHandles.push_back(libHandle);
+    }
+  }
+
+  ASSERT(options.count("i"),"No input specified");
+  string infileName = options["i"].as<string>();
+  Module* top;
+  if (!loadFromFile(c,infileName,&top)) {
+    c->die();
+  }
+  ASSERT(top,"No top in " + infileName);
+
+  SimGraph graph(top);
+  string engine = options["e"].as<string>();
+  Simulator* sim;
+  ThreadedSimulator* threaded = nullptr;
+  HierSimulator* hier = nullptr;
+  if (engine=="compiled" && options.count("c")) {
+    sim = new CompiledSimulator(&graph,options["c"].as<string>());
+  }
+  else if (engine=="threaded") {
+    threaded = new ThreadedSimulator(&graph,options.count("t") ? options["t"].as<int>() : 0);
+    sim = threaded;
+  }
+  else if (engine=="hier") {
+    hier = new HierSimulator(&graph);
+    sim = hier;
+  }
+  else {
+    sim = newSimulator(&graph,engine);
+  }
+  cout << "Simulating " << top->getRefName() << ": " << graph.nodes.size() << " nodes, " << graph.slots.size() << " nets" << endl;
+  if (options.count("load")) {
+    loadCheckpoint(sim,options["load"].as<string>());
+    cout << "Restored cycle " << sim->getCycle() << endl;
+  }
+
+  vector<vector<std::pair<string,uint64_t>>> stimulus;
+  if (options.count("s")) {
+    string sfile = options["s"].as<string>();
+    std::ifstream fin(sfile);
+    ASSERT(fin.is_open(),"Cannot open file: " + sfile);
+    string line;
+    vector<std::pair<string,uint64_t>> assigns;
+    while (std::getline(fin,line)) {
+      if (line=="" || line[0]=='#') continue;
+      parseStimulus(line,assigns);
+      stimulus.push_back(assigns);
+    }
+  }
+  WaveformWriter* waves = nullptr;
+  if (options.count("w")) {
+    string wfile = options["w"].as<string>();
+    WaveOptions wopts;
+    string ext = wfile.substr(wfile.find_last_of('.')+1);
+    if (ext=="cwav") wopts.format = WF_Block;
+    if (options.count("f")) {
+      for (auto path : splitString<vector<string>>(options["f"].as<string>(),',')) {
+        vector<string> p = splitString<vector<string>>(path,'.');
+        wopts.scopes.push_back(SelectPath(p.begin(),p.end()));
+      }
+    }
+    waves = new WaveformWriter(sim,wfile,wopts);
+  }
+
+  if (options.count("p")) sim->setProfiling(options["p"].as<int>());
+
+  uint cycles = options.count("n") ? options["n"].as<int>() : stimulus.size();
+  bool quiet = options.count("q");
+  for (uint i=0; i<cycles; ++i) {
+    if (i<stimulus.size()) {
+      for (auto kv : stimulus[i]) sim->setValue(kv.first,kv.second);
+    }
+    if (waves) waves->sample();
+    sim->step();
+    if (!quiet) printOutputs(sim);
+  }
+  if (quiet) printOutputs(sim);
+  if (threaded) threaded->printImbalance(cout);
+  if (hier) hier->printBatches(cout);
+  if (options.count("save")) saveCheckpoint(sim,options["save"].as<string>());
+  if (options.count("p")) {
+    SimProfile profile;
+    sim->getProfile(profile);
+    printProfile(&graph,profile,10);
+    if (options.count("a")) {
+      annotateActivity(&graph,profile);
+      saveToFilePretty(top->getNamespace(),options["a"].as<string>(),top);
+    }
+  }
+  if (waves) delete waves;
+
+  delete sim;
+  deleteContext(c);
+  for (auto handle : libHandles) dlclose(handle);
+  return 0;
+}
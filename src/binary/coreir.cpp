@@ -2,6 +2,10 @@
 #include "cxxopts.hpp"
 #include <dlfcn.h>
 #include <fstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 #include "coreir-passes/analysis/firrtl.h"
 #include "coreir-passes/analysis/coreirjson.h"
@@ -48,6 +52,287 @@ bool shutdown(Context* c,OpenPassHandles_t openPassHandles, OpenLibHandles_t ope
 
 
 
+//Output options shared by the command line and the daemon
+struct EmitOptions {
+  vector<string> namespaces = {"global"};
+  int threads = 0;
+  string cacheDir = "";
+  string outDir = "";
+};
+
+//Writes the design in c to os in outExt format
+//Returns if the IR was modified (verilog needs flattened types, aig and
+//blif a flattened top)
+bool emit(Context* c, string topRef, string outExt, std::ostream& os, const EmitOptions& eo) {
+  bool modified = false;
+  if (outExt=="json") {
+    c->runPasses({"coreirjson"},eo.namespaces);
+    auto jpass = static_cast<Passes::CoreIRJson*>(c->getPassManager()->getAnalysisPass("coreirjson"));
+    jpass->writeToStream(os,topRef);
+  }
+  else if (outExt=="fir") {
+    //Get the analysis pass
+    auto fpass = static_cast<Passes::Firrtl*>(c->getPassManager()->getAnalysisPass("firrtl"));
+    if (eo.cacheDir!="") {
+      fpass->setCacheDir(eo.cacheDir);
+    }
+    c->runPasses({"firrtl"});
+    fpass->setNumThreads(eo.threads);
+    
+    //Create file here.
+    fpass->writeToStream(os);
+  }
+  else if (outExt=="v") {
+    modified |= c->runPasses({"removebulkconnections","flattentypes","verilog"});
+    auto vpass = static_cast<Passes::Verilog*>(c->getPassManager()->getAnalysisPass("verilog"));
+    vpass->setNumThreads(eo.threads);
+    if (eo.cacheDir!="") {
+      vpass->setCacheDir(eo.cacheDir);
+    }
+    if (eo.outDir!="") {
+      vpass->writeToFiles(eo.outDir);
+    }
+    else {
+      vpass->writeToStream(os);
+    }
+  }
+  else if (outExt=="aig" || outExt=="blif") {
+    ASSERT(topRef!="","Need a top module to write " + outExt);
+    Module* top = c->getModule(topRef);
+    modified |= c->runPasses({"rungenerators","flatten"},{top->getNamespace()->getName()});
+    Aig aig;
+    lowerToAig(top,aig);
+    aig.cleanup();
+    if (outExt=="aig") {
+      writeAiger(aig,os);
+    }
+    else {
+      writeBlif(aig,os,top->getName());
+    }
+  }
+  else {
+    cout << "NYI" << endl;
+  }
+  return modified;
+}
+
+//Long running server that keeps designs loaded between requests.
+//External passes and libs are only opened once and then registered with the
+//Context of every design. The next Context (with the prims, passes and libs
+//registered) is built while the daemon is idle, so loads do not pay for it.
+//
+//Requests are single lines of space separated words. Each response is the
+//output of the request followed by a line "OK" or "ERROR: <message>".
+//  load <design> <file.json>          Loads file into a fresh Context
+//  run <design> <pass1,pass2,...>     Runs passes on the design
+//  emit <design> <json|fir|v|aig|blif> [ns,..] Sends the design back in that format
+//  write <design> <file.<json|fir|v>> [ns,..]  Writes the design to a file
+//  unload <design>
+//  list
+//  shutdown
+//Requests are served one at a time. Errors inside the IR (ASSERT) still
+//terminate the daemon, so bad requests are checked up front where possible.
+class Daemon {
+  struct Design {
+    Context* c;
+    string topRef;
+  };
+  const OpenPassHandles_t& passHandles;
+  const OpenLibHandles_t& libHandles;
+  Context::GenNaming genNaming;
+  bool topOnly;
+  EmitOptions emitOptions;
+  std::map<string,Design> designs;
+  //Warm Context for the next load
+  Context* spare = nullptr;
+  public :
+    Daemon(const OpenPassHandles_t& passHandles, const OpenLibHandles_t& libHandles, Context::GenNaming genNaming, bool topOnly, EmitOptions emitOptions) : passHandles(passHandles), libHandles(libHandles), genNaming(genNaming), topOnly(topOnly), emitOptions(emitOptions) {}
+    ~Daemon() {
+      for (auto& dmap : designs) deleteDesign(dmap.second);
+      if (spare) deleteContext(spare);
+    }
+    //Returns the exit code
+    int serve(string socketPath);
+  private :
+    Context* newWarmContext();
+    //Builds the spare Context if it was used
+    void refill() {
+      if (!spare) spare = newWarmContext();
+    }
+    Design newDesign();
+    void deleteDesign(Design& d);
+    //Returns an error message ("" on success). Sets done on shutdown
+    string handle(const vector<string>& req, std::ostream& os, bool& done);
+};
+
+Context* Daemon::newWarmContext() {
+  Context* c = newContext();
+  c->setGenNaming(genNaming);
+  c->getPassManager()->setTopOnly(topOnly);
+  for (auto handle : passHandles) {
+    register_pass_t* registerPass = (register_pass_t*) dlsym(handle.second.first,"registerPass");
+    c->addPass(registerPass());
+  }
+  for (auto handle : libHandles) {
+    vector<string> f1parse = splitString<vector<string>>(handle.first,'/');
+    string libname = splitRef(f1parse[f1parse.size()-1])[0];
+    libname = libname.substr(10,libname.length()-10);
+    LoadLibrary_t* loadLib = (LoadLibrary_t*) dlsym(handle.second.first,("ExternalLoadLibrary_"+libname).c_str());
+    loadLib(c);
+  }
+  return c;
+}
+
+Daemon::Design Daemon::newDesign() {
+  refill();
+  Design d;
+  d.c = spare;
+  spare = nullptr;
+  return d;
+}
+
+//The PassManager of d.c owns (and deletes) the external passes
+void Daemon::deleteDesign(Design& d) {
+  deleteContext(d.c);
+}
+
+string Daemon::handle(const vector<string>& req, std::ostream& os, bool& done) {
+  if (req.size()==0) return "Empty request";
+  string cmd = req[0];
+  if (cmd=="shutdown") {
+    done = true;
+    return "";
+  }
+  if (cmd=="list") {
+    for (auto dmap : designs) {
+      os << dmap.first << " " << dmap.second.topRef << endl;
+    }
+    return "";
+  }
+  if (req.size()<2) return "Missing design name";
+  string dname = req[1];
+  if (cmd=="load") {
+    if (req.size()!=3) return "Usage: load <design> <file.json>";
+    if (splitString<vector<string>>(req[2],'.').back()!="json") return "Input needs to be json";
+    if (!std::ifstream(req[2]).is_open()) return "Cannot open file: " + req[2];
+    if (designs.count(dname)) {
+      deleteDesign(designs[dname]);
+      designs.erase(dname);
+    }
+    Design d = newDesign();
+    Module* top;
+    if (!loadFromFile(d.c,req[2],&top)) {
+      deleteDesign(d);
+      return "Could not load " + req[2];
+    }
+    if (top) d.topRef = top->getRefName();
+    designs[dname] = d;
+    return "";
+  }
+  if (!designs.count(dname)) return "No design named " + dname;
+  Design& d = designs[dname];
+  if (cmd=="unload") {
+    deleteDesign(d);
+    designs.erase(dname);
+    return "";
+  }
+  if (cmd=="run") {
+    if (req.size()!=3) return "Usage: run <design> <pass1,pass2,...>";
+    vector<string> porder = splitString<vector<string>>(req[2],',');
+    for (auto pname : porder) {
+      if (!d.c->getPassManager()->hasPass(pname)) return "Unknown pass " + pname;
+    }
+    bool modified = d.c->runPasses(porder);
+    os << "Modified?: " << (modified?"Yes":"No") << endl;
+    return "";
+  }
+  if (cmd=="emit" || cmd=="write") {
+    if (req.size()<3 || req.size()>4) return "Usage: " + cmd + " <design> <format|file> [namespaces]";
+    EmitOptions eo = emitOptions;
+    if (req.size()==4) {
+      eo.namespaces = splitString<vector<string>>(req[3],',');
+      for (auto ns : eo.namespaces) {
+        if (!d.c->hasNamespace(ns)) return "Missing namespace: " + ns;
+      }
+    }
+    string outExt = cmd=="emit" ? req[2] : splitString<vector<string>>(req[2],'.').back();
+    if (outExt!="json" && outExt!="fir" && outExt!="v" && outExt!="aig" && outExt!="blif") return "Cannot support out extention: " + outExt;
+    if ((outExt=="aig" || outExt=="blif") && d.topRef=="") return "Need a top module to write " + outExt;
+    if (cmd=="emit") {
+      emit(d.c,d.topRef,outExt,os,eo);
+      os << endl;
+      return "";
+    }
+    std::ofstream fout(req[2]);
+    if (!fout.is_open()) return "Cannot open file: " + req[2];
+    emit(d.c,d.topRef,outExt,fout,eo);
+    return "";
+  }
+  return "Unknown request " + cmd;
+}
+
+int Daemon::serve(string socketPath) {
+  int sfd = socket(AF_UNIX,SOCK_STREAM,0);
+  ASSERT(sfd>=0,"Cannot create socket");
+  struct sockaddr_un addr;
+  memset(&addr,0,sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  ASSERT(socketPath.size()<sizeof(addr.sun_path),"Socket path too long: " + socketPath);
+  strncpy(addr.sun_path,socketPath.c_str(),sizeof(addr.sun_path)-1);
+  //Only replace a stale socket, never some other file
+  struct stat st;
+  if (lstat(socketPath.c_str(),&st)==0) {
+    if (!S_ISSOCK(st.st_mode)) {
+      cout << "ERROR: " << socketPath << " exists and is not a socket" << endl;
+      close(sfd);
+      return 1;
+    }
+    unlink(socketPath.c_str());
+  }
+  ASSERT(bind(sfd,(struct sockaddr*) &addr,sizeof(addr))==0,"Cannot bind socket " + socketPath);
+  ASSERT(listen(sfd,16)==0,"Cannot listen on socket " + socketPath);
+  refill();
+  cout << "Listening on " << socketPath << endl;
+
+  bool done = false;
+  while (!done) {
+    int cfd = accept(sfd,nullptr,nullptr);
+    if (cfd<0) continue;
+    //Serve requests on this connection until it is closed
+    string buf;
+    char chunk[4096];
+    ssize_t n;
+    while (!done && (n = read(cfd,chunk,sizeof(chunk)))>0) {
+      buf.append(chunk,n);
+      size_t nl;
+      while (!done && (nl = buf.find('\n'))!=string::npos) {
+        string line = buf.substr(0,nl);
+        buf.erase(0,nl+1);
+        vector<string> req;
+        for (auto w : splitString<vector<string>>(line,' ')) {
+          if (w!="") req.push_back(w);
+        }
+        ostringstream resp;
+        string err = handle(req,resp,done);
+        if (err=="") resp << "OK" << endl;
+        else resp << "ERROR: " << err << endl;
+        string rstr = resp.str();
+        for (size_t sent = 0; sent<rstr.size(); ) {
+          ssize_t w = write(cfd,rstr.data()+sent,rstr.size()-sent);
+          if (w<=0) break;
+          sent += w;
+        }
+        //Ready for the next load before reading the next request
+        if (!done) refill();
+      }
+    }
+    close(cfd);
+  }
+  close(sfd);
+  if (lstat(socketPath.c_str(),&st)==0 && S_ISSOCK(st.st_mode)) unlink(socketPath.c_str());
+  return 0;
+}
+
 int main(int argc, char *argv[]) {
   int argc_copy = argc;
   cxxopts::Options options("coreir", "a simple hardware compiler");
@@ -55,11 +340,18 @@ int main(int argc, char *argv[]) {
     ("h,help","help")
     ("v,verbose","Set verbose")
     ("i,input","input file: <file>.json",cxxopts::value<std::string>())
-    ("o,output","output file: <file>.<json|fir|v|dot>",cxxopts::value<std::string>())
+    ("o,output","output file: <file>.<json|fir|v|aig|blif>",cxxopts::value<std::string>())
+    ("a,aiger","replace the definition of the top with the logic of an AIGER file: <file>.<aig|aag>",cxxopts::value<std::string>())
     ("p,passes","Run passes in order: '<pass1>,<pass2>,<pass3>,...'",cxxopts::value<std::string>())
     ("e,load_passes","external passes: '<path1.so>,<path2.so>,<path3.so>,...'",cxxopts::value<std::string>())
     ("l,load_libs","external libs: '<path/libname0.so>,<path/libname1.so>,<path/libname2.so>,...'",cxxopts::value<std::string>())
     ("n,namespaces","namespaces to output: '<namespace1>,<namespace2>,<namespace3>,...'",cxxopts::value<std::string>()->default_value("global"))
+    ("d,outdir","verilog output directory: one <dir>/<module>.v file per module",cxxopts::value<std::string>())
+    ("j,threads","number of threads used to emit output (0 means one per core)",cxxopts::value<int>()->default_value("0"))
+    ("c,cache","emit cache directory: reuse the text of unchanged modules from earlier runs",cxxopts::value<std::string>())
+    ("g,gennames","naming of generated modules: <unique|hash|namegen>",cxxopts::value<std::string>()->default_value("unique"))
+    ("t,toponly","only run passes on and output the modules reachable from the top of the input")
+    ("s,server","run as a daemon listening on the Unix socket <path> (see Daemon for the requests)",cxxopts::value<std::string>())
     ;
   
   //Do the parsing of the arguments
@@ -70,6 +362,16 @@ int main(int argc, char *argv[]) {
   
   
   Context* c = newContext();
+  //Has to be set before any generator runs (including while loading the input)
+  string gennames = options["g"].as<string>();
+  if (gennames=="hash") c->setGenNaming(Context::GN_Hash);
+  else if (gennames=="namegen") c->setGenNaming(Context::GN_NameGen);
+  else ASSERT(gennames=="unique","Unknown gennames option: " + gennames);
+  
+  EmitOptions eo;
+  eo.namespaces = splitString<vector<string>>(options["n"].as<string>(),',');
+  eo.threads = options["j"].as<int>();
+  if (options.count("c")) eo.cacheDir = options["c"].as<string>();
   //Load external passes
   if (options.count("e")) {
     vector<string> libs = splitString<vector<string>>(options["e"].as<string>(),',');
@@ -133,6 +435,19 @@ int main(int argc, char *argv[]) {
   if (options.count("v")) {
     c->getPassManager()->setVerbosity(options["v"].as<bool>());
   }
+  if (options.count("t")) {
+    c->getPassManager()->setTopOnly(true);
+  }
+
+  if (options.count("s")) {
+    int ret;
+    {
+      Daemon daemon(openPassHandles,openLibHandles,c->getGenNaming(),c->getPassManager()->isTopOnly(),eo);
+      ret = daemon.serve(options["s"].as<string>());
+    }
+    if (!shutdown(c,openPassHandles,openLibHandles) ) return 1;
+    return ret;
+  }
 
   ASSERT(options.count("i"),"No input specified")
   string infileName = options["i"].as<string>();
@@ -142,13 +457,20 @@ int main(int argc, char *argv[]) {
   std::ostream* sout = &std::cout;
   std::ofstream fout;
   string outExt = "json";
-  if (options.count("o")) {
+  if (options.count("d")) {
+    ASSERT(!options.count("o"),"Cannot specify both an output file and an output directory");
+    outExt = "v";
+    eo.outDir = options["d"].as<string>();
+  }
+  else if (options.count("o")) {
     string outfileName = options["o"].as<string>();
     outExt = getExt(outfileName);
     ASSERT(outExt == "json" 
         || outExt == "txt"
         || outExt == "fir"
-        || outExt == "v", "Cannot support out extention: " + outExt);
+        || outExt == "v"
+        || outExt == "aig"
+        || outExt == "blif", "Cannot support out extention: " + outExt);
     fout.open(outfileName);
     ASSERT(fout.is_open(),"Cannot open file: " + outfileName);
     sout = &fout;
@@ -162,39 +484,27 @@ int main(int argc, char *argv[]) {
   string topRef = "";
   if (top) topRef = top->getRefName();
 
-  //Load and run passes
+  //Import logic optimized outside (names have to match the ports of the top)
   bool modified = false;
+  if (options.count("a")) {
+    ASSERT(top,"Need a top module to import an AIGER file");
+    string aigerName = options["a"].as<string>();
+    std::ifstream ain(aigerName,std::ios::binary);
+    ASSERT(ain.is_open(),"Cannot open file: " + aigerName);
+    Aig aig;
+    readAiger(ain,aig);
+    top->setDef(liftAig(aig,top));
+    modified = true;
+  }
+
+  //Load and run passes
   if (options.count("p")) {
     string plist = options["p"].as<string>();
     vector<string> porder = splitString<vector<string>>(plist,',');
-    modified = c->runPasses(porder);
+    modified |= c->runPasses(porder);
   }
   
-  vector<string> namespaces = splitString<vector<string>>(options["n"].as<string>(),',');
-
-  //Output to correct format
-  if (outExt=="json") {
-    c->runPasses({"coreirjson"},namespaces);
-    auto jpass = static_cast<Passes::CoreIRJson*>(c->getPassManager()->getAnalysisPass("coreirjson"));
-    jpass->writeToStream(*sout,topRef);
-  }
-  else if (outExt=="fir") {
-    c->runPasses({"firrtl"});
-    //Get the analysis pass
-    auto fpass = static_cast<Passes::Firrtl*>(c->getPassManager()->getAnalysisPass("firrtl"));
-    
-    //Create file here.
-    fpass->writeToStream(*sout);
-  }
-  else if (outExt=="v") {
-    modified |= c->runPasses({"removebulkconnections","flattentypes","verilog"});
-    auto vpass = static_cast<Passes::Verilog*>(c->getPassManager()->getAnalysisPass("verilog"));
-    
-    vpass->writeToStream(*sout);
-  }
-  else {
-    cout << "NYI" << endl;
-  }
+  modified |= emit(c,topRef,outExt,*sout,eo);
   cout << endl << "Modified?: " << (modified?"Yes":"No") << endl;
 
   //Shutdown
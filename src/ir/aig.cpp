@@ -0,0 +1,558 @@
+#include "aig.hpp"
+#include "bitnets.hpp"
+#include "context.hpp"
+#include "moduledef.hpp"
+#include "wireable.hpp"
+#include "types.hpp"
+#include "instantiable.hpp"
+#include "namespace.hpp"
+#include "primops.hpp"
+
+using namespace std;
+
+namespace CoreIR {
+
+const AigLit Aig::False;
+const AigLit Aig::True;
+
+Aig::Aig() {
+  kinds.push_back(AK_Const);
+  fanin0.push_back(0);
+  fanin1.push_back(0);
+}
+
+AigLit Aig::newInput(string name) {
+  uint32_t n = kinds.size();
+  kinds.push_back(AK_Input);
+  fanin0.push_back(0);
+  fanin1.push_back(0);
+  inputs.push_back(n);
+  inputNames.push_back(name);
+  return lit(n);
+}
+
+AigLit Aig::newLatch(string name, bool init) {
+  uint32_t n = kinds.size();
+  kinds.push_back(AK_Latch);
+  fanin0.push_back(0);
+  fanin1.push_back(0);
+  latches.push_back(n);
+  latchNames.push_back(name);
+  latchNexts.push_back(False);
+  latchInits.push_back(init);
+  return lit(n);
+}
+
+void Aig::newOutput(string name, AigLit l) {
+  outputs.push_back(l);
+  outputNames.push_back(name);
+}
+
+AigLit Aig::And(AigLit a, AigLit b) {
+  if (a>b) std::swap(a,b);
+  if (a==False) return False;
+  if (a==True) return b;
+  if (a==b) return a;
+  if (a==Not(b)) return False;
+  uint64_t key = ((uint64_t) a<<32) | b;
+  auto it = strash.find(key);
+  if (it!=strash.end()) return lit(it->second);
+  uint32_t n = kinds.size();
+  kinds.push_back(AK_And);
+  fanin0.push_back(a);
+  fanin1.push_back(b);
+  strash[key] = n;
+  numAnds++;
+  return lit(n);
+}
+
+AigLit Aig::Xor(AigLit a, AigLit b) {
+  if (a==False) return b;
+  if (b==False) return a;
+  if (a==True) return Not(b);
+  if (b==True) return Not(a);
+  return Or(And(a,Not(b)),And(Not(a),b));
+}
+
+AigLit Aig::Mux(AigLit s, AigLit t, AigLit e) {
+  if (s==True || t==e) return t;
+  if (s==False) return e;
+  return Or(And(s,t),And(Not(s),e));
+}
+
+void Aig::cleanup() {
+  //Everything the outputs depend on, through the latches
+  vector<bool> live(kinds.size(),false);
+  vector<uint32_t> stack;
+  auto mark = [&](AigLit l) {
+    uint32_t n = node(l);
+    if (live[n]) return;
+    live[n] = true;
+    stack.push_back(n);
+  };
+  vector<int> latchIdx(kinds.size(),-1);
+  for (uint i=0; i<latches.size(); ++i) latchIdx[latches[i]] = i;
+  mark(False);
+  for (auto o : outputs) mark(o);
+  while (!stack.empty()) {
+    uint32_t n = stack.back();
+    stack.pop_back();
+    if (kinds[n]==AK_And) {
+      mark(fanin0[n]);
+      mark(fanin1[n]);
+    }
+    else if (kinds[n]==AK_Latch) {
+      mark(latchNexts[latchIdx[n]]);
+    }
+  }
+
+  //Constant, inputs (all of them), live latches, then the live ands (which
+  //are already in topological order)
+  vector<uint32_t> order = {0};
+  for (auto n : inputs) order.push_back(n);
+  for (auto n : latches) if (live[n]) order.push_back(n);
+  for (uint32_t n=0; n<kinds.size(); ++n) {
+    if (kinds[n]==AK_And && live[n]) order.push_back(n);
+  }
+  vector<uint32_t> newNode(kinds.size(),0);
+  for (uint32_t i=0; i<order.size(); ++i) newNode[order[i]] = i;
+  auto newLit = [&](AigLit l) { return lit(newNode[node(l)],isNeg(l));};
+
+  Aig old(std::move(*this));
+  *this = Aig();
+  for (uint i=0; i<old.inputs.size(); ++i) newInput(old.inputNames[i]);
+  vector<uint> latchMap;
+  for (uint i=0; i<old.latches.size(); ++i) {
+    if (!live[old.latches[i]]) continue;
+    newLatch(old.latchNames[i],old.latchInits[i]);
+    latchMap.push_back(i);
+  }
+  for (auto n : order) {
+    if (old.kinds[n]!=AK_And) continue;
+    AigLit l = And(newLit(old.fanin0[n]),newLit(old.fanin1[n]));
+    ASSERT(l==lit(newNode[n]),"Aig cleanup renumbered an and");
+  }
+  for (uint i=0; i<latchMap.size(); ++i) setLatchNext(i,newLit(old.latchNexts[latchMap[i]]));
+  for (uint i=0; i<old.outputs.size(); ++i) newOutput(old.outputNames[i],newLit(old.outputs[i]));
+}
+
+void Aig::print() {
+  cout << "Aig: " << inputs.size() << " inputs, " << latches.size() << " latches, " << numAnds << " ands, " << outputs.size() << " outputs" << endl;
+}
+
+namespace {
+
+using namespace PrimOps;
+
+AigWord notWord(const AigWord& a) {
+  AigWord r;
+  for (auto l : a) r.push_back(Aig::Not(l));
+  return r;
+}
+
+AigWord constWord(uint width, AigLit l) {
+  return AigWord(width,l);
+}
+
+//a+b+cin (carry out in cout)
+AigWord addWords(Aig& aig, const AigWord& a, const AigWord& b, AigLit cin, AigLit* cout=nullptr) {
+  AigWord r;
+  AigLit carry = cin;
+  for (uint i=0; i<a.size(); ++i) {
+    AigLit axb = aig.Xor(a[i],b[i]);
+    r.push_back(aig.Xor(axb,carry));
+    carry = aig.Or(aig.And(a[i],b[i]),aig.And(axb,carry));
+  }
+  if (cout) *cout = carry;
+  return r;
+}
+
+AigWord subWords(Aig& aig, const AigWord& a, const AigWord& b, AigLit* noBorrow=nullptr) {
+  return addWords(aig,a,notWord(b),Aig::True,noBorrow);
+}
+
+AigWord muxWords(Aig& aig, AigLit s, const AigWord& t, const AigWord& e) {
+  AigWord r;
+  for (uint i=0; i<t.size(); ++i) r.push_back(aig.Mux(s,t[i],e[i]));
+  return r;
+}
+
+AigLit orReduce(Aig& aig, const AigWord& a) {
+  AigLit r = Aig::False;
+  for (auto l : a) r = aig.Or(r,l);
+  return r;
+}
+
+AigLit ult(Aig& aig, const AigWord& a, const AigWord& b) {
+  AigLit noBorrow;
+  subWords(aig,a,b,&noBorrow);
+  return Aig::Not(noBorrow);
+}
+
+//Signed compare is the unsigned compare with the sign bits flipped
+AigLit slt(Aig& aig, AigWord a, AigWord b) {
+  a.back() = Aig::Not(a.back());
+  b.back() = Aig::Not(b.back());
+  return ult(aig,a,b);
+}
+
+//Barrel shifter. Amounts of at least the width shift in fill completely
+AigWord shiftWord(Aig& aig, const AigWord& a, const AigWord& b, bool left, AigLit fill) {
+  uint width = a.size();
+  AigWord r = a;
+  AigLit overflow = Aig::False;
+  for (uint k=0; k<b.size(); ++k) {
+    if (k>=32 || (1ULL<<k)>=width) {
+      overflow = aig.Or(overflow,b[k]);
+      continue;
+    }
+    uint amount = 1<<k;
+    AigWord shifted(width,fill);
+    for (uint i=0; i<width; ++i) {
+      if (left && i>=amount) shifted[i] = r[i-amount];
+      if (!left && i+amount<width) shifted[i] = r[i+amount];
+    }
+    r = muxWords(aig,b[k],shifted,r);
+  }
+  return muxWords(aig,overflow,constWord(width,fill),r);
+}
+
+AigWord mulWords(Aig& aig, const AigWord& a, const AigWord& b) {
+  uint width = a.size();
+  AigWord acc = constWord(width,Aig::False);
+  for (uint i=0; i<width; ++i) {
+    AigWord pp(width,Aig::False);
+    for (uint j=i; j<width; ++j) pp[j] = aig.And(a[j-i],b[i]);
+    acc = addWords(aig,acc,pp,Aig::False);
+  }
+  return acc;
+}
+
+//Restoring division. Dividing by zero gives all ones and the dividend like
+//PrimOps::eval
+void divWords(Aig& aig, const AigWord& a, const AigWord& b, AigWord& q, AigWord& r) {
+  uint width = a.size();
+  AigWord b1 = b;
+  b1.push_back(Aig::False);
+  AigWord rem(width+1,Aig::False);
+  q = AigWord(width,Aig::False);
+  for (int i=width-1; i>=0; --i) {
+    AigWord shifted = {a[i]};
+    shifted.insert(shifted.end(),rem.begin(),rem.begin()+width);
+    AigLit ge;
+    AigWord diff = subWords(aig,shifted,b1,&ge);
+    q[i] = ge;
+    rem = muxWords(aig,ge,diff,shifted);
+  }
+  r = AigWord(rem.begin(),rem.begin()+width);
+}
+
+AigWord negWord(Aig& aig, const AigWord& a) {
+  return addWords(aig,notWord(a),constWord(a.size(),Aig::False),Aig::True);
+}
+
+AigWord absWord(Aig& aig, const AigWord& a) {
+  return muxWords(aig,a.back(),negWord(aig,a),a);
+}
+
+AigWord lowerOp(Aig& aig, Op op, const AigWord& a, const AigWord& b, const AigWord& c) {
+  uint width = a.size();
+  switch(op) {
+    case OP_not : return notWord(a);
+    case OP_neg : return negWord(aig,a);
+    case OP_andr : return {Aig::Not(orReduce(aig,notWord(a)))};
+    case OP_orr : return {orReduce(aig,a)};
+    case OP_xorr : {
+      AigLit r = Aig::False;
+      for (auto l : a) r = aig.Xor(r,l);
+      return {r};
+    }
+    case OP_and : case OP_or : case OP_xor : {
+      AigWord r;
+      for (uint i=0; i<width; ++i) {
+        if (op==OP_and) r.push_back(aig.And(a[i],b[i]));
+        else if (op==OP_or) r.push_back(aig.Or(a[i],b[i]));
+        else r.push_back(aig.Xor(a[i],b[i]));
+      }
+      return r;
+    }
+    case OP_dshl : return shiftWord(aig,a,b,true,Aig::False);
+    case OP_dlshr : return shiftWord(aig,a,b,false,Aig::False);
+    case OP_dashr : return shiftWord(aig,a,b,false,a.back());
+    case OP_add : return addWords(aig,a,b,Aig::False);
+    case OP_sub : return subWords(aig,a,b);
+    case OP_mul : return mulWords(aig,a,b);
+    case OP_udiv : case OP_urem : {
+      AigWord q, r;
+      divWords(aig,a,b,q,r);
+      return op==OP_udiv ? q : r;
+    }
+    case OP_sdiv : case OP_srem : case OP_smod : {
+      AigWord q, r;
+      divWords(aig,absWord(aig,a),absWord(aig,b),q,r);
+      AigLit sa = a.back(), sb = b.back();
+      if (op==OP_sdiv) {
+        AigLit bzero = Aig::Not(orReduce(aig,b));
+        q = muxWords(aig,aig.Xor(sa,sb),negWord(aig,q),q);
+        return muxWords(aig,bzero,constWord(width,Aig::True),q);
+      }
+      //The remainder has the sign of the dividend
+      r = muxWords(aig,sa,negWord(aig,r),r);
+      if (op==OP_srem) return r;
+      //and then gets the sign of the divisor
+      AigLit fix = aig.And(orReduce(aig,r),aig.Xor(r.back(),sb));
+      return muxWords(aig,fix,addWords(aig,r,b,Aig::False),r);
+    }
+    case OP_eq : {
+      AigLit r = Aig::True;
+      for (uint i=0; i<width; ++i) r = aig.And(r,Aig::Not(aig.Xor(a[i],b[i])));
+      return {r};
+    }
+    case OP_ult : return {ult(aig,a,b)};
+    case OP_ugt : return {ult(aig,b,a)};
+    case OP_ule : return {Aig::Not(ult(aig,b,a))};
+    case OP_uge : return {Aig::Not(ult(aig,a,b))};
+    case OP_slt : return {slt(aig,a,b)};
+    case OP_sgt : return {slt(aig,b,a)};
+    case OP_sle : return {Aig::Not(slt(aig,b,a))};
+    case OP_sge : return {Aig::Not(slt(aig,a,b))};
+    case OP_mux : return muxWords(aig,c[0],b,a);
+    default : ASSERT(0,"Cannot lower op " + op2Str(op));
+  }
+  return AigWord();
+}
+
+bool isClock(Type* t) {
+  auto nt = dyn_cast<NamedType>(t);
+  return nt && nt->getNamespace()->getName()=="coreir" && (nt->getName()=="clk" || nt->getName()=="clkIn");
+}
+
+string bitName(BitNets& nets, uint bit) {
+  SelectPath path = nets.getWireable(bit)->getSelectPath();
+  if (path[0]=="self") path.erase(path.begin());
+  return SelectPath2Str(path);
+}
+
+class Lowering {
+  Aig& aig;
+  ModuleDef* def;
+  BitNets nets;
+  const AigLit undef = ~0u;
+  vector<AigLit> netLits;
+  public :
+    Lowering(Aig& aig, Module* m) : aig(aig), def(m->getDef()), nets(m->getDef()), netLits(nets.getNumNets(),undef) {}
+    void run();
+  private :
+    AigLit readBit(uint bit) {
+      uint net = nets.getNet(bit);
+      if (nets.getDriver(net)<0) return Aig::False;
+      ASSERT(netLits[net]!=undef,"Aig lowering read " + bitName(nets,bit) + " before it was driven");
+      return netLits[net];
+    }
+    AigWord read(Instance* inst, string port) {
+      Wireable* w = inst->sel(port);
+      uint base = nets.getBit(w);
+      AigWord word;
+      for (uint i=0; i<w->getType()->getSize(); ++i) word.push_back(readBit(base+i));
+      return word;
+    }
+    void write(Instance* inst, string port, const AigWord& word, uint offset=0) {
+      uint base = nets.getBit(inst->sel(port)) + offset;
+      for (uint i=0; i<word.size(); ++i) netLits[nets.getNet(base+i)] = word[i];
+    }
+    uint genInt(Instance* inst, string name) {
+      return getInstanceArg(inst,name)->get<ArgInt>();
+    }
+    void lowerInstance(Instance* inst);
+};
+
+void Lowering::lowerInstance(Instance* inst) {
+  string name = coreirPrimName(inst);
+  Op op = str2Op(name);
+  if (op!=OP_none) {
+    AigWord a, b, c;
+    if (numOperands(op)==1) a = read(inst,"in");
+    else {
+      a = read(inst,"in0");
+      b = read(inst,"in1");
+      if (op==OP_mux) c = read(inst,"sel");
+    }
+    write(inst,"out",lowerOp(aig,op,a,b,c));
+  }
+  else if (name=="const") {
+    uint width = genInt(inst,"width");
+    uint64_t value = (uint64_t) (int64_t) getInstanceArg(inst,"value")->get<ArgInt>();
+    AigWord word;
+    for (uint i=0; i<width; ++i) word.push_back(((value >> (i<64 ? i : 63)) & 1) ? Aig::True : Aig::False);
+    write(inst,"out",word);
+  }
+  else if (name=="passthrough") {
+    write(inst,"out",read(inst,"in"));
+  }
+  else if (name=="slice") {
+    AigWord in = read(inst,"in");
+    write(inst,"out",AigWord(in.begin()+genInt(inst,"lo"),in.begin()+genInt(inst,"hi")));
+  }
+  else if (name=="concat") {
+    //out = {in0,in1}
+    AigWord in1 = read(inst,"in1");
+    write(inst,"out",in1);
+    write(inst,"out",read(inst,"in0"),in1.size());
+  }
+  else if (name!="term") {
+    ASSERT(0,"Cannot lower " + inst->getInstantiableRef()->getRefName() + " (instance " + inst->getInstname() + ") to an Aig");
+  }
+}
+
+void Lowering::run() {
+  auto& tops = nets.getTops();
+  //Inputs of self (but not the clock)
+  int clockNet = -1;
+  for (uint bit=nets.getBase(0); bit<nets.getBase(1); ++bit) {
+    Wireable* w = nets.getWireable(bit);
+    if (isClock(w->getType())) continue;
+    if (nets.isDriver(bit)) netLits[nets.getNet(bit)] = aig.newInput(bitName(nets,bit));
+  }
+  //Register outputs are known before anything is evaluated
+  vector<Instance*> regs;
+  vector<uint> regLatches;
+  for (uint t=1; t<tops.size(); ++t) {
+    Instance* inst = cast<Instance>(tops[t]);
+    string name = coreirPrimName(inst);
+    ASSERT(name!="","Aig lowering needs a flattened module, found " + inst->getInstantiableRef()->getRefName() + " (instance " + inst->getInstname() + ")");
+    if (name!="reg") continue;
+    uint width = genInt(inst,"width");
+    uint64_t init = (uint64_t) (int64_t) getInstanceArg(inst,"init")->get<ArgInt>();
+    uint base = nets.getBit(inst->sel("out"));
+    regs.push_back(inst);
+    regLatches.push_back(aig.getLatches().size());
+    for (uint i=0; i<width; ++i) {
+      bool ibit = (init >> (i<64 ? i : 63)) & 1;
+      netLits[nets.getNet(base+i)] = aig.newLatch(bitName(nets,base+i),ibit);
+    }
+    //Unconnected clocks are the implicit clock
+    int clk = nets.getDriver(nets.getNet(nets.getBit(inst->sel("clk"))));
+    if (clk<0) continue;
+    ASSERT(nets.getTop(clk)==0,"The clock of " + inst->getInstname() + " has to be an input of the module");
+    ASSERT(clockNet<0 || clockNet==(int) nets.getNet(clk),"Aig lowering needs a single clock (" + inst->getInstname() + ")");
+    clockNet = nets.getNet(clk);
+  }
+
+  //The other instances in topological order
+  vector<uint> numDeps(tops.size(),0);
+  vector<vector<uint>> users(tops.size());
+  for (uint t=1; t<tops.size(); ++t) {
+    if (coreirPrimName(cast<Instance>(tops[t]))=="reg") continue;
+    for (uint bit=nets.getBase(t); bit<nets.getBase(t+1); ++bit) {
+      if (nets.isDriver(bit)) continue;
+      int d = nets.getDriver(nets.getNet(bit));
+      if (d<0) continue;
+      uint dt = nets.getTop(d);
+      if (dt==0 || coreirPrimName(cast<Instance>(tops[dt]))=="reg") continue;
+      users[dt].push_back(t);
+      numDeps[t]++;
+    }
+  }
+  vector<uint> ready;
+  for (uint t=1; t<tops.size(); ++t) {
+    if (numDeps[t]==0 && coreirPrimName(cast<Instance>(tops[t]))!="reg") ready.push_back(t);
+  }
+  uint done = regs.size();
+  while (!ready.empty()) {
+    uint t = ready.back();
+    ready.pop_back();
+    lowerInstance(cast<Instance>(tops[t]));
+    done++;
+    for (auto u : users[t]) {
+      if (--numDeps[u]==0) ready.push_back(u);
+    }
+  }
+  ASSERT(done==tops.size()-1,"Aig lowering found a combinational loop in " + def->getModule()->getRefName());
+
+  //Next states like Sim::clockNode: en ? (clr ? init : in) : out, and
+  //init while the (active low) rst is 0
+  for (uint r=0; r<regs.size(); ++r) {
+    Instance* inst = regs[r];
+    AigWord in = read(inst,"in");
+    AigLit en = getInstanceArg(inst,"en")->get<ArgBool>() ? read(inst,"en")[0] : Aig::True;
+    AigLit clr = getInstanceArg(inst,"clr")->get<ArgBool>() ? read(inst,"clr")[0] : Aig::False;
+    AigLit rst = getInstanceArg(inst,"rst")->get<ArgBool>() ? Aig::Not(read(inst,"rst")[0]) : Aig::False;
+    for (uint i=0; i<in.size(); ++i) {
+      uint latch = regLatches[r] + i;
+      AigLit cur = Aig::lit(aig.getLatches()[latch]);
+      AigLit init = aig.getLatchInits()[latch] ? Aig::True : Aig::False;
+      AigLit next = aig.Mux(en,aig.Mux(clr,init,in[i]),cur);
+      aig.setLatchNext(latch,aig.Mux(rst,init,next));
+    }
+  }
+
+  //Outputs of self
+  for (uint bit=nets.getBase(0); bit<nets.getBase(1); ++bit) {
+    if (nets.isDriver(bit) || isClock(nets.getWireable(bit)->getType())) continue;
+    aig.newOutput(bitName(nets,bit),readBit(bit));
+  }
+}
+
+}
+
+void lowerToAig(Module* m, Aig& aig) {
+  ASSERT(m->hasDef(),"Cannot lower a module without a definition: " + m->getRefName());
+  Lowering(aig,m).run();
+}
+
+ModuleDef* liftAig(Aig& aig, Module* m) {
+  Context* c = m->getContext();
+  ModuleDef* def = m->newModuleDef();
+  Args w1({{"width",c->argInt(1)}});
+  string clock = "";
+  for (auto field : cast<RecordType>(m->getType())->getFields()) {
+    Type* t = cast<RecordType>(m->getType())->getRecord()[field];
+    if (isClock(t) && t->isInput()) clock = field;
+  }
+
+  //Positive and negative drivers of every node (created when needed)
+  vector<Wireable*> pos(aig.getNumNodes(),nullptr);
+  vector<Wireable*> neg(aig.getNumNodes(),nullptr);
+  for (uint i=0; i<aig.getInputs().size(); ++i) {
+    pos[aig.getInputs()[i]] = def->sel("self." + aig.getInputNames()[i]);
+  }
+  for (uint i=0; i<aig.getLatches().size(); ++i) {
+    string name = "latch" + to_string(i);
+    def->addInstance(name,"coreir.reg",w1,{{"init",c->argInt(aig.getLatchInits()[i])}});
+    if (clock!="") def->connect("self." + clock,name + ".clk");
+    pos[aig.getLatches()[i]] = def->sel(name + ".out");
+  }
+  auto driver = [&](AigLit l) {
+    uint32_t n = Aig::node(l);
+    if (n==0) {
+      string name = l==Aig::True ? "const1" : "const0";
+      if (!def->getInstances().count(name)) def->addInstance(name,"coreir.const",w1,{{"value",c->argInt(l==Aig::True)}});
+      return def->sel(name + ".out");
+    }
+    if (!Aig::isNeg(l)) return pos[n];
+    if (!neg[n]) {
+      string name = "not" + to_string(n);
+      def->addInstance(name,"coreir.not",w1);
+      def->connect(pos[n],def->sel(name + ".in"));
+      neg[n] = def->sel(name + ".out");
+    }
+    return neg[n];
+  };
+  for (uint32_t n=0; n<aig.getNumNodes(); ++n) {
+    if (aig.getKind(n)!=Aig::AK_And) continue;
+    string name = "and" + to_string(n);
+    def->addInstance(name,"coreir.and",w1);
+    def->connect(driver(aig.getFanin0(n)),def->sel(name + ".in0"));
+    def->connect(driver(aig.getFanin1(n)),def->sel(name + ".in1"));
+    pos[n] = def->sel(name + ".out");
+  }
+  for (uint i=0; i<aig.getLatches().size(); ++i) {
+    def->connect(driver(aig.getLatchNexts()[i]),def->sel("latch" + to_string(i) + ".in"));
+  }
+  for (uint i=0; i<aig.getOutputs().size(); ++i) {
+    def->connect(driver(aig.getOutputs()[i]),def->sel("self." + aig.getOutputNames()[i]));
+  }
+  return def;
+}
+
+}//CoreIR namespace
@@ -0,0 +1,115 @@
+#ifndef AIG_HPP_
+#define AIG_HPP_
+
+#include "common.hpp"
+
+namespace CoreIR {
+
+//A literal is 2*node+complement. Node 0 is the constant false, so literal 0
+//is false and literal 1 is true.
+typedef uint32_t AigLit;
+typedef vector<AigLit> AigWord;
+
+//And-inverter graph with latches. Nodes are kept in flat arrays and every
+//and is structurally hashed (and constant folded) when it is created, so
+//the same function of the same literals is only built once. Fanins of an
+//and are always created before it.
+//Latches are clocked by a single implicit clock and start at their init.
+class Aig {
+  public :
+    enum NodeKind {AK_Const, AK_Input, AK_Latch, AK_And};
+    static const AigLit False = 0;
+    static const AigLit True = 1;
+  private :
+    vector<uint8_t> kinds;
+    //Fanins of ands (0 for the other nodes)
+    vector<AigLit> fanin0;
+    vector<AigLit> fanin1;
+    //(fanin0,fanin1) -> node
+    unordered_map<uint64_t,uint32_t> strash;
+    uint numAnds = 0;
+
+    vector<uint32_t> inputs;
+    vector<string> inputNames;
+    vector<uint32_t> latches;
+    vector<string> latchNames;
+    vector<AigLit> latchNexts;
+    vector<bool> latchInits;
+    vector<AigLit> outputs;
+    vector<string> outputNames;
+  public :
+    Aig();
+    static AigLit lit(uint32_t node, bool neg=false) { return 2*node + (neg ? 1 : 0);}
+    static uint32_t node(AigLit l) { return l>>1;}
+    static bool isNeg(AigLit l) { return l&1;}
+    static AigLit Not(AigLit l) { return l^1;}
+
+    AigLit newInput(string name);
+    //Returns the literal of the latch output. The next state is False
+    //until setLatchNext
+    AigLit newLatch(string name, bool init=false);
+    //idx is the index of the latch (in creation order)
+    void setLatchNext(uint idx, AigLit next) { latchNexts[idx] = next;}
+    void newOutput(string name, AigLit l);
+
+    AigLit And(AigLit a, AigLit b);
+    AigLit Or(AigLit a, AigLit b) { return Not(And(Not(a),Not(b)));}
+    AigLit Xor(AigLit a, AigLit b);
+    //s ? t : e
+    AigLit Mux(AigLit s, AigLit t, AigLit e);
+
+    uint getNumNodes() { return kinds.size();}
+    uint getNumAnds() { return numAnds;}
+    NodeKind getKind(uint32_t n) { return (NodeKind) kinds[n];}
+    AigLit getFanin0(uint32_t n) { return fanin0[n];}
+    AigLit getFanin1(uint32_t n) { return fanin1[n];}
+
+    //Nodes of the inputs and latches in creation order
+    const vector<uint32_t>& getInputs() { return inputs;}
+    const vector<string>& getInputNames() { return inputNames;}
+    const vector<uint32_t>& getLatches() { return latches;}
+    const vector<string>& getLatchNames() { return latchNames;}
+    const vector<AigLit>& getLatchNexts() { return latchNexts;}
+    const vector<bool>& getLatchInits() { return latchInits;}
+    const vector<AigLit>& getOutputs() { return outputs;}
+    const vector<string>& getOutputNames() { return outputNames;}
+
+    //Removes the ands and latches that no output depends on and renumbers
+    //the nodes as the constant, the inputs, the latches and then the ands
+    //in topological order (the order of AIGER files).
+    void cleanup();
+    void print();
+};
+
+//Lowers the flattened module m (instances of coreir primitives only) into
+//aig. Every bit of an input port of m becomes an input and every bit of an
+//output port an output, named by its select path ("in.3"). Every bit of a
+//reg becomes a latch ("r.out.3"). Clock ports are left out, so all the
+//regs have to be clocked by the same clock input of m (or be unconnected).
+//Resets are applied at the clock edge like the simulator does.
+void lowerToAig(Module* m, Aig& aig);
+
+//Builds a definition of m out of 1 bit coreir and/not/const/reg instances
+//for aig, connecting the inputs and outputs of aig to the ports of m with
+//the same names (as created by lowerToAig). Latches are clocked by the
+//clock input of m if it has one. The def is not set on m.
+ModuleDef* liftAig(Aig& aig, Module* m);
+
+//Writes aig in the binary AIGER format with a symbol table of the names.
+//Latches with init 1 use the reset field of AIGER 1.9. The output is
+//streamed, nothing proportional to the size of aig is buffered.
+void writeAiger(Aig& aig, std::ostream& os);
+
+//Writes aig as a single BLIF model. Ands become two input .names and
+//latches .latch lines (without a clock, like in the Aig).
+void writeBlif(Aig& aig, std::ostream& os, string model);
+
+//Reads a binary (aig) or ascii (aag) AIGER file into the empty aig. Names
+//come from the symbol table (i<k>, l<k> and o<k> when missing), so a file
+//written by writeAiger (or an optimizer keeping the symbols) can be lifted
+//back with liftAig. Uninitialized latches start at 0.
+void readAiger(std::istream& is, Aig& aig);
+
+}//CoreIR namespace
+
+#endif //AIG_HPP_
@@ -0,0 +1,251 @@
+#include <iostream>
+#include "aig.hpp"
+
+using namespace std;
+
+namespace CoreIR {
+
+namespace {
+
+//Collects small writes and hands them to the stream in large chunks
+class OutBuffer {
+  std::ostream& os;
+  string buf;
+  public :
+    OutBuffer(std::ostream& os) : os(os) { buf.reserve(1<<16);}
+    ~OutBuffer() { flush();}
+    void flush() {
+      os.write(buf.data(),buf.size());
+      buf.clear();
+    }
+    OutBuffer& operator<<(const string& s) {
+      buf += s;
+      if (buf.size()>=(1<<16)) flush();
+      return *this;
+    }
+    OutBuffer& operator<<(char ch) {
+      buf += ch;
+      if (buf.size()>=(1<<16)) flush();
+      return *this;
+    }
+    OutBuffer& operator<<(uint64_t n) { return *this << to_string(n);}
+};
+
+//AIGER numbering of the nodes: the inputs, the latches and then the ands
+//(which are already in topological order)
+vector<uint32_t> aigerVars(Aig& aig) {
+  vector<uint32_t> var(aig.getNumNodes(),0);
+  uint32_t next = 1;
+  for (auto n : aig.getInputs()) var[n] = next++;
+  for (auto n : aig.getLatches()) var[n] = next++;
+  for (uint32_t n=0; n<aig.getNumNodes(); ++n) {
+    if (aig.getKind(n)==Aig::AK_And) var[n] = next++;
+  }
+  return var;
+}
+
+void writeVarint(OutBuffer& out, uint32_t x) {
+  while (x & ~0x7f) {
+    out << (char) ((x & 0x7f) | 0x80);
+    x >>= 7;
+  }
+  out << (char) x;
+}
+
+uint32_t readVarint(std::istream& is) {
+  uint32_t x = 0;
+  uint shift = 0;
+  while (true) {
+    int ch = is.get();
+    ASSERT(ch!=EOF,"Unexpected end of the AIGER and section");
+    x |= (uint32_t) (ch & 0x7f) << shift;
+    if (!(ch & 0x80)) return x;
+    shift += 7;
+    ASSERT(shift<32,"Bad AIGER delta");
+  }
+}
+
+vector<uint32_t> readNumbers(std::istream& is, string what) {
+  string line;
+  ASSERT(std::getline(is,line),"Unexpected end of the AIGER file in the " + what);
+  std::istringstream ss(line);
+  vector<uint32_t> nums;
+  uint32_t n;
+  while (ss >> n) nums.push_back(n);
+  return nums;
+}
+
+}
+
+void writeAiger(Aig& aig, std::ostream& os) {
+  vector<uint32_t> var = aigerVars(aig);
+  auto aigerLit = [&](AigLit l) { return (uint64_t) Aig::lit(var[Aig::node(l)],Aig::isNeg(l));};
+  uint numIns = aig.getInputs().size();
+  uint numLatches = aig.getLatches().size();
+  OutBuffer out(os);
+  out << "aig " << (uint64_t) (numIns + numLatches + aig.getNumAnds()) << ' ' << (uint64_t) numIns << ' ' << (uint64_t) numLatches << ' ' << (uint64_t) aig.getOutputs().size() << ' ' << (uint64_t) aig.getNumAnds() << '\n';
+  for (uint i=0; i<numLatches; ++i) {
+    out << aigerLit(aig.getLatchNexts()[i]);
+    if (aig.getLatchInits()[i]) out << " 1";
+    out << '\n';
+  }
+  for (auto o : aig.getOutputs()) out << aigerLit(o) << '\n';
+  for (uint32_t n=0; n<aig.getNumNodes(); ++n) {
+    if (aig.getKind(n)!=Aig::AK_And) continue;
+    uint32_t lhs = 2*var[n];
+    uint32_t rhs0 = aigerLit(aig.getFanin0(n));
+    uint32_t rhs1 = aigerLit(aig.getFanin1(n));
+    if (rhs0<rhs1) std::swap(rhs0,rhs1);
+    writeVarint(out,lhs-rhs0);
+    writeVarint(out,rhs0-rhs1);
+  }
+  for (uint i=0; i<numIns; ++i) out << 'i' << (uint64_t) i << ' ' << aig.getInputNames()[i] << '\n';
+  for (uint i=0; i<numLatches; ++i) out << 'l' << (uint64_t) i << ' ' << aig.getLatchNames()[i] << '\n';
+  for (uint i=0; i<aig.getOutputs().size(); ++i) out << 'o' << (uint64_t) i << ' ' << aig.getOutputNames()[i] << '\n';
+}
+
+void writeBlif(Aig& aig, std::ostream& os, string model) {
+  vector<string> names(aig.getNumNodes());
+  for (uint i=0; i<aig.getInputs().size(); ++i) names[aig.getInputs()[i]] = aig.getInputNames()[i];
+  for (uint i=0; i<aig.getLatches().size(); ++i) names[aig.getLatches()[i]] = aig.getLatchNames()[i];
+  auto andName = [](uint32_t n) { return "aig_n" + to_string(n);};
+
+  OutBuffer out(os);
+  auto list = [&](string keyword, const vector<string>& ns) {
+    out << keyword;
+    for (uint i=0; i<ns.size(); ++i) {
+      if (i>0 && i%8==0) out << " \\\n";
+      out << ' ' << ns[i];
+    }
+    out << '\n';
+  };
+  out << ".model " << model << '\n';
+  list(".inputs",aig.getInputNames());
+  list(".outputs",aig.getOutputNames());
+
+  //Latch next states and outputs drive their nets through buffers (or
+  //inverters), ands use the complements in their covers
+  auto drive = [&](AigLit l, string net) {
+    uint32_t n = Aig::node(l);
+    if (n==0) {
+      out << ".names " << net << '\n';
+      if (l==Aig::True) out << "1\n";
+      return;
+    }
+    out << ".names " << names[n] << ' ' << net << '\n' << (Aig::isNeg(l) ? "0 1\n" : "1 1\n");
+  };
+  for (uint i=0; i<aig.getLatches().size(); ++i) {
+    string next = "aig_l" + to_string(i) + "_next";
+    out << ".latch " << next << ' ' << aig.getLatchNames()[i] << ' ' << (aig.getLatchInits()[i] ? '1' : '0') << '\n';
+  }
+  for (uint32_t n=0; n<aig.getNumNodes(); ++n) {
+    if (aig.getKind(n)!=Aig::AK_And) continue;
+    names[n] = andName(n);
+    AigLit f0 = aig.getFanin0(n);
+    AigLit f1 = aig.getFanin1(n);
+    out << ".names " << names[Aig::node(f0)] << ' ' << names[Aig::node(f1)] << ' ' << names[n] << '\n';
+    out << (Aig::isNeg(f0) ? '0' : '1') << (Aig::isNeg(f1) ? '0' : '1') << " 1\n";
+  }
+  for (uint i=0; i<aig.getLatches().size(); ++i) {
+    drive(aig.getLatchNexts()[i],"aig_l" + to_string(i) + "_next");
+  }
+  for (uint i=0; i<aig.getOutputs().size(); ++i) {
+    drive(aig.getOutputs()[i],aig.getOutputNames()[i]);
+  }
+  out << ".end\n";
+}
+
+void readAiger(std::istream& is, Aig& aig) {
+  ASSERT(aig.getNumNodes()==1,"Can only read AIGER into an empty Aig");
+  string line;
+  ASSERT(std::getline(is,line),"Empty AIGER file");
+  std::istringstream header(line);
+  string format;
+  header >> format;
+  ASSERT(format=="aig" || format=="aag","Not an AIGER file: " + line);
+  bool binary = format=="aig";
+  vector<uint32_t> nums;
+  uint32_t n;
+  while (header >> n) nums.push_back(n);
+  ASSERT(nums.size()>=5,"Bad AIGER header: " + line);
+  for (uint i=5; i<nums.size(); ++i) {
+    ASSERT(nums[i]==0,"Bad constraints, justice or fairness properties are not supported");
+  }
+  uint32_t maxVar = nums[0], numIns = nums[1], numLatches = nums[2], numOuts = nums[3], numAnds = nums[4];
+
+  //Variables of the inputs, latches and ands in the file
+  vector<uint32_t> inVars, latchVars, latchNexts, andVars, andRhs0, andRhs1, outLits;
+  vector<bool> latchInits;
+  for (uint32_t i=0; i<numIns; ++i) {
+    if (binary) inVars.push_back(i+1);
+    else inVars.push_back(readNumbers(is,"inputs").at(0)/2);
+  }
+  for (uint32_t i=0; i<numLatches; ++i) {
+    vector<uint32_t> l = readNumbers(is,"latches");
+    if (binary) l.insert(l.begin(),2*(numIns+i+1));
+    ASSERT(l.size()==2 || l.size()==3,"Bad AIGER latch " + to_string(i));
+    latchVars.push_back(l[0]/2);
+    latchNexts.push_back(l[1]);
+    //An init equal to the latch itself is uninitialized
+    latchInits.push_back(l.size()==3 && l[2]==1);
+  }
+  for (uint32_t i=0; i<numOuts; ++i) {
+    outLits.push_back(readNumbers(is,"outputs").at(0));
+  }
+  for (uint32_t i=0; i<numAnds; ++i) {
+    if (binary) {
+      uint32_t lhs = 2*(numIns+numLatches+i+1);
+      uint32_t rhs0 = lhs - readVarint(is);
+      uint32_t rhs1 = rhs0 - readVarint(is);
+      andVars.push_back(lhs/2);
+      andRhs0.push_back(rhs0);
+      andRhs1.push_back(rhs1);
+    }
+    else {
+      vector<uint32_t> a = readNumbers(is,"ands");
+      ASSERT(a.size()==3,"Bad AIGER and " + to_string(i));
+      andVars.push_back(a[0]/2);
+      andRhs0.push_back(a[1]);
+      andRhs1.push_back(a[2]);
+    }
+  }
+
+  //Symbol table (up to the comment section)
+  vector<string> inNames, latchNames, outNames;
+  for (uint32_t i=0; i<numIns; ++i) inNames.push_back("i" + to_string(i));
+  for (uint32_t i=0; i<numLatches; ++i) latchNames.push_back("l" + to_string(i));
+  for (uint32_t i=0; i<numOuts; ++i) outNames.push_back("o" + to_string(i));
+  while (std::getline(is,line)) {
+    if (line.empty()) continue;
+    if (line[0]=='c') break;
+    size_t space = line.find(' ');
+    if (space==string::npos || space<2) continue;
+    uint32_t idx = std::stoul(line.substr(1,space-1));
+    string name = line.substr(space+1);
+    if (line[0]=='i' && idx<numIns) inNames[idx] = name;
+    else if (line[0]=='l' && idx<numLatches) latchNames[idx] = name;
+    else if (line[0]=='o' && idx<numOuts) outNames[idx] = name;
+  }
+
+  //File variable -> literal in aig
+  vector<AigLit> map(maxVar+1,Aig::False);
+  vector<bool> defined(maxVar+1,false);
+  defined[0] = true;
+  auto define = [&](uint32_t var, AigLit l) {
+    ASSERT(var<=maxVar && !defined[var],"Bad AIGER variable " + to_string(var));
+    map[var] = l;
+    defined[var] = true;
+  };
+  auto get = [&](uint32_t flit) {
+    uint32_t var = flit/2;
+    ASSERT(var<=maxVar && defined[var],"AIGER literal used before its definition: " + to_string(flit));
+    return map[var] ^ (flit&1);
+  };
+  for (uint32_t i=0; i<numIns; ++i) define(inVars[i],aig.newInput(inNames[i]));
+  for (uint32_t i=0; i<numLatches; ++i) define(latchVars[i],aig.newLatch(latchNames[i],latchInits[i]));
+  for (uint32_t i=0; i<numAnds; ++i) define(andVars[i],aig.And(get(andRhs0[i]),get(andRhs1[i])));
+  for (uint32_t i=0; i<numLatches; ++i) aig.setLatchNext(i,get(latchNexts[i]));
+  for (uint32_t i=0; i<numOuts; ++i) aig.newOutput(outNames[i],get(outLits[i]));
+}
+
+}//CoreIR namespace
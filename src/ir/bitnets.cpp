@@ -0,0 +1,191 @@
+#include "bitnets.hpp"
+#include "context.hpp"
+#include "moduledef.hpp"
+#include "wireable.hpp"
+#include "types.hpp"
+#include "instantiable.hpp"
+#include "namespace.hpp"
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+
+namespace CoreIR {
+
+namespace {
+
+Type* stripNamed(Type* t) {
+  while (auto nt = dyn_cast<NamedType>(t)) t = nt->getRaw();
+  return t;
+}
+
+//Offset of field or index sel within t
+uint selOffset(Type* t, const string& sel, Type*& ret) {
+  t = stripNamed(t);
+  if (auto at = dyn_cast<ArrayType>(t)) {
+    ret = at->getElemType();
+    return stoi(sel)*ret->getSize();
+  }
+  auto rt = cast<RecordType>(t);
+  auto record = rt->getRecord();
+  uint offset = 0;
+  for (auto field : rt->getFields()) {
+    if (field==sel) break;
+    offset += record[field]->getSize();
+  }
+  ret = record.at(sel);
+  return offset;
+}
+
+//Calls fun with the direction of every bit of t
+void forEachBit(Type* t, std::function<void(bool)> fun) {
+  t = stripNamed(t);
+  if (auto at = dyn_cast<ArrayType>(t)) {
+    for (uint i=0; i<at->getLen(); ++i) forEachBit(at->getElemType(),fun);
+  }
+  else if (auto rt = dyn_cast<RecordType>(t)) {
+    auto record = rt->getRecord();
+    for (auto field : rt->getFields()) forEachBit(record[field],fun);
+  }
+  else {
+    fun(t->getDir()==Type::DK_Out);
+  }
+}
+
+}
+
+BitNets::BitNets(ModuleDef* def) : def(def) {
+  tops.push_back(def->getInterface());
+  for (Instance* inst = def->getInstancesIterBegin(); inst!=def->getInstancesIterEnd(); inst = def->getInstancesIterNext(inst)) {
+    tops.push_back(inst);
+  }
+  bases.push_back(0);
+  for (uint i=0; i<tops.size(); ++i) {
+    topIndex[tops[i]] = i;
+    forEachBit(tops[i]->getType(),[this](bool out) { drivers.push_back(out);});
+    bases.push_back(drivers.size());
+  }
+
+  //Union find over the bits
+  uint numBits = drivers.size();
+  vector<uint> parent(numBits);
+  for (uint i=0; i<numBits; ++i) parent[i] = i;
+  auto find = [&parent](uint x) {
+    while (parent[x]!=x) {
+      parent[x] = parent[parent[x]];
+      x = parent[x];
+    }
+    return x;
+  };
+  for (auto con : def->getConnections()) {
+    uint a = getBit(con.first);
+    uint b = getBit(con.second);
+    uint size = con.first->getType()->getSize();
+    for (uint i=0; i<size; ++i) {
+      uint ra = find(a+i), rb = find(b+i);
+      if (ra!=rb) parent[ra] = rb;
+    }
+  }
+  nets.assign(numBits,0);
+  unordered_map<uint,uint> rootNets;
+  for (uint bit=0; bit<numBits; ++bit) {
+    uint root = find(bit);
+    auto it = rootNets.find(root);
+    if (it==rootNets.end()) {
+      it = rootNets.emplace(root,netDrivers.size()).first;
+      netDrivers.push_back(-1);
+      netBits.push_back(vector<uint>());
+    }
+    uint net = it->second;
+    nets[bit] = net;
+    netBits[net].push_back(bit);
+    if (drivers[bit] && netDrivers[net]<0) netDrivers[net] = bit;
+  }
+}
+
+uint BitNets::getBit(Wireable* w) {
+  if (auto sel = dyn_cast<Select>(w)) {
+    Wireable* parent = sel->getParent();
+    Type* t;
+    return getBit(parent) + selOffset(parent->getType(),sel->getSelStr(),t);
+  }
+  return bases[topIndex.at(w)];
+}
+
+uint BitNets::getTop(uint bit) {
+  return std::upper_bound(bases.begin(),bases.end(),bit) - bases.begin() - 1;
+}
+
+Wireable* BitNets::getWireable(uint bit, uint width) {
+  uint top = getTop(bit);
+  Wireable* w = tops[top];
+  uint offset = bit - bases[top];
+  while (true) {
+    Type* t = w->getType();
+    if (offset==0 && width==t->getSize()) return w;
+    t = stripNamed(t);
+    Wireable* next = nullptr;
+    if (auto at = dyn_cast<ArrayType>(t)) {
+      uint esize = at->getElemType()->getSize();
+      uint idx = offset/esize;
+      offset -= idx*esize;
+      if (offset+width<=esize) next = w->sel(idx);
+    }
+    else if (auto rt = dyn_cast<RecordType>(t)) {
+      auto record = rt->getRecord();
+      for (auto field : rt->getFields()) {
+        uint fsize = record[field]->getSize();
+        if (offset<fsize) {
+          if (offset+width<=fsize) next = w->sel(field);
+          break;
+        }
+        offset -= fsize;
+      }
+    }
+    if (!next) return nullptr;
+    w = next;
+  }
+}
+
+void BitNets::redirect(Wireable* port, const vector<uint>& srcs) {
+  uint base = getBit(port);
+  for (auto con : port->getLocalConnections()) {
+    Wireable* other = con.second;
+    uint off = getBit(con.first) - base;
+    uint width = con.first->getType()->getSize();
+    def->disconnect(con.first,other);
+    bool consecutive = true;
+    for (uint i=1; i<width; ++i) consecutive &= srcs[off+i]==srcs[off]+i;
+    Wireable* src = consecutive ? getWireable(srcs[off],width) : nullptr;
+    if (src) {
+      def->connect(src,other);
+      continue;
+    }
+    uint otherBase = getBit(other);
+    for (uint i=0; i<width; ++i) {
+      def->connect(getWireable(srcs[off+i]),getWireable(otherBase+i));
+    }
+  }
+}
+
+string coreirPrimName(Instance* inst) {
+  Generator* gen = inst->getGeneratorRef();
+  if (!gen || gen->getNamespace()->getName()!="coreir") return "";
+  return gen->getName();
+}
+
+Arg* getInstanceArg(Instance* inst, string name) {
+  Args genargs = inst->getGenArgs();
+  if (genargs.count(name)) return genargs.at(name);
+  Args configargs = inst->getConfigArgs();
+  if (configargs.count(name)) return configargs.at(name);
+  if (Generator* gen = inst->getGeneratorRef()) {
+    Args defaults = gen->getDefaultGenArgs();
+    if (defaults.count(name)) return defaults.at(name);
+  }
+  Args defaults = inst->getInstantiableRef()->getDefaultConfigArgs();
+  if (defaults.count(name)) return defaults.at(name);
+  return nullptr;
+}
+
+}//CoreIR namespace
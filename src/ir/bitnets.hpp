@@ -0,0 +1,66 @@
+#ifndef BITNETS_HPP_
+#define BITNETS_HPP_
+
+#include "common.hpp"
+
+namespace CoreIR {
+
+//Bit level view of the nets of a ModuleDef for the netlist optimizations.
+//Every bit of self and of every instance gets an index (in the order of
+//getTops()) and the connections, bulk or not, join the bits into nets.
+//A net is driven by an output bit of an instance or an input bit of self.
+//The view is a snapshot: connections added later are not seen, but bit
+//indices of the existing wireables stay valid.
+class BitNets {
+  ModuleDef* def;
+  //self, then the instances in iteration order
+  vector<Wireable*> tops;
+  unordered_map<Wireable*,uint> topIndex;
+  //First bit of every top (and the total number of bits at the end)
+  vector<uint> bases;
+  vector<bool> drivers;
+  vector<uint> nets;
+  vector<int> netDrivers;
+  vector<vector<uint>> netBits;
+  public :
+    explicit BitNets(ModuleDef* def);
+    ModuleDef* getDef() { return def;}
+    const vector<Wireable*>& getTops() { return tops;}
+    uint getNumBits() { return bases.back();}
+    uint getNumNets() { return netDrivers.size();}
+
+    //First bit of w (self, an instance or a select of one of those)
+    uint getBit(Wireable* w);
+    //Bits of the top with index top are [getBase(top),getBase(top+1))
+    uint getBase(uint top) { return bases[top];}
+    uint getTopIndex(Wireable* top) { return topIndex.at(top);}
+    //Index of the top containing bit
+    uint getTop(uint bit);
+
+    uint getNet(uint bit) { return nets[bit];}
+    //Driving bit of net or -1 if nothing drives it
+    int getDriver(uint net) { return netDrivers[net];}
+    bool isDriver(uint bit) { return drivers[bit];}
+    //Every bit of net (driver and readers)
+    const vector<uint>& getBits(uint net) { return netBits[net];}
+
+    //The wireable that is exactly the bits [bit,bit+width) or nullptr if
+    //the range is not one select
+    Wireable* getWireable(uint bit, uint width=1);
+
+    //Rewires everything connected to port (or to selects of port) to read
+    //the bits srcs instead, where srcs[i] replaces bit i of port. Ranges of
+    //consecutive bits are connected at once when possible.
+    void redirect(Wireable* port, const vector<uint>& srcs);
+};
+
+//Name of the coreir primitive inst instantiates ("add", "reg", ...) or ""
+string coreirPrimName(Instance* inst);
+
+//Gen or config arg name of inst (the default if inst does not set it) or
+//nullptr if there is neither
+Arg* getInstanceArg(Instance* inst, string name);
+
+}//CoreIR namespace
+
+#endif //BITNETS_HPP_
@@ -3,6 +3,7 @@
 #include <sstream>
 #include <vector>
 #include <iterator>
+#include <map>
 
 //#include "coreir.hpp"
 //#include "typedcoreir.hpp"
@@ -72,6 +73,15 @@ string Args2Str(Args args) {
   }
   return s + ")";
 }
+string Args2CanonicalStr(Args args) {
+  std::map<string,Arg*> sorted(args.begin(),args.end());
+  string s = "(";
+  for (auto it=sorted.begin(); it!=sorted.end(); ++it) {
+    s = s + (it==sorted.begin() ? "" : ",") + it->first + ":"+it->second->toString();
+  }
+  return s + ")";
+}
+
 string SelectPath2Str(SelectPath path) {
   return join(path.begin(),path.end(),string("."));
 }
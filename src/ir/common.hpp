@@ -105,6 +105,8 @@ bool isNumber(string s);
 string Param2Str(Param);
 string Params2Str(Params);
 string Args2Str(Args);
+//Same as Args2Str but sorted by name so it is stable across runs
+string Args2CanonicalStr(Args);
 string SelectPath2Str(SelectPath path);
 string Connection2Str(Connection con);
 Param Str2Param(string s);
@@ -13,6 +13,12 @@ Context::Context() : maxErrors(8) {
   pm = new PassManager(this);
 }
 
+void Context::reserveGenName(string name, string key) {
+  auto it = genNames.find(name);
+  ASSERT(it==genNames.end() || it->second==key,"Generated module name " + name + " is used by both " + it->second + " and " + key);
+  genNames[name] = key;
+}
+
 // Order of this matters
 Context::~Context() {
   
@@ -31,6 +31,24 @@ class Context {
   //Unique int
   uint unique=0;
 
+  //The top module (see setTop)
+  Module* top = nullptr;
+
+  public :
+    //How Generator::getModule names the modules it creates
+    //  GN_Unique: <generator>_U<n>. Depends on the order generators are run.
+    //  GN_Hash: <generator>_H<hash> where hash is a stable hash of the generator ref and the canonical genargs.
+    //  GN_NameGen: The NameGen_t of the generator (or just its name). The
+    //    hash is appended unless the NameGen_t is marked injective.
+    //Hash and NameGen names only depend on the generator and its args, so
+    //they are the same across runs, machines and elaboration orders
+    enum GenNaming {GN_Unique, GN_Hash, GN_NameGen};
+  private :
+  GenNaming genNaming=GN_Unique;
+  //Every name handed out to a generated module -> the generator and args
+  //it was handed out for (used to catch collisions)
+  unordered_map<string,string> genNames;
+
 
   //Memory management
   TypeCache* cache;
@@ -78,6 +96,13 @@ class Context {
     Generator* getGenerator(string ref);
     Instantiable* getInstantiable(string ref);
     map<string,Namespace*> getNamespaces() {return libs;}
+    
+    //The designated top of the design (set by loadFromFile when the file
+    //has one). PassManager::setTopOnly restricts the passes to the modules
+    //reachable from it.
+    void setTop(Module* top) { this->top = top;}
+    Module* getTop() { return top;}
+    bool hasTop() { return !!top;}
     void addPass(Pass* p);
     bool runPasses(vector<string> order,vector<string> namespaces= vector<string>({"global"}));
 
@@ -115,6 +140,12 @@ class Context {
       return "_U" + to_string(unique++);
     }
 
+    void setGenNaming(GenNaming gn) { genNaming = gn;}
+    GenNaming getGenNaming() { return genNaming;}
+    //Reserves name for the generated module identified by key (its
+    //generator and canonical args). Errors if another module has the name.
+    void reserveGenName(string name, string key);
+
     
 
 
@@ -137,6 +168,7 @@ void deleteContext(Context* c);
 
 //This will load the namespaces in the file into the context
 //If there is a labeled "top", it will be returned in top (if it is not null)
+//and set as the top of the context (Context::setTop)
 //if no "top" in file, *top == nullptr
 bool loadFromFile(Context* c, string filename,Module** top=nullptr);
 
@@ -127,7 +127,7 @@ bool loadFromFile(Context* c, string filename,Module** top) {
           }
           
           json jmod = jmodmap.second;
-          checkJson(jmod,{"type","configparams","defaultconfigargs","instances","connections"});
+          checkJson(jmod,{"type","configparams","defaultconfigargs","instances","connections","metadata","wiremetadata"});
           Type* t = json2Type(c,jmod.at("type"));
           
           Params configparams;
@@ -154,7 +154,7 @@ bool loadFromFile(Context* c, string filename,Module** top) {
           }
 
           json jgen = jgenmap.second;
-          checkJson(jgen,{"typegen","genparams","defaultgenargs","configparams","defaultconfigargs"});
+          checkJson(jgen,{"typegen","genparams","defaultgenargs","configparams","defaultconfigargs","metadata"});
           Params genparams = json2Params(jgen.at("genparams"));
           auto tgenref = getRef(jgen.at("typegen").get<string>());
           TypeGen* typegen = c->getTypeGen(jgen.at("typegen").get<string>());
@@ -187,7 +187,8 @@ bool loadFromFile(Context* c, string filename,Module** top) {
         for (auto jinstmap : jmod.at("instances").get<jsonmap>()) {
           string instname = jinstmap.first;
           json jinst = jinstmap.second;
-          checkJson(jinst,{"modref","genref","genargs","configargs"});
+          checkJson(jinst,{"modref","genref","genargs","configargs","metadata"});
+          Instance* inst;
           // This function can throw an error
           if (jinst.count("modref")) {
             assert(jinst.count("genref")==0);
@@ -197,7 +198,7 @@ bool loadFromFile(Context* c, string filename,Module** top) {
             if (jinst.count("configargs")) {
               configargs = json2Args(c,modRef->getConfigParams(),jinst.at("configargs"));
             }
-            mdef->addInstance(instname,modRef,configargs);
+            inst = mdef->addInstance(instname,modRef,configargs);
           }
           else if (jinst.count("genargs") && jinst.count("genref")) { // This is a generator
             auto gref = getRef(jinst.at("genref").get<string>());
@@ -207,11 +208,14 @@ bool loadFromFile(Context* c, string filename,Module** top) {
             if (jinst.count("configargs")) {
               configargs = json2Args(c,genRef->getConfigParams(),jinst.at("configargs"));
             }
-            mdef->addInstance(instname,genRef,genargs,configargs);
+            inst = mdef->addInstance(instname,genRef,genargs,configargs);
           }
           else {
             ASSERTTHROW(0,"Bad Instance. Need (modref || (genref && genargs))");
           }
+          if (jinst.count("metadata")) {
+            inst->setMetaData(jinst.at("metadata"));
+          }
         } // End Instances
       }
 
@@ -222,18 +226,25 @@ bool loadFromFile(Context* c, string filename,Module** top) {
           mdef->connect(jcon[0],jcon[1]);
         }
       }
+
+      //Metadata of ports (instance ports and self)
+      if (jmod.count("wiremetadata")) {
+        for (auto jwire : jmod.at("wiremetadata").get<jsonmap>()) {
+          mdef->sel(jwire.first)->setMetaData(jwire.second);
+        }
+      }
       
       //Add Def back in
       m->setDef(mdef);
     } //End Module loop
 
-    //If top exists return it
-    if (top && j.count("top")) {
-      *top = getModSymbol(c,j["top"].get<string>());
-    }
-    else if (top) {
-      *top = nullptr;
+    //If top exists return it (and make it the top of the context)
+    Module* jtop = nullptr;
+    if (j.count("top")) {
+      jtop = getModSymbol(c,j["top"].get<string>());
+      c->setTop(jtop);
     }
+    if (top) *top = jtop;
   } catch(std::exception& exc) {
     Error e; 
     e.message(exc.what());
@@ -267,6 +267,18 @@ json Instantiable::toJson() {
   return j;
 }
 
+//Selects (at any depth) that have metadata
+void WireMetaData2Json(Wireable* w, json& j) {
+  for (auto sel : w->getSelects()) {
+    Wireable* s = sel.second;
+    if (s->hasMetaData()) {
+      SelectPath path = s->getSelectPath();
+      j[join(path.begin(),path.end(),string("."))] = s->getMetaData();
+    }
+    WireMetaData2Json(s,j);
+  }
+}
+
 json Module::toJson() {
   json j = Instantiable::toJson();
   j["type"] = type->toJson();
@@ -278,6 +290,15 @@ json Module::toJson() {
     if (jdef.count("connections")) {
       j["connections"] = jdef["connections"];
     }
+    json jwires;
+    WireMetaData2Json(this->getDef()->getInterface(),jwires);
+    for (auto inst : this->getDef()->getInstances()) WireMetaData2Json(inst.second,jwires);
+    if (!jwires.empty()) {
+      j["wiremetadata"] = jwires;
+    }
+  }
+  if (this->hasMetaData()) {
+    j["metadata"] = this->getMetaData();
   }
   return j;
 }
@@ -333,6 +354,9 @@ json Instance::toJson() {
   if (this->hasConfigArgs()) {
     j["configargs"] = Args2Json(this->getConfigArgs());
   }
+  if (this->hasMetaData()) {
+    j["metadata"] = this->getMetaData();
+  }
   return j;
 }
 
@@ -2,6 +2,15 @@
 
 using namespace CoreIR;
 
+void CoreIR::addReachable(Module* top, std::unordered_set<Instantiable*>& reachable) {
+  if (!reachable.insert(top).second || !top->hasDef()) return;
+  for (auto imap : top->getDef()->getInstances()) {
+    Instance* inst = imap.second;
+    if (inst->isGen()) reachable.insert(inst->getGeneratorRef());
+    else addReachable(inst->getModuleRef(),reachable);
+  }
+}
+
 void InstanceGraph::releaseMemory() {
   nodeMap.clear();
   for (auto ign : sortedNodes) delete ign;
@@ -1,9 +1,12 @@
 #include <cassert>
 #include <vector>
 #include <set>
+#include <map>
 
 #include "instantiable.hpp"
 #include "typegen.hpp"
+#include "structuralhash.hpp"
+#include "moduledef.hpp"
 
 using namespace std;
 
@@ -65,7 +68,7 @@ Module* Generator::getModule(Args args) {
   
   checkArgsAreParams(args,genparams);
   Type* type = typegen->getType(args);
-  Module* m = new Module(ns,name + getContext()->getUnique(),type,configparams);
+  Module* m = new Module(ns,genModuleName(args),type,configparams);
   m->setLinkageKind(Instantiable::LK_Generated);
   genCache[args] = m;
   
@@ -80,6 +83,37 @@ Module* Generator::getModule(Args args) {
   return m;
 }
 
+void Generator::eraseModule(Module* m) {
+  for (auto it = genCache.begin(); it != genCache.end(); ) {
+    if (it->second==m) it = genCache.erase(it);
+    else ++it;
+  }
+}
+
+string Generator::genModuleName(Args args) {
+  Context* c = getContext();
+  if (c->getGenNaming()==Context::GN_Unique) {
+    return name + c->getUnique();
+  }
+  //Only depends on the generator and the args so it is stable across runs
+  string key = getRefName() + Args2CanonicalStr(args);
+  string hstr = hash2Str(stableHash(key));
+  string ret;
+  if (c->getGenNaming()==Context::GN_Hash) {
+    ret = name + "_H" + hstr;
+  }
+  //NameGen functions do not have to be injective (reg ignores width), so
+  //the hash is appended unless the generator says otherwise
+  else if (nameGen && nameGenInjective) {
+    ret = getName(args);
+  }
+  else {
+    ret = getName(args) + "_H" + hstr;
+  }
+  c->reserveGenName(ret,key);
+  return ret;
+}
+
 void Generator::setGeneratorDefFromFun(ModuleDefGenFun fun) {
   ASSERT(!def,"Do you really want to overwrite the def? No.");
   this->def = new GeneratorDefFromFun(this,fun);
@@ -125,46 +159,108 @@ ModuleDef* Module::newModuleDef() {
   return md;
 }
 
+namespace {
+
+string pathStr(SelectPath path, const unordered_map<string,string>& rename) {
+  if (rename.count(path[0])) path[0] = rename.at(path[0]);
+  string s = path[0];
+  for (uint i=1; i<path.size(); ++i) s += "." + path[i];
+  return s;
+}
+
+//Instance labels that only depend on the instance itself (and its name if
+//withName). Labels of instances that are not unique get the labels of
+//their neighbors appended. Returns false if they are still not unique.
+bool instanceLabels(ModuleDef* def, bool withName, bool withRefName, unordered_map<string,string>& labels) {
+  unordered_map<string,string> base;
+  for (auto imap : def->getInstances()) {
+    Instance* inst = imap.second;
+    string l = withRefName ? inst->getInstantiableRef()->getRefName() : inst->getType()->toString();
+    l += Args2CanonicalStr(inst->getGenArgs()) + Args2CanonicalStr(inst->getConfigArgs());
+    if (withName) l += "@" + imap.first;
+    base[imap.first] = l;
+  }
+  unordered_map<string,string> none;
+  std::map<string,uint> counts;
+  for (auto b : base) counts[b.second]++;
+  labels.clear();
+  std::set<string> unique;
+  for (auto imap : def->getInstances()) {
+    string l = base[imap.first];
+    if (counts[l]>1) {
+      std::multiset<string> neighbors;
+      for (auto con : imap.second->getLocalConnections()) {
+        SelectPath local = con.first->getSelectPath();
+        SelectPath other = con.second->getSelectPath();
+        local[0] = "";
+        string otherStr = other[0]=="self" ? "self" : base[other[0]];
+        other[0] = "";
+        neighbors.insert(pathStr(local,none) + ">" + otherStr + pathStr(other,none));
+      }
+      for (auto& n : neighbors) l += "|" + n;
+    }
+    if (!unique.insert(l).second) return false;
+    labels[imap.first] = l;
+  }
+  return true;
+}
+
+std::multiset<string> connectionStrs(ModuleDef* def, const unordered_map<string,string>& rename) {
+  std::multiset<string> cons;
+  for (auto con : def->getConnections()) {
+    string a = pathStr(con.first->getSelectPath(),rename);
+    string b = pathStr(con.second->getSelectPath(),rename);
+    cons.insert(a<b ? a + "=" + b : b + "=" + a);
+  }
+  return cons;
+}
+
+}
+
 bool Module::isEqual(Module* m0, Module* m1, bool checkConfig, bool checkInstNames,bool checkModuleNames) {
-  //Check for the same configparams
+  //Check for the same configparams and their defaults
   if (checkConfig && (m0->getConfigParams() != m1->getConfigParams())) {
     return false;
   }
+  if (checkConfig && !(m0->getDefaultConfigArgs() == m1->getDefaultConfigArgs())) {
+    return false;
+  }
 
   //Check if it is of the same type
   if (m0->getType() != m1->getType()) {
     return false;
   }
-  
-  //workqueue
-  //while workqueue not done:
-  //  instance,instance= pop
-  //  get all wireables, wireables pairs.
-  //  place all the connected instances in queue (if not in done set)
-  //  remove first element of select paths for each pair.
-  //  add to a map from SelectPath to SelectPath (for both pairs)
-  //  check equality of the maps. 
-  //  or something like that
-  //check if all instances have:
-  //  same type
-  //  same genargs
-  //  same configargs
-
-
-  //for now as an approximate thing, just check that number of instances and number of connections are the same
-  uint m0InstSize = m0->getDef()->getInstances().size();
-  uint m1InstSize = m1->getDef()->getInstances().size();
-  if (m0InstSize != m1InstSize) {
+  if (m0==m1) return true;
+  //Declarations are only equal to themselves
+  if (!m0->hasDef() || !m1->hasDef()) return false;
+
+  ModuleDef* d0 = m0->getDef();
+  ModuleDef* d1 = m1->getDef();
+  if (d0->getInstances().size() != d1->getInstances().size()) {
     return false;
   }
-
-  uint m0ConSize = m0->getDef()->getConnections().size();
-  uint m1ConSize = m1->getDef()->getConnections().size();
-  if (m0ConSize != m1ConSize) {
+  if (d0->getConnections().size() != d1->getConnections().size()) {
     return false;
   }
-  return true;
 
+  //Match the instances by label: the same instantiable (or type without
+  //checkModuleNames), gen and config args and (with checkInstNames) name.
+  //Without names, instances that cannot be told apart by their label and
+  //the labels of their neighbors make the modules count as different.
+  unordered_map<string,string> labels0, labels1;
+  if (!instanceLabels(d0,checkInstNames,checkModuleNames,labels0)) return false;
+  if (!instanceLabels(d1,checkInstNames,checkModuleNames,labels1)) return false;
+  unordered_map<string,string> byLabel;
+  for (auto l : labels1) byLabel[l.second] = l.first;
+  unordered_map<string,string> rename;
+  for (auto l : labels0) {
+    auto it = byLabel.find(l.second);
+    if (it==byLabel.end()) return false;
+    rename[l.first] = it->second;
+  }
+
+  //Then the connections in terms of the instances of m1
+  return connectionStrs(d0,rename)==connectionStrs(d1,unordered_map<string,string>());
 }
 
 void Module::setDef(ModuleDef* def, bool validate) {
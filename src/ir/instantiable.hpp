@@ -65,6 +65,8 @@ class Generator : public Instantiable {
   Params genparams;
   Args defaultGenArgs; 
   NameGen_t nameGen=nullptr;
+  //Different args always give different names
+  bool nameGenInjective=false;
 
   //This is memory managed
   unordered_map<Args,Module*> genCache;
@@ -88,6 +90,10 @@ class Generator : public Instantiable {
     //This will create a fully run module
     //Note, this is stored in the generator itself and is not in the namespace
     Module* getModule(Args args);
+    //Forgets the cached module m (without deleting it)
+    void eraseModule(Module* m);
+    //The modules created so far (including the ones moved to a namespace)
+    unordered_map<Args,Module*> getGeneratedModules() { return genCache;}
     
     //This will transfer memory management of def to this Generator
     void setDef(GeneratorDef* def) { assert(!this->def); this->def = def;}
@@ -97,8 +103,15 @@ class Generator : public Instantiable {
     void setDefaultGenArgs(Args defaultGenfigargs);
     Args getDefaultGenArgs() { return defaultGenArgs;}
   
-    void setNameGen(NameGen_t ng) {nameGen = ng;}
-
+    //injective: ng never gives two sets of args the same name, so
+    //GN_NameGen can use its names as they are
+    void setNameGen(NameGen_t ng, bool injective=false) {
+      nameGen = ng;
+      nameGenInjective = injective;
+    }
+  private :
+    //Name of the module generated with args (see Context::GenNaming)
+    string genModuleName(Args args);
 
 };
 
@@ -123,8 +136,10 @@ class Module : public Instantiable {
    
     ModuleDef* newModuleDef();
     
-    //check for equal graphs, types, genargs, configargs
-    //Does not check instance names
+    //check for equal graphs, types, genargs, configargs (with checkConfig
+    //also the config params and their defaults)
+    //Instances are matched by name with checkInstNames, otherwise by their
+    //instantiable (type without checkInstantiableNames), args and neighbors
     static bool isEqual(Module* m0, Module* m1, bool checkConfig=false, bool checkInstNames=false,bool checkInstantiableNames=false);
     
     DirectedModule* newDirectedModule();
@@ -274,4 +274,23 @@ void ModuleDef::removeInstance(string iname) {
 
 }
 
+void ModuleDef::removeInstances(const unordered_set<Instance*>& insts) {
+  for (auto it = connections.begin(); it!=connections.end(); ) {
+    Wireable* a = it->first->getTopParent();
+    Wireable* b = it->second->getTopParent();
+    if (!insts.count((Instance*) a) && !insts.count((Instance*) b)) {
+      ++it;
+      continue;
+    }
+    it->first->removeConnectedWireable(it->second);
+    it->second->removeConnectedWireable(it->first);
+    it = connections.erase(it);
+  }
+  for (auto inst : insts) {
+    ASSERT(instances.count(inst->getInstname()) && instances.at(inst->getInstname())==inst,"Instance " + inst->getInstname() + " does not exist");
+    instances.erase(inst->getInstname());
+    removeInstanceFromIter(inst);
+  }
+}
+
 } //coreir namespace
@@ -91,6 +91,8 @@ class ModuleDef {
     //This will also delete all connections from all connected things
     void removeInstance(string inst);
     void removeInstance(Instance* inst);
+    //Removes many instances with a single sweep over the connections
+    void removeInstances(const unordered_set<Instance*>& insts);
 
 
     // This 'typechecks' everything
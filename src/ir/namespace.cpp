@@ -1,5 +1,6 @@
 #include "namespace.hpp"
 #include "typegen.hpp"
+#include "context.hpp"
 
 using namespace std;
 
@@ -165,6 +166,18 @@ void Namespace::addModule(Module* m) {
   moduleList[name] = m;
 }
 
+void Namespace::eraseModule(string mname) {
+  ASSERT(moduleList.count(mname),"Cannot erase missing module " + mname + " in " + name);
+  Module* m = moduleList[mname];
+  moduleList.erase(mname);
+  if (c->getTop()==m) c->setTop(nullptr);
+  //Generated modules added to the namespace are still cached by their generator
+  for (auto nsmap : c->getNamespaces()) {
+    for (auto gmap : nsmap.second->getGenerators()) gmap.second->eraseModule(m);
+  }
+  delete m;
+}
+
 Generator* Namespace::getGenerator(string gname) {
   auto it = generatorList.find(gname);
   if (it != generatorList.end()) return it->second;
@@ -69,6 +69,8 @@ class Namespace {
     Generator* newGeneratorDecl(string name,TypeGen* typegen, Params genparams, Params configparams=Params());
     Module* newModuleDecl(string name, Type* t,Params configparams=Params());
     void addModule(Module* m);
+    //Deletes the module. It must not be instantiated anywhere anymore
+    void eraseModule(string mname);
 
     Generator* getGenerator(string gname);
     Module* getModule(string mname);
@@ -0,0 +1,91 @@
+#include "parallel.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+using namespace std;
+
+namespace CoreIR {
+
+uint defaultNumThreads() {
+  uint n = std::thread::hardware_concurrency();
+  return n==0 ? 1 : n;
+}
+
+void parallelFor(size_t n, std::function<void(size_t)> fun, uint numThreads) {
+  if (numThreads==0) numThreads = defaultNumThreads();
+  if (numThreads > n) numThreads = n;
+  if (numThreads<=1) {
+    for (size_t i=0; i<n; ++i) fun(i);
+    return;
+  }
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i<n; i = next++) {
+      fun(i);
+    }
+  };
+  vector<std::thread> workers;
+  for (uint t=1; t<numThreads; ++t) workers.emplace_back(worker);
+  worker();
+  for (auto& w : workers) w.join();
+}
+
+void parallelRenderOrdered(size_t n, RenderFun render, std::ostream& os, uint numThreads, size_t window) {
+  if (numThreads==0) numThreads = defaultNumThreads();
+  if (numThreads > n) numThreads = n;
+  if (numThreads<=1) {
+    for (size_t i=0; i<n; ++i) render(i,os);
+    return;
+  }
+  if (window==0) window = 4*numThreads;
+
+  //Ring of rendered buffers. Slot i%window holds item i once it is ready
+  vector<string> slots(window);
+  vector<bool> ready(window,false);
+  size_t next = 0; //Next item to hand out
+  size_t written = 0; //Next item to write to os
+  std::mutex m;
+  std::condition_variable cv;
+
+  auto worker = [&]() {
+    while (true) {
+      size_t i;
+      {
+        std::unique_lock<std::mutex> lk(m);
+        //Do not run further ahead than the window allows
+        cv.wait(lk,[&]() {return next>=n || next < written+window;});
+        if (next>=n) return;
+        i = next++;
+      }
+      ostringstream buf;
+      render(i,buf);
+      {
+        std::lock_guard<std::mutex> lk(m);
+        slots[i%window] = buf.str();
+        ready[i%window] = true;
+      }
+      cv.notify_all();
+    }
+  };
+  vector<std::thread> workers;
+  for (uint t=0; t<numThreads; ++t) workers.emplace_back(worker);
+
+  //This thread is the writer
+  while (written < n) {
+    string s;
+    {
+      std::unique_lock<std::mutex> lk(m);
+      cv.wait(lk,[&]() {return ready[written%window];});
+      s.swap(slots[written%window]);
+      ready[written%window] = false;
+      ++written;
+    }
+    cv.notify_all();
+    os << s;
+  }
+  for (auto& w : workers) w.join();
+}
+
+}//CoreIR namespace
@@ -0,0 +1,26 @@
+#ifndef PARALLEL_HPP_
+#define PARALLEL_HPP_
+
+#include "common.hpp"
+#include <functional>
+#include <ostream>
+
+namespace CoreIR {
+
+//Number of worker threads used when a caller asks for 0 threads
+//(hardware concurrency, at least 1)
+uint defaultNumThreads();
+
+//Calls fun(i) for every i in [0,n) spread across numThreads workers.
+//fun must be safe to call concurrently (Do not create types or selects in it!)
+void parallelFor(size_t n, std::function<void(size_t)> fun, uint numThreads=0);
+
+//Renders n items into per-item buffers in parallel and streams them to os in index order.
+//At most 'window' rendered buffers are alive at once so memory stays bounded.
+//With a single thread the items are rendered straight into os.
+typedef std::function<void(size_t,std::ostream&)> RenderFun;
+void parallelRenderOrdered(size_t n, RenderFun render, std::ostream& os, uint numThreads=0, size_t window=0);
+
+}//CoreIR namespace
+
+#endif //PARALLEL_HPP_
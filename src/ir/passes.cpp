@@ -6,6 +6,10 @@ using namespace CoreIR;
 Pass* Pass::getAnalysisOutside(std::string ID) {
   return pm->getAnalysisPass(ID);
 }
+bool Pass::inScope(Instantiable* i) {
+  assert(pm);
+  return pm->inScope(i);
+}
 Context* Pass::getContext() {
   assert(pm);
   return pm->c;
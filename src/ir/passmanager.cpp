@@ -47,6 +47,7 @@ bool PassManager::runModulePass(Pass* pass) {
   for (auto ns : this->nss) {
     for (auto modmap : ns->getModules()) {
       Module* m = modmap.second;
+      if (!inScope(m)) continue;
       modified |= mpass->runOnModule(m);
     }
   }
@@ -61,6 +62,7 @@ bool PassManager::runInstanceGraphPass(Pass* pass) {
   bool ret = false;
   InstanceGraphPass* igpass = cast<InstanceGraphPass>(pass);
   for (auto node : cig->getInstanceGraph()->getSortedNodes()) {
+    if (!inScope(node->getInstantiable())) continue;
     cout << "running pass " << node->getInstantiable()->getName() << endl;
     bool modified = igpass->runOnInstanceGraphNode(*node);
     cout << "finished running pass " << node->getInstantiable()->getName() << endl;
@@ -69,10 +71,25 @@ bool PassManager::runInstanceGraphPass(Pass* pass) {
   return ret;
 }
 
+void PassManager::setTopOnly(bool t) {
+  topOnly = t;
+  //The analyses ran over a different set of modules
+  for (auto amap : analysisPasses) {
+    analysisPasses[amap.first] = false;
+  }
+}
+
+void PassManager::updateScope() {
+  scope.clear();
+  if (topOnly && c->hasTop()) addReachable(c->getTop(),scope);
+}
+
 bool PassManager::runPass(Pass* p) {
   if (verbose) {
     cout << "Running Pass: " << p->getName() << endl;
   }
+  //Earlier passes may have changed what is reachable
+  updateScope();
   bool modified = false;
   switch(p->getKind()) {
     case Pass::PK_Namespace:
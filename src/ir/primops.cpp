@@ -0,0 +1,45 @@
+#include "primops.hpp"
+
+using namespace std;
+
+namespace CoreIR {
+namespace PrimOps {
+
+namespace {
+const vector<string> opNames = {
+  "not","neg",
+  "andr","orr","xorr",
+  "and","or","xor","dshl","dlshr","dashr",
+  "add","sub","mul","udiv","urem","sdiv","srem","smod",
+  "eq","slt","sgt","sle","sge","ult","ugt","ule","uge",
+  "mux"
+};
+}
+
+Op str2Op(string s) {
+  static const unordered_map<string,Op> strMap = []() {
+    unordered_map<string,Op> ret;
+    for (uint i=0; i<opNames.size(); ++i) ret[opNames[i]] = (Op) i;
+    return ret;
+  }();
+  auto it = strMap.find(s);
+  return it==strMap.end() ? OP_none : it->second;
+}
+
+string op2Str(Op op) {
+  if (op>=OP_none) return "none";
+  return opNames[op];
+}
+
+uint numOperands(Op op) {
+  if (op<=OP_xorr) return 1;
+  if (op==OP_mux) return 3;
+  return 2;
+}
+
+bool hasBitOutput(Op op) {
+  return (op>=OP_andr && op<=OP_xorr) || (op>=OP_eq && op<=OP_uge);
+}
+
+}//PrimOps namespace
+}//CoreIR namespace
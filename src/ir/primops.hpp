@@ -0,0 +1,110 @@
+#ifndef PRIMOPS_HPP_
+#define PRIMOPS_HPP_
+
+#include <iostream>
+#include <cstdint>
+#include "common.hpp"
+
+namespace CoreIR {
+
+//Semantics of the combinational coreir primitives (see opmap and
+//tools/gen_verilog_prims.py). Values live in the low width bits of a uint64_t,
+//so widths are limited to 64. Results are always masked to the output width.
+namespace PrimOps {
+
+enum Op {
+  //unary
+  OP_not, OP_neg,
+  //unaryReduce
+  OP_andr, OP_orr, OP_xorr,
+  //binary
+  OP_and, OP_or, OP_xor, OP_dshl, OP_dlshr, OP_dashr,
+  OP_add, OP_sub, OP_mul, OP_udiv, OP_urem, OP_sdiv, OP_srem, OP_smod,
+  //binaryReduce
+  OP_eq, OP_slt, OP_sgt, OP_sle, OP_sge, OP_ult, OP_ugt, OP_ule, OP_uge,
+  //ternary (out = sel ? in1 : in0)
+  OP_mux,
+  OP_none
+};
+
+//Returns OP_none if s is not the name of an op
+Op str2Op(std::string s);
+std::string op2Str(Op op);
+
+//Number of operands (mux is in0,in1,sel)
+uint numOperands(Op op);
+
+//Reduces and comparisons have a single bit output
+bool hasBitOutput(Op op);
+
+inline uint64_t mask(uint width) {
+  return width>=64 ? ~0ULL : (1ULL<<width)-1;
+}
+
+inline int64_t sext(uint64_t v, uint width) {
+  if (width>=64) return (int64_t) v;
+  uint s = 64-width;
+  return ((int64_t) (v<<s)) >> s;
+}
+
+//a,b,c are the operands in port order (in/in0, in1, sel) already masked to width
+inline uint64_t eval(Op op, uint width, uint64_t a, uint64_t b=0, uint64_t c=0) {
+  uint64_t m = mask(width);
+  switch(op) {
+    case OP_not : return ~a & m;
+    case OP_neg : return (0-a) & m;
+    case OP_andr : return a==m;
+    case OP_orr : return a!=0;
+    case OP_xorr : return __builtin_parityll(a);
+    case OP_and : return a & b;
+    case OP_or : return a | b;
+    case OP_xor : return a ^ b;
+    case OP_dshl : return b>=width ? 0 : (a<<b) & m;
+    case OP_dlshr : return b>=width ? 0 : a>>b;
+    case OP_dashr : return (uint64_t) (sext(a,width) >> (b>=width ? width-1 : b)) & m;
+    case OP_add : return (a+b) & m;
+    case OP_sub : return (a-b) & m;
+    case OP_mul : return (a*b) & m;
+    //Division by zero: quotient is all ones and remainder is the dividend
+    case OP_udiv : return b==0 ? m : a/b;
+    case OP_urem : return b==0 ? a : a%b;
+    case OP_sdiv : {
+      int64_t sa = sext(a,width), sb = sext(b,width);
+      if (sb==0) return m;
+      if (sb==-1) return (0-a) & m;
+      return (uint64_t) (sa/sb) & m;
+    }
+    case OP_srem : {
+      int64_t sa = sext(a,width), sb = sext(b,width);
+      if (sb==0) return a;
+      if (sb==-1) return 0;
+      return (uint64_t) (sa%sb) & m;
+    }
+    //Like srem but the result has the sign of the divisor
+    case OP_smod : {
+      int64_t sa = sext(a,width), sb = sext(b,width);
+      if (sb==0) return a;
+      if (sb==-1) return 0;
+      int64_t r = sa%sb;
+      if (r!=0 && ((r<0) != (sb<0))) r += sb;
+      return (uint64_t) r & m;
+    }
+    case OP_eq : return a==b;
+    case OP_slt : return sext(a,width) < sext(b,width);
+    case OP_sgt : return sext(a,width) > sext(b,width);
+    case OP_sle : return sext(a,width) <= sext(b,width);
+    case OP_sge : return sext(a,width) >= sext(b,width);
+    case OP_ult : return a < b;
+    case OP_ugt : return a > b;
+    case OP_ule : return a <= b;
+    case OP_uge : return a >= b;
+    case OP_mux : return (c&1) ? b : a;
+    default : ASSERT(0,"Cannot evaluate op " + op2Str(op));
+  }
+  return 0;
+}
+
+}//PrimOps namespace
+}//CoreIR namespace
+
+#endif //PRIMOPS_HPP_
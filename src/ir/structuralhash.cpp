@@ -0,0 +1,106 @@
+#include "structuralhash.hpp"
+#include "context.hpp"
+#include "instantiable.hpp"
+#include "wireable.hpp"
+#include <map>
+#include <algorithm>
+#include <cstdio>
+
+using namespace std;
+
+namespace CoreIR {
+
+uint64_t stableHash(const std::string& s, uint64_t h) {
+  for (unsigned char ch : s) {
+    h ^= ch;
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+uint64_t stableHashCombine(uint64_t h, uint64_t v) {
+  return h ^ (v + 0x9e3779b97f4a7c15ULL + (h<<6) + (h>>2));
+}
+
+string hash2Str(uint64_t h) {
+  char buf[17];
+  snprintf(buf,sizeof(buf),"%016llx",(unsigned long long) h);
+  return string(buf);
+}
+
+namespace {
+string Params2CanonicalStr(Params ps) {
+  std::map<string,Param> sorted(ps.begin(),ps.end());
+  string s = "(";
+  for (auto p : sorted) s += p.first + ":" + Param2Str(p.second) + ",";
+  return s + ")";
+}
+}
+
+uint64_t moduleHash(Module* m) {
+  //Build up a canonical description and hash it. Everything is sorted by name
+  //because the containers in the IR are unordered.
+  uint64_t h = stableHash("module:" + m->getRefName());
+  h = stableHash("type:" + m->getType()->toString(),h);
+  h = stableHash("configparams:" + Params2CanonicalStr(m->getConfigParams()),h);
+  h = stableHash("defaultconfigargs:" + Args2CanonicalStr(m->getDefaultConfigArgs()),h);
+  h = stableHash("metadata:" + m->getMetaData().dump(),h);
+  if (!m->hasDef()) return h;
+
+  ModuleDef* def = m->getDef();
+  auto instances = def->getInstances();
+  std::map<string,Instance*> sortedInstances(instances.begin(),instances.end());
+  for (auto imap : sortedInstances) {
+    Instance* inst = imap.second;
+    Instantiable* iref = inst->getInstantiableRef();
+    string istr = "inst:" + imap.first + ":" + iref->getRefName();
+    if (inst->isGen()) {
+      istr += ":genargs" + Args2CanonicalStr(inst->getGenArgs());
+    }
+    istr += ":configargs" + Args2CanonicalStr(inst->getConfigArgs());
+    istr += ":type" + inst->getType()->toString();
+    istr += ":meta" + iref->getMetaData().dump();
+    h = stableHash(istr,h);
+  }
+
+  vector<string> cons;
+  for (auto con : def->getConnections()) {
+    string a = SelectPath2Str(con.first->getSelectPath());
+    string b = SelectPath2Str(con.second->getSelectPath());
+    if (b < a) std::swap(a,b);
+    cons.push_back(a + "=" + b);
+  }
+  std::sort(cons.begin(),cons.end());
+  for (auto con : cons) {
+    h = stableHash("con:" + con,h);
+  }
+  return h;
+}
+
+uint64_t moduleEmitHash(Module* m) {
+  uint64_t h = moduleHash(m);
+  if (!m->hasDef()) return h;
+  //Instances render the parameters and defaults of what they reference
+  std::map<string,Instantiable*> refs;
+  for (auto imap : m->getDef()->getInstances()) {
+    Instantiable* iref = imap.second->getInstantiableRef();
+    refs[iref->getRefName()] = iref;
+  }
+  for (auto rmap : refs) {
+    Instantiable* iref = rmap.second;
+    string rstr = "ref:" + rmap.first;
+    rstr += ":configparams" + Params2CanonicalStr(iref->getConfigParams());
+    rstr += ":defaultconfigargs" + Args2CanonicalStr(iref->getDefaultConfigArgs());
+    if (auto g = dyn_cast<Generator>(iref)) {
+      rstr += ":genparams" + Params2CanonicalStr(g->getGenParams());
+      rstr += ":defaultgenargs" + Args2CanonicalStr(g->getDefaultGenArgs());
+    }
+    else {
+      rstr += ":type" + cast<Module>(iref)->getType()->toString();
+    }
+    h = stableHash(rstr,h);
+  }
+  return h;
+}
+
+}//CoreIR namespace
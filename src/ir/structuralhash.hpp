@@ -0,0 +1,31 @@
+#ifndef STRUCTURALHASH_HPP_
+#define STRUCTURALHASH_HPP_
+
+#include "common.hpp"
+
+namespace CoreIR {
+
+//64 bit FNV-1a. Unlike std::hash this is stable across runs, compilers and machines
+uint64_t stableHash(const std::string& s, uint64_t h=0xcbf29ce484222325ULL);
+
+//Combines two stable hashes (order dependent)
+uint64_t stableHashCombine(uint64_t h, uint64_t v);
+
+//16 character hex string of a hash
+std::string hash2Str(uint64_t h);
+
+//Stable hash of everything that the emitted text of m depends on:
+//  name, type, config params, default config args, metadata,
+//  every instance (name, ref, gen/config args, type, ref metadata)
+//  and every connection.
+//Instantiated modules only contribute their name and type, so changing the
+//definition of a child does not change the hash of its parent.
+uint64_t moduleHash(Module* m);
+
+//moduleHash plus the interface of every instantiated module or generator
+//(type, config params, default args). Use this to key text rendered from m.
+uint64_t moduleEmitHash(Module* m);
+
+}//CoreIR namespace
+
+#endif //STRUCTURALHASH_HPP_
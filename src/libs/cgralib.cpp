@@ -35,7 +35,8 @@ Namespace* CoreIRLoadLibrary_cgralib(Context* c) {
       })}
     });
   });
-  cgralib->newGeneratorDecl("PE",cgralib->getTypeGen("PEType"),PEGenParams,opParams);
+  Generator* PE = cgralib->newGeneratorDecl("PE",cgralib->getTypeGen("PEType"),PEGenParams,opParams);
+  PE->getMetaData()["timing"]["delay"] = 1;
 
   //Const Declaration
   Params valueParams = {{"value",AINT}};
@@ -45,14 +46,17 @@ Namespace* CoreIRLoadLibrary_cgralib(Context* c) {
       {"out",c->Bit()->Arr(width)}
     });
   });
-  cgralib->newGeneratorDecl("Const",cgralib->getTypeGen("SrcType"),widthParams,valueParams);
+  Generator* Const = cgralib->newGeneratorDecl("Const",cgralib->getTypeGen("SrcType"),widthParams,valueParams);
+  Const->getMetaData()["timing"]["delay"] = 0;
 
   //Reg declaration
-  cgralib->newGeneratorDecl("Reg",cgralib->getTypeGen("unary"),widthParams);
+  Generator* Reg = cgralib->newGeneratorDecl("Reg",cgralib->getTypeGen("unary"),widthParams);
+  Reg->getMetaData()["timing"]["sequential"] = true;
 
   //IO Declaration
   Params modeParams = {{"mode",ASTRING}};
-  cgralib->newGeneratorDecl("IO",cgralib->getTypeGen("unary"),widthParams,modeParams);
+  Generator* IO = cgralib->newGeneratorDecl("IO",cgralib->getTypeGen("unary"),widthParams,modeParams);
+  IO->getMetaData()["timing"]["delay"] = 0;
 
   //Mem declaration
   Params MemGenParams = {{"width",AINT},{"depth",AINT}};
@@ -68,7 +72,8 @@ Namespace* CoreIRLoadLibrary_cgralib(Context* c) {
       {"full", c->Bit()}
     });
   });
-  cgralib->newGeneratorDecl("Mem",cgralib->getTypeGen("MemType"),MemGenParams,modeParams);
+  Generator* Mem = cgralib->newGeneratorDecl("Mem",cgralib->getTypeGen("MemType"),MemGenParams,modeParams);
+  Mem->getMetaData()["timing"]["sequential"] = true;
 
   //Declare a TypeGenerator (in global) for linebuffer
   cgralib->newTypeGen(
@@ -12,24 +12,28 @@ Namespace* CoreIRLoadLibrary_ice40(Context* c) {
                                    {"I3", c->BitIn()},
                                    {"O",  c->Bit()}});
     Params SB_LUT4Params({{"LUT_INIT", AINT}});
-    ice40->newModuleDecl("SB_LUT4", SB_LUT4Type, SB_LUT4Params);
+    Module* lut = ice40->newModuleDecl("SB_LUT4", SB_LUT4Type, SB_LUT4Params);
+    lut->getMetaData()["timing"]["delay"] = 1;
 
     Type* SB_CARRYType = c->Record({{"I0", c->BitIn()},
                                     {"I1", c->BitIn()},
                                     {"CI", c->BitIn()},
                                     {"CO",  c->Bit()}});
-    ice40->newModuleDecl("SB_CARRY", SB_CARRYType);
+    Module* carry = ice40->newModuleDecl("SB_CARRY", SB_CARRYType);
+    carry->getMetaData()["timing"]["delay"] = 1;
 
     Type* SB_DFFType = c->Record({{"C", c->BitIn()},
                                   {"D", c->BitIn()},
                                   {"Q", c->Bit()}});
-    ice40->newModuleDecl("SB_DFF", SB_DFFType);
+    Module* dff = ice40->newModuleDecl("SB_DFF", SB_DFFType);
+    dff->getMetaData()["timing"]["sequential"] = true;
 
     Type* SB_DFFEType = c->Record({{"C", c->BitIn()},
                                    {"D", c->BitIn()},
                                    {"E", c->BitIn()},
                                    {"Q", c->Bit()}});
-    ice40->newModuleDecl("SB_DFFE", SB_DFFEType);
+    Module* dffe = ice40->newModuleDecl("SB_DFFE", SB_DFFEType);
+    dffe->getMetaData()["timing"]["sequential"] = true;
 
     return ice40;
 }
@@ -0,0 +1,358 @@
+#include "coreir.h"
+#include "coreir-passes/analysis/combgraph.h"
+#include "coreir-passes/analysis/combdepth.h"
+#include <algorithm>
+
+using namespace CoreIR;
+
+struct Passes::CombDepth::ModuleInfo {
+  CombTiming timing;
+  //Deepest path per endpoint, deepest first
+  vector<CombPath> endpoints;
+  //Node path -> arrival
+  unordered_map<string,int> arrivals;
+  bool loops = false;
+};
+
+namespace {
+
+//Paths of a submodule as seen from its instance: the ports of self are the
+//ports of the instance (which the outer path lists itself) and everything
+//else is prefixed by the instance name
+void appendInner(vector<SelectPath>& path, const string& instname, const vector<SelectPath>& inner) {
+  for (auto sp : inner) {
+    if (sp[0]=="self") continue;
+    sp.push_front(instname);
+    path.push_back(sp);
+  }
+}
+
+//Something ending a path in the graph of a module
+struct Endpoint {
+  uint node;
+  int depth;
+  vector<SelectPath> path;
+};
+
+//Arrival levels of one module: edges are connections (delay 0) and arcs
+//through instances, paths start at launches and end at captures
+class Levelizer {
+  struct Pred {
+    uint from;
+    int delay;
+    //Path inside a submodule (nullptr for a leaf or a connection)
+    const vector<SelectPath>* inner;
+  };
+  CombGraph& g;
+  uint numNodes;
+  vector<vector<Pred>> preds;
+  vector<int> launch;
+  vector<const vector<SelectPath>*> launchInner;
+  vector<int> capture;
+  vector<const vector<SelectPath>*> captureInner;
+  //Topological order and the position of every node in it
+  vector<uint> order;
+  vector<uint> pos;
+  public :
+    vector<int> arrival;
+    vector<int> how;
+    bool loops = false;
+
+    Levelizer(CombGraph& g) : g(g), numNodes(g.getNumNodes()), preds(numNodes), launch(numNodes,-1), launchInner(numNodes,nullptr), capture(numNodes,-1), captureInner(numNodes,nullptr) {
+      for (uint n=0; n<numNodes; ++n) {
+        for (auto p : g.getPreds(n)) preds[n].push_back({p,0,nullptr});
+      }
+    }
+    void addArc(uint from, uint to, int delay, const vector<SelectPath>* inner=nullptr) {
+      preds[to].push_back({from,delay,inner});
+    }
+    void setLaunch(uint n, int delay, const vector<SelectPath>* inner=nullptr) {
+      launch[n] = delay;
+      launchInner[n] = inner;
+    }
+    void setCapture(uint n, int delay, const vector<SelectPath>* inner=nullptr) {
+      capture[n] = delay;
+      captureInner[n] = inner;
+    }
+    void sort();
+    //Arrivals from source (a node of self) or from the launches if -1
+    void propagate(int source);
+    vector<SelectPath> pathTo(uint n);
+    //Paths of this propagation to the outputs of self and the captures
+    vector<Endpoint> endpoints();
+};
+
+void Levelizer::sort() {
+  vector<vector<uint>> succs(numNodes);
+  vector<uint> indegree(numNodes,0);
+  for (uint n=0; n<numNodes; ++n) {
+    for (auto& p : preds[n]) {
+      succs[p.from].push_back(n);
+      indegree[n]++;
+    }
+  }
+  pos.assign(numNodes,numNodes);
+  vector<uint> work;
+  for (uint n=0; n<numNodes; ++n) if (indegree[n]==0) work.push_back(n);
+  uint next = 0;
+  while (order.size()<numNodes) {
+    if (work.empty()) {
+      //Cut a loop at its first node
+      loops = true;
+      while (pos[next]<numNodes || indegree[next]==0) next++;
+      indegree[next] = 0;
+      work.push_back(next);
+    }
+    uint n = work.back();
+    work.pop_back();
+    pos[n] = order.size();
+    order.push_back(n);
+    for (auto s : succs[n]) {
+      if (pos[s]==numNodes && indegree[s]>0 && --indegree[s]==0) work.push_back(s);
+    }
+  }
+}
+
+void Levelizer::propagate(int source) {
+  arrival.assign(numNodes,-1);
+  how.assign(numNodes,-2);
+  for (auto n : order) {
+    if ((int) n==source) {
+      arrival[n] = 0;
+      how[n] = -1;
+    }
+    else if (source<0 && launch[n]>=0) {
+      arrival[n] = launch[n];
+      how[n] = -1;
+    }
+    for (uint i=0; i<preds[n].size(); ++i) {
+      Pred& p = preds[n][i];
+      if (pos[p.from]>=pos[n] || arrival[p.from]<0) continue;
+      int a = arrival[p.from] + p.delay;
+      if (a>arrival[n]) {
+        arrival[n] = a;
+        how[n] = i;
+      }
+    }
+  }
+}
+
+vector<SelectPath> Levelizer::pathTo(uint n) {
+  vector<uint> chain = {n};
+  while (how[chain.back()]>=0) chain.push_back(preds[chain.back()][how[chain.back()]].from);
+  std::reverse(chain.begin(),chain.end());
+  vector<SelectPath> path;
+  uint start = chain[0];
+  if (launchInner[start]) appendInner(path,g.getNode(start).path[0],*launchInner[start]);
+  path.push_back(g.getNode(start).path);
+  for (uint i=1; i<chain.size(); ++i) {
+    const vector<SelectPath>* inner = preds[chain[i]][how[chain[i]]].inner;
+    if (inner) appendInner(path,g.getNode(chain[i]).path[0],*inner);
+    path.push_back(g.getNode(chain[i]).path);
+  }
+  return path;
+}
+
+vector<Endpoint> Levelizer::endpoints() {
+  vector<Endpoint> ends;
+  for (uint n=0; n<numNodes; ++n) {
+    if (arrival[n]<0) continue;
+    const CombGraph::Node& node = g.getNode(n);
+    if (!node.inst && !node.driver) {
+      ends.push_back({n,arrival[n],pathTo(n)});
+    }
+    else if (capture[n]>=0) {
+      ends.push_back({n,arrival[n]+capture[n],pathTo(n)});
+      if (captureInner[n]) appendInner(ends.back().path,node.path[0],*captureInner[n]);
+    }
+  }
+  return ends;
+}
+
+void keepDeeper(CombPath& p, int depth, const vector<SelectPath>& path) {
+  if (depth>p.depth) {
+    p.depth = depth;
+    p.path = path;
+  }
+}
+
+}
+
+string Passes::CombDepth::ID = "combdepth";
+
+Passes::CombDepth::CombDepth() : InstanceGraphPass(ID,"Computes the combinational depth and critical paths of modules",true) {
+  for (auto op : {"const","term","passthrough","slice","concat"}) opDelays[op] = 0;
+}
+
+bool Passes::CombDepth::runOnInstanceGraphNode(InstanceGraphNode& node) {
+  if (auto m = dyn_cast<Module>(node.getInstantiable())) {
+    if (m->hasDef()) analyze(m);
+  }
+  return false;
+}
+
+void Passes::CombDepth::releaseMemory() {
+  for (auto imap : infos) delete imap.second;
+  infos.clear();
+}
+
+void Passes::CombDepth::setDelay(string op, int delay) {
+  opDelays[op] = delay;
+  releaseMemory();
+}
+
+void Passes::CombDepth::setDelay(string op, uint width, int delay) {
+  widthDelays[{op,width}] = delay;
+  releaseMemory();
+}
+
+int Passes::CombDepth::getDelay(Instance* inst) {
+  string op = coreirPrimName(inst);
+  if (op!="") {
+    if (Arg* width = getInstanceArg(inst,"width")) {
+      auto it = widthDelays.find({op,(uint) width->get<ArgInt>()});
+      if (it!=widthDelays.end()) return it->second;
+    }
+    return opDelays.count(op) ? opDelays[op] : 1;
+  }
+  json delay = cellTiming(inst,"delay");
+  return delay.is_number() ? delay.get<int>() : 1;
+}
+
+Passes::CombDepth::ModuleInfo* Passes::CombDepth::analyze(Module* m) {
+  if (infos.count(m)) return infos[m];
+  ASSERT(m->hasDef(),"Cannot compute the depth of " + m->getRefName() + " without a definition");
+  ModuleInfo* info = new ModuleInfo();
+  CombGraph g(m);
+  Levelizer lev(g);
+  //Deepest paths inside submodules (already prefixed)
+  vector<CombPath> innerPaths;
+  for (auto inst : g.getInstances()) {
+    vector<uint> ins, outs;
+    unordered_map<string,uint> ports;
+    for (auto n : g.getInstanceNodes(inst)) {
+      (g.getNode(n).driver ? outs : ins).push_back(n);
+      ports[g.getNode(n).port] = n;
+    }
+    if (Module* sub = combDefModule(inst)) {
+      const CombTiming& t = analyze(sub)->timing;
+      for (auto& amap : t.arcs) {
+        for (auto& omap : amap.second) {
+          lev.addArc(ports.at(amap.first),ports.at(omap.first),omap.second.depth,&omap.second.path);
+        }
+      }
+      for (auto& lmap : t.launch) lev.setLaunch(ports.at(lmap.first),lmap.second.depth,&lmap.second.path);
+      for (auto& cmap : t.capture) lev.setCapture(ports.at(cmap.first),cmap.second.depth,&cmap.second.path);
+      if (t.internal.depth>=0) {
+        innerPaths.push_back(CombPath());
+        innerPaths.back().depth = t.internal.depth;
+        appendInner(innerPaths.back().path,inst->getInstname(),t.internal.path);
+      }
+    }
+    else if (isSequentialCell(inst)) {
+      for (auto n : outs) lev.setLaunch(n,0);
+      for (auto n : ins) lev.setCapture(n,0);
+    }
+    else {
+      //Unconnected inputs start paths like constants do
+      int delay = getDelay(inst);
+      bool floating = ins.empty();
+      for (auto i : ins) floating |= g.getPreds(i).empty();
+      for (auto o : outs) {
+        if (floating) lev.setLaunch(o,delay);
+        for (auto i : ins) lev.addArc(i,o,delay);
+      }
+    }
+  }
+  lev.sort();
+  info->loops = lev.loops;
+
+  CombTiming& timing = info->timing;
+  map<uint,CombPath> ends;
+  vector<int> arrivals(g.getNumNodes(),-1);
+  //Keeps the deepest path to every endpoint and the latest arrivals of all
+  //the propagations
+  auto record = [&](const vector<Endpoint>& es) {
+    for (auto& e : es) keepDeeper(ends[e.node],e.depth,e.path);
+    for (uint n=0; n<g.getNumNodes(); ++n) arrivals[n] = std::max(arrivals[n],lev.arrival[n]);
+  };
+
+  //From inside
+  lev.propagate(-1);
+  vector<Endpoint> es = lev.endpoints();
+  for (auto& e : es) {
+    if (g.getNode(e.node).inst) keepDeeper(timing.internal,e.depth,e.path);
+    else keepDeeper(timing.launch[g.getNode(e.node).port],e.depth,e.path);
+  }
+  for (auto& p : innerPaths) keepDeeper(timing.internal,p.depth,p.path);
+  record(es);
+
+  //From every input
+  for (auto src : g.getSelfNodes()) {
+    if (!g.getNode(src).driver) continue;
+    string in = g.getNode(src).port;
+    lev.propagate(src);
+    es = lev.endpoints();
+    for (auto& e : es) {
+      if (g.getNode(e.node).inst) keepDeeper(timing.capture[in],e.depth,e.path);
+      else keepDeeper(timing.arcs[in][g.getNode(e.node).port],e.depth,e.path);
+    }
+    record(es);
+  }
+  for (uint n=0; n<g.getNumNodes(); ++n) {
+    if (arrivals[n]>=0) info->arrivals[SelectPath2Str(g.getNode(n).path)] = arrivals[n];
+  }
+
+  for (auto& emap : ends) info->endpoints.push_back(emap.second);
+  for (auto& p : innerPaths) info->endpoints.push_back(p);
+  std::stable_sort(info->endpoints.begin(),info->endpoints.end(),[](const CombPath& a, const CombPath& b) { return a.depth > b.depth;});
+  infos[m] = info;
+  return info;
+}
+
+const CombTiming& Passes::CombDepth::getTiming(Module* m) {
+  return analyze(m)->timing;
+}
+
+int Passes::CombDepth::getDepth(Module* m) {
+  ModuleInfo* info = analyze(m);
+  return info->endpoints.empty() ? 0 : info->endpoints[0].depth;
+}
+
+CombPath Passes::CombDepth::getCriticalPath(Module* m) {
+  ModuleInfo* info = analyze(m);
+  return info->endpoints.empty() ? CombPath() : info->endpoints[0];
+}
+
+vector<CombPath> Passes::CombDepth::getWorstPaths(Module* m, uint k) {
+  ModuleInfo* info = analyze(m);
+  uint num = std::min(k,(uint) info->endpoints.size());
+  return vector<CombPath>(info->endpoints.begin(),info->endpoints.begin()+num);
+}
+
+int Passes::CombDepth::getArrival(Module* m, SelectPath port) {
+  ModuleInfo* info = analyze(m);
+  while (!port.empty()) {
+    auto it = info->arrivals.find(SelectPath2Str(port));
+    if (it!=info->arrivals.end()) return it->second;
+    port.pop_back();
+  }
+  return -1;
+}
+
+bool Passes::CombDepth::hasLoops(Module* m) {
+  return analyze(m)->loops;
+}
+
+void Passes::CombDepth::print() {
+  vector<Module*> mods;
+  for (auto imap : infos) mods.push_back(imap.first);
+  std::sort(mods.begin(),mods.end(),[](Module* a, Module* b) { return a->getRefName() < b->getRefName();});
+  for (auto m : mods) {
+    CombPath p = getCriticalPath(m);
+    cout << m->getRefName() << ": depth " << getDepth(m) << (hasLoops(m) ? " (with loops)" : "") << endl;
+    vector<string> strs;
+    for (auto sp : p.path) strs.push_back(SelectPath2Str(sp));
+    if (!strs.empty()) cout << "  " << join(strs.begin(),strs.end(),string(" -> ")) << endl;
+  }
+}
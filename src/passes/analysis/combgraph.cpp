@@ -0,0 +1,172 @@
+#include "coreir.h"
+#include "coreir-passes/analysis/combgraph.h"
+#include <algorithm>
+
+using namespace CoreIR;
+
+namespace {
+
+bool isClockType(Type* t) {
+  auto nt = dyn_cast<NamedType>(t);
+  return nt && nt->getNamespace()->getName()=="coreir" && (nt->getName()=="clk" || nt->getName()=="clkIn");
+}
+
+//Calls f(path,port,t) for every part of t that is only an input or only an
+//output
+template<typename F>
+void splitPorts(SelectPath path, string port, Type* t, F f) {
+  if (isClockType(t)) return;
+  if (!t->isMixed()) {
+    f(path,port,t);
+    return;
+  }
+  auto sub = [&](string field, Type* ft) {
+    SelectPath fpath = path;
+    fpath.push_back(field);
+    splitPorts(fpath,port=="" ? field : port + "." + field,ft,f);
+  };
+  if (auto rt = dyn_cast<RecordType>(t)) {
+    for (auto field : rt->getFields()) sub(field,rt->getRecord()[field]);
+  }
+  else if (auto at = dyn_cast<ArrayType>(t)) {
+    for (uint i=0; i<at->getLen(); ++i) sub(to_string(i),at->getElemType());
+  }
+  else {
+    ASSERT(0,"Cannot split " + t->toString());
+  }
+}
+
+}
+
+CombGraph::CombGraph(Module* m) : m(m) {
+  ASSERT(m->hasDef(),"Cannot build the combinational graph of " + m->getRefName() + " without a definition");
+  ModuleDef* def = m->getDef();
+  for (auto imap : def->getInstances()) insts.push_back(imap.second);
+  std::sort(insts.begin(),insts.end(),[](Instance* a, Instance* b) { return a->getInstname() < b->getInstname();});
+  addNodes(nullptr,{"self"},"",def->getInterface()->getType());
+  for (auto inst : insts) {
+    instNodes[inst];
+    addNodes(inst,{inst->getInstname()},"",inst->getType());
+  }
+
+  succs.resize(nodes.size());
+  preds.resize(nodes.size());
+  for (auto con : def->getConnections()) {
+    ASSERT(!con.first->getType()->isMixed() && !con.second->getType()->isMixed(),"Connection of mixed direction " + Connection2Str(con) + " in " + m->getRefName() + " (run removebulkconnections)");
+  }
+  DirectedModule dm(m);
+  for (auto dcon : dm.getConnections()) {
+    int src = findNode(dcon->getSrc());
+    int snk = findNode(dcon->getSnk());
+    if (src<0 || snk<0) continue;
+    succs[src].push_back(snk);
+    preds[snk].push_back(src);
+  }
+  auto uniq = [](vector<uint>& v) {
+    std::sort(v.begin(),v.end());
+    v.erase(std::unique(v.begin(),v.end()),v.end());
+  };
+  for (uint n=0; n<nodes.size(); ++n) {
+    uniq(succs[n]);
+    uniq(preds[n]);
+  }
+}
+
+void CombGraph::addNodes(Instance* inst, SelectPath path, string port, Type* t) {
+  splitPorts(path,port,t,[&](SelectPath npath, string nport, Type* nt) {
+    uint n = nodes.size();
+    //Within the definition self has the flipped type, so a driver is
+    //always something of output type
+    nodes.push_back({npath,inst,nport,nt->isOutput()});
+    nodeIndex[SelectPath2Str(npath)] = n;
+    if (inst) instNodes[inst].push_back(n);
+    else selfNodes.push_back(n);
+  });
+}
+
+int CombGraph::findNode(const SelectPath& path) {
+  SelectPath prefix = path;
+  while (!prefix.empty()) {
+    auto it = nodeIndex.find(SelectPath2Str(prefix));
+    if (it!=nodeIndex.end()) return it->second;
+    prefix.pop_back();
+  }
+  return -1;
+}
+
+json CoreIR::cellTiming(Instance* inst, string key) {
+  auto lookup = [&](MetaData* md, json& ret) {
+    json& j = md->getMetaData();
+    if (j.count("timing") && j["timing"].count(key)) {
+      ret = j["timing"][key];
+      return true;
+    }
+    return false;
+  };
+  json ret;
+  if (lookup(inst,ret)) return ret;
+  if (inst->getModuleRef() && lookup(inst->getModuleRef(),ret)) return ret;
+  if (inst->getGeneratorRef() && lookup(inst->getGeneratorRef(),ret)) return ret;
+  return ret;
+}
+
+bool CoreIR::isSequentialCell(Instance* inst) {
+  if (coreirPrimName(inst)=="reg") return true;
+  json seq = cellTiming(inst,"sequential");
+  return seq.is_boolean() && seq.get<bool>();
+}
+
+Module* CoreIR::combDefModule(Instance* inst) {
+  if (inst->isGen()) return nullptr;
+  Module* ref = inst->getModuleRef();
+  return ref && ref->hasDef() ? ref : nullptr;
+}
+
+//Tarjan's algorithm without recursion
+vector<int> CoreIR::strongComponents(const vector<vector<uint>>& succs, uint& numComps) {
+  uint numNodes = succs.size();
+  vector<int> comp(numNodes,-1);
+  vector<int> index(numNodes,-1);
+  vector<int> low(numNodes,0);
+  vector<bool> onStack(numNodes,false);
+  vector<uint> stack;
+  //Node and the next successor to visit
+  vector<std::pair<uint,uint>> calls;
+  int next = 0;
+  numComps = 0;
+  for (uint root=0; root<numNodes; ++root) {
+    if (index[root]>=0) continue;
+    calls.push_back({root,0});
+    while (!calls.empty()) {
+      uint n = calls.back().first;
+      uint& i = calls.back().second;
+      if (i==0) {
+        index[n] = low[n] = next++;
+        stack.push_back(n);
+        onStack[n] = true;
+      }
+      if (i<succs[n].size()) {
+        uint s = succs[n][i++];
+        if (index[s]<0) calls.push_back({s,0});
+        else if (onStack[s]) low[n] = std::min(low[n],index[s]);
+        continue;
+      }
+      if (low[n]==index[n]) {
+        uint m;
+        do {
+          m = stack.back();
+          stack.pop_back();
+          onStack[m] = false;
+          comp[m] = numComps;
+        } while (m!=n);
+        numComps++;
+      }
+      calls.pop_back();
+      if (!calls.empty()) {
+        uint p = calls.back().first;
+        low[p] = std::min(low[p],low[n]);
+      }
+    }
+  }
+  return comp;
+}
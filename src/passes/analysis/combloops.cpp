@@ -0,0 +1,155 @@
+#include "coreir.h"
+#include "coreir-passes/analysis/combgraph.h"
+#include "coreir-passes/analysis/combloops.h"
+#include <algorithm>
+
+using namespace CoreIR;
+
+struct Passes::CombLoops::ModuleInfo {
+  vector<vector<SelectPath>> loops;
+  bool anyLoops = false;
+  map<string,std::set<string>> deps;
+};
+
+namespace {
+
+//A cycle through start within its component (shortest by breadth first)
+vector<uint> findCycle(const vector<vector<uint>>& succs, const vector<int>& comp, uint start) {
+  unordered_map<uint,uint> parent;
+  vector<uint> work = {start};
+  for (uint w=0; w<work.size(); ++w) {
+    uint n = work[w];
+    for (auto s : succs[n]) {
+      if (comp[s]!=comp[start]) continue;
+      if (s==start) {
+        vector<uint> cycle = {n};
+        while (cycle.back()!=start) cycle.push_back(parent[cycle.back()]);
+        std::reverse(cycle.begin(),cycle.end());
+        return cycle;
+      }
+      if (parent.count(s)) continue;
+      parent[s] = n;
+      work.push_back(s);
+    }
+  }
+  ASSERT(0,"Component without a cycle");
+  return {};
+}
+
+}
+
+std::string Passes::CombLoops::ID = "combloops";
+
+bool Passes::CombLoops::runOnInstanceGraphNode(InstanceGraphNode& node) {
+  if (auto m = dyn_cast<Module>(node.getInstantiable())) {
+    if (m->hasDef()) analyze(m);
+  }
+  return false;
+}
+
+void Passes::CombLoops::releaseMemory() {
+  for (auto imap : infos) delete imap.second;
+  infos.clear();
+}
+
+Passes::CombLoops::ModuleInfo* Passes::CombLoops::analyze(Module* m) {
+  if (infos.count(m)) return infos[m];
+  ASSERT(m->hasDef(),"Cannot look for loops in " + m->getRefName() + " without a definition");
+  ModuleInfo* info = new ModuleInfo();
+  CombGraph g(m);
+  uint numNodes = g.getNumNodes();
+  vector<vector<uint>> succs(numNodes);
+  for (uint n=0; n<numNodes; ++n) succs[n] = g.getSuccs(n);
+  //Edges through the instances
+  for (auto inst : g.getInstances()) {
+    vector<uint> ins, outs;
+    unordered_map<string,uint> ports;
+    for (auto n : g.getInstanceNodes(inst)) {
+      (g.getNode(n).driver ? outs : ins).push_back(n);
+      ports[g.getNode(n).port] = n;
+    }
+    if (Module* sub = combDefModule(inst)) {
+      ModuleInfo* subInfo = analyze(sub);
+      info->anyLoops |= subInfo->anyLoops;
+      for (auto& dmap : subInfo->deps) {
+        for (auto& out : dmap.second) succs[ports.at(dmap.first)].push_back(ports.at(out));
+      }
+    }
+    else if (!isSequentialCell(inst)) {
+      for (auto i : ins) {
+        for (auto o : outs) succs[i].push_back(o);
+      }
+    }
+  }
+
+  uint numComps;
+  vector<int> comp = strongComponents(succs,numComps);
+
+  //Loops are the components with more than one node (there are no edges
+  //from a node to itself)
+  vector<vector<uint>> members(numComps);
+  for (uint n=0; n<numNodes; ++n) members[comp[n]].push_back(n);
+  for (auto& nodes : members) {
+    if (nodes.size()<2) continue;
+    vector<SelectPath> loop;
+    for (auto n : findCycle(succs,comp,nodes[0])) loop.push_back(g.getNode(n).path);
+    info->loops.push_back(loop);
+  }
+  std::sort(info->loops.begin(),info->loops.end());
+  info->anyLoops |= !info->loops.empty();
+
+  //Outputs reachable from every component, successors first
+  vector<uint> outs;
+  unordered_map<uint,uint> outIndex;
+  for (auto n : g.getSelfNodes()) {
+    if (g.getNode(n).driver) continue;
+    outIndex[n] = outs.size();
+    outs.push_back(n);
+  }
+  uint words = (outs.size()+63)/64;
+  vector<vector<uint64_t>> reach(numComps,vector<uint64_t>(words,0));
+  for (uint c=0; c<numComps; ++c) {
+    for (auto n : members[c]) {
+      if (outIndex.count(n)) reach[c][outIndex[n]/64] |= 1ULL << (outIndex[n]%64);
+      for (auto s : succs[n]) {
+        if ((uint) comp[s]==c) continue;
+        for (uint w=0; w<words; ++w) reach[c][w] |= reach[comp[s]][w];
+      }
+    }
+  }
+  for (auto n : g.getSelfNodes()) {
+    if (!g.getNode(n).driver) continue;
+    for (uint o=0; o<outs.size(); ++o) {
+      if (reach[comp[n]][o/64] & (1ULL << (o%64))) {
+        info->deps[g.getNode(n).port].insert(g.getNode(outs[o]).port);
+      }
+    }
+  }
+  infos[m] = info;
+  return info;
+}
+
+const vector<vector<SelectPath>>& Passes::CombLoops::getLoops(Module* m) {
+  return analyze(m)->loops;
+}
+
+bool Passes::CombLoops::hasLoops(Module* m) {
+  return analyze(m)->anyLoops;
+}
+
+const map<string,std::set<string>>& Passes::CombLoops::getDependencies(Module* m) {
+  return analyze(m)->deps;
+}
+
+void Passes::CombLoops::print() {
+  vector<Module*> mods;
+  for (auto imap : infos) mods.push_back(imap.first);
+  std::sort(mods.begin(),mods.end(),[](Module* a, Module* b) { return a->getRefName() < b->getRefName();});
+  for (auto m : mods) {
+    for (auto& loop : infos[m]->loops) {
+      vector<string> strs;
+      for (auto& sp : loop) strs.push_back(SelectPath2Str(sp));
+      cout << "Combinational loop in " << m->getRefName() << ": " << join(strs.begin(),strs.end(),string(" -> ")) << endl;
+    }
+  }
+}
@@ -41,6 +41,7 @@ class Dict {
     string toString() {
       return "{"+join(fields.begin(),fields.end(),string(", ")) + "}";
     }
+    bool empty() { return fields.empty();}
 
 };
 
@@ -150,6 +151,9 @@ string Instances2Json(unordered_map<string,Instance*>& insts) {
     if (i->hasConfigArgs()) {
       j.add("configargs",Args2Json(i->getConfigArgs()));
     }
+    if (i->hasMetaData()) {
+      j.add("metadata",toString(i->getMetaData()));
+    }
     jis.add(iname,j.toMultiString());
   }
   return jis.toMultiString(true);
@@ -171,6 +175,18 @@ string Connections2Json(unordered_set<Connection>& cons) {
   return a.toMultiString();
 }
 
+//Selects (at any depth) that have metadata
+void collectWireMetaData(Wireable* w, Dict& j) {
+  for (auto sel : w->getSelects()) {
+    Wireable* s = sel.second;
+    if (s->hasMetaData()) {
+      SelectPath path = s->getSelectPath();
+      j.add(join(path.begin(),path.end(),string(".")),toString(s->getMetaData()));
+    }
+    collectWireMetaData(s,j);
+  }
+}
+
 void Instantiable2Json(Instantiable* i, Dict& j) {
   if (!i->getConfigParams().empty()) {
     j.add("configparams",Params2Json(i->getConfigParams()));
@@ -194,6 +210,12 @@ string Module2Json(Module* m) {
       auto cons = def->getConnections();
       j.add("connections",Connections2Json(cons));
     }
+    Dict jwires(8);
+    collectWireMetaData(def->getInterface(),jwires);
+    for (auto inst : def->getInstances()) collectWireMetaData(inst.second,jwires);
+    if (!jwires.empty()) {
+      j.add("wiremetadata",jwires.toMultiString(true));
+    }
   }
   if (m->hasMetaData()) {
     j.add("metadata",toString(m->getMetaData()));
@@ -218,16 +240,16 @@ json Generator2Json(Generator* g) {
 string Passes::CoreIRJson::ID = "coreirjson";
 bool Passes::CoreIRJson::runOnNamespace(Namespace* ns) {
   Dict jns(2);
-  if (!ns->getModules().empty()) {
-    Dict jmod(4);
-    for (auto m : ns->getModules()) jmod.add(m.first,Module2Json(m.second));
-    jns.add("modules",jmod.toMultiString(true));
+  Dict jmod(4);
+  for (auto m : ns->getModules()) {
+    if (inScope(m.second)) jmod.add(m.first,Module2Json(m.second));
   }
-  if (!ns->getGenerators().empty()) {
-    Dict jgen(4);
-    for (auto g : ns->getGenerators()) jgen.add(g.first,Generator2Json(g.second));
-    jns.add("generators",jgen.toMultiString(true));
+  if (!jmod.empty()) jns.add("modules",jmod.toMultiString(true));
+  Dict jgen(4);
+  for (auto g : ns->getGenerators()) {
+    if (inScope(g.second)) jgen.add(g.first,Generator2Json(g.second));
   }
+  if (!jgen.empty()) jns.add("generators",jgen.toMultiString(true));
   //if (!namedTypeNameMap.empty()) {
   //  ASSERT(0,"NYI");
     //Dict jntypes;
@@ -0,0 +1,59 @@
+#include "coreir.h"
+#include "coreir-passes/analysis/emitcache.h"
+#include <fstream>
+#include <thread>
+#include <cstdio>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace CoreIR;
+
+namespace {
+bool readFile(std::string filename, std::string& text) {
+  std::ifstream fin(filename,std::ios::binary);
+  if (!fin.is_open()) return false;
+  std::ostringstream buf;
+  buf << fin.rdbuf();
+  text = buf.str();
+  return true;
+}
+}
+
+EmitCache::EmitCache(std::string dir, std::string backend) : dir(dir), backend(backend), hits(0), misses(0) {
+  mkdir(dir.c_str(),0755);
+}
+
+std::string EmitCache::entryName(uint64_t key) {
+  return dir + "/" + backend + "-" + hash2Str(key);
+}
+
+bool EmitCache::lookup(uint64_t key, std::string& text) {
+  if (readFile(entryName(key),text)) {
+    ++hits;
+    return true;
+  }
+  ++misses;
+  return false;
+}
+
+void EmitCache::store(uint64_t key, const std::string& text) {
+  //Write to a unique temporary and rename so readers never see a partial entry
+  std::string entry = entryName(key);
+  std::ostringstream tmp;
+  tmp << entry << ".tmp" << getpid() << "_" << std::this_thread::get_id();
+  {
+    std::ofstream fout(tmp.str(),std::ios::binary);
+    if (!fout.is_open()) return; //Failing to cache is not an error
+    fout << text;
+  }
+  std::rename(tmp.str().c_str(),entry.c_str());
+}
+
+bool CoreIR::writeFileIfChanged(std::string filename, const std::string& text) {
+  std::string old;
+  if (readFile(filename,old) && old==text) return false;
+  std::ofstream fout(filename,std::ios::binary);
+  ASSERT(fout.is_open(),"Cannot open file: " + filename);
+  fout << text;
+  return true;
+}
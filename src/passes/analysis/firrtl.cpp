@@ -1,77 +1,100 @@
 #include "coreir.h"
 #include "coreir-passes/analysis/firrtl.h"
+#include <algorithm>
 
 using namespace CoreIR;
 
+namespace CoreIR {
 struct FModule {
   string name;
-  RecordType* rt;
-  bool noWidths;
+  //Port declarations
+  string header;
+  //Null for coreir primitives, which only have stmts
+  Module* mod = nullptr;
   vector<string> stmts;
-  FModule(string name, Type* t, bool noWidths=false) : name(name), noWidths(noWidths) {
-    if (! (this->rt = dyn_cast<RecordType>(t))) {
-      assert(0);
-    }
-  }
+  FModule(string name, string header) : name(name), header(header) {}
   void addStmt(string stmt) {
     stmts.push_back(stmt);
   }
-  string type2firrtl(Type* t);
-  string toString() {
-    vector<string> lines;
-    lines.push_back("  module " + this->name + " :");
-    for (auto rec : rt->getRecord()) {
-      string s = "    ";
-      if (rec.second->isInput()) {
-        s = s + "input ";
-      }
-      else if(rec.second->isOutput()) {
-        s = s + "output ";
-      }
-      else {
-        rt->print();
-        ASSERT(0,"NYI");
-      }
-      s = s + rec.first + " : " + type2firrtl(rec.second);
-      lines.push_back(s);
-    }
-    for (auto s : this->stmts) {
-      lines.push_back("    " + s);
-    }
-    return join(lines.begin(),lines.end(),string("\n"));
-  }
+  void writeToStream(std::ostream& os, const unordered_map<Instantiable*,string>& nameMap);
 };
+}
+
+namespace {
+//Same as Select::toString but does not need the Wireable
+string path2firrtl(const SelectPath& path) {
+  string ret = path[0];
+  for (uint i=1; i<path.size(); ++i) {
+    if (isNumber(path[i])) ret += "[" + path[i] + "]";
+    else ret += "." + path[i];
+  }
+  return ret;
+}
+}
+
+//Only reads the IR so it can be called from multiple threads
+void FModule::writeToStream(std::ostream& os, const unordered_map<Instantiable*,string>& nameMap) {
+  os << header;
+  for (auto s : this->stmts) {
+    os << "\n    " << s;
+  }
+  if (!mod) return;
+  ModuleDef* def = mod->getDef();
 
-string FModule::type2firrtl(Type* t) {
+  //First add all instances
+  auto instances = def->getInstances();
+  std::map<string,Instance*> sortedInstances(instances.begin(),instances.end());
+  for (auto instmap : sortedInstances) {
+    //TODO Deal with consts, regs, shift
+    os << "\n    inst " << instmap.first << " of " << nameMap.at(instmap.second->getInstantiableRef());
+  }
+  //Then add all connections
+  vector<string> cons;
+  for (auto dcon : mod->newDirectedModule()->getConnections()) {
+    cons.push_back(path2firrtl(dcon->getSnk()) + " <= " + path2firrtl(dcon->getSrc()));
+  }
+  std::sort(cons.begin(),cons.end());
+  for (auto con : cons) {
+    os << "\n    " << con;
+  }
+}
+
+string Passes::Firrtl::type2firrtl(Type* t, bool noWidths) {
+  auto key = std::make_pair(t,noWidths);
+  auto cached = typeLayouts.find(key);
+  if (cached != typeLayouts.end()) return cached->second;
+  string ret;
   if (auto rt = dyn_cast<RecordType>(t)) {
     vector<string> sels;
     if (!rt->isMixed()) {
       for (auto rec : rt->getRecord()) {
-        sels.push_back(rec.first + " : " + type2firrtl(rec.second));
+        sels.push_back(rec.first + " : " + type2firrtl(rec.second,noWidths));
       }
     }
     else {
       ASSERT(0,"NYI");
     }
-    return join(sels.begin(),sels.end(),string(", "));
+    ret = join(sels.begin(),sels.end(),string(", "));
   }
   else if (auto at = dyn_cast<ArrayType>(t)) {
     Type* et = at->getElemType();
     if (et->isBaseType()) {
-      if (noWidths) return "UInt";
-      return "UInt<" + to_string(at->getLen()) + ">";
+      ret = noWidths ? "UInt" : "UInt<" + to_string(at->getLen()) + ">";
     }
     else {
-      return type2firrtl(et) + "[" + to_string(at->getLen()) + "]";
+      ret = type2firrtl(et,noWidths) + "[" + to_string(at->getLen()) + "]";
     }
   }
   else if (t->isBaseType()) {
-    return "UInt<1>";
+    ret = "UInt<1>";
   }
   else {
     assert(0);
   }
+  typeLayouts[key] = ret;
+  return ret;
 }
+
 string op2firrtl(string op) {
   //TODO 
   return op;
@@ -117,59 +140,78 @@ bool Passes::Firrtl::runOnInstanceGraphNode(InstanceGraphNode& node) {
   //TODO sometimes failing here!
   ASSERT(nameMap.count(i)==0,i->getName());
   nameMap[i] = name;
-  FModule* fm;
+  Type* t;
   if (isStdlib) {
     //This ugliness is getting an example of a type for coreir generator
     //The 5 does not matter because I am throwing away widths anyways
-    Type* t = cast<Generator>(i)->getTypeGen()->createType(i->getContext(),{{"width",i->getContext()->argInt(5)}});
-    fm = new FModule(name,t,true);
-    coreir2firrtl(i,*fm);
+    t = cast<Generator>(i)->getTypeGen()->createType(i->getContext(),{{"width",i->getContext()->argInt(5)}});
   }
   else {
-    //General case.
-    Module* m = cast<Module>(i);
-    ASSERT(m->hasDef(),"NYI external modules");
-    ModuleDef* def = m->getDef();
-    fm = new FModule(name,m->getType());
-    
-    //First add all instances
-    for (auto instmap : def->getInstances()) {
-      string mname = nameMap[instmap.second->getInstantiableRef()];
-      string iname = instmap.second->getInstname();
-      //TODO Deal with consts, regs, shift
-      fm->addStmt("inst " + iname + " of " + mname);
+    ASSERT(i->hasDef(),"NYI external modules");
+    t = cast<Module>(i)->getType();
+  }
+  RecordType* rt = dyn_cast<RecordType>(t);
+  assert(rt);
+  
+  //Port declarations
+  vector<string> lines;
+  lines.push_back("  module " + name + " :");
+  for (auto rec : rt->getRecord()) {
+    string s = "    ";
+    if (rec.second->isInput()) {
+      s = s + "input ";
     }
-    //Then add all connections
-    auto dm = m->newDirectedModule();
-    for (auto dcon : dm->getConnections()) {
-      fm->addStmt(def->sel(dcon->getSnk())->toString() + " <= " + def->sel(dcon->getSrc())->toString());
+    else if(rec.second->isOutput()) {
+      s = s + "output ";
     }
+    else {
+      rt->print();
+      ASSERT(0,"NYI");
+    }
+    s = s + rec.first + " : " + type2firrtl(rec.second,isStdlib);
+    lines.push_back(s);
+  }
+  FModule* fm = new FModule(name,join(lines.begin(),lines.end(),string("\n")));
+  if (isStdlib) {
+    coreir2firrtl(i,*fm);
+  }
+  else {
+    //General case. The body is rendered in writeToStream.
+    fm->mod = cast<Module>(i);
+    //Create the directed view now so rendering does not modify the module
+    fm->mod->newDirectedModule();
   }
-  fmods.push_back(fm->toString());
+  fmods.push_back(fm);
   return false;
 }
 
-void Passes::Firrtl::writeToStream(std::ostream& os) {
-  os << "Circuit MyCircuit : " << endl;
-  for (auto smod : fmods) {
-    os << smod << endl;
-  }
+void Passes::Firrtl::releaseMemory() {
+  for (auto fm : fmods) delete fm;
+  fmods.clear();
+  nameMap.clear();
+  typeLayouts.clear();
 }
 
+void Passes::Firrtl::renderModule(FModule* fm, std::ostream& os) {
+  if (!cache || !fm->mod) {
+    fm->writeToStream(os,nameMap);
+    return;
+  }
+  uint64_t key = moduleEmitHash(fm->mod);
+  string text;
+  if (!cache->lookup(key,text)) {
+    ostringstream buf;
+    fm->writeToStream(buf,nameMap);
+    text = buf.str();
+    cache->store(key,text);
+  }
+  os << text;
+}
 
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
+void Passes::Firrtl::writeToStream(std::ostream& os) {
+  os << "Circuit MyCircuit : " << endl;
+  parallelRenderOrdered(fmods.size(),[&](size_t i, std::ostream& buf) {
+    this->renderModule(fmods[i],buf);
+    buf << endl;
+  },os,numThreads);
+}
@@ -1,27 +1,14 @@
 #include "coreir.h"
 #include "coreir-passes/analysis/vmodule.hpp"
 #include "coreir-passes/analysis/verilog.h"
+#include <algorithm>
+#include <sys/stat.h>
 
 using namespace CoreIR;
 
-namespace {
-
-string VWireDec(VWire w) { return "  wire " + w.dimstr() + " " + w.getName() + ";"; }
-
-
-string VAssign(Connection con) {
-  Wireable* left = con.first->getType()->getDir()==Type::DK_In ? con.first : con.second;
-  Wireable* right = left==con.first ? con.second : con.first;
-  VWire vleft(left);
-  VWire vright(right);
-  return "  assign " + vleft.getName() + vleft.dimstr() + " = " + vright.getName() + vright.dimstr() + ";";
-}
-
-}
-
 std::string Passes::Verilog::ID = "verilog";
 bool Passes::Verilog::runOnInstanceGraphNode(InstanceGraphNode& node) {
-  
+
   //Create a new Vmodule for this node
   Instantiable* i = node.getInstantiable();
   if (auto g = dyn_cast<Generator>(i)) {
@@ -34,43 +21,61 @@ bool Passes::Verilog::runOnInstanceGraphNode(InstanceGraphNode& node) {
   modMap[i] = vmod;
   if (!m->hasDef()) {
     this->external.insert(i);
-    return false;
   }
+  return false;
+}
 
-  ModuleDef* def = m->getDef();
-  
-  string tab = "  ";
-  for (auto imap : def->getInstances()) {
-    string iname = imap.first;
-    Instance* inst = imap.second;
-    Instantiable* iref = imap.second->getInstantiableRef();
-    vmod->addStmt("  //Wire declarations for instance '" + imap.first + "' (Module "+ iref->getName() + ")");
-    for (auto rmap : cast<RecordType>(imap.second->getType())->getRecord()) {
-      vmod->addStmt(VWireDec(VWire(iname+"_"+rmap.first,rmap.second)));
+void Passes::Verilog::releaseMemory() {
+  for (auto vmap : modMap) delete vmap.second;
+  modMap.clear();
+  external.clear();
+}
+
+vector<VModule*> Passes::Verilog::getSortedModules(bool isExternal) {
+  vector<VModule*> vmods;
+  for (auto vmap : modMap) {
+    if (external.count(vmap.first)==(isExternal ? 1 : 0)) {
+      vmods.push_back(vmap.second);
     }
-    ASSERT(modMap.count(iref),"DEBUG ME: Missing iref");
-    vmod->addStmt(modMap[iref]->toInstanceString(inst));
   }
+  std::sort(vmods.begin(),vmods.end(),[](VModule* a, VModule* b) {return a->getName() < b->getName();});
+  return vmods;
+}
 
-  vmod->addStmt("  //All the connections");
-  for (auto con : def->getConnections()) {
-    vmod->addStmt(VAssign(con));
+void Passes::Verilog::renderModule(VModule* vmod, std::ostream& os) {
+  if (!cache) {
+    vmod->writeToStream(os,modMap);
+    return;
   }
-  
-  return false;
+  uint64_t key = moduleEmitHash(vmod->getModule());
+  string text;
+  if (!cache->lookup(key,text)) {
+    ostringstream buf;
+    vmod->writeToStream(buf,modMap);
+    text = buf.str();
+    cache->store(key,text);
+  }
+  os << text;
 }
 
 void Passes::Verilog::writeToStream(std::ostream& os) {
-  
-  for (auto ext : external) {
-    os << modMap[ext]->toCommentString() << endl;
+
+  for (auto vmod : getSortedModules(true)) {
+    os << vmod->toCommentString() << endl;
   }
   os << endl;
-  for (auto mmap : modMap) {
-    if (external.count(mmap.first)==0) { 
-      os << mmap.second->toString() << endl;
-    }
-  }
-
+  vector<VModule*> vmods = getSortedModules(false);
+  parallelRenderOrdered(vmods.size(),[&](size_t i, std::ostream& buf) {
+    this->renderModule(vmods[i],buf);
+  },os,numThreads);
+}
 
+void Passes::Verilog::writeToFiles(std::string dir) {
+  mkdir(dir.c_str(),0755);
+  vector<VModule*> vmods = getSortedModules(false);
+  parallelFor(vmods.size(),[&](size_t i) {
+    ostringstream buf;
+    this->renderModule(vmods[i],buf);
+    writeFileIfChanged(dir + "/" + vmods[i]->getName() + ".v",buf.str());
+  },numThreads);
 }
@@ -1,18 +1,35 @@
 #include "coreir.h"
 #include "coreir-passes/analysis/vmodule.hpp"
+#include <map>
+#include <algorithm>
 
 using namespace CoreIR;
 
-string VModule::toString() {
-  vector<string> pdecs;
-  for (auto pmap : ports) {
-    auto port = pmap.second;
-    pdecs.push_back(port.dirstr() + " " + port.dimstr() + " " + port.getName());
-  }
-  ostringstream o;
+namespace {
+
+void writeWireDec(std::ostream& os, VWire w) { os << "  wire " << w.dimstr() << " " << w.getName() << ";\n"; }
+
+//Returns the {left,right} of the assign statement for a connection
+std::pair<string,string> VAssign(Connection con) {
+  Wireable* left = con.first->getType()->getDir()==Type::DK_In ? con.first : con.second;
+  Wireable* right = left==con.first ? con.second : con.first;
+  VWire vleft(left);
+  VWire vright(right);
+  return {vleft.getName() + vleft.dimstr(), vright.getName() + vright.dimstr()};
+}
+
+}
+
+void VModule::writeToStream(std::ostream& o, const VModuleMap& modMap) {
+  ASSERT(mod,"Cannot write external module " + modname);
   string tab = "  ";
   //Module declaration
-  o << endl << "module " << modname << "(\n" << tab << join(pdecs.begin(),pdecs.end(),string(",\n  ")) << "\n);" << endl;
+  o << endl << "module " << modname << "(\n";
+  for (uint i=0; i<ports.size(); ++i) {
+    o << tab << ports[i].dirstr() << " " << ports[i].dimstr() << " " << ports[i].getName();
+    o << (i==ports.size()-1 ? "\n" : ",\n");
+  }
+  o << ");" << endl;
 
   //Param declaraions
   for (auto p : params) {
@@ -23,31 +40,58 @@ string VModule::toString() {
     o << ";" << endl;
   }
   o << endl;
-  
-  for (auto s : stmts) o << s << endl;
-  o << endl << "endmodule //" << modname;
-  return o.str();
+
+  ModuleDef* def = mod->getDef();
+
+  //Sort instances by name so the output is deterministic
+  auto instances = def->getInstances();
+  std::map<string,Instance*> sortedInstances(instances.begin(),instances.end());
+  for (auto imap : sortedInstances) {
+    string iname = imap.first;
+    Instance* inst = imap.second;
+    Instantiable* iref = inst->getInstantiableRef();
+    o << "  //Wire declarations for instance '" << iname << "' (Module " << iref->getName() << ")\n";
+    RecordType* rt = cast<RecordType>(inst->getType());
+    auto record = rt->getRecord();
+    for (auto field : rt->getFields()) {
+      writeWireDec(o,VWire(iname+"_"+field,record.at(field)));
+    }
+    auto vmod = modMap.find(iref);
+    ASSERT(vmod!=modMap.end(),"DEBUG ME: Missing iref");
+    vmod->second->writeInstance(o,inst);
+  }
+
+  o << "  //All the connections\n";
+  vector<std::pair<string,string>> assigns;
+  for (auto con : def->getConnections()) {
+    assigns.push_back(VAssign(con));
+  }
+  std::sort(assigns.begin(),assigns.end());
+  for (auto assign : assigns) {
+    o << "  assign " << assign.first << " = " << assign.second << ";\n";
+  }
+  o << endl << "endmodule //" << modname << endl;
 }
 
-string VModule::toInstanceString(Instance* inst) {
+void VModule::writeInstance(std::ostream& o, Instance* inst) {
   string instname = inst->getInstname();
   Instantiable* iref = inst->getInstantiableRef();
   if (this->gen) {
     ASSERT(inst->isGen(),"DEBUG ME:");
   }
-  ostringstream o;
   string tab = "  ";
   string mname;
-  unordered_map<string,VWire> iports;
+  vector<string> iports;
   Args args;
   if (gen) {
     args = inst->getGenArgs();
-    Type2Ports(gen->getTypeGen()->getType(inst->getGenArgs()),iports);
+    //The instance already has the generated type. (Calling the typegen here is not thread safe)
+    iports = cast<RecordType>(inst->getType())->getFields();
     mname = gen->getNamespace()->getName() + "_" + gen->getName(args);
   }
   else {
     mname = modname;
-    iports = ports;
+    for (auto port : ports) iports.push_back(port.getName());
   }
 
   for (auto amap : inst->getConfigArgs()) {
@@ -64,6 +108,7 @@ string VModule::toInstanceString(Instance* inst) {
     for (auto amap : args) {
       params.push_back(amap.first);
     }
+    std::sort(params.begin(),params.end());
   }
   vector<string> paramstrs;
   for (auto param : params) {
@@ -77,10 +122,8 @@ string VModule::toInstanceString(Instance* inst) {
   //Assume names are <instname>_port
   vector<string> portstrs;
   for (auto port : iports) {
-    string pstr = "."+port.first+"(" + instname+"_"+ port.first+")";
+    string pstr = "."+port+"(" + instname+"_"+ port+")";
     portstrs.push_back(pstr);
   }
   o << instname << "(\n" << tab << tab << join(portstrs.begin(),portstrs.end(),",\n"+tab+tab) << "\n  );" << endl;
-  return o.str();
 }
-
@@ -0,0 +1,18 @@
+#include "coreir.h"
+#include "coreir-passes/transform/bitblast.h"
+
+using namespace CoreIR;
+
+bool Passes::BitBlast::runOnModule(Module* m) {
+  if (!m->hasDef()) return false;
+  for (auto imap : m->getDef()->getInstances()) {
+    if (coreirPrimName(imap.second)=="") return false;
+  }
+  Aig aig;
+  lowerToAig(m,aig);
+  aig.cleanup();
+  m->setDef(liftAig(aig,m));
+  return true;
+}
+
+std::string Passes::BitBlast::ID = "bitblast";
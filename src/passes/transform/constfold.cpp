@@ -0,0 +1,352 @@
+#include "coreir.h"
+#include "coreir-passes/transform/constfold.h"
+#include <deque>
+
+using namespace CoreIR;
+using namespace CoreIR::PrimOps;
+
+namespace {
+
+//Some bits of a value: the bits in known have the value in value
+struct Bits {
+  uint64_t known = 0;
+  uint64_t value = 0;
+};
+
+struct Prim {
+  Instance* inst;
+  string name;
+  Op op = OP_none;
+  uint width = 0;
+};
+
+//Constants are stored in ArgInts, which are sign extended
+bool fitsInArg(uint64_t v, uint width) {
+  return ((uint64_t) (int64_t) (int) v & mask(width))==v;
+}
+
+uint64_t intArg(Instance* inst, string name, uint width) {
+  return (uint64_t) (int64_t) getInstanceArg(inst,name)->get<ArgInt>() & mask(width);
+}
+
+class Folder {
+  ModuleDef* def;
+  Context* c;
+  BitNets nets;
+  //Per net: 0, 1 or -1 if not constant
+  vector<int> values;
+  vector<Prim> prims;
+
+  public :
+    explicit Folder(ModuleDef* def) : def(def), c(def->getContext()), nets(def) {}
+    bool run();
+  private :
+    void propagate();
+    Bits eval(const Prim& p);
+    Bits read(Instance* inst, string port);
+    uint portBit(Instance* inst, string port) { return nets.getBit(inst->sel(port));}
+    uint portWidth(Instance* inst, string port) { return inst->sel(port)->getType()->getSize();}
+    string identity(const Prim& p);
+    bool sameNets(Instance* inst, string a, string b);
+};
+
+Bits Folder::read(Instance* inst, string port) {
+  Bits b;
+  uint base = portBit(inst,port);
+  uint width = portWidth(inst,port);
+  for (uint i=0; i<width; ++i) {
+    int v = values[nets.getNet(base+i)];
+    if (v<0) continue;
+    b.known |= 1ULL<<i;
+    b.value |= (uint64_t) v<<i;
+  }
+  return b;
+}
+
+//Known bits of the output of p
+Bits Folder::eval(const Prim& p) {
+  Bits out;
+  Instance* inst = p.inst;
+  uint64_t m = mask(p.width);
+  if (p.name=="const") {
+    out.known = m;
+    out.value = intArg(inst,"value",p.width);
+    return out;
+  }
+  if (p.name=="reg") {
+    //out is init until the register loads a value. A bit stays init when
+    //the register can only load init into it
+    uint64_t init = intArg(inst,"init",p.width);
+    Bits in = read(inst,"in");
+    bool hold = false;
+    if (getInstanceArg(inst,"en")->get<ArgBool>()) {
+      Bits en = read(inst,"en");
+      hold |= en.known && !en.value;
+    }
+    if (getInstanceArg(inst,"clr")->get<ArgBool>()) {
+      Bits clr = read(inst,"clr");
+      hold |= clr.known && clr.value;
+    }
+    out.known = hold ? m : in.known & ~(in.value ^ init);
+    out.value = init & out.known;
+    return out;
+  }
+  if (p.name=="slice") {
+    Bits in = read(inst,"in");
+    uint lo = getInstanceArg(inst,"lo")->get<ArgInt>();
+    out.known = (in.known>>lo) & m;
+    out.value = (in.value>>lo) & m;
+    return out;
+  }
+  if (p.name=="concat") {
+    //out = {in0,in1}
+    Bits in0 = read(inst,"in0");
+    Bits in1 = read(inst,"in1");
+    uint width1 = getInstanceArg(inst,"width1")->get<ArgInt>();
+    out.known = ((in0.known<<width1) | in1.known) & m;
+    out.value = ((in0.value<<width1) | in1.value) & m;
+    return out;
+  }
+
+  uint n = numOperands(p.op);
+  Bits a = read(inst,n==1 ? "in" : "in0");
+  Bits b, sel;
+  if (n>1) b = read(inst,"in1");
+  if (p.op==OP_mux) sel = read(inst,"sel");
+  uint64_t outMask = hasBitOutput(p.op) ? 1 : m;
+  bool full = a.known==m && (n<2 || b.known==m) && (n<3 || sel.known==1);
+  if (full) {
+    out.known = outMask;
+    out.value = PrimOps::eval(p.op,p.width,a.value,b.value,sel.value);
+    return out;
+  }
+  switch (p.op) {
+    case OP_and : {
+      uint64_t zeros = (a.known & ~a.value) | (b.known & ~b.value);
+      out.known = zeros | (a.known & b.known);
+      out.value = a.value & b.value & out.known;
+      break;
+    }
+    case OP_or : {
+      uint64_t ones = (a.known & a.value) | (b.known & b.value);
+      out.known = ones | (a.known & b.known);
+      out.value = (a.value | b.value) & out.known;
+      break;
+    }
+    case OP_not :
+      out.known = a.known;
+      out.value = ~a.value & a.known;
+      break;
+    case OP_xor :
+      out.known = a.known & b.known;
+      out.value = (a.value ^ b.value) & out.known;
+      break;
+    case OP_mul :
+      if ((a.known==m && a.value==0) || (b.known==m && b.value==0)) out.known = m;
+      break;
+    case OP_mux :
+      if (sel.known) {
+        out = sel.value ? b : a;
+      }
+      else {
+        out.known = a.known & b.known & ~(a.value ^ b.value);
+        out.value = a.value & out.known;
+      }
+      break;
+    default :
+      break;
+  }
+  return out;
+}
+
+void Folder::propagate() {
+  values.assign(nets.getNumNets(),-1);
+  //Primitives reading each net
+  vector<vector<uint>> readers(nets.getNumNets());
+  for (auto w : nets.getTops()) {
+    auto inst = dyn_cast<Instance>(w);
+    if (!inst) continue;
+    Prim p;
+    p.inst = inst;
+    p.name = coreirPrimName(inst);
+    if (p.name=="") continue;
+    p.op = str2Op(p.name);
+    if (p.op==OP_none && p.name!="const" && p.name!="reg" && p.name!="slice" && p.name!="concat") continue;
+    //Widest port of the primitive
+    Arg* width = getInstanceArg(inst,p.name=="concat" ? "width0" : "width");
+    p.width = width->get<ArgInt>();
+    if (p.name=="concat") p.width += getInstanceArg(inst,"width1")->get<ArgInt>();
+    if (p.name=="slice") p.width = getInstanceArg(inst,"hi")->get<ArgInt>() - getInstanceArg(inst,"lo")->get<ArgInt>();
+    if (p.width>64 || portWidth(inst,"out")>64) continue;
+    uint top = nets.getTopIndex(inst);
+    for (uint bit=nets.getBase(top); bit<nets.getBase(top+1); ++bit) {
+      if (!nets.isDriver(bit)) readers[nets.getNet(bit)].push_back(prims.size());
+    }
+    prims.push_back(p);
+  }
+
+  //Every net becomes constant at most once, so every primitive is
+  //evaluated at most once per input bit
+  std::deque<uint> queue;
+  vector<bool> queued(prims.size(),true);
+  for (uint i=0; i<prims.size(); ++i) queue.push_back(i);
+  while (!queue.empty()) {
+    uint i = queue.front();
+    queue.pop_front();
+    queued[i] = false;
+    Bits out = eval(prims[i]);
+    uint base = portBit(prims[i].inst,"out");
+    uint width = portWidth(prims[i].inst,"out");
+    for (uint b=0; b<width; ++b) {
+      if (!((out.known>>b) & 1)) continue;
+      uint net = nets.getNet(base+b);
+      if (values[net]>=0 || nets.getDriver(net)!=(int) (base+b)) continue;
+      values[net] = (out.value>>b) & 1;
+      for (auto r : readers[net]) {
+        if (!queued[r]) {
+          queued[r] = true;
+          queue.push_back(r);
+        }
+      }
+    }
+  }
+}
+
+bool Folder::sameNets(Instance* inst, string a, string b) {
+  uint baseA = portBit(inst,a), baseB = portBit(inst,b);
+  for (uint i=0; i<portWidth(inst,a); ++i) {
+    if (nets.getNet(baseA+i)!=nets.getNet(baseB+i)) return false;
+  }
+  return true;
+}
+
+//Input port the output of p is equal to or ""
+string Folder::identity(const Prim& p) {
+  if (p.op==OP_none) return "";
+  Instance* inst = p.inst;
+  uint64_t m = mask(p.width);
+  if (p.op==OP_mux) {
+    Bits sel = read(inst,"sel");
+    if (sel.known) return sel.value ? "in1" : "in0";
+    return sameNets(inst,"in0","in1") ? "in0" : "";
+  }
+  if (numOperands(p.op)!=2 || hasBitOutput(p.op)) return "";
+  Bits a = read(inst,"in0");
+  Bits b = read(inst,"in1");
+  auto is = [m](Bits x, uint64_t v) { return x.known==m && x.value==v;};
+  switch (p.op) {
+    case OP_and :
+      if (is(b,m)) return "in0";
+      if (is(a,m)) return "in1";
+      break;
+    case OP_or :
+    case OP_xor :
+    case OP_add :
+      if (is(b,0)) return "in0";
+      if (is(a,0)) return "in1";
+      break;
+    case OP_mul :
+      if (is(b,1)) return "in0";
+      if (is(a,1)) return "in1";
+      break;
+    case OP_sub :
+    case OP_dshl :
+    case OP_dlshr :
+    case OP_dashr :
+      if (is(b,0)) return "in0";
+      break;
+    case OP_udiv :
+      if (is(b,1)) return "in0";
+      break;
+    default :
+      break;
+  }
+  return "";
+}
+
+bool Folder::run() {
+  propagate();
+
+  //Constants read by something, removed at the end if that is no longer the case
+  vector<Instance*> consts;
+  for (auto& p : prims) {
+    if (p.name=="const" && nets.getBits(nets.getNet(portBit(p.inst,"out"))).size()>1) consts.push_back(p.inst);
+  }
+
+  bool modified = false;
+  //Identities become wires first: the constants replacing other primitives
+  //take over the connections of those later
+  unordered_map<uint,uint> wired;
+  auto resolve = [&wired](uint bit) {
+    while (wired.count(bit)) bit = wired[bit];
+    return bit;
+  };
+  vector<Prim*> folded;
+  for (auto& p : prims) {
+    if (p.name=="const") continue;
+    Bits out = eval(p);
+    uint outWidth = portWidth(p.inst,"out");
+    if (out.known==mask(outWidth) && fitsInArg(out.value,outWidth)) {
+      folded.push_back(&p);
+      continue;
+    }
+    string port = identity(p);
+    if (port=="") continue;
+    uint in = portBit(p.inst,port);
+    uint out0 = portBit(p.inst,"out");
+    vector<uint> srcs;
+    bool ok = true;
+    for (uint i=0; i<outWidth && ok; ++i) {
+      int driver = nets.getDriver(nets.getNet(in+i));
+      ok = driver>=0;
+      if (!ok) break;
+      srcs.push_back(resolve(driver));
+      ok = srcs[i]<out0 || srcs[i]>=out0+outWidth;
+    }
+    if (!ok) continue;
+    for (uint i=0; i<outWidth; ++i) wired[out0+i] = srcs[i];
+    nets.redirect(p.inst->sel("out"),srcs);
+    def->removeInstance(p.inst);
+    modified = true;
+  }
+
+  for (auto p : folded) {
+    Instance* inst = p->inst;
+    uint width = portWidth(inst,"out");
+    uint64_t value = eval(*p).value;
+    vector<std::pair<SelectPath,Wireable*>> readers;
+    for (auto con : inst->sel("out")->getLocalConnections()) {
+      if (con.second->getTopParent()==inst) continue;
+      SelectPath path = con.first->getSelectPath();
+      path.erase(path.begin(),path.begin()+2);
+      readers.push_back({path,con.second});
+    }
+    string name = inst->getInstname();
+    def->removeInstance(inst);
+    modified = true;
+    if (readers.empty()) continue;
+    Instance* k = def->addInstance(name,"coreir.const",{{"width",c->argInt(width)}},{{"value",c->argInt((int) value)}});
+    for (auto r : readers) def->connect(k->sel("out")->sel(r.first),r.second);
+    //Readers folded later leave it unread
+    consts.push_back(k);
+  }
+
+  for (auto k : consts) {
+    if (k->sel("out")->getLocalConnections().empty()) {
+      def->removeInstance(k);
+      modified = true;
+    }
+  }
+  return modified;
+}
+
+}
+
+std::string Passes::ConstFold::ID = "constfold";
+bool Passes::ConstFold::runOnModule(Module* m) {
+  if (!m->hasDef()) return false;
+  bool modified = false;
+  //Wiring up an identity can connect constants to more logic
+  while (Folder(m->getDef()).run()) modified = true;
+  return modified;
+}
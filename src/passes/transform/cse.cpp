@@ -0,0 +1,120 @@
+#include "coreir.h"
+#include "coreir-passes/transform/cse.h"
+#include <map>
+#include <set>
+
+using namespace CoreIR;
+using namespace CoreIR::PrimOps;
+
+namespace {
+
+bool isComb(const string& name) {
+  return str2Op(name)!=OP_none || name=="const" || name=="slice" || name=="concat";
+}
+
+bool isCommutative(const string& name) {
+  Op op = str2Op(name);
+  return op==OP_add || op==OP_mul || op==OP_and || op==OP_or || op==OP_xor || op==OP_eq;
+}
+
+string argsStr(Args args) {
+  std::map<string,Arg*> sorted(args.begin(),args.end());
+  string s;
+  for (auto arg : sorted) s += arg.first + "=" + arg.second->toString() + ",";
+  return s;
+}
+
+//Input ports of a primitive in port order
+vector<string> inputPorts(Instance* inst) {
+  vector<string> ports;
+  for (auto field : cast<RecordType>(inst->getType())->getFields()) {
+    if (field!="out") ports.push_back(field);
+  }
+  return ports;
+}
+
+}
+
+std::string Passes::CSE::ID = "cse";
+bool Passes::CSE::runOnModule(Module* m) {
+  if (!m->hasDef()) return false;
+  ModuleDef* def = m->getDef();
+  BitNets nets(def);
+
+  //Combinational primitives (by top index) and the ones they read
+  auto& tops = nets.getTops();
+  vector<bool> comb(tops.size(),false);
+  for (uint i=1; i<tops.size(); ++i) comb[i] = isComb(coreirPrimName(cast<Instance>(tops[i])));
+  vector<uint> numIns(tops.size(),0);
+  vector<vector<uint>> fanout(tops.size());
+  for (uint i=1; i<tops.size(); ++i) {
+    if (!comb[i]) continue;
+    std::set<uint> drivers;
+    for (uint bit=nets.getBase(i); bit<nets.getBase(i+1); ++bit) {
+      if (nets.isDriver(bit)) continue;
+      int driver = nets.getDriver(nets.getNet(bit));
+      if (driver<0) continue;
+      uint top = nets.getTop(driver);
+      if (comb[top] && top!=i) drivers.insert(top);
+    }
+    numIns[i] = drivers.size();
+    for (auto d : drivers) fanout[d].push_back(i);
+  }
+
+  //Topological order. Primitives on combinational loops are left alone
+  vector<uint> order;
+  for (uint i=1; i<tops.size(); ++i) {
+    if (comb[i] && numIns[i]==0) order.push_back(i);
+  }
+  for (uint k=0; k<order.size(); ++k) {
+    for (auto r : fanout[order[k]]) {
+      if (--numIns[r]==0) order.push_back(r);
+    }
+  }
+
+  //Out bit of a merged instance -> out bit of the instance it was merged into
+  unordered_map<uint,uint> merged;
+  auto driverStr = [&](uint bit) {
+    uint net = nets.getNet(bit);
+    int driver = nets.getDriver(net);
+    if (driver<0) return "n" + to_string(net);
+    auto it = merged.find(driver);
+    return to_string(it==merged.end() ? driver : it->second);
+  };
+
+  bool modified = false;
+  unordered_map<string,Instance*> keys;
+  for (auto i : order) {
+    Instance* inst = cast<Instance>(tops[i]);
+    string name = coreirPrimName(inst);
+    vector<string> ins;
+    for (auto port : inputPorts(inst)) {
+      Wireable* w = inst->sel(port);
+      uint base = nets.getBit(w);
+      string s;
+      for (uint b=0; b<w->getType()->getSize(); ++b) s += driverStr(base+b) + " ";
+      ins.push_back(s);
+    }
+    if (isCommutative(name)) std::sort(ins.begin(),ins.end());
+    string key = name + "(" + argsStr(inst->getGenArgs()) + ")(" + argsStr(inst->getConfigArgs()) + ")";
+    for (auto& s : ins) key += "|" + s;
+
+    auto it = keys.find(key);
+    if (it==keys.end()) {
+      keys[key] = inst;
+      continue;
+    }
+    uint from = nets.getBit(inst->sel("out"));
+    uint to = nets.getBit(it->second->sel("out"));
+    uint width = inst->sel("out")->getType()->getSize();
+    vector<uint> srcs;
+    for (uint b=0; b<width; ++b) {
+      srcs.push_back(to+b);
+      merged[from+b] = to+b;
+    }
+    nets.redirect(inst->sel("out"),srcs);
+    def->removeInstance(inst);
+    modified = true;
+  }
+  return modified;
+}
@@ -0,0 +1,160 @@
+#include "coreir.h"
+#include "coreir-passes/transform/deadlogic.h"
+#include "coreir-passes/analysis/constructinstancegraph.h"
+
+using namespace CoreIR;
+
+bool Passes::DeadLogic::removable(Instance* inst) {
+  Instantiable* ref = inst->getInstantiableRef();
+  string ns = ref->getNamespace()->getName();
+  if (ns=="coreir") return true;
+  if (ns=="cgralib") {
+    Generator* gen = inst->getGeneratorRef();
+    return (gen ? gen->getName() : ref->getName())!="IO";
+  }
+  if (inst->isGen() || !inst->getModuleRef()->hasDef()) return false;
+  return !hasSideEffects(inst->getModuleRef());
+}
+
+bool Passes::DeadLogic::hasSideEffects(Module* m) {
+  auto it = sideEffects.find(m);
+  if (it!=sideEffects.end()) return it->second;
+  bool ret = false;
+  for (auto imap : m->getDef()->getInstances()) {
+    ret |= !removable(imap.second);
+  }
+  sideEffects[m] = ret;
+  return ret;
+}
+
+//Marks the tops that are live and the nets they read. Self reads the
+//outputs in outputs, or every output if it is null
+vector<bool> Passes::DeadLogic::findLive(BitNets& nets, const vector<string>* outputs, vector<bool>& liveNets) {
+  auto& tops = nets.getTops();
+  vector<bool> live(tops.size(),false);
+  liveNets.assign(nets.getNumNets(),false);
+  vector<uint> queue;
+  auto markLive = [&](uint top) {
+    if (live[top]) return;
+    live[top] = true;
+    queue.push_back(top);
+  };
+  //Every input of a live top keeps its driver alive
+  auto markReads = [&](uint lo, uint hi) {
+    for (uint bit=lo; bit<hi; ++bit) {
+      if (nets.isDriver(bit)) continue;
+      uint net = nets.getNet(bit);
+      liveNets[net] = true;
+      int driver = nets.getDriver(net);
+      if (driver>=0) markLive(nets.getTop(driver));
+    }
+  };
+  //Self is top 0
+  live[0] = true;
+  if (outputs) {
+    for (auto field : *outputs) {
+      Wireable* w = tops[0]->sel(field);
+      uint bit = nets.getBit(w);
+      markReads(bit,bit+w->getType()->getSize());
+    }
+  }
+  else {
+    markReads(nets.getBase(0),nets.getBase(1));
+  }
+  for (uint i=1; i<tops.size(); ++i) {
+    Instance* inst = cast<Instance>(tops[i]);
+    if (!removable(inst)) markLive(i);
+  }
+  for (uint k=0; k<queue.size(); ++k) {
+    markReads(nets.getBase(queue[k]),nets.getBase(queue[k]+1));
+  }
+  return live;
+}
+
+//Nets read by live logic in a module above the current one. Its outputs are read if a
+//live top reads them in a module above it (every output of the top is)
+Passes::DeadLogic::Liveness& Passes::DeadLogic::getLiveness(ModuleDef* def) {
+  auto it = above.find(def);
+  if (it!=above.end()) return it->second;
+  Module* m = def->getModule();
+  vector<string> outputs;
+  RecordType* rt = cast<RecordType>(m->getType());
+  for (auto field : rt->getFields()) {
+    if (rt->getRecord().at(field)->getDir()!=Type::DK_Out) continue;
+    if (isRead(m,field)) outputs.push_back(field);
+  }
+  Liveness l;
+  l.nets = std::make_shared<BitNets>(def);
+  findLive(*l.nets,&outputs,l.liveNets);
+  return above.emplace(def,l).first->second;
+}
+
+bool Passes::DeadLogic::isRead(Module* m, string field) {
+  InstanceGraphNode* node = nodes.at(m);
+  if (node->getInstanceList().empty()) return true;
+  for (auto inst : node->getInstanceList()) {
+    Liveness& l = getLiveness(inst->getContainer());
+    Wireable* w = inst->sel(field);
+    uint bit = l.nets->getBit(w);
+    for (uint i=0; i<w->getType()->getSize(); ++i) {
+      if (l.liveNets[l.nets->getNet(bit+i)]) return true;
+    }
+  }
+  return false;
+}
+
+bool Passes::DeadLogic::runOnInstanceGraphNode(InstanceGraphNode& node) {
+  if (node.isExternal() || !isa<Module>(node.getInstantiable())) return false;
+  Module* m = cast<Module>(node.getInstantiable());
+  if (!m->hasDef()) return false;
+  ModuleDef* def = m->getDef();
+  bool modified = false;
+  //The top (which nothing instantiates) keeps its ports
+  bool ports = removePorts && !node.getInstanceList().empty();
+  Interface* self = def->getInterface();
+
+  //Outputs that no live logic above reads are not needed, and neither is
+  //the logic only driving them. The modules above are not visited yet, so
+  //their dead logic is found without removing it.
+  if (ports) {
+    //The instance graph is built again after passes that modify
+    nodes.clear();
+    for (auto n : getAnalysisPass<ConstructInstanceGraph>()->getInstanceGraph()->getSortedNodes()) {
+      if (auto nm = dyn_cast<Module>(n->getInstantiable())) nodes[nm] = n;
+    }
+    above.clear();
+    RecordType* rt = cast<RecordType>(m->getType());
+    vector<string> unread;
+    for (auto field : rt->getFields()) {
+      if (rt->getRecord().at(field)->getDir()==Type::DK_Out && !isRead(m,field)) unread.push_back(field);
+    }
+    for (auto field : unread) {
+      node.detachField(field);
+      modified = true;
+    }
+  }
+
+  BitNets nets(def);
+  auto& tops = nets.getTops();
+  vector<bool> liveNets;
+  vector<bool> live = findLive(nets,nullptr,liveNets);
+  unordered_set<Instance*> dead;
+  for (uint i=1; i<tops.size(); ++i) {
+    if (!live[i]) dead.insert(cast<Instance>(tops[i]));
+  }
+  if (!dead.empty()) {
+    def->removeInstances(dead);
+    modified = true;
+  }
+
+  //Ports left unconnected inside
+  if (!ports) return modified;
+  RecordType* rt = cast<RecordType>(m->getType());
+  for (auto field : rt->getFields()) {
+    if (self->sel(field)->getLocalConnections().empty()) {
+      node.detachField(field);
+      modified = true;
+    }
+  }
+  return modified;
+}
@@ -0,0 +1,111 @@
+#include "coreir.h"
+#include "coreir-passes/transform/dedup.h"
+#include <algorithm>
+#include <map>
+#include <set>
+
+using namespace CoreIR;
+
+namespace {
+
+string instanceLabel(Instance* inst) {
+  return inst->getInstantiableRef()->getRefName() + Args2CanonicalStr(inst->getGenArgs()) + Args2CanonicalStr(inst->getConfigArgs());
+}
+
+//Does not depend on the instance names
+uint64_t structuralHash(Module* m) {
+  std::map<string,Param> params(m->getConfigParams().begin(),m->getConfigParams().end());
+  uint64_t h = stableHash(m->getType()->toString());
+  for (auto p : params) h = stableHashCombine(h,stableHash(p.first + ":" + Param2Str(p.second)));
+  h = stableHashCombine(h,stableHash("defaults:" + Args2CanonicalStr(m->getDefaultConfigArgs())));
+  ModuleDef* def = m->getDef();
+  unordered_map<string,string> labels;
+  std::multiset<string> items;
+  for (auto imap : def->getInstances()) {
+    labels[imap.first] = instanceLabel(imap.second);
+    items.insert("i:" + labels[imap.first]);
+  }
+  auto pathStr = [&](SelectPath path) {
+    if (path[0]!="self") path[0] = labels[path[0]];
+    return SelectPath2Str(path);
+  };
+  for (auto con : def->getConnections()) {
+    string a = pathStr(con.first->getSelectPath());
+    string b = pathStr(con.second->getSelectPath());
+    items.insert("c:" + (a<b ? a + "=" + b : b + "=" + a));
+  }
+  for (auto& item : items) h = stableHashCombine(h,stableHash(item));
+  return h;
+}
+
+void visit(Module* m, std::set<Module*>& visited, vector<Module*>& order) {
+  if (!visited.insert(m).second) return;
+  if (!m->hasDef()) return;
+  std::map<string,Module*> children;
+  for (auto imap : m->getDef()->getInstances()) {
+    if (!imap.second->isGen()) children[imap.first] = imap.second->getModuleRef();
+  }
+  for (auto child : children) visit(child.second,visited,order);
+  order.push_back(m);
+}
+
+}
+
+bool Passes::Dedup::runOnNamespace(Namespace* ns) {
+  Context* c = this->getContext();
+  //Every module of the context in a deterministic order, children first
+  vector<Module*> order;
+  std::set<Module*> visited;
+  for (auto nsmap : c->getNamespaces()) {
+    std::map<string,Module*> modules;
+    for (auto mmap : nsmap.second->getModules()) modules.insert(mmap);
+    for (auto mmap : modules) visit(mmap.second,visited,order);
+  }
+  unordered_map<Module*,vector<Instance*>> users;
+  for (auto m : order) {
+    for (auto imap : m->getDef()->getInstances()) {
+      if (!imap.second->isGen()) users[imap.second->getModuleRef()].push_back(imap.second);
+    }
+  }
+
+  bool modified = false;
+  unordered_map<uint64_t,vector<Module*>> buckets;
+  for (auto m : order) {
+    vector<Module*>& bucket = buckets[structuralHash(m)];
+    Module* rep = nullptr;
+    uint idx = 0;
+    for (; idx<bucket.size(); ++idx) {
+      if (Module::isEqual(bucket[idx],m,true,false,true)) {
+        rep = bucket[idx];
+        break;
+      }
+    }
+    if (!rep) {
+      bucket.push_back(m);
+      continue;
+    }
+    //Keep the one outside ns if only one of them can be deleted
+    Module* dup = m;
+    if (m->getNamespace()!=ns && rep->getNamespace()==ns) {
+      std::swap(dup,rep);
+      bucket[idx] = rep;
+    }
+    if (dup->getNamespace()!=ns || users[dup].empty()) continue;
+    for (auto inst : users[dup]) {
+      inst->replace(rep,inst->getConfigArgs());
+      users[rep].push_back(inst);
+    }
+    users.erase(dup);
+    //The instances of dup go away with it
+    for (auto imap : dup->getDef()->getInstances()) {
+      if (imap.second->isGen()) continue;
+      auto& list = users[imap.second->getModuleRef()];
+      list.erase(std::find(list.begin(),list.end(),imap.second));
+    }
+    ns->eraseModule(dup->getName());
+    modified = true;
+  }
+  return modified;
+}
+
+std::string Passes::Dedup::ID = "dedup";
@@ -0,0 +1,482 @@
+#include "coreir.h"
+#include "coreir-passes/analysis/combgraph.h"
+#include "coreir-passes/analysis/combdepth.h"
+#include "coreir-passes/analysis/constructinstancegraph.h"
+#include "coreir-passes/transform/pipeline.h"
+#include <algorithm>
+
+using namespace CoreIR;
+
+namespace {
+
+enum VertexKind {V_Input, V_Output, V_Comb, V_Sub, V_Seq, V_Reg};
+
+//A port of self or an instance. All its nodes are delayed by lag cycles
+struct Vertex {
+  VertexKind kind;
+  Instance* inst = nullptr;
+  const CombTiming* timing = nullptr;
+  //Nodes read and driven by the vertex
+  vector<uint> ins;
+  vector<uint> outs;
+  int lag = 0;
+  //Plain registers that are bypassed
+  bool removed = false;
+  //Part of a feedback loop (through registers or not)
+  bool cyclic = false;
+};
+
+//Plain registers can be moved: no enable or resets and initialized to 0
+bool isMovableReg(Instance* inst) {
+  if (coreirPrimName(inst)!="reg") return false;
+  for (auto arg : {"en","clr","rst"}) {
+    if (getInstanceArg(inst,arg)->get<ArgBool>()) return false;
+  }
+  return getInstanceArg(inst,"init")->get<ArgInt>()==0;
+}
+
+bool isBits(Type* t) {
+  if (auto at = dyn_cast<ArrayType>(t)) t = at->getElemType();
+  return isa<BitType>(t);
+}
+
+//Instance level graph of g in succs: a vertex per port of self, then one
+//per instance (in the order of CombGraph). Returns the vertex of every node.
+vector<uint> vertexGraph(CombGraph& g, vector<vector<uint>>& succs) {
+  vector<uint> vertOf(g.getNumNodes());
+  uint numVerts = 0;
+  for (auto n : g.getSelfNodes()) vertOf[n] = numVerts++;
+  for (auto inst : g.getInstances()) {
+    for (auto n : g.getInstanceNodes(inst)) vertOf[n] = numVerts;
+    numVerts++;
+  }
+  succs.assign(numVerts,{});
+  for (uint n=0; n<g.getNumNodes(); ++n) {
+    for (auto s : g.getSuccs(n)) succs[vertOf[n]].push_back(vertOf[s]);
+  }
+  return vertOf;
+}
+
+//Vertices of succs on a cycle, given its strongly connected components
+vector<bool> onCycles(const vector<vector<uint>>& succs, const vector<int>& comp, uint numComps) {
+  vector<uint> sizes(numComps,0);
+  for (auto cn : comp) sizes[cn]++;
+  vector<bool> cyclic(succs.size(),false);
+  for (uint v=0; v<succs.size(); ++v) {
+    cyclic[v] = sizes[comp[v]]>1 || std::find(succs[v].begin(),succs[v].end(),v)!=succs[v].end();
+  }
+  return cyclic;
+}
+
+//Instances of m in a feedback loop
+unordered_set<Instance*> loopInstances(Module* m) {
+  CombGraph g(m);
+  vector<vector<uint>> succs;
+  vector<uint> vertOf = vertexGraph(g,succs);
+  uint numComps;
+  vector<int> comp = strongComponents(succs,numComps);
+  vector<bool> cyclic = onCycles(succs,comp,numComps);
+  unordered_set<Instance*> insts;
+  for (uint n=0; n<g.getNumNodes(); ++n) {
+    if (g.getNode(n).inst && cyclic[vertOf[n]]) insts.insert(g.getNode(n).inst);
+  }
+  return insts;
+}
+
+//Lags of the vertices of one module, chosen in topological order of its
+//vertex graph
+class Retimer {
+  CombGraph& g;
+  Passes::CombDepth* depth;
+  int target;
+  vector<uint> vertOf;
+  //Vertex graph
+  vector<vector<uint>> succs;
+  //Cycles the submodule adds to a node on top of the lag of its vertex
+  vector<int> extra;
+  vector<int> arrival;
+  //Position in a topological order of the nodes
+  vector<uint> pos;
+  public :
+    vector<Vertex> verts;
+    bool met = true;
+
+    Retimer(CombGraph& g, Passes::CombDepth* depth, int target, unordered_map<Module*,map<string,int>>& latencies);
+    void run();
+    //Cycles delaying the values of the driver p
+    int lagOut(uint p) {
+      Vertex& v = verts[vertOf[p]];
+      return v.lag + extra[p] - (v.removed ? 1 : 0);
+    }
+    //Registers needed on the edge from p to n. Constants are never delayed.
+    int regsOn(uint p, uint n) {
+      Vertex& v = verts[vertOf[p]];
+      if (v.kind==V_Comb && v.ins.empty()) return 0;
+      return verts[vertOf[n]].lag - lagOut(p);
+    }
+  private :
+    void sortNodes();
+    void arrive(uint n);
+    void arrive(const vector<uint>& members);
+    //How much deeper than the target the paths through v are
+    int excess(Vertex& v);
+};
+
+Retimer::Retimer(CombGraph& g, Passes::CombDepth* depth, int target, unordered_map<Module*,map<string,int>>& latencies) : g(g), depth(depth), target(target) {
+  uint numNodes = g.getNumNodes();
+  vertOf = vertexGraph(g,succs);
+  extra.assign(numNodes,0);
+  arrival.assign(numNodes,0);
+  for (auto n : g.getSelfNodes()) {
+    Vertex v;
+    v.kind = g.getNode(n).driver ? V_Input : V_Output;
+    (v.kind==V_Input ? v.outs : v.ins).push_back(n);
+    verts.push_back(v);
+  }
+  for (auto inst : g.getInstances()) {
+    Vertex v;
+    v.inst = inst;
+    Module* sub = combDefModule(inst);
+    if (sub) {
+      v.kind = V_Sub;
+      v.timing = &depth->getTiming(sub);
+    }
+    else if (isMovableReg(inst)) v.kind = V_Reg;
+    else if (isSequentialCell(inst)) v.kind = V_Seq;
+    else v.kind = V_Comb;
+    for (auto n : g.getInstanceNodes(inst)) {
+      (g.getNode(n).driver ? v.outs : v.ins).push_back(n);
+      if (sub && latencies.count(sub) && latencies[sub].count(g.getNode(n).port)) {
+        extra[n] = latencies[sub][g.getNode(n).port];
+      }
+    }
+    verts.push_back(v);
+  }
+}
+
+void Retimer::sortNodes() {
+  uint numNodes = g.getNumNodes();
+  vector<vector<uint>> nsuccs(numNodes);
+  for (uint n=0; n<numNodes; ++n) nsuccs[n] = g.getSuccs(n);
+  for (auto& v : verts) {
+    if (v.kind==V_Comb || (v.kind==V_Reg && !v.cyclic)) {
+      for (auto i : v.ins) {
+        for (auto o : v.outs) nsuccs[i].push_back(o);
+      }
+    }
+    else if (v.kind==V_Sub) {
+      unordered_map<string,uint> ports;
+      for (auto n : v.outs) ports[g.getNode(n).port] = n;
+      for (auto i : v.ins) {
+        auto it = v.timing->arcs.find(g.getNode(i).port);
+        if (it==v.timing->arcs.end()) continue;
+        for (auto& amap : it->second) nsuccs[i].push_back(ports.at(amap.first));
+      }
+    }
+  }
+  vector<uint> indegree(numNodes,0);
+  for (uint n=0; n<numNodes; ++n) {
+    for (auto s : nsuccs[n]) indegree[s]++;
+  }
+  pos.assign(numNodes,numNodes);
+  vector<uint> work;
+  for (uint n=0; n<numNodes; ++n) if (indegree[n]==0) work.push_back(n);
+  uint next = 0;
+  uint placed = 0;
+  while (placed<numNodes) {
+    if (work.empty()) {
+      //Cut a combinational loop at its first node
+      while (pos[next]<numNodes || indegree[next]==0) next++;
+      indegree[next] = 0;
+      work.push_back(next);
+    }
+    uint n = work.back();
+    work.pop_back();
+    pos[n] = placed++;
+    for (auto s : nsuccs[n]) {
+      if (pos[s]==numNodes && indegree[s]>0 && --indegree[s]==0) work.push_back(s);
+    }
+  }
+}
+
+void Retimer::arrive(uint n) {
+  Vertex& v = verts[vertOf[n]];
+  int a = 0;
+  if (!g.getNode(n).driver) {
+    for (auto p : g.getPreds(n)) {
+      if (regsOn(p,n)==0) a = std::max(a,arrival[p]);
+    }
+  }
+  else if (v.kind==V_Comb) {
+    for (auto i : v.ins) a = std::max(a,arrival[i]);
+    a += depth->getDelay(v.inst);
+  }
+  else if (v.kind==V_Sub) {
+    const string& port = g.getNode(n).port;
+    if (v.timing->launch.count(port)) a = v.timing->launch.at(port).depth;
+    for (auto i : v.ins) {
+      auto it = v.timing->arcs.find(g.getNode(i).port);
+      if (it==v.timing->arcs.end() || !it->second.count(port)) continue;
+      a = std::max(a,arrival[i] + it->second.at(port).depth);
+    }
+  }
+  else if (v.kind==V_Reg && v.removed) {
+    a = arrival[v.ins[0]];
+  }
+  arrival[n] = a;
+}
+
+void Retimer::arrive(const vector<uint>& members) {
+  vector<uint> nodes;
+  for (auto vi : members) {
+    nodes.insert(nodes.end(),verts[vi].ins.begin(),verts[vi].ins.end());
+    nodes.insert(nodes.end(),verts[vi].outs.begin(),verts[vi].outs.end());
+  }
+  std::sort(nodes.begin(),nodes.end(),[this](uint a, uint b) { return pos[a] < pos[b];});
+  for (auto n : nodes) arrive(n);
+}
+
+int Retimer::excess(Vertex& v) {
+  if (target<0) return 0;
+  int deepest = 0;
+  for (auto o : v.outs) deepest = std::max(deepest,arrival[o]);
+  for (auto i : v.ins) {
+    if (v.kind==V_Output || v.kind==V_Seq || (v.kind==V_Reg && !v.removed)) {
+      deepest = std::max(deepest,arrival[i]);
+    }
+    else if (v.kind==V_Sub && v.timing->capture.count(g.getNode(i).port)) {
+      deepest = std::max(deepest,arrival[i] + v.timing->capture.at(g.getNode(i).port).depth);
+    }
+  }
+  return std::max(0,deepest-target);
+}
+
+void Retimer::run() {
+  uint numComps;
+  vector<int> comp = strongComponents(succs,numComps);
+  vector<bool> cyclic = onCycles(succs,comp,numComps);
+  vector<vector<uint>> members(numComps);
+  for (uint vi=0; vi<verts.size(); ++vi) {
+    members[comp[vi]].push_back(vi);
+    verts[vi].cyclic = cyclic[vi];
+  }
+  sortNodes();
+
+  //Constants first as they do not depend on anything
+  for (uint vi=0; vi<verts.size(); ++vi) {
+    if (verts[vi].ins.empty()) arrive(vector<uint>{vi});
+  }
+  //Predecessors have larger component numbers
+  for (int c=numComps-1; c>=0; --c) {
+    int base = 0;
+    for (auto vi : members[c]) {
+      for (auto i : verts[vi].ins) {
+        for (auto p : g.getPreds(i)) {
+          Vertex& pv = verts[vertOf[p]];
+          if (comp[vertOf[p]]==c || (pv.kind==V_Comb && pv.ins.empty())) continue;
+          base = std::max(base,lagOut(p));
+        }
+      }
+    }
+    for (auto vi : members[c]) verts[vi].lag = base;
+    Vertex& v = verts[members[c][0]];
+    if (v.ins.empty()) continue;
+    //Loops keep their registers and lags
+    if (v.cyclic) {
+      arrive(members[c]);
+      for (auto vi : members[c]) met &= excess(verts[vi])==0;
+      continue;
+    }
+    //A plain register after the first added one moves up to it
+    if (v.kind==V_Reg && base>0) v.removed = true;
+    arrive(members[c]);
+    int before = excess(v);
+    if (before==0) continue;
+    //Register the inputs
+    v.lag = base+1;
+    v.removed = false;
+    arrive(members[c]);
+    int after = excess(v);
+    if (after>=before) {
+      v.lag = base;
+      v.removed = v.kind==V_Reg && base>0;
+      arrive(members[c]);
+    }
+    met &= std::min(before,after)==0;
+  }
+}
+
+//Inserts and removes the registers of a module
+class Rewriter {
+  ModuleDef* def;
+  Context* c;
+  Wireable* clk;
+  unordered_set<string> names;
+  uint next = 0;
+  //Outputs of the registers delaying a driver by 1, 2, ... cycles
+  unordered_map<Wireable*,vector<Wireable*>> chains;
+  public :
+    Rewriter(ModuleDef* def, Wireable* clk) : def(def), c(def->getContext()), clk(clk) {
+      for (auto imap : def->getInstances()) names.insert(imap.first);
+    }
+    string freshName(string prefix) {
+      string name;
+      do name = prefix + to_string(next++); while (names.count(name));
+      names.insert(name);
+      return name;
+    }
+    Wireable* delayed(Wireable* src, uint k) {
+      vector<Wireable*>& chain = chains[src];
+      while (chain.size()<k) {
+        Type* t = src->getType();
+        uint width = isa<ArrayType>(t) ? cast<ArrayType>(t)->getLen() : 1;
+        Instance* r = def->addInstance(freshName("pipe"),"coreir.reg",{{"width",c->argInt(width)}});
+        def->connect(chain.empty() ? src : chain.back(),r->sel("in"));
+        def->connect(clk,r->sel("clk"));
+        chain.push_back(r->sel("out"));
+      }
+      return chain[k-1];
+    }
+    //Connects snk to src delayed by k cycles, a register per array of bits.
+    //coreir.reg of width 1 is a Bit, so Bit[1] gets the register on its bit
+    void insertDelay(Wireable* src, Wireable* snk, uint k) {
+      Type* t = src->getType();
+      auto at1 = dyn_cast<ArrayType>(t);
+      if (at1 && at1->getLen()==1 && isBits(t)) {
+        insertDelay(src->sel(0),snk->sel(0),k);
+      }
+      else if (isBits(t)) {
+        def->connect(delayed(src,k),snk);
+      }
+      else if (auto rt = dyn_cast<RecordType>(t)) {
+        for (auto field : rt->getFields()) insertDelay(src->sel(field),snk->sel(field),k);
+      }
+      else if (auto at = dyn_cast<ArrayType>(t)) {
+        for (uint i=0; i<at->getLen(); ++i) insertDelay(src->sel(i),snk->sel(i),k);
+      }
+      else {
+        ASSERT(0,"Cannot add registers to " + src->toString() + " of type " + t->toString());
+      }
+    }
+    //Connects everything reg passed through directly
+    void bypass(Instance* reg) {
+      string name = freshName("pipe_bypass");
+      Instance* pt = def->addInstance(name,"coreir.passthrough",{{"type",c->argType(reg->sel("out")->getType())}});
+      for (auto con : reg->getLocalConnections()) {
+        SelectPath path = con.first->getSelectPath();
+        if (path[1]=="clk") continue;
+        path[0] = name;
+        def->connect(path,con.second->getSelectPath());
+      }
+      def->removeInstance(reg);
+      inlineInstance(pt);
+    }
+};
+
+}
+
+std::string Passes::Pipeline::ID = "pipeline";
+
+bool Passes::Pipeline::runOnInstanceGraphNode(InstanceGraphNode& node) {
+  if (auto m = dyn_cast<Module>(node.getInstantiable())) {
+    if (m->hasDef()) return pipeline(m);
+  }
+  return false;
+}
+
+bool Passes::Pipeline::inParentLoop(Module* m, unordered_map<Instantiable*,InstanceGraphNode*>& nodes, unordered_set<Module*>& visited) {
+  if (!nodes.count(m) || !visited.insert(m).second) return false;
+  for (auto inst : nodes[m]->getInstanceList()) {
+    Module* parent = inst->getContainer()->getModule();
+    if (!loops.count(parent)) loops[parent] = loopInstances(parent);
+    if (loops[parent].count(inst) || inParentLoop(parent,nodes,visited)) return true;
+  }
+  return false;
+}
+
+bool Passes::Pipeline::pipeline(Module* m) {
+  ModuleDef* def = m->getDef();
+  latencies[m].clear();
+  missed.erase(m);
+  //m is done with by its submodules and about to change
+  loops.erase(m);
+  //Latency added to m would change the cycles of a loop above it
+  unordered_map<Instantiable*,InstanceGraphNode*> nodes;
+  for (auto node : getAnalysisPass<ConstructInstanceGraph>()->getInstanceGraph()->getSortedNodes()) {
+    nodes[node->getInstantiable()] = node;
+  }
+  unordered_set<Module*> visited;
+  bool fixed = inParentLoop(m,nodes,visited);
+  Wireable* clk = nullptr;
+  RecordType* rt = cast<RecordType>(m->getType());
+  for (auto field : rt->getFields()) {
+    if (rt->getRecord().at(field)==this->getContext()->Named("coreir.clkIn")) clk = def->sel("self")->sel(field);
+  }
+  int depthTarget = target;
+  json& md = m->getMetaData();
+  if (md.count("timing") && md["timing"].count("target")) depthTarget = md["timing"]["target"].get<int>();
+
+  CombDepth* depth = getAnalysisPass<CombDepth>();
+  CombGraph g(m);
+  Retimer lags(g,depth,clk ? depthTarget : -1,latencies);
+  if (clk) lags.run();
+  if (!lags.met) missed.insert(m);
+
+  //Registers on every connection between different lags
+  vector<std::tuple<Wireable*,Wireable*,uint>> delays;
+  for (auto con : def->getConnections()) {
+    int a = g.findNode(con.first->getSelectPath());
+    int b = g.findNode(con.second->getSelectPath());
+    if (a<0 || b<0) continue;
+    if (!g.getNode(a).driver) {
+      std::swap(a,b);
+      std::swap(con.first,con.second);
+    }
+    int k = lags.regsOn(a,b);
+    //A submodule in a loop got latency (which should not happen as such
+    //submodules are not pipelined)
+    if (k<0) fixed = true;
+    if (k>0) delays.push_back(std::make_tuple(con.first,con.second,k));
+  }
+  vector<Instance*> removed;
+  for (auto& v : lags.verts) {
+    if (v.removed) removed.push_back(v.inst);
+  }
+  bool changes = !delays.empty() || !removed.empty();
+  for (auto& v : lags.verts) {
+    if (v.kind==V_Output) latencies[m][g.getNode(v.ins[0]).port] = fixed && changes ? 0 : v.lag;
+  }
+  if (!changes) return false;
+  //Left as it is, missing its target
+  if (fixed) {
+    missed.insert(m);
+    return false;
+  }
+
+  Rewriter rw(def,clk);
+  for (auto& d : delays) {
+    def->disconnect(std::get<0>(d),std::get<1>(d));
+    rw.insertDelay(std::get<0>(d),std::get<1>(d),std::get<2>(d));
+  }
+  for (auto inst : removed) rw.bypass(inst);
+  //The timing of m and of everything above it changed
+  depth->releaseMemory();
+  return true;
+}
+
+const map<string,int>& Passes::Pipeline::getAddedLatency(Module* m) {
+  return latencies[m];
+}
+
+void Passes::Pipeline::print() {
+  vector<Module*> mods;
+  for (auto lmap : latencies) mods.push_back(lmap.first);
+  std::sort(mods.begin(),mods.end(),[](Module* a, Module* b) { return a->getRefName() < b->getRefName();});
+  for (auto m : mods) {
+    vector<string> strs;
+    for (auto& lat : latencies[m]) strs.push_back(lat.first + " +" + to_string(lat.second));
+    cout << "Latency added to " << m->getRefName() << ": " << join(strs.begin(),strs.end(),string(", "));
+    if (missed.count(m)) cout << " (target not met)";
+    cout << endl;
+  }
+}
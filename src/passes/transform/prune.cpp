@@ -0,0 +1,33 @@
+#include "coreir.h"
+#include "coreir-passes/transform/prune.h"
+#include "instancegraph.h"
+
+using namespace CoreIR;
+
+bool Passes::Prune::runOnNamespace(Namespace* ns) {
+  Context* c = this->getContext();
+  ASSERT(c->hasTop(),"prune needs a top module (see Context::setTop)");
+  std::unordered_set<Instantiable*> reachable;
+  addReachable(c->getTop(),reachable);
+
+  bool modified = false;
+  for (auto mmap : ns->getModules()) {
+    if (reachable.count(mmap.second)) continue;
+    ns->eraseModule(mmap.first);
+    modified = true;
+  }
+  //Generated modules that were not moved into the namespace
+  for (auto gmap : ns->getGenerators()) {
+    Generator* g = gmap.second;
+    for (auto gen : g->getGeneratedModules()) {
+      Module* m = gen.second;
+      if (m->getLinkageKind()!=Instantiable::LK_Generated || reachable.count(m)) continue;
+      g->eraseModule(m);
+      delete m;
+      modified = true;
+    }
+  }
+  return modified;
+}
+
+std::string Passes::Prune::ID = "prune";
@@ -0,0 +1,397 @@
+#include "coreir.h"
+#include "coreir-sim/bitparallelsim.h"
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+namespace {
+
+inline uint64_t spread(uint64_t v, uint bit) {
+  return ((v>>bit) & 1) ? ~0ULL : 0;
+}
+
+//Value of lane l of a bit sliced word vector
+inline uint64_t getLane(const uint64_t* a, uint width, uint lane) {
+  uint64_t v = 0;
+  for (uint i=0; i<width; ++i) v |= ((a[i]>>lane) & 1) << i;
+  return v;
+}
+
+inline void setLane(uint64_t* a, uint width, uint lane, uint64_t v) {
+  uint64_t bit = 1ULL << lane;
+  for (uint i=0; i<width; ++i) {
+    a[i] = ((v>>i) & 1) ? (a[i] | bit) : (a[i] & ~bit);
+  }
+}
+
+//o = a + b + carry in every lane. Returns the carry out
+uint64_t addBits(const uint64_t* a, const uint64_t* b, uint64_t carry, uint64_t* o, uint width) {
+  for (uint i=0; i<width; ++i) {
+    uint64_t x = a[i] ^ b[i];
+    uint64_t c = (a[i] & b[i]) | (carry & x);
+    o[i] = x ^ carry;
+    carry = c;
+  }
+  return carry;
+}
+
+//Lanes where a>=b (unsigned): the carry out of a + ~b + 1
+uint64_t uge(const uint64_t* a, const uint64_t* b, uint width) {
+  uint64_t carry = ~0ULL;
+  for (uint i=0; i<width; ++i) {
+    uint64_t nb = ~b[i];
+    carry = (a[i] & nb) | (carry & (a[i] ^ nb));
+  }
+  return carry;
+}
+
+//Signed compares are unsigned compares with the sign bits flipped.
+//scratch has 2*width words
+uint64_t sge(const uint64_t* a, const uint64_t* b, uint width, uint64_t* scratch) {
+  uint64_t* sa = scratch;
+  uint64_t* sb = scratch+width;
+  std::copy(a,a+width,sa);
+  std::copy(b,b+width,sb);
+  sa[width-1] = ~sa[width-1];
+  sb[width-1] = ~sb[width-1];
+  return uge(sa,sb,width);
+}
+
+//Barrel shifter. Stage k shifts the lanes that have bit k of b set by 2^k.
+//scratch has 2*width words
+void shiftBits(PrimOps::Op op, const uint64_t* a, const uint64_t* b, uint64_t* o, uint width, uint64_t* scratch) {
+  uint64_t* cur = scratch;
+  uint64_t* next = scratch+width;
+  std::copy(a,a+width,cur);
+  uint64_t fill = op==PrimOps::OP_dashr ? a[width-1] : 0;
+  for (uint k=0; k<width; ++k) {
+    uint64_t s = b[k];
+    if (!s) continue;
+    uint64_t amt = 1ULL << k;
+    for (uint i=0; i<width; ++i) {
+      uint64_t v;
+      if (op==PrimOps::OP_dshl) v = i>=amt ? cur[i-amt] : 0;
+      else v = (amt<width && i+amt<width) ? cur[i+amt] : fill;
+      next[i] = (s & v) | (~s & cur[i]);
+    }
+    std::swap(cur,next);
+  }
+  std::copy(cur,cur+width,o);
+}
+
+//Shift and add. scratch has 2*width words
+void mulBits(const uint64_t* a, const uint64_t* b, uint64_t* o, uint width, uint64_t* scratch) {
+  uint64_t* acc = scratch;
+  uint64_t* partial = scratch+width;
+  std::fill(acc,acc+width,0);
+  for (uint j=0; j<width; ++j) {
+    if (!b[j]) continue;
+    for (uint i=0; i<width; ++i) partial[i] = i>=j ? (a[i-j] & b[j]) : 0;
+    addBits(acc,partial,0,acc,width);
+  }
+  std::copy(acc,acc+width,o);
+}
+
+}
+
+BitParallelSimulator::BitParallelSimulator(SimGraph* g) : Simulator(g) {
+  uint total = 1;
+  for (auto& slot : g->slots) {
+    slotWords.push_back(total);
+    total += slot.width;
+  }
+  words.assign(total,0);
+  auto bitWords = [this](const SimInput& in) {
+    vector<uint> ret(in.width,0);
+    for (auto& seg : in.segs) {
+      for (uint k=0; k<seg.len; ++k) ret[seg.dstLo+k] = slotWords[seg.slot]+seg.srcLo+k;
+    }
+    return ret;
+  };
+  uint regBits = 0, numOpnds = 0, maxWidth = 0;
+  for (auto& n : g->nodes) {
+    inWords.push_back(vector<vector<uint>>());
+    opndFirst.push_back(numOpnds);
+    for (auto& in : n.ins) {
+      inWords.back().push_back(bitWords(in));
+      numOpnds += in.width;
+    }
+    if (n.kind==NK_Reg) regBits += n.width;
+    if (n.kind==NK_Op) maxWidth = std::max(maxWidth,n.width);
+  }
+  for (auto& out : g->outputs) outWords.push_back(bitWords(out));
+  regNext.assign(regBits,0);
+  opndWords.assign(numOpnds,0);
+  scratch.assign(2*maxWidth,0);
+  reset();
+}
+
+void BitParallelSimulator::reset() {
+  vector<vector<uint64_t>> ins;
+  for (auto slot : g->inputs) {
+    uint64_t* w = &words[slotWords[slot]];
+    ins.push_back(vector<uint64_t>(w,w+g->slots[slot].width));
+  }
+  std::fill(words.begin(),words.end(),0);
+  for (uint i=0; i<ins.size(); ++i) {
+    std::copy(ins[i].begin(),ins[i].end(),&words[slotWords[g->inputs[i]]]);
+  }
+  mems.assign(g->numMems,vector<uint64_t>());
+  memPtrs.assign(g->numMems,0);
+  memCounts.assign(g->numMems,0);
+  for (auto& n : g->nodes) {
+    if (n.kind==NK_Reg) {
+      uint64_t* o = &words[slotWords[n.outs[0]]];
+      for (uint i=0; i<n.width; ++i) o[i] = spread(n.value,i);
+    }
+    if (n.kind==NK_Mem) mems[n.mem].assign(n.depth*n.width,0);
+  }
+  cycle = 0;
+  dirty = true;
+}
+
+void BitParallelSimulator::getState(SimState& s) {
+  eval();
+  s.slots.resize(g->slots.size());
+  for (uint slot=0; slot<g->slots.size(); ++slot) {
+    s.slots[slot] = getLane(&words[slotWords[slot]],g->slots[slot].width,0);
+  }
+  s.mems.assign(g->numMems,vector<uint64_t>());
+  for (auto& n : g->nodes) {
+    if (n.kind!=NK_Mem) continue;
+    for (uint a=0; a<n.depth; ++a) {
+      s.mems[n.mem].push_back(getLane(&mems[n.mem][a*n.width],n.width,0));
+    }
+  }
+  s.memPtrs = memPtrs;
+  s.memCounts = memCounts;
+  s.cycle = cycle;
+}
+
+void BitParallelSimulator::setState(const SimState& s) {
+  for (uint slot=0; slot<g->slots.size(); ++slot) {
+    uint64_t* w = &words[slotWords[slot]];
+    for (uint i=0; i<g->slots[slot].width; ++i) w[i] = spread(s.slots[slot],i);
+  }
+  for (auto& n : g->nodes) {
+    if (n.kind!=NK_Mem) continue;
+    for (uint a=0; a<n.depth; ++a) {
+      uint64_t* row = &mems[n.mem][a*n.width];
+      for (uint i=0; i<n.width; ++i) row[i] = spread(s.mems[n.mem][a],i);
+    }
+  }
+  memPtrs = s.memPtrs;
+  memCounts = s.memCounts;
+  cycle = s.cycle;
+  dirty = true;
+}
+
+void BitParallelSimulator::setInput(uint idx, uint64_t v) {
+  uint slot = g->inputs[idx];
+  uint64_t* w = &words[slotWords[slot]];
+  for (uint i=0; i<g->slots[slot].width; ++i) w[i] = spread(v,i);
+  dirty = true;
+}
+
+void BitParallelSimulator::setInputLane(uint idx, uint lane, uint64_t v) {
+  ASSERT(lane<numLanes,"Lane " + to_string(lane) + " out of range");
+  uint slot = g->inputs[idx];
+  setLane(&words[slotWords[slot]],g->slots[slot].width,lane,v);
+  dirty = true;
+}
+
+uint64_t BitParallelSimulator::getOutputLane(uint idx, uint lane) {
+  ASSERT(lane<numLanes,"Lane " + to_string(lane) + " out of range");
+  eval();
+  uint64_t v = 0;
+  const vector<uint>& bits = outWords[idx];
+  for (uint i=0; i<bits.size(); ++i) v |= ((words[bits[i]]>>lane) & 1) << i;
+  return v;
+}
+
+uint64_t BitParallelSimulator::getSlotLane(uint slot, uint lane) {
+  ASSERT(lane<numLanes,"Lane " + to_string(lane) + " out of range");
+  eval();
+  return getLane(&words[slotWords[slot]],g->slots[slot].width,lane);
+}
+
+void BitParallelSimulator::gather(uint nid, uint num, const uint64_t** opnds) {
+  uint64_t* p = &opndWords[opndFirst[nid]];
+  for (uint k=0; k<num; ++k) {
+    opnds[k] = p;
+    for (auto word : inWords[nid][k]) *p++ = words[word];
+  }
+}
+
+void BitParallelSimulator::evalOp(const SimNode& n, uint nid) {
+  using namespace PrimOps;
+  uint w = n.width;
+  const uint64_t* opnds[3] = {nullptr,nullptr,nullptr};
+  gather(nid,n.ins.size(),opnds);
+  const uint64_t* a = opnds[0];
+  const uint64_t* b = opnds[1];
+  uint64_t* o = &words[slotWords[n.outs[0]]];
+  switch (n.op) {
+    case OP_not : for (uint i=0; i<w; ++i) o[i] = ~a[i]; break;
+    case OP_and : for (uint i=0; i<w; ++i) o[i] = a[i] & b[i]; break;
+    case OP_or : for (uint i=0; i<w; ++i) o[i] = a[i] | b[i]; break;
+    case OP_xor : for (uint i=0; i<w; ++i) o[i] = a[i] ^ b[i]; break;
+    case OP_andr : {
+      uint64_t v = ~0ULL;
+      for (uint i=0; i<w; ++i) v &= a[i];
+      o[0] = v;
+      break;
+    }
+    case OP_orr : {
+      uint64_t v = 0;
+      for (uint i=0; i<w; ++i) v |= a[i];
+      o[0] = v;
+      break;
+    }
+    case OP_xorr : {
+      uint64_t v = 0;
+      for (uint i=0; i<w; ++i) v ^= a[i];
+      o[0] = v;
+      break;
+    }
+    case OP_mux : {
+      uint64_t sel = opnds[2][0];
+      for (uint i=0; i<w; ++i) o[i] = (sel & b[i]) | (~sel & a[i]);
+      break;
+    }
+    case OP_add : addBits(a,b,0,o,w); break;
+    case OP_sub : {
+      uint64_t* nb = scratch.data();
+      for (uint i=0; i<w; ++i) nb[i] = ~b[i];
+      addBits(a,nb,~0ULL,o,w);
+      break;
+    }
+    case OP_neg : {
+      uint64_t* na = scratch.data();
+      uint64_t* zero = na+w;
+      for (uint i=0; i<w; ++i) na[i] = ~a[i];
+      std::fill(zero,zero+w,0);
+      addBits(zero,na,~0ULL,o,w);
+      break;
+    }
+    case OP_mul : mulBits(a,b,o,w,scratch.data()); break;
+    case OP_dshl :
+    case OP_dlshr :
+    case OP_dashr : shiftBits(n.op,a,b,o,w,scratch.data()); break;
+    case OP_eq : {
+      uint64_t v = ~0ULL;
+      for (uint i=0; i<w; ++i) v &= ~(a[i] ^ b[i]);
+      o[0] = v;
+      break;
+    }
+    case OP_uge : o[0] = uge(a,b,w); break;
+    case OP_ult : o[0] = ~uge(a,b,w); break;
+    case OP_ule : o[0] = uge(b,a,w); break;
+    case OP_ugt : o[0] = ~uge(b,a,w); break;
+    case OP_sge : o[0] = sge(a,b,w,scratch.data()); break;
+    case OP_slt : o[0] = ~sge(a,b,w,scratch.data()); break;
+    case OP_sle : o[0] = sge(b,a,w,scratch.data()); break;
+    case OP_sgt : o[0] = ~sge(b,a,w,scratch.data()); break;
+    default : {
+      //Divides and remainders one lane at a time
+      uint outWidth = hasBitOutput(n.op) ? 1 : w;
+      std::fill(o,o+outWidth,0);
+      for (uint lane=0; lane<numLanes; ++lane) {
+        uint64_t v = PrimOps::eval(n.op,w,getLane(a,w,lane),getLane(b,w,lane));
+        for (uint i=0; i<outWidth; ++i) o[i] |= ((v>>i) & 1) << lane;
+      }
+    }
+  }
+}
+
+void BitParallelSimulator::evalMem(const SimNode& n, uint nid) {
+  const vector<uint64_t>& mem = mems[n.mem];
+  uint64_t* rdata = &words[slotWords[n.outs[0]]];
+  if (n.linebuffer) {
+    std::copy(&mem[memPtrs[n.mem]*n.width],&mem[(memPtrs[n.mem]+1)*n.width],rdata);
+    words[slotWords[n.outs[1]]] = memCounts[n.mem]==0 ? ~0ULL : 0;
+    words[slotWords[n.outs[2]]] = memCounts[n.mem]==n.depth ? ~0ULL : 0;
+    return;
+  }
+  //Every lane reads its own address
+  const uint64_t* addr;
+  gather(nid,1,&addr);
+  uint addrWidth = n.ins[0].width;
+  std::fill(rdata,rdata+n.width,0);
+  for (uint lane=0; lane<numLanes; ++lane) {
+    const uint64_t* row = &mem[(getLane(addr,addrWidth,lane) % n.depth)*n.width];
+    for (uint i=0; i<n.width; ++i) rdata[i] |= row[i] & (1ULL << lane);
+  }
+}
+
+void BitParallelSimulator::eval() {
+  if (!dirty) return;
+  for (auto nid : g->combOrder) {
+    const SimNode& n = g->nodes[nid];
+    switch (n.kind) {
+      case NK_Op : evalOp(n,nid); break;
+      case NK_Const : {
+        uint64_t* o = &words[slotWords[n.outs[0]]];
+        for (uint i=0; i<n.width; ++i) o[i] = spread(n.value,i);
+        break;
+      }
+      case NK_Mem : evalMem(n,nid); break;
+      default : ASSERT(0,"Not a combinational node: " + n.path);
+    }
+  }
+  dirty = false;
+}
+
+void BitParallelSimulator::step(uint num) {
+  for (uint c=0; c<num; ++c) {
+    eval();
+    //Registers only read words, which do not change until the commit below
+    uint r = 0;
+    for (auto nid : g->seqNodes) {
+      const SimNode& n = g->nodes[nid];
+      const vector<vector<uint>>& ins = inWords[nid];
+      if (n.kind==NK_Reg) {
+        const uint64_t* cur = &words[slotWords[n.outs[0]]];
+        uint64_t en = n.en ? words[ins[1][0]] : ~0ULL;
+        uint64_t clr = n.clr ? words[ins[2][0]] : 0;
+        //rst is active low
+        uint64_t rst = n.rst ? ~words[ins[3][0]] : 0;
+        for (uint i=0; i<n.width; ++i) {
+          uint64_t init = spread(n.value,i);
+          uint64_t v = (clr & init) | (~clr & words[ins[0][i]]);
+          v = (en & v) | (~en & cur[i]);
+          regNext[r++] = (rst & init) | (~rst & v);
+        }
+        continue;
+      }
+      vector<uint64_t>& mem = mems[n.mem];
+      if (n.linebuffer) {
+        uint& ptr = memPtrs[n.mem];
+        for (uint i=0; i<n.width; ++i) mem[ptr*n.width+i] = words[ins[1][i]];
+        ptr = (ptr+1) % n.depth;
+        if (memCounts[n.mem]<n.depth) memCounts[n.mem]++;
+        continue;
+      }
+      uint64_t wen = words[ins[2][0]];
+      if (!wen) continue;
+      const uint64_t* addr;
+      gather(nid,1,&addr);
+      uint addrWidth = n.ins[0].width;
+      for (uint lane=0; lane<numLanes; ++lane) {
+        uint64_t bit = 1ULL << lane;
+        if (!(wen & bit)) continue;
+        uint64_t* row = &mem[(getLane(addr,addrWidth,lane) % n.depth)*n.width];
+        for (uint i=0; i<n.width; ++i) row[i] = (row[i] & ~bit) | (words[ins[1][i]] & bit);
+      }
+    }
+    r = 0;
+    for (auto nid : g->seqNodes) {
+      const SimNode& n = g->nodes[nid];
+      if (n.kind!=NK_Reg) continue;
+      uint64_t* o = &words[slotWords[n.outs[0]]];
+      for (uint i=0; i<n.width; ++i) o[i] = regNext[r++];
+    }
+    cycle++;
+    dirty = true;
+  }
+}
@@ -0,0 +1,85 @@
+#include "coreir.h"
+#include "coreir-sim/checkpoint.h"
+#include "varint.hpp"
+#include <fstream>
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+namespace {
+const string checkpointMagic = "CCKPT1\n";
+}
+
+//  magic, design hash (8 bytes), then varints:
+//  number of slots, number of nodes, cycle,
+//  number of inputs, input values,
+//  number of registers, register values (in seqNodes order),
+//  number of memories, then per memory: depth, ptr, count, contents
+void Sim::saveCheckpoint(Simulator* sim, string filename) {
+  SimGraph* g = sim->getGraph();
+  SimState s;
+  sim->getState(s);
+  string buf = checkpointMagic;
+  putFixed64(buf,g->getHash());
+  putVarint(buf,g->slots.size());
+  putVarint(buf,g->nodes.size());
+  putVarint(buf,s.cycle);
+  putVarint(buf,g->inputs.size());
+  for (auto slot : g->inputs) putVarint(buf,s.slots[slot]);
+  vector<uint64_t> regs;
+  for (auto nid : g->seqNodes) {
+    const SimNode& n = g->nodes[nid];
+    if (n.kind==NK_Reg) regs.push_back(s.slots[n.outs[0]]);
+  }
+  putVarint(buf,regs.size());
+  for (auto v : regs) putVarint(buf,v);
+  putVarint(buf,s.mems.size());
+  for (uint m=0; m<s.mems.size(); ++m) {
+    putVarint(buf,s.mems[m].size());
+    putVarint(buf,s.memPtrs[m]);
+    putVarint(buf,s.memCounts[m]);
+    for (auto v : s.mems[m]) putVarint(buf,v);
+  }
+  std::ofstream fout(filename,std::ios::binary);
+  ASSERT(fout.is_open(),"Cannot open " + filename);
+  fout.write(buf.data(),buf.size());
+  ASSERT(fout.good(),"Cannot write " + filename);
+}
+
+void Sim::loadCheckpoint(Simulator* sim, string filename) {
+  SimGraph* g = sim->getGraph();
+  std::ifstream fin(filename,std::ios::binary);
+  ASSERT(fin.is_open(),"Cannot open " + filename);
+  std::ostringstream contents;
+  contents << fin.rdbuf();
+  string buf = contents.str();
+  ASSERT(buf.compare(0,checkpointMagic.size(),checkpointMagic)==0,filename + " is not a checkpoint");
+  size_t pos = checkpointMagic.size();
+  ASSERT(getFixed64(buf,pos)==g->getHash(),filename + " is a checkpoint of a different design");
+  ASSERT(getVarint(buf,pos)==g->slots.size() && getVarint(buf,pos)==g->nodes.size(),"Corrupt checkpoint " + filename);
+
+  SimState s(g);
+  s.cycle = getVarint(buf,pos);
+  ASSERT(getVarint(buf,pos)==g->inputs.size(),"Corrupt checkpoint " + filename);
+  for (auto slot : g->inputs) s.slots[slot] = getVarint(buf,pos);
+  uint numRegs = getVarint(buf,pos);
+  for (auto nid : g->seqNodes) {
+    const SimNode& n = g->nodes[nid];
+    if (n.kind!=NK_Reg) continue;
+    ASSERT(numRegs-->0,"Corrupt checkpoint " + filename);
+    s.slots[n.outs[0]] = getVarint(buf,pos);
+  }
+  ASSERT(numRegs==0 && getVarint(buf,pos)==s.mems.size(),"Corrupt checkpoint " + filename);
+  for (uint m=0; m<s.mems.size(); ++m) {
+    uint64_t depth = s.mems[m].size();
+    ASSERT(getVarint(buf,pos)==depth,"Corrupt checkpoint " + filename);
+    uint64_t ptr = getVarint(buf,pos);
+    uint64_t count = getVarint(buf,pos);
+    ASSERT(ptr<depth && count<=depth,"Corrupt checkpoint " + filename);
+    s.memPtrs[m] = ptr;
+    s.memCounts[m] = count;
+    for (auto& v : s.mems[m]) v = getVarint(buf,pos);
+  }
+  ASSERT(pos==buf.size(),"Corrupt checkpoint " + filename);
+  sim->setState(s);
+}
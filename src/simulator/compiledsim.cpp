@@ -0,0 +1,398 @@
+#include "coreir.h"
+#include "coreir-sim/compiledsim.h"
+#include <dlfcn.h>
+#include <fstream>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+namespace {
+
+//Bump whenever the generated code changes
+const string codegenVersion = "1";
+
+//Nodes per generated function. Keeps the compiler fast on big designs
+const uint chunkSize = 1024;
+
+const char* prelude =
+  "#include <stdint.h>\n"
+  "static inline int64_t sx(uint64_t v, unsigned w) {\n"
+  "  return w>=64 ? (int64_t) v : ((int64_t) (v<<(64-w)))>>(64-w);\n"
+  "}\n"
+  "static inline uint64_t dashr_(uint64_t a, uint64_t b, unsigned w, uint64_t m) {\n"
+  "  return (uint64_t) (sx(a,w) >> (b>=w ? w-1 : b)) & m;\n"
+  "}\n"
+  "static inline uint64_t sdiv_(uint64_t a, uint64_t b, unsigned w, uint64_t m) {\n"
+  "  int64_t sb = sx(b,w);\n"
+  "  if (sb==0) return m;\n"
+  "  if (sb==-1) return (0-a) & m;\n"
+  "  return (uint64_t) (sx(a,w)/sb) & m;\n"
+  "}\n"
+  "static inline uint64_t srem_(uint64_t a, uint64_t b, unsigned w, uint64_t m) {\n"
+  "  int64_t sb = sx(b,w);\n"
+  "  if (sb==0) return a;\n"
+  "  if (sb==-1) return 0;\n"
+  "  return (uint64_t) (sx(a,w)%sb) & m;\n"
+  "}\n"
+  "static inline uint64_t smod_(uint64_t a, uint64_t b, unsigned w, uint64_t m) {\n"
+  "  int64_t sb = sx(b,w);\n"
+  "  if (sb==0) return a;\n"
+  "  if (sb==-1) return 0;\n"
+  "  int64_t r = sx(a,w)%sb;\n"
+  "  if (r!=0 && ((r<0) != (sb<0))) r += sb;\n"
+  "  return (uint64_t) r & m;\n"
+  "}\n";
+
+string hexLit(uint64_t v) {
+  std::ostringstream os;
+  os << "0x" << std::hex << v << "ULL";
+  return os.str();
+}
+
+string cType(uint width) {
+  if (width<=8) return "uint8_t";
+  if (width<=16) return "uint16_t";
+  if (width<=32) return "uint32_t";
+  return "uint64_t";
+}
+
+//Inline expression of op (same semantics as PrimOps::eval)
+string opExpr(PrimOps::Op op, uint width, string a, string b, string c) {
+  using namespace PrimOps;
+  string m = hexLit(mask(width));
+  string w = to_string(width);
+  string hargs = "(" + a + "," + b + "," + w + "," + m + ")";
+  switch(op) {
+    case OP_not : return "(~" + a + " & " + m + ")";
+    case OP_neg : return "((0-" + a + ") & " + m + ")";
+    case OP_andr : return "(uint64_t) (" + a + "==" + m + ")";
+    case OP_orr : return "(uint64_t) (" + a + "!=0)";
+    case OP_xorr : return "(uint64_t) __builtin_parityll(" + a + ")";
+    case OP_and : return "(" + a + " & " + b + ")";
+    case OP_or : return "(" + a + " | " + b + ")";
+    case OP_xor : return "(" + a + " ^ " + b + ")";
+    case OP_dshl : return "(" + b + ">=" + w + " ? 0 : (" + a + "<<" + b + ") & " + m + ")";
+    case OP_dlshr : return "(" + b + ">=" + w + " ? 0 : " + a + ">>" + b + ")";
+    case OP_dashr : return "dashr_" + hargs;
+    case OP_add : return "((" + a + "+" + b + ") & " + m + ")";
+    case OP_sub : return "((" + a + "-" + b + ") & " + m + ")";
+    case OP_mul : return "((" + a + "*" + b + ") & " + m + ")";
+    case OP_udiv : return "(" + b + "==0 ? " + m + " : " + a + "/" + b + ")";
+    case OP_urem : return "(" + b + "==0 ? " + a + " : " + a + "%" + b + ")";
+    case OP_sdiv : return "sdiv_" + hargs;
+    case OP_srem : return "srem_" + hargs;
+    case OP_smod : return "smod_" + hargs;
+    case OP_eq : return "(uint64_t) (" + a + "==" + b + ")";
+    case OP_slt : return "(uint64_t) (sx(" + a + "," + w + ") < sx(" + b + "," + w + "))";
+    case OP_sgt : return "(uint64_t) (sx(" + a + "," + w + ") > sx(" + b + "," + w + "))";
+    case OP_sle : return "(uint64_t) (sx(" + a + "," + w + ") <= sx(" + b + "," + w + "))";
+    case OP_sge : return "(uint64_t) (sx(" + a + "," + w + ") >= sx(" + b + "," + w + "))";
+    case OP_ult : return "(uint64_t) (" + a + " < " + b + ")";
+    case OP_ugt : return "(uint64_t) (" + a + " > " + b + ")";
+    case OP_ule : return "(uint64_t) (" + a + " <= " + b + ")";
+    case OP_uge : return "(uint64_t) (" + a + " >= " + b + ")";
+    case OP_mux : return "((" + c + " & 1) ? " + b + " : " + a + ")";
+    default : ASSERT(0,"Cannot compile op " + op2Str(op));
+  }
+  return "";
+}
+
+class CodeGen {
+  SimGraph* g;
+  std::ostream& os;
+  //Slots held in a local of the current function
+  vector<char> local;
+  public :
+    CodeGen(SimGraph* g, std::ostream& os) : g(g), os(os) {
+      local.assign(g->slots.size(),0);
+    }
+    void run();
+  private :
+    string ref(uint slot) {
+      if (local[slot]) return "(uint64_t) n" + to_string(slot);
+      return "s[" + to_string(slot) + "]";
+    }
+    string read(const SimInput& in) {
+      if (in.direct>=0) return ref(in.direct);
+      if (in.segs.empty()) return "0ULL";
+      string ret;
+      for (auto& seg : in.segs) {
+        if (ret!="") ret += " | ";
+        string v = ref(seg.slot);
+        if (seg.srcLo) v = "(" + v + ">>" + to_string(seg.srcLo) + ")";
+        v = "(" + v + " & " + hexLit(PrimOps::mask(seg.len)) + ")";
+        if (seg.dstLo) v = "(" + v + "<<" + to_string(seg.dstLo) + ")";
+        ret += v;
+      }
+      return "(" + ret + ")";
+    }
+    void define(uint slot, string expr) {
+      os << "  const " << cType(g->slots[slot].width) << " n" << slot << " = " << expr << ";\n";
+      os << "  s[" << slot << "] = n" << slot << ";\n";
+      local[slot] = 1;
+    }
+    void evalNode(const SimNode& n);
+    void clockNode(const SimNode& n, uint regIdx);
+};
+
+void CodeGen::evalNode(const SimNode& n) {
+  os << "  //" << n.path << "\n";
+  switch (n.kind) {
+    case NK_Op : {
+      string a = read(n.ins[0]);
+      string b = n.ins.size()>1 ? read(n.ins[1]) : "0ULL";
+      string c = n.ins.size()>2 ? read(n.ins[2]) : "0ULL";
+      define(n.outs[0],opExpr(n.op,n.width,a,b,c));
+      break;
+    }
+    case NK_Const :
+      define(n.outs[0],hexLit(n.value));
+      break;
+    case NK_Mem : {
+      string m = to_string(n.mem);
+      if (n.linebuffer) {
+        define(n.outs[0],"mem[" + m + "][ptr[" + m + "]]");
+        define(n.outs[1],"(uint64_t) (cnt[" + m + "]==0)");
+        define(n.outs[2],"(uint64_t) (cnt[" + m + "]==" + to_string(n.depth) + ")");
+      }
+      else {
+        define(n.outs[0],"mem[" + m + "][" + read(n.ins[0]) + " % " + to_string(n.depth) + "]");
+      }
+      break;
+    }
+    default :
+      ASSERT(0,"Not a combinational node: " + n.path);
+  }
+}
+
+void CodeGen::clockNode(const SimNode& n, uint regIdx) {
+  os << "  //" << n.path << "\n";
+  if (n.kind==NK_Reg) {
+    string init = hexLit(n.value);
+    os << "  {\n";
+    os << "    uint64_t v = " << ref(n.outs[0]) << ";\n";
+    //en ? (clr ? init : in) : out
+    string next = read(n.ins[0]);
+    if (n.clr) next = "((" + read(n.ins[2]) + " & 1) ? " + init + " : " + next + ")";
+    if (n.en) {
+      os << "    if (" << read(n.ins[1]) << " & 1) v = " << next << ";\n";
+    }
+    else {
+      os << "    v = " << next << ";\n";
+    }
+    //rst is active low
+    if (n.rst) os << "    if (!(" << read(n.ins[3]) << " & 1)) v = " << init << ";\n";
+    os << "    t[" << regIdx << "] = v;\n";
+    os << "  }\n";
+    return;
+  }
+  //Memory writes do not affect anything read during the clock edge
+  string m = to_string(n.mem);
+  string wdata = read(n.ins[1]);
+  if (n.linebuffer) {
+    os << "  mem[" << m << "][ptr[" << m << "]] = " << wdata << ";\n";
+    os << "  ptr[" << m << "] = (ptr[" << m << "]+1) % " << n.depth << ";\n";
+    os << "  if (cnt[" << m << "]<" << n.depth << ") cnt[" << m << "]++;\n";
+  }
+  else {
+    os << "  if (" << read(n.ins[2]) << " & 1) mem[" << m << "][" << read(n.ins[0]) << " % " << n.depth << "] = " << wdata << ";\n";
+  }
+}
+
+void CodeGen::run() {
+  string params = "(uint64_t* s, uint64_t* const* mem, unsigned* ptr, unsigned* cnt, uint64_t* t)";
+  os << "//Generated by coreir-sim for " << g->getTop()->getRefName() << "\n";
+  os << prelude;
+  os << "extern \"C\" {\n";
+  os << "unsigned coreir_sim_num_slots = " << g->slots.size() << ";\n";
+  os << "unsigned coreir_sim_num_nodes = " << g->nodes.size() << ";\n";
+  os << "}\n\n";
+
+  //Combinational logic in level order
+  uint numEval = 0;
+  for (uint i=0; i<g->combOrder.size(); i+=chunkSize) {
+    local.assign(g->slots.size(),0);
+    os << "static void eval" << numEval++ << params << " {\n";
+    for (uint j=i; j<std::min(i+chunkSize,(uint) g->combOrder.size()); ++j) {
+      evalNode(g->nodes[g->combOrder[j]]);
+    }
+    os << "}\n\n";
+  }
+
+  //Next values of the registers go to t, then they are all committed
+  local.assign(g->slots.size(),0);
+  uint numClock = 0;
+  vector<uint> regOuts;
+  for (uint i=0; i<g->seqNodes.size(); i+=chunkSize) {
+    os << "static void clock" << numClock++ << params << " {\n";
+    for (uint j=i; j<std::min(i+chunkSize,(uint) g->seqNodes.size()); ++j) {
+      const SimNode& n = g->nodes[g->seqNodes[j]];
+      clockNode(n,regOuts.size());
+      if (n.kind==NK_Reg) regOuts.push_back(n.outs[0]);
+    }
+    os << "}\n\n";
+  }
+  os << "static const unsigned regOuts[" << std::max((size_t) 1,regOuts.size()) << "] = {";
+  for (uint i=0; i<regOuts.size(); ++i) os << (i ? "," : "") << regOuts[i];
+  os << "};\n\n";
+
+  os << "extern \"C\" void coreir_sim_eval" << params << " {\n";
+  for (uint i=0; i<numEval; ++i) os << "  eval" << i << "(s,mem,ptr,cnt,t);\n";
+  os << "}\n\n";
+  os << "extern \"C\" void coreir_sim_clock" << params << " {\n";
+  for (uint i=0; i<numClock; ++i) os << "  clock" << i << "(s,mem,ptr,cnt,t);\n";
+  os << "  for (unsigned i=0; i<" << regOuts.size() << "; ++i) s[regOuts[i]] = t[i];\n";
+  os << "}\n";
+}
+
+//Writes text to filename atomically (readers never see a partial file)
+void writeAtomic(string filename, const string& text) {
+  std::ostringstream tmp;
+  tmp << filename << ".tmp" << getpid() << "_" << std::this_thread::get_id();
+  {
+    std::ofstream fout(tmp.str());
+    ASSERT(fout.is_open(),"Cannot open file: " + tmp.str());
+    fout << text;
+  }
+  std::rename(tmp.str().c_str(),filename.c_str());
+}
+
+bool fileExists(string filename) {
+  struct stat st;
+  return lstat(filename.c_str(),&st)==0;
+}
+
+//Creates dir and its missing parents (only accessible by the user)
+void makeDirs(string dir) {
+  for (size_t pos=dir.find('/',1); pos!=string::npos; pos=dir.find('/',pos+1)) {
+    mkdir(dir.substr(0,pos).c_str(),0700);
+  }
+  mkdir(dir.c_str(),0700);
+}
+
+//Anything loaded into the process has to be a plain file or directory
+//(not a symlink) of the user that nobody else can write
+void checkPrivate(string path, bool isDir) {
+  struct stat st;
+  ASSERT(lstat(path.c_str(),&st)==0,"Cannot stat " + path);
+  bool kind = isDir ? S_ISDIR(st.st_mode) : S_ISREG(st.st_mode);
+  ASSERT(kind,path + " is not a " + (isDir ? "directory" : "regular file"));
+  ASSERT(st.st_uid==geteuid(),path + " is not owned by the current user");
+  ASSERT(!(st.st_mode & (S_IWGRP | S_IWOTH)),path + " is writable by other users");
+}
+
+//Single quoted for the shell
+string shellQuote(const string& s) {
+  string ret = "'";
+  for (auto ch : s) {
+    if (ch=='\'') ret += "'\\''";
+    else ret += ch;
+  }
+  return ret + "'";
+}
+
+}
+
+void Sim::writeSimCode(SimGraph* g, std::ostream& os) {
+  CodeGen(g,os).run();
+}
+
+string Sim::defaultSimCacheDir() {
+  const char* dir = getenv("COREIR_SIM_CACHE");
+  if (dir && *dir) return string(dir);
+  const char* xdg = getenv("XDG_CACHE_HOME");
+  if (xdg && *xdg) return string(xdg) + "/coreir-sim";
+  const char* home = getenv("HOME");
+  if (home && *home) return string(home) + "/.cache/coreir-sim";
+  return "/tmp/coreir-sim-cache-" + to_string(geteuid());
+}
+
+CompiledSimulator::CompiledSimulator(SimGraph* g, string cacheDir) : Simulator(g), state(g) {
+  const char* envCxx = getenv("CXX");
+  string cxx = envCxx ? string(envCxx) : "c++";
+  string flags = "-O1 -shared -fPIC";
+
+  //Identical designs generate identical code
+  uint64_t key = stableHash(codegenVersion + ":" + cxx + " " + flags,g->getHash());
+  makeDirs(cacheDir);
+  checkPrivate(cacheDir,true);
+  string base = cacheDir + "/sim-" + hash2Str(key);
+  libName = base + ".so";
+  cached = fileExists(libName);
+  if (!cached) {
+    std::ostringstream code;
+    writeSimCode(g,code);
+    writeAtomic(base + ".cpp",code.str());
+    std::ostringstream tmpLib;
+    tmpLib << base << ".tmp" << getpid() << "_" << std::this_thread::get_id() << ".so";
+    string cmd = cxx + " " + flags + " -o " + shellQuote(tmpLib.str()) + " " + shellQuote(base + ".cpp");
+    ASSERT(std::system(cmd.c_str())==0,"Failed to compile the simulation: " + cmd);
+    std::rename(tmpLib.str().c_str(),libName.c_str());
+  }
+
+  checkPrivate(libName,false);
+  handle = dlopen(libName.c_str(),RTLD_NOW | RTLD_LOCAL);
+  ASSERT(handle,"Cannot open " + libName + ": " + string(dlerror()));
+  evalFun = (SimFun) dlsym(handle,"coreir_sim_eval");
+  clockFun = (SimFun) dlsym(handle,"coreir_sim_clock");
+  unsigned* numSlots = (unsigned*) dlsym(handle,"coreir_sim_num_slots");
+  unsigned* numNodes = (unsigned*) dlsym(handle,"coreir_sim_num_nodes");
+  ASSERT(evalFun && clockFun && numSlots && numNodes,"Bad simulation library " + libName);
+  ASSERT(*numSlots==g->slots.size() && *numNodes==g->nodes.size(),"Simulation library " + libName + " does not match the design");
+
+  for (auto& mem : state.mems) memData.push_back(mem.data());
+  regNext.assign(g->seqNodes.size(),0);
+}
+
+void CompiledSimulator::reset() {
+  state.reset(g);
+  memData.clear();
+  for (auto& mem : state.mems) memData.push_back(mem.data());
+  dirty = true;
+}
+
+void CompiledSimulator::getState(SimState& s) {
+  eval();
+  s = state;
+}
+
+void CompiledSimulator::setState(const SimState& s) {
+  state = s;
+  memData.clear();
+  for (auto& mem : state.mems) memData.push_back(mem.data());
+  dirty = true;
+}
+
+CompiledSimulator::~CompiledSimulator() {
+  if (handle) dlclose(handle);
+}
+
+void CompiledSimulator::setInput(uint idx, uint64_t v) {
+  state.slots[g->inputs[idx]] = v & PrimOps::mask(g->slots[g->inputs[idx]].width);
+  dirty = true;
+}
+
+uint64_t CompiledSimulator::getOutput(uint idx) {
+  eval();
+  return readInput(g->outputs[idx],state.slots.data());
+}
+
+void CompiledSimulator::eval() {
+  if (!dirty) return;
+  evalFun(state.slots.data(),memData.data(),state.memPtrs.data(),state.memCounts.data(),regNext.data());
+  dirty = false;
+}
+
+void CompiledSimulator::step(uint n) {
+  for (uint i=0; i<n; ++i) {
+    eval();
+    clockFun(state.slots.data(),memData.data(),state.memPtrs.data(),state.memCounts.data(),regNext.data());
+    state.cycle++;
+    dirty = true;
+  }
+}
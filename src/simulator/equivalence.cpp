@@ -0,0 +1,124 @@
+#include "coreir.h"
+#include "coreir-sim/equivalence.h"
+#include "coreir-sim/bitparallelsim.h"
+#include <random>
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+namespace {
+
+string flatName(string name) {
+  std::replace(name.begin(),name.end(),'.','_');
+  return name;
+}
+
+//For every name of a, the index of the same (or flattened) name in b.
+//Returns the first name without a match
+string matchNames(const vector<string>& a, const vector<string>& b, vector<uint>& aToB) {
+  unordered_map<string,uint> bMap;
+  for (uint i=0; i<b.size(); ++i) bMap[flatName(b[i])] = i;
+  if (bMap.size()!=b.size()) return "names that clash when flattened";
+  aToB.clear();
+  for (auto name : a) {
+    auto it = bMap.find(flatName(name));
+    if (it==bMap.end()) return name;
+    aToB.push_back(it->second);
+  }
+  return "";
+}
+
+//Top level ports are under self, cgralib.IO pins are named by instance path
+SelectPath outputPath(SimGraph* g, uint idx) {
+  string name = g->outputNames[idx];
+  SelectPath path = splitString<SelectPath>(name,'.');
+  RecordType* rt = cast<RecordType>(g->getTop()->getType());
+  if (rt->getRecord().count(path[0])) path.push_front("self");
+  return path;
+}
+
+}
+
+EquivResult Sim::checkEquivalence(Module* a, Module* b, EquivOptions opts) {
+  EquivResult res;
+  SimGraph ga(a);
+  SimGraph gb(b);
+  vector<uint> inMap, outMap;
+  string missing = matchNames(ga.inputNames,gb.inputNames,inMap);
+  if (missing=="" && ga.inputs.size()!=gb.inputs.size()) missing = "(" + b->getRefName() + " has more inputs)";
+  if (missing!="") {
+    res.equivalent = false;
+    res.error = "No matching input for " + missing;
+    return res;
+  }
+  missing = matchNames(ga.outputNames,gb.outputNames,outMap);
+  if (missing=="" && ga.outputs.size()!=gb.outputs.size()) missing = "(" + b->getRefName() + " has more outputs)";
+  if (missing!="") {
+    res.equivalent = false;
+    res.error = "No matching output for " + missing;
+    return res;
+  }
+  for (uint i=0; i<inMap.size(); ++i) {
+    if (ga.slots[ga.inputs[i]].width!=gb.slots[gb.inputs[inMap[i]]].width) {
+      res.equivalent = false;
+      res.error = "Input " + ga.inputNames[i] + " has different widths";
+      return res;
+    }
+  }
+  for (uint i=0; i<outMap.size(); ++i) {
+    if (ga.outputs[i].width!=gb.outputs[outMap[i]].width) {
+      res.equivalent = false;
+      res.error = "Output " + ga.outputNames[i] + " has different widths";
+      return res;
+    }
+  }
+
+  BitParallelSimulator simA(&ga);
+  BitParallelSimulator simB(&gb);
+  uint numLanes = simA.getNumLanes();
+  uint numIns = ga.inputs.size();
+  vector<uint64_t> masks;
+  for (auto slot : ga.inputs) masks.push_back(PrimOps::mask(ga.slots[slot].width));
+  for (uint run=0; run<opts.runs; ++run) {
+    std::mt19937_64 rng(opts.seed+run);
+    simA.reset();
+    simB.reset();
+    for (uint cycle=0; cycle<opts.cycles; ++cycle) {
+      for (uint lane=0; lane<numLanes; ++lane) {
+        for (uint idx=0; idx<numIns; ++idx) {
+          uint64_t v = rng() & masks[idx];
+          simA.setInputLane(idx,lane,v);
+          simB.setInputLane(inMap[idx],lane,v);
+        }
+      }
+      for (uint lane=0; lane<numLanes; ++lane) {
+        for (uint idx=0; idx<ga.outputs.size(); ++idx) {
+          uint64_t va = simA.getOutputLane(idx,lane);
+          uint64_t vb = simB.getOutputLane(outMap[idx],lane);
+          if (va==vb) continue;
+          res.equivalent = false;
+          res.cycle = cycle;
+          res.output = outputPath(&ga,idx);
+          res.valueA = va;
+          res.valueB = vb;
+          //Replay the stimulus of the lane (drawn cycle by cycle, lane by
+          //lane and input by input)
+          std::mt19937_64 replay(opts.seed+run);
+          res.stimulus.assign(cycle+1,vector<uint64_t>(numIns));
+          for (uint c=0; c<=cycle; ++c) {
+            for (uint l=0; l<numLanes; ++l) {
+              for (uint idx=0; idx<numIns; ++idx) {
+                uint64_t v = replay() & masks[idx];
+                if (l==lane) res.stimulus[c][idx] = v;
+              }
+            }
+          }
+          return res;
+        }
+      }
+      simA.step();
+      simB.step();
+    }
+  }
+  return res;
+}
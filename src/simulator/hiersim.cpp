@@ -0,0 +1,418 @@
+#include "coreir.h"
+#include "coreir-sim/hiersim.h"
+#include <map>
+#include <algorithm>
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+namespace {
+void remap(SimInput& in, const vector<uint>& slotMap) {
+  for (auto& seg : in.segs) seg.slot = slotMap[seg.slot];
+  if (in.direct>=0) in.direct = slotMap[in.direct];
+}
+
+//in reads the slots of in0 plus k
+bool isShifted(const SimInput& in, const SimInput& in0, uint k) {
+  if (in.segs.size()!=in0.segs.size() || (in.direct>=0)!=(in0.direct>=0)) return false;
+  for (uint i=0; i<in.segs.size(); ++i) {
+    const Segment& a = in.segs[i];
+    const Segment& b = in0.segs[i];
+    if (a.slot!=b.slot+k || a.srcLo!=b.srcLo || a.len!=b.len || a.dstLo!=b.dstLo) return false;
+  }
+  return true;
+}
+}
+
+HierSimulator::HierSimulator(SimGraph* g) : Simulator(g), outputs(g->outputs) {
+  elaborate();
+  reset();
+}
+
+//Every node of g is a primitive Instance (SimNode::inst) in one instance of
+//the module containing it, which is identified by the path of the node
+//without the name of the Instance. The nodes of an Instance become one
+//HierNode and the slots are renumbered module by module, node by node and
+//output by output, with the instances of the module next to each other.
+void HierSimulator::elaborate() {
+  uint numNodes = g->nodes.size();
+  //Instance of its module and HierNode of every node of g
+  vector<uint> instOf(numNodes);
+  vector<uint> nodeOf(numNodes);
+  unordered_map<ModuleDef*,uint> moduleIdx;
+  vector<unordered_map<string,uint>> paths;
+  unordered_map<Instance*,uint> nodeIdx;
+  for (uint nid=0; nid<numNodes; ++nid) {
+    const SimNode& n = g->nodes[nid];
+    ModuleDef* def = n.inst->getContainer();
+    auto mit = moduleIdx.find(def);
+    if (mit==moduleIdx.end()) {
+      mit = moduleIdx.emplace(def,modules.size()).first;
+      modules.push_back(HierModule());
+      modules.back().def = def;
+      paths.push_back(unordered_map<string,uint>());
+    }
+    uint m = mit->second;
+    string path = n.path.substr(0,n.path.size()-n.inst->getInstname().size());
+    auto pit = paths[m].emplace(path,modules[m].numInsts);
+    if (pit.second) modules[m].numInsts++;
+    instOf[nid] = pit.first->second;
+    auto nit = nodeIdx.find(n.inst);
+    if (nit==nodeIdx.end()) {
+      nit = nodeIdx.emplace(n.inst,nodes.size()).first;
+      modules[m].nodes.push_back(nodes.size());
+      nodes.push_back(HierNode());
+      nodes.back().proto = &n;
+      nodes.back().module = m;
+    }
+    nodeOf[nid] = nit->second;
+  }
+  //Node of g of every instance of every HierNode
+  const uint none = -1;
+  vector<vector<uint>> uses(nodes.size());
+  for (uint t=0; t<nodes.size(); ++t) uses[t].assign(modules[nodes[t].module].numInsts,none);
+  for (uint nid=0; nid<numNodes; ++nid) uses[nodeOf[nid]][instOf[nid]] = nid;
+  for (uint t=0; t<nodes.size(); ++t) {
+    for (auto nid : uses[t]) ASSERT(nid!=none,"Missing instance of " + nodes[t].proto->path);
+  }
+
+  slotMap.assign(g->slots.size(),none);
+  memMap.assign(g->numMems,none);
+  uint nextSlot = 0, nextMem = 0;
+  for (auto& mod : modules) {
+    for (auto t : mod.nodes) {
+      HierNode& h = nodes[t];
+      for (uint o=0; o<h.proto->outs.size(); ++o) {
+        h.outs.push_back(nextSlot);
+        for (uint k=0; k<mod.numInsts; ++k) slotMap[g->nodes[uses[t][k]].outs[o]] = nextSlot+k;
+        nextSlot += mod.numInsts;
+      }
+      if (h.proto->kind==NK_Mem) {
+        h.mem = nextMem;
+        for (uint k=0; k<mod.numInsts; ++k) memMap[g->nodes[uses[t][k]].mem] = nextMem+k;
+        nextMem += mod.numInsts;
+        mems.push_back(t);
+      }
+    }
+  }
+  for (uint slot=0; slot<slotMap.size(); ++slot) {
+    if (slotMap[slot]==none) slotMap[slot] = nextSlot++;
+  }
+
+  for (uint t=0; t<nodes.size(); ++t) {
+    HierNode& h = nodes[t];
+    uint numInsts = uses[t].size();
+    h.ins.assign(h.proto->ins.size(),HierInput());
+    for (uint j=0; j<h.ins.size(); ++j) {
+      HierInput& in = h.ins[j];
+      in.perInst.resize(numInsts);
+      in.shared = true;
+      for (uint k=0; k<numInsts; ++k) {
+        in.perInst[k] = g->nodes[uses[t][k]].ins[j];
+        remap(in.perInst[k],slotMap);
+        in.shared &= isShifted(in.perInst[k],in.perInst[0],k);
+      }
+      if (in.shared) {
+        in.in = in.perInst[0];
+        in.perInst.clear();
+      }
+    }
+  }
+  for (auto& out : outputs) remap(out,slotMap);
+  buildBatches(instOf,nodeOf);
+}
+
+//Combinational nodes are evaluated by level, which can differ between the
+//instances of a node. Registers are clocked all instances at once
+void HierSimulator::buildBatches(const vector<uint>& instOf, const vector<uint>& nodeOf) {
+  std::map<std::pair<uint,uint>,uint> index;
+  vector<vector<uint>> groups;
+  vector<uint> levels;
+  vector<uint> groupNodes;
+  for (auto nid : g->combOrder) {
+    auto key = std::make_pair(g->nodes[nid].level,nodeOf[nid]);
+    auto it = index.find(key);
+    if (it==index.end()) {
+      it = index.emplace(key,groups.size()).first;
+      groups.push_back(vector<uint>());
+      levels.push_back(key.first);
+      groupNodes.push_back(key.second);
+    }
+    groups[it->second].push_back(instOf[nid]);
+  }
+  vector<uint> sorted(groups.size());
+  for (uint i=0; i<sorted.size(); ++i) sorted[i] = i;
+  std::stable_sort(sorted.begin(),sorted.end(),[&](uint a, uint b) { return levels[a]<levels[b];});
+  for (auto i : sorted) {
+    std::sort(groups[i].begin(),groups[i].end());
+    SimBatch b;
+    b.node = groupNodes[i];
+    b.first = order.size();
+    b.size = groups[i].size();
+    order.insert(order.end(),groups[i].begin(),groups[i].end());
+    batches.push_back(b);
+  }
+  uint numRegs = 0;
+  for (uint t=0; t<nodes.size(); ++t) {
+    if (nodes[t].proto->kind!=NK_Reg) continue;
+    SimBatch b;
+    b.node = t;
+    b.first = order.size();
+    b.size = modules[nodes[t].module].numInsts;
+    for (uint k=0; k<b.size; ++k) order.push_back(k);
+    regBatches.push_back(b);
+    numRegs += b.size;
+  }
+  regNext.assign(numRegs,0);
+  for (auto bs : {&batches,&regBatches}) {
+    for (auto& b : *bs) setKernel(b);
+  }
+}
+
+//Kernels for the batches of ops reading whole slots
+void HierSimulator::setKernel(SimBatch& b) {
+  const HierNode& h = nodes[b.node];
+  const SimNode& n = *h.proto;
+  uint numOpnds = 0;
+  if (n.kind==NK_Op) {
+    numOpnds = n.ins.size();
+  }
+  else if (n.kind==NK_Reg && !n.en && !n.clr && !n.rst) {
+    numOpnds = 1;
+  }
+  //Outputs are written as one array
+  uint k0 = order[b.first];
+  b.kernel = numOpnds>0 && order[b.first+b.size-1]==k0+b.size-1;
+  for (uint j=0; j<numOpnds && b.kernel; ++j) {
+    const HierInput& in = h.ins[j];
+    if (in.shared) {
+      b.kernel &= in.in.direct>=0;
+      continue;
+    }
+    for (uint k=k0; k<k0+b.size; ++k) b.kernel &= in.perInst[k].direct>=0;
+  }
+  if (!b.kernel) return;
+  for (uint j=0; j<numOpnds; ++j) {
+    const HierInput& in = h.ins[j];
+    if (in.shared) {
+      b.base[j] = in.in.direct + k0;
+      continue;
+    }
+    bool consecutive = true;
+    for (uint k=k0; k<k0+b.size; ++k) {
+      uint slot = in.perInst[k].direct;
+      b.opnds[j].push_back(slot);
+      consecutive &= slot==b.opnds[j][0]+k-k0;
+    }
+    if (consecutive) {
+      b.base[j] = b.opnds[j][0];
+      b.opnds[j].clear();
+    }
+  }
+}
+
+void HierSimulator::reset() {
+  SimState s(g);
+  if (state.slots.size()==g->slots.size()) {
+    for (auto slot : g->inputs) s.slots[slot] = state.slots[slotMap[slot]];
+  }
+  setState(s);
+}
+
+void HierSimulator::getState(SimState& s) {
+  eval();
+  s = state;
+  for (uint slot=0; slot<g->slots.size(); ++slot) s.slots[slot] = state.slots[slotMap[slot]];
+  for (uint mem=0; mem<g->numMems; ++mem) {
+    s.mems[mem] = state.mems[memMap[mem]];
+    s.memPtrs[mem] = state.memPtrs[memMap[mem]];
+    s.memCounts[mem] = state.memCounts[memMap[mem]];
+  }
+}
+
+void HierSimulator::setState(const SimState& s) {
+  state = s;
+  for (uint slot=0; slot<g->slots.size(); ++slot) state.slots[slotMap[slot]] = s.slots[slot];
+  for (uint mem=0; mem<g->numMems; ++mem) {
+    state.mems[memMap[mem]] = s.mems[mem];
+    state.memPtrs[memMap[mem]] = s.memPtrs[mem];
+    state.memCounts[memMap[mem]] = s.memCounts[mem];
+  }
+  dirty = true;
+}
+
+void HierSimulator::setInput(uint idx, uint64_t v) {
+  uint slot = g->inputs[idx];
+  state.slots[slotMap[slot]] = v & PrimOps::mask(g->slots[slot].width);
+  dirty = true;
+}
+
+uint64_t HierSimulator::getOutput(uint idx) {
+  eval();
+  return readInput(outputs[idx],state.slots.data());
+}
+
+//Same as evalNode for instance k
+void HierSimulator::evalInst(const HierNode& h, uint k) {
+  const SimNode& n = *h.proto;
+  uint64_t* vals = state.slots.data();
+  switch (n.kind) {
+    case NK_Op : {
+      uint64_t a = read(h.ins[0],k);
+      uint64_t b = h.ins.size()>1 ? read(h.ins[1],k) : 0;
+      uint64_t c = h.ins.size()>2 ? read(h.ins[2],k) : 0;
+      vals[h.outs[0]+k] = PrimOps::eval(n.op,n.width,a,b,c);
+      break;
+    }
+    case NK_Const :
+      vals[h.outs[0]+k] = n.value;
+      break;
+    case NK_Mem : {
+      uint mem = h.mem+k;
+      const vector<uint64_t>& words = state.mems[mem];
+      if (n.linebuffer) {
+        uint count = state.memCounts[mem];
+        vals[h.outs[0]+k] = words[state.memPtrs[mem]];
+        vals[h.outs[1]+k] = count==0;
+        vals[h.outs[2]+k] = count==n.depth;
+      }
+      else {
+        vals[h.outs[0]+k] = words[read(h.ins[0],k) % n.depth];
+      }
+      break;
+    }
+    default :
+      ASSERT(0,"Not a combinational node: " + n.path);
+  }
+}
+
+//Same as clockNode for instance k
+uint64_t HierSimulator::clockInst(const HierNode& h, uint k) {
+  const SimNode& n = *h.proto;
+  if (n.kind==NK_Reg) {
+    uint64_t v = state.slots[h.outs[0]+k];
+    if (!n.en || (read(h.ins[1],k) & 1)) {
+      v = (n.clr && (read(h.ins[2],k) & 1)) ? n.value : read(h.ins[0],k);
+    }
+    if (n.rst && !(read(h.ins[3],k) & 1)) v = n.value;
+    return v;
+  }
+  uint mem = h.mem+k;
+  vector<uint64_t>& words = state.mems[mem];
+  uint64_t wdata = read(h.ins[1],k);
+  if (n.linebuffer) {
+    uint& ptr = state.memPtrs[mem];
+    words[ptr] = wdata;
+    ptr = (ptr+1) % n.depth;
+    if (state.memCounts[mem]<n.depth) state.memCounts[mem]++;
+  }
+  else if (read(h.ins[2],k) & 1) {
+    words[read(h.ins[0],k) % n.depth] = wdata;
+  }
+  return 0;
+}
+
+void HierSimulator::evalBatch(const SimBatch& bat) {
+  const HierNode& h = nodes[bat.node];
+  if (!bat.kernel) {
+    for (uint i=0; i<bat.size; ++i) evalInst(h,order[bat.first+i]);
+    return;
+  }
+  uint64_t* vals = state.slots.data();
+  const SimNode& n = *h.proto;
+  const uint64_t* ops[3] = {nullptr,nullptr,nullptr};
+  for (uint j=0; j<h.ins.size(); ++j) {
+    if (bat.base[j]>=0) {
+      ops[j] = vals + bat.base[j];
+      continue;
+    }
+    gathered[j].resize(bat.size);
+    for (uint k=0; k<bat.size; ++k) gathered[j][k] = vals[bat.opnds[j][k]];
+    ops[j] = gathered[j].data();
+  }
+  const uint64_t* a = ops[0];
+  const uint64_t* b = ops[1];
+  const uint64_t* c = ops[2];
+  uint64_t* out = vals + h.outs[0] + order[bat.first];
+  uint size = bat.size;
+  uint64_t m = PrimOps::mask(n.width);
+  using namespace PrimOps;
+  switch (n.op) {
+    case OP_not : for (uint k=0; k<size; ++k) out[k] = ~a[k] & m; break;
+    case OP_and : for (uint k=0; k<size; ++k) out[k] = a[k] & b[k]; break;
+    case OP_or : for (uint k=0; k<size; ++k) out[k] = a[k] | b[k]; break;
+    case OP_xor : for (uint k=0; k<size; ++k) out[k] = a[k] ^ b[k]; break;
+    case OP_add : for (uint k=0; k<size; ++k) out[k] = (a[k] + b[k]) & m; break;
+    case OP_sub : for (uint k=0; k<size; ++k) out[k] = (a[k] - b[k]) & m; break;
+    case OP_mul : for (uint k=0; k<size; ++k) out[k] = (a[k] * b[k]) & m; break;
+    case OP_eq : for (uint k=0; k<size; ++k) out[k] = a[k]==b[k]; break;
+    case OP_ult : for (uint k=0; k<size; ++k) out[k] = a[k]<b[k]; break;
+    case OP_mux : for (uint k=0; k<size; ++k) out[k] = (c[k] & 1) ? b[k] : a[k]; break;
+    default :
+      for (uint k=0; k<size; ++k) out[k] = PrimOps::eval(n.op,n.width,a[k],b ? b[k] : 0,c ? c[k] : 0);
+  }
+}
+
+void HierSimulator::eval() {
+  if (!dirty) return;
+  for (auto& b : batches) evalBatch(b);
+  dirty = false;
+}
+
+void HierSimulator::clockBatch(const SimBatch& bat, uint64_t* next) {
+  const uint64_t* vals = state.slots.data();
+  if (!bat.kernel) {
+    for (uint i=0; i<bat.size; ++i) next[i] = clockInst(nodes[bat.node],order[bat.first+i]);
+  }
+  else if (bat.base[0]>=0) {
+    std::copy(vals+bat.base[0],vals+bat.base[0]+bat.size,next);
+  }
+  else {
+    for (uint k=0; k<bat.size; ++k) next[k] = vals[bat.opnds[0][k]];
+  }
+}
+
+void HierSimulator::step(uint num) {
+  for (uint c=0; c<num; ++c) {
+    eval();
+    //Registers only read slots, which do not change until the commit below
+    uint r = 0;
+    for (auto& b : regBatches) {
+      clockBatch(b,&regNext[r]);
+      r += b.size;
+    }
+    for (auto t : mems) {
+      for (uint k=0; k<modules[nodes[t].module].numInsts; ++k) clockInst(nodes[t],k);
+    }
+    r = 0;
+    for (auto& b : regBatches) {
+      uint64_t* out = &state.slots[nodes[b.node].outs[0] + order[b.first]];
+      std::copy(&regNext[r],&regNext[r]+b.size,out);
+      r += b.size;
+    }
+    state.cycle++;
+    dirty = true;
+  }
+}
+
+void HierSimulator::printBatches(std::ostream& os) {
+  uint numInsts = 0, numShared = 0, numInputs = 0;
+  for (auto& h : nodes) {
+    numInsts += modules[h.module].numInsts;
+    for (auto& in : h.ins) numShared += in.shared;
+    numInputs += h.ins.size();
+  }
+  os << modules.size() << " modules, " << nodes.size() << " nodes for " << numInsts << " instances (";
+  os << numShared << "/" << numInputs << " inputs shared by the instances)" << endl;
+  uint numNodes = 0, numKernel = 0, numGathered = 0;
+  for (auto bs : {&batches,&regBatches}) {
+    for (auto& b : *bs) {
+      numNodes += b.size;
+      if (!b.kernel) continue;
+      numKernel += b.size;
+      for (uint j=0; j<3; ++j) numGathered += b.opnds[j].empty() ? 0 : 1;
+    }
+  }
+  os << batches.size() + regBatches.size() << " batches for " << numNodes << " nodes, ";
+  os << numKernel << " nodes in kernels (" << numGathered << " gathered operands)" << endl;
+}
@@ -0,0 +1,111 @@
+#include "coreir.h"
+#include "coreir-sim/interpsim.h"
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+InterpSimulator::InterpSimulator(SimGraph* g) : Simulator(g), state(g) {
+  buckets.assign(std::max(g->numLevels,1u),vector<uint>());
+  queued.assign(g->nodes.size(),0);
+  //Everything has to be evaluated once
+  for (auto nid : g->combOrder) schedule(nid);
+}
+
+void InterpSimulator::reset() {
+  state.reset(g);
+  updateCounting();
+  for (auto nid : g->combOrder) schedule(nid);
+}
+
+void InterpSimulator::getState(SimState& s) {
+  eval();
+  s = state;
+}
+
+void InterpSimulator::setState(const SimState& s) {
+  state = s;
+  updateCounting();
+  for (auto nid : g->combOrder) schedule(nid);
+}
+
+void InterpSimulator::setProfiling(uint interval) {
+  profileInterval = interval;
+  profile.clear(g);
+  updateCounting();
+}
+
+void InterpSimulator::setInput(uint idx, uint64_t v) {
+  uint slot = g->inputs[idx];
+  v &= PrimOps::mask(g->slots[slot].width);
+  if (state.slots[slot]==v) return;
+  if (counting) profile.toggles[slot] += __builtin_popcountll(state.slots[slot] ^ v);
+  state.slots[slot] = v;
+  scheduleReaders(slot);
+}
+
+uint64_t InterpSimulator::getOutput(uint idx) {
+  eval();
+  return readInput(g->outputs[idx],state.slots.data());
+}
+
+void InterpSimulator::eval() {
+  if (!pending) return;
+  //Nodes only schedule nodes of a higher level
+  for (auto& bucket : buckets) {
+    for (uint i=0; i<bucket.size(); ++i) {
+      uint nid = bucket[i];
+      queued[nid] = 0;
+      numEvals++;
+      const SimNode& n = g->nodes[nid];
+      if (counting) {
+        profile.evals[nid]++;
+        uint64_t before[3];
+        for (uint k=0; k<n.outs.size(); ++k) before[k] = state.slots[n.outs[k]];
+        if (evalNode(n,state)) {
+          for (uint k=0; k<n.outs.size(); ++k) {
+            profile.toggles[n.outs[k]] += __builtin_popcountll(before[k] ^ state.slots[n.outs[k]]);
+            scheduleReaders(n.outs[k]);
+          }
+        }
+        continue;
+      }
+      if (evalNode(n,state)) {
+        for (auto slot : n.outs) scheduleReaders(slot);
+      }
+    }
+    bucket.clear();
+  }
+  pending = false;
+}
+
+void InterpSimulator::step(uint n) {
+  vector<uint> changedSlots;
+  vector<uint> touchedNodes;
+  for (uint i=0; i<n; ++i) {
+    eval();
+    changedSlots.clear();
+    touchedNodes.clear();
+    bool countEdge = counting;
+    if (countEdge) {
+      regsBefore.clear();
+      for (auto nid : g->seqNodes) {
+        if (g->nodes[nid].kind==NK_Reg) regsBefore.push_back(state.slots[g->nodes[nid].outs[0]]);
+      }
+    }
+    clockEdge(g,state,&changedSlots,&touchedNodes);
+    if (countEdge) {
+      uint r = 0;
+      for (auto nid : g->seqNodes) {
+        const SimNode& node = g->nodes[nid];
+        profile.evals[nid]++;
+        if (node.kind!=NK_Reg) continue;
+        profile.toggles[node.outs[0]] += __builtin_popcountll(regsBefore[r++] ^ state.slots[node.outs[0]]);
+      }
+      profile.cycles++;
+    }
+    updateCounting();
+    for (auto slot : changedSlots) scheduleReaders(slot);
+    for (auto nid : touchedNodes) schedule(nid);
+  }
+  //The next cycle is settled lazily, together with its input changes
+}
@@ -0,0 +1,60 @@
+#include "coreir.h"
+#include "coreir-sim/profile.h"
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+namespace {
+
+SelectPath toSelectPath(string s) {
+  vector<string> parts = splitString<vector<string>>(s,'.');
+  return SelectPath(parts.begin(),parts.end());
+}
+
+//Instance at a hierarchical path below top
+Instance* findInstance(Module* top, string path) {
+  Module* m = top;
+  Instance* inst = nullptr;
+  for (auto name : splitString<vector<string>>(path,'.')) {
+    ASSERT(m && m->hasDef() && m->getDef()->getInstances().count(name),"No instance " + path);
+    inst = m->getDef()->getInstances().at(name);
+    m = inst->getModuleRef();
+  }
+  return inst;
+}
+
+}
+
+Wireable* Sim::getSlotWireable(SimGraph* g, uint slot) {
+  const SimSlot& s = g->slots[slot];
+  if (s.driver>=0) {
+    const SimNode& n = g->nodes[s.driver];
+    return n.inst->sel(toSelectPath(s.name.substr(n.path.size()+1)));
+  }
+  if (s.name.compare(0,5,"self.")==0) {
+    return g->getTop()->getDef()->getInterface()->sel(toSelectPath(s.name.substr(5)));
+  }
+  //cgralib.IO pins in input mode
+  return findInstance(g->getTop(),s.name)->sel("out");
+}
+
+void Sim::annotateActivity(SimGraph* g, const SimProfile& p) {
+  std::map<MetaData*,std::pair<uint64_t,uint64_t>> evals;
+  std::map<MetaData*,std::pair<uint64_t,uint64_t>> toggles;
+  for (uint nid=0; nid<g->nodes.size(); ++nid) {
+    auto& e = evals[g->nodes[nid].inst];
+    e.first += p.evals[nid];
+    e.second += p.cycles;
+  }
+  for (uint slot=0; slot<g->slots.size(); ++slot) {
+    auto& t = toggles[getSlotWireable(g,slot)];
+    t.first += p.toggles[slot];
+    t.second += p.cycles;
+  }
+  for (auto& e : evals) {
+    e.first->getMetaData()["activity"] = {{"evals",e.second.first},{"cycles",e.second.second}};
+  }
+  for (auto& t : toggles) {
+    t.first->getMetaData()["activity"] = {{"toggles",t.second.first},{"cycles",t.second.second}};
+  }
+}
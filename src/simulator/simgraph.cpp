@@ -0,0 +1,493 @@
+#include "coreir.h"
+#include "coreir-sim/simgraph.h"
+#include <map>
+#include <set>
+#include <functional>
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+namespace {
+
+Type* stripNamed(Type* t) {
+  while (auto nt = dyn_cast<NamedType>(t)) t = nt->getRaw();
+  return t;
+}
+
+//Offset of the bits of path[1:] within t. The selected type is returned in ret
+uint selOffset(Type* t, const SelectPath& path, Type*& ret) {
+  uint offset = 0;
+  for (uint i=1; i<path.size(); ++i) {
+    t = stripNamed(t);
+    if (auto at = dyn_cast<ArrayType>(t)) {
+      uint idx = stoi(path[i]);
+      ASSERT(idx < at->getLen(),"Bad index " + path[i]);
+      offset += idx*at->getElemType()->getSize();
+      t = at->getElemType();
+    }
+    else if (auto rt = dyn_cast<RecordType>(t)) {
+      auto record = rt->getRecord();
+      ASSERT(record.count(path[i]),"Bad field " + path[i]);
+      for (auto field : rt->getFields()) {
+        if (field==path[i]) break;
+        offset += record[field]->getSize();
+      }
+      t = record[path[i]];
+    }
+    else {
+      ASSERT(0,"Cannot select " + path[i] + " from " + t->toString());
+    }
+  }
+  ret = t;
+  return offset;
+}
+
+//Calls fun on every Bit or Array of Bits in t (name is the path relative to t)
+void forEachLeaf(Type* t, string name, uint offset, std::function<void(Type*,string,uint)> fun) {
+  t = stripNamed(t);
+  if (auto at = dyn_cast<ArrayType>(t)) {
+    Type* et = at->getElemType();
+    if (!stripNamed(et)->isBaseType()) {
+      for (uint i=0; i<at->getLen(); ++i) {
+        forEachLeaf(et,name + "." + to_string(i),offset + i*et->getSize(),fun);
+      }
+      return;
+    }
+  }
+  else if (auto rt = dyn_cast<RecordType>(t)) {
+    auto record = rt->getRecord();
+    for (auto field : rt->getFields()) {
+      forEachLeaf(record[field],name=="" ? field : name + "." + field,offset,fun);
+      offset += record[field]->getSize();
+    }
+    return;
+  }
+  fun(t,name,offset);
+}
+
+Arg* getArg(string name, Args& args, Args defaults) {
+  if (args.count(name)) return args.at(name);
+  ASSERT(defaults.count(name),"Missing arg " + name);
+  return defaults.at(name);
+}
+
+class Elaborator {
+  SimGraph* g;
+  //Union find over every bit of every port in the hierarchy
+  vector<uint> parent;
+  //(bit, slot*64+bit in slot) for every bit of a driver
+  vector<std::pair<uint,uint64_t>> driverBits;
+  //(node, in, first bit) of inputs still to be resolved. node==-1 for top outputs
+  struct Pending {
+    int node;
+    uint in;
+    uint base;
+  };
+  vector<Pending> pending;
+  //Every module definition that was elaborated (for the hash)
+  std::map<string,Module*> modules;
+
+  public :
+    Elaborator(SimGraph* g) : g(g) {}
+    void run(Module* top);
+    uint64_t getHash();
+  private :
+    uint newBits(uint n) {
+      uint base = parent.size();
+      for (uint i=0; i<n; ++i) parent.push_back(base+i);
+      return base;
+    }
+    uint find(uint x) {
+      while (parent[x]!=x) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+      }
+      return x;
+    }
+    void unite(uint a, uint b) {
+      a = find(a); b = find(b);
+      if (a!=b) parent[a] = b;
+    }
+    uint addSlot(uint width, string name, int driver, uint base) {
+      ASSERT(width<=64,"Cannot simulate " + name + ": wider than 64 bits");
+      uint slot = g->slots.size();
+      g->slots.push_back({width,name,driver});
+      for (uint i=0; i<width; ++i) driverBits.push_back({base+i,((uint64_t) slot<<6) | i});
+      return slot;
+    }
+
+    void elab(Module* m, string prefix, uint selfBase);
+    void addPrim(Instance* inst, string path, uint base);
+    void levelize();
+
+    //Helpers for primitives
+    SimNode& newNode(NodeKind kind, Instance* inst, string path) {
+      g->nodes.push_back(SimNode());
+      SimNode& n = g->nodes.back();
+      n.kind = kind;
+      n.inst = inst;
+      n.path = path;
+      return n;
+    }
+    void addIn(Type* t, string port, uint base) {
+      uint nid = g->nodes.size()-1;
+      SimNode& n = g->nodes[nid];
+      uint in = n.ins.size();
+      n.ins.push_back(SimInput());
+      if (port=="") return; //Port does not exist, reads 0
+      Type* pt;
+      uint off = selOffset(t,{"",port},pt);
+      n.ins[in].width = pt->getSize();
+      ASSERT(n.ins[in].width<=64,"Cannot simulate " + n.path + ": wider than 64 bits");
+      pending.push_back({(int) nid,in,base+off});
+    }
+    void addOut(Type* t, string port, uint base) {
+      uint nid = g->nodes.size()-1;
+      Type* pt;
+      uint off = selOffset(t,{"",port},pt);
+      uint slot = addSlot(pt->getSize(),g->nodes[nid].path + "." + port,nid,base+off);
+      g->nodes[nid].outs.push_back(slot);
+    }
+    void wire(Type* t, string a, string b, uint base, uint len, uint aLo=0, uint bLo=0) {
+      Type* pt;
+      uint aoff = selOffset(t,splitString<SelectPath>("." + a,'.'),pt);
+      uint boff = selOffset(t,splitString<SelectPath>("." + b,'.'),pt);
+      for (uint i=0; i<len; ++i) unite(base+aoff+aLo+i,base+boff+bLo+i);
+    }
+};
+
+void Elaborator::run(Module* top) {
+  ASSERT(top->hasDef(),"Cannot simulate " + top->getRefName() + ": no definition");
+  uint selfBase = newBits(top->getType()->getSize());
+
+  //Top level ports. Inputs drive nets, outputs read them
+  forEachLeaf(top->getType(),"",0,[&](Type* t, string name, uint off) {
+    if (t->isInput()) {
+      g->inputs.push_back(addSlot(t->getSize(),"self." + name,-1,selfBase+off));
+      g->inputNames.push_back(name);
+    }
+    else {
+      ASSERT(t->getSize()<=64,"Cannot simulate port " + name + ": wider than 64 bits");
+      g->outputs.push_back(SimInput());
+      g->outputs.back().width = t->getSize();
+      g->outputNames.push_back(name);
+      pending.push_back({-1,(uint) g->outputs.size()-1,selfBase+off});
+    }
+  });
+
+  elab(top,"",selfBase);
+
+  //Every net has at most one driver
+  vector<int64_t> rootDriver(parent.size(),-1);
+  for (auto db : driverBits) {
+    uint root = find(db.first);
+    if (rootDriver[root]!=-1) {
+      string a = g->slots[rootDriver[root]>>6].name;
+      string b = g->slots[db.second>>6].name;
+      ASSERT(0,"Net driven by both " + a + " and " + b);
+    }
+    rootDriver[root] = db.second;
+  }
+  for (auto p : pending) {
+    SimInput& in = p.node==-1 ? g->outputs[p.in] : g->nodes[p.node].ins[p.in];
+    uint width = in.width;
+    in.segs.clear();
+    for (uint i=0; i<width; ++i) {
+      int64_t d = rootDriver[find(p.base+i)];
+      if (d==-1) continue;
+      uint slot = d>>6;
+      uint bit = d & 63;
+      if (!in.segs.empty()) {
+        Segment& last = in.segs.back();
+        if (last.slot==slot && last.srcLo+last.len==bit && last.dstLo+last.len==i) {
+          last.len++;
+          continue;
+        }
+      }
+      in.segs.push_back({slot,bit,1,i});
+    }
+    if (in.segs.size()==1 && in.segs[0].srcLo==0 && in.segs[0].dstLo==0 && in.segs[0].len==width && g->slots[in.segs[0].slot].width==width) {
+      in.direct = in.segs[0].slot;
+    }
+  }
+  levelize();
+}
+
+void Elaborator::elab(Module* m, string prefix, uint selfBase) {
+  modules[m->getRefName()] = m;
+  ModuleDef* def = m->getDef();
+  unordered_map<string,uint> bases;
+  auto instances = def->getInstances();
+  std::map<string,Instance*> sorted(instances.begin(),instances.end());
+  for (auto imap : sorted) {
+    Instance* inst = imap.second;
+    uint base = newBits(inst->getType()->getSize());
+    bases[imap.first] = base;
+    string path = prefix + imap.first;
+    Module* sub = nullptr;
+    if (inst->isGen()) {
+      Generator* gen = inst->getGeneratorRef();
+      if (gen->hasDef()) sub = gen->getModule(inst->getGenArgs());
+    }
+    else if (inst->getModuleRef()->hasDef()) {
+      sub = inst->getModuleRef();
+    }
+    if (sub) {
+      elab(sub,path + ".",base);
+    }
+    else {
+      addPrim(inst,path,base);
+    }
+  }
+  for (auto con : def->getConnections()) {
+    uint base[2];
+    uint off[2];
+    uint size = 0;
+    int i = 0;
+    for (auto w : {con.first,con.second}) {
+      SelectPath path = w->getSelectPath();
+      Type* wt;
+      if (path[0]=="self") {
+        base[i] = selfBase;
+        off[i] = selOffset(m->getType(),path,wt);
+      }
+      else {
+        base[i] = bases[path[0]];
+        off[i] = selOffset(instances[path[0]]->getType(),path,wt);
+      }
+      size = wt->getSize();
+      ++i;
+    }
+    for (uint b=0; b<size; ++b) unite(base[0]+off[0]+b,base[1]+off[1]+b);
+  }
+}
+
+void Elaborator::addPrim(Instance* inst, string path, uint base) {
+  Instantiable* ref = inst->getInstantiableRef();
+  Args genargs = inst->getGenArgs();
+  Args configargs = inst->getConfigArgs();
+  Args defaultGenArgs;
+  if (inst->getGeneratorRef()) defaultGenArgs = inst->getGeneratorRef()->getDefaultGenArgs();
+  Args defaultConfigArgs = ref->getDefaultConfigArgs();
+  string ns = ref->getNamespace()->getName();
+  string name = inst->getGeneratorRef() ? inst->getGeneratorRef()->getName() : ref->getName();
+  Type* t = inst->getType();
+  auto genInt = [&](string arg) {
+    return (uint) getArg(arg,genargs,defaultGenArgs)->get<ArgInt>();
+  };
+  auto genBool = [&](string arg) {
+    return getArg(arg,genargs,defaultGenArgs)->get<ArgBool>();
+  };
+  auto configInt = [&](string arg) {
+    return (uint64_t) getArg(arg,configargs,defaultConfigArgs)->get<ArgInt>();
+  };
+  auto configString = [&](string arg) {
+    return getArg(arg,configargs,defaultConfigArgs)->get<ArgString>();
+  };
+
+  if (ns=="coreir") {
+    PrimOps::Op op = PrimOps::str2Op(name);
+    if (op!=PrimOps::OP_none) {
+      SimNode& n = newNode(NK_Op,inst,path);
+      n.op = op;
+      n.width = genInt("width");
+      if (PrimOps::numOperands(op)==1) {
+        addIn(t,"in",base);
+      }
+      else {
+        addIn(t,"in0",base);
+        addIn(t,"in1",base);
+        if (op==PrimOps::OP_mux) addIn(t,"sel",base);
+      }
+      g->nodes.back().numCombIns = g->nodes.back().ins.size();
+      addOut(t,"out",base);
+      return;
+    }
+    if (name=="const") {
+      SimNode& n = newNode(NK_Const,inst,path);
+      n.width = genInt("width");
+      n.value = configInt("value") & PrimOps::mask(n.width);
+      addOut(t,"out",base);
+      return;
+    }
+    if (name=="reg") {
+      SimNode& n = newNode(NK_Reg,inst,path);
+      n.width = genInt("width");
+      n.value = configInt("init") & PrimOps::mask(n.width);
+      n.en = genBool("en");
+      n.clr = genBool("clr");
+      n.rst = genBool("rst");
+      bool en = n.en, clr = n.clr, rst = n.rst;
+      addIn(t,"in",base);
+      addIn(t,en ? "en" : "",base);
+      addIn(t,clr ? "clr" : "",base);
+      addIn(t,rst ? "rst" : "",base);
+      addOut(t,"out",base);
+      return;
+    }
+    if (name=="term") return;
+    if (name=="passthrough") {
+      Type* pt = getArg("type",genargs,defaultGenArgs)->get<ArgType>();
+      wire(t,"in","out",base,pt->getSize());
+      return;
+    }
+    if (name=="slice") {
+      uint lo = genInt("lo");
+      uint hi = genInt("hi");
+      wire(t,"in","out",base,hi-lo,lo,0);
+      return;
+    }
+    if (name=="concat") {
+      //out = {in0,in1}
+      uint width0 = genInt("width0");
+      uint width1 = genInt("width1");
+      wire(t,"in1","out",base,width1,0,0);
+      wire(t,"in0","out",base,width0,0,width1);
+      return;
+    }
+  }
+  else if (ns=="cgralib") {
+    if (name=="Reg") {
+      SimNode& n = newNode(NK_Reg,inst,path);
+      n.width = genInt("width");
+      addIn(t,"in",base);
+      addIn(t,"",base);
+      addIn(t,"",base);
+      addIn(t,"",base);
+      addOut(t,"out",base);
+      return;
+    }
+    if (name=="Const") {
+      SimNode& n = newNode(NK_Const,inst,path);
+      n.width = genInt("width");
+      n.value = configInt("value") & PrimOps::mask(n.width);
+      addOut(t,"out",base);
+      return;
+    }
+    //IOs are the pins of the CGRA, so they become top level inputs/outputs
+    //named by their instance path
+    if (name=="IO") {
+      uint width = genInt("width");
+      Type* pt;
+      if (configString("mode")=="i") {
+        uint off = selOffset(t,{"","out"},pt);
+        g->inputs.push_back(addSlot(width,path,-1,base+off));
+        g->inputNames.push_back(path);
+      }
+      else {
+        uint off = selOffset(t,{"","in"},pt);
+        wire(t,"in","out",base,width);
+        g->outputs.push_back(SimInput());
+        g->outputs.back().width = width;
+        g->outputNames.push_back(path);
+        pending.push_back({-1,(uint) g->outputs.size()-1,base+off});
+      }
+      return;
+    }
+    if (name=="PE") {
+      string opstr = configString("op");
+      PrimOps::Op op = PrimOps::str2Op(opstr);
+      ASSERT(op!=PrimOps::OP_none && PrimOps::numOperands(op)==2,"Cannot simulate PE op " + opstr + " in " + path);
+      ASSERT(genInt("numin")>=2,"Cannot simulate PE with less than 2 inputs in " + path);
+      SimNode& n = newNode(NK_Op,inst,path);
+      n.op = op;
+      n.width = genInt("width");
+      addIn(t,"data.in.0",base);
+      addIn(t,"data.in.1",base);
+      g->nodes.back().numCombIns = 2;
+      addOut(t,"data.out",base);
+      return;
+    }
+    if (name=="Mem") {
+      SimNode& n = newNode(NK_Mem,inst,path);
+      n.width = genInt("width");
+      n.depth = genInt("depth");
+      n.linebuffer = configString("mode")=="linebuffer";
+      n.mem = g->numMems++;
+      ASSERT(n.depth>0,"Memory with depth 0 in " + path);
+      n.numCombIns = n.linebuffer ? 0 : 1;
+      addIn(t,"addr",base);
+      addIn(t,"wdata",base);
+      addIn(t,"wen",base);
+      addOut(t,"rdata",base);
+      addOut(t,"empty",base);
+      addOut(t,"full",base);
+      return;
+    }
+  }
+  ASSERT(0,"Cannot simulate " + ref->getRefName() + " (instance " + path + ")");
+}
+
+void Elaborator::levelize() {
+  uint numNodes = g->nodes.size();
+  g->readers.assign(g->slots.size(),vector<uint>());
+  vector<vector<uint>> succs(numNodes);
+  vector<uint> indegree(numNodes,0);
+  for (uint nid=0; nid<numNodes; ++nid) {
+    SimNode& n = g->nodes[nid];
+    if (n.kind==NK_Reg) {
+      g->seqNodes.push_back(nid);
+      continue;
+    }
+    if (n.kind==NK_Mem) g->seqNodes.push_back(nid);
+    std::set<uint> slots;
+    for (uint i=0; i<n.numCombIns; ++i) {
+      for (auto seg : n.ins[i].segs) slots.insert(seg.slot);
+    }
+    for (auto slot : slots) {
+      g->readers[slot].push_back(nid);
+      int d = g->slots[slot].driver;
+      if (d>=0 && g->nodes[d].kind!=NK_Reg) {
+        succs[d].push_back(nid);
+        indegree[nid]++;
+      }
+    }
+  }
+  //Kahn's algorithm
+  vector<uint> work;
+  for (uint nid=0; nid<numNodes; ++nid) {
+    if (g->nodes[nid].kind!=NK_Reg && indegree[nid]==0) work.push_back(nid);
+  }
+  for (uint i=0; i<work.size(); ++i) {
+    uint nid = work[i];
+    g->combOrder.push_back(nid);
+    g->numLevels = std::max(g->numLevels,g->nodes[nid].level+1);
+    for (auto s : succs[nid]) {
+      g->nodes[s].level = std::max(g->nodes[s].level,g->nodes[nid].level+1);
+      if (--indegree[s]==0) work.push_back(s);
+    }
+  }
+  for (uint nid=0; nid<numNodes; ++nid) {
+    ASSERT(indegree[nid]==0,"Combinational loop through " + g->nodes[nid].path);
+  }
+}
+
+uint64_t Elaborator::getHash() {
+  uint64_t h = stableHash("simgraph");
+  for (auto mmap : modules) h = stableHashCombine(h,moduleHash(mmap.second));
+  return h;
+}
+
+}
+
+SimGraph::SimGraph(Module* top) : top(top) {
+  Elaborator e(this);
+  e.run(top);
+  hash = e.getHash();
+  for (uint i=0; i<inputs.size(); ++i) inputMap[inputNames[i]] = i;
+  for (uint i=0; i<outputs.size(); ++i) outputMap[outputNames[i]] = i;
+  for (uint i=0; i<slots.size(); ++i) slotMap[slots[i].name] = i;
+}
+
+int SimGraph::getInput(string name) {
+  auto it = inputMap.find(name);
+  return it==inputMap.end() ? -1 : it->second;
+}
+int SimGraph::getOutput(string name) {
+  auto it = outputMap.find(name);
+  return it==outputMap.end() ? -1 : it->second;
+}
+int SimGraph::getSlot(string name) {
+  auto it = slotMap.find(name);
+  return it==slotMap.end() ? -1 : it->second;
+}
@@ -0,0 +1,198 @@
+#include "coreir.h"
+#include "coreir-sim/simulator.h"
+#include "coreir-sim/interpsim.h"
+#include "coreir-sim/compiledsim.h"
+#include "coreir-sim/bitparallelsim.h"
+#include "coreir-sim/threadedsim.h"
+#include "coreir-sim/hiersim.h"
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+void SimState::reset(SimGraph* g) {
+  vector<uint64_t> ins;
+  if (slots.size()==g->slots.size()) {
+    for (auto slot : g->inputs) ins.push_back(slots[slot]);
+  }
+  slots.assign(g->slots.size(),0);
+  for (uint i=0; i<ins.size(); ++i) slots[g->inputs[i]] = ins[i];
+  mems.assign(g->numMems,vector<uint64_t>());
+  memPtrs.assign(g->numMems,0);
+  memCounts.assign(g->numMems,0);
+  for (auto& n : g->nodes) {
+    if (n.kind==NK_Reg) slots[n.outs[0]] = n.value;
+    if (n.kind==NK_Mem) mems[n.mem].assign(n.depth,0);
+  }
+  cycle = 0;
+}
+
+namespace {
+inline bool update(uint64_t& slot, uint64_t v) {
+  if (slot==v) return false;
+  slot = v;
+  return true;
+}
+}
+
+bool Sim::evalNode(const SimNode& n, uint64_t* slots, const SimState& s) {
+  switch (n.kind) {
+    case NK_Op : {
+      uint64_t a = readInput(n.ins[0],slots);
+      uint64_t b = n.ins.size()>1 ? readInput(n.ins[1],slots) : 0;
+      uint64_t c = n.ins.size()>2 ? readInput(n.ins[2],slots) : 0;
+      return update(slots[n.outs[0]],PrimOps::eval(n.op,n.width,a,b,c));
+    }
+    case NK_Const :
+      return update(slots[n.outs[0]],n.value);
+    case NK_Mem : {
+      const vector<uint64_t>& mem = s.mems[n.mem];
+      bool changed = false;
+      if (n.linebuffer) {
+        uint count = s.memCounts[n.mem];
+        changed |= update(slots[n.outs[0]],mem[s.memPtrs[n.mem]]);
+        changed |= update(slots[n.outs[1]],count==0);
+        changed |= update(slots[n.outs[2]],count==n.depth);
+      }
+      else {
+        changed |= update(slots[n.outs[0]],mem[readInput(n.ins[0],slots) % n.depth]);
+      }
+      return changed;
+    }
+    default :
+      ASSERT(0,"Not a combinational node: " + n.path);
+  }
+  return false;
+}
+
+uint64_t Sim::clockNode(const SimNode& n, const uint64_t* slots, SimState& s) {
+  if (n.kind==NK_Reg) {
+    uint64_t v = slots[n.outs[0]];
+    //en ? (clr ? init : in) : out
+    if (!n.en || (readInput(n.ins[1],slots) & 1)) {
+      v = (n.clr && (readInput(n.ins[2],slots) & 1)) ? n.value : readInput(n.ins[0],slots);
+    }
+    //rst is active low
+    if (n.rst && !(readInput(n.ins[3],slots) & 1)) v = n.value;
+    return v;
+  }
+  vector<uint64_t>& mem = s.mems[n.mem];
+  uint64_t wdata = readInput(n.ins[1],slots);
+  if (n.linebuffer) {
+    uint& ptr = s.memPtrs[n.mem];
+    mem[ptr] = wdata;
+    ptr = (ptr+1) % n.depth;
+    if (s.memCounts[n.mem]<n.depth) s.memCounts[n.mem]++;
+  }
+  else if (readInput(n.ins[2],slots) & 1) {
+    mem[readInput(n.ins[0],slots) % n.depth] = wdata;
+  }
+  return 0;
+}
+
+void Sim::clockEdge(SimGraph* g, SimState& s, vector<uint>* changedSlots, vector<uint>* touchedNodes) {
+  uint64_t* slots = s.slots.data();
+  //Registers only read slots, which do not change until the commit below
+  vector<std::pair<uint,uint64_t>> next;
+  next.reserve(g->seqNodes.size());
+  for (auto nid : g->seqNodes) {
+    const SimNode& n = g->nodes[nid];
+    uint64_t v = clockNode(n,slots,s);
+    if (n.kind==NK_Reg) {
+      next.push_back({n.outs[0],v});
+    }
+    else if (touchedNodes) {
+      touchedNodes->push_back(nid);
+    }
+  }
+  for (auto nv : next) {
+    if (update(slots[nv.first],nv.second) && changedSlots) {
+      changedSlots->push_back(nv.first);
+    }
+  }
+  s.cycle++;
+}
+
+void Simulator::setInputLane(uint idx, uint lane, uint64_t v) {
+  ASSERT(lane==0,"Lane " + to_string(lane) + " out of range");
+  setInput(idx,v);
+}
+
+uint64_t Simulator::getOutputLane(uint idx, uint lane) {
+  ASSERT(lane==0,"Lane " + to_string(lane) + " out of range");
+  return getOutput(idx);
+}
+
+void SimProfile::clear(SimGraph* g) {
+  cycles = 0;
+  toggles.assign(g->slots.size(),0);
+  evals.assign(g->nodes.size(),0);
+}
+
+void SimProfile::merge(const SimProfile& p) {
+  for (uint i=0; i<toggles.size(); ++i) toggles[i] += p.toggles[i];
+  for (uint i=0; i<evals.size(); ++i) evals[i] += p.evals[i];
+}
+
+void Simulator::setProfiling(uint interval) {
+  ASSERT(interval==0,"This simulation engine cannot profile");
+}
+
+void Simulator::getProfile(SimProfile& p) {
+  ASSERT(0,"This simulation engine cannot profile");
+}
+
+void Simulator::setValue(string name, uint64_t v) {
+  int idx = g->getInput(name);
+  ASSERT(idx>=0,"No input named " + name);
+  setInput(idx,v);
+}
+
+uint64_t Simulator::getValue(string name) {
+  int idx = g->getOutput(name);
+  if (idx>=0) return getOutput(idx);
+  idx = g->getSlot(name);
+  ASSERT(idx>=0,"No output or net named " + name);
+  return getSlot(idx);
+}
+
+vector<Trace> Sim::simulateBatch(Simulator* sim, const vector<Trace>& stimuli) {
+  SimGraph* g = sim->getGraph();
+  uint lanes = sim->getNumLanes();
+  vector<Trace> ret(stimuli.size());
+  for (uint first=0; first<stimuli.size(); first+=lanes) {
+    uint last = std::min(first+lanes,(uint) stimuli.size());
+    //Lanes without a stimulus keep the values of the previous batch
+    uint cycles = 0;
+    for (uint s=first; s<last; ++s) {
+      cycles = std::max(cycles,(uint) stimuli[s].size());
+      ret[s].assign(stimuli[s].size(),vector<uint64_t>(g->outputs.size()));
+    }
+    sim->reset();
+    for (uint cycle=0; cycle<cycles; ++cycle) {
+      for (uint s=first; s<last; ++s) {
+        if (cycle>=stimuli[s].size()) continue;
+        const vector<uint64_t>& ins = stimuli[s][cycle];
+        ASSERT(ins.size()==g->inputs.size(),"Expected a value for every input in each cycle");
+        for (uint idx=0; idx<ins.size(); ++idx) sim->setInputLane(idx,s-first,ins[idx]);
+      }
+      for (uint s=first; s<last; ++s) {
+        if (cycle>=stimuli[s].size()) continue;
+        for (uint idx=0; idx<g->outputs.size(); ++idx) {
+          ret[s][cycle][idx] = sim->getOutputLane(idx,s-first);
+        }
+      }
+      sim->step();
+    }
+  }
+  return ret;
+}
+
+Simulator* Sim::newSimulator(SimGraph* g, string engine) {
+  if (engine=="interp") return new InterpSimulator(g);
+  if (engine=="compiled") return new CompiledSimulator(g);
+  if (engine=="bitparallel") return new BitParallelSimulator(g);
+  if (engine=="threaded") return new ThreadedSimulator(g);
+  if (engine=="hier") return new HierSimulator(g);
+  ASSERT(0,"Unknown simulation engine " + engine);
+  return nullptr;
+}
@@ -0,0 +1,333 @@
+#include "coreir.h"
+#include "coreir-sim/threadedsim.h"
+#include <chrono>
+#include <set>
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+namespace {
+typedef std::chrono::steady_clock Clock;
+
+double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now()-start).count();
+}
+}
+
+void SpinBarrier::wait() {
+  uint gen = generation.load(std::memory_order_acquire);
+  if (count.fetch_add(1,std::memory_order_acq_rel)+1==n) {
+    count.store(0,std::memory_order_relaxed);
+    generation.fetch_add(1,std::memory_order_release);
+    return;
+  }
+  uint spins = 0;
+  while (generation.load(std::memory_order_acquire)==gen) {
+    if (++spins>1000) std::this_thread::yield();
+  }
+}
+
+ThreadedSimulator::ThreadedSimulator(SimGraph* g, uint numThreads) : Simulator(g), state(g) {
+  if (numThreads==0) numThreads = defaultNumThreads();
+  uint numSinks = g->seqNodes.size() + g->outputs.size();
+  partition(std::max(1u,std::min(numThreads,numSinks)));
+  partSlots.assign(parts.size(),vector<uint64_t>(g->slots.size(),0));
+  partNext.assign(parts.size(),vector<uint64_t>());
+  for (uint p=0; p<parts.size(); ++p) partNext[p].assign(parts[p].seqNodes.size(),0);
+  barrier.setSize(parts.size());
+  for (uint p=1; p<parts.size(); ++p) {
+    workers.push_back(std::thread(&ThreadedSimulator::worker,this,p));
+  }
+}
+
+ThreadedSimulator::~ThreadedSimulator() {
+  command(CMD_quit,0);
+  for (auto& t : workers) t.join();
+}
+
+//Greedy: the biggest cones go first, each to the partition that already
+//has most of it (as long as that partition stays under its share)
+void ThreadedSimulator::partition(uint numParts) {
+  uint numNodes = g->nodes.size();
+
+  //Combinational nodes feeding ins (stops at registers and top level inputs)
+  vector<uint> mark(numNodes,0);
+  uint stamp = 0;
+  auto cone = [&](vector<const SimInput*> ins) {
+    ++stamp;
+    vector<uint> ret;
+    while (!ins.empty()) {
+      const SimInput* in = ins.back();
+      ins.pop_back();
+      for (auto& seg : in->segs) {
+        int d = g->slots[seg.slot].driver;
+        if (d<0 || g->nodes[d].kind==NK_Reg || mark[d]==stamp) continue;
+        mark[d] = stamp;
+        ret.push_back(d);
+        const SimNode& n = g->nodes[d];
+        uint numIns = n.kind==NK_Mem ? n.numCombIns : n.ins.size();
+        for (uint i=0; i<numIns; ++i) ins.push_back(&n.ins[i]);
+      }
+    }
+    return ret;
+  };
+
+  //A sink is a sequential node (seq>=0) or a top level output
+  struct Sink {
+    int seq;
+    vector<uint> cone;
+  };
+  vector<Sink> sinks;
+  for (auto nid : g->seqNodes) {
+    vector<const SimInput*> ins;
+    for (auto& in : g->nodes[nid].ins) ins.push_back(&in);
+    sinks.push_back({(int) nid,cone(ins)});
+  }
+  for (auto& out : g->outputs) sinks.push_back({-1,cone({&out})});
+  std::stable_sort(sinks.begin(),sinks.end(),[](const Sink& a, const Sink& b) {
+    return a.cone.size() > b.cone.size();
+  });
+
+  parts.assign(numParts,SimPartition());
+  vector<vector<char>> member(numParts,vector<char>(numNodes,0));
+  vector<uint> load(numParts,0);
+  //Memories are also combinational nodes, so sequential ownership is separate
+  vector<int> seqOwner(numNodes,-1);
+  uint cap = g->combOrder.size()/numParts + g->seqNodes.size()/numParts + 1;
+  cap += cap/4;
+  auto assign = [&](uint p, const vector<uint>& nodes) {
+    for (auto nid : nodes) {
+      if (member[p][nid]) continue;
+      member[p][nid] = 1;
+      load[p]++;
+    }
+  };
+  for (auto& sink : sinks) {
+    int best = -1;
+    uint bestAdded = 0;
+    for (uint p=0; p<numParts; ++p) {
+      uint added = 1;
+      for (auto nid : sink.cone) added += !member[p][nid];
+      bool fits = load[p]+added<=cap;
+      bool bestFits = best>=0 && load[best]+bestAdded<=cap;
+      if (best<0 || (fits && !bestFits)
+          || (fits && bestFits && (added<bestAdded || (added==bestAdded && load[p]<load[best])))
+          || (!fits && !bestFits && load[p]+added<load[best]+bestAdded)) {
+        best = p;
+        bestAdded = added;
+      }
+    }
+    assign(best,sink.cone);
+    if (sink.seq>=0) {
+      seqOwner[sink.seq] = best;
+      load[best]++;
+    }
+  }
+
+  //Logic that reaches no sink still has to be evaluated for getSlot
+  for (auto nid : g->combOrder) {
+    bool covered = false;
+    for (uint p=0; p<numParts && !covered; ++p) covered = member[p][nid];
+    if (covered) continue;
+    uint p = std::min_element(load.begin(),load.end()) - load.begin();
+    vector<const SimInput*> ins;
+    for (auto& in : g->nodes[nid].ins) ins.push_back(&in);
+    vector<uint> nodes = cone(ins);
+    nodes.push_back(nid);
+    assign(p,nodes);
+  }
+
+  //Node lists, owners and sources
+  vector<int> owner(numNodes,-1);
+  vector<uint> numOwners(numNodes,0);
+  for (uint p=0; p<numParts; ++p) {
+    SimPartition& part = parts[p];
+    for (auto nid : g->combOrder) {
+      if (!member[p][nid]) continue;
+      part.nodes.push_back(nid);
+      numOwners[nid]++;
+      if (owner[nid]<0) owner[nid] = p;
+    }
+    for (auto nid : g->seqNodes) {
+      if (seqOwner[nid]==(int) p) part.seqNodes.push_back(nid);
+    }
+  }
+  for (uint p=0; p<numParts; ++p) {
+    SimPartition& part = parts[p];
+    std::set<uint> sources;
+    auto addSources = [&](const SimInput& in) {
+      for (auto& seg : in.segs) {
+        int d = g->slots[seg.slot].driver;
+        if (d<0 || g->nodes[d].kind==NK_Reg) sources.insert(seg.slot);
+      }
+    };
+    for (auto nid : part.nodes) {
+      const SimNode& n = g->nodes[nid];
+      for (auto& in : n.ins) addSources(in);
+      if (owner[nid]==(int) p) {
+        for (auto slot : n.outs) part.owned.push_back(slot);
+      }
+      if (numOwners[nid]>1) part.numShared++;
+    }
+    for (auto nid : part.seqNodes) {
+      const SimNode& n = g->nodes[nid];
+      for (auto& in : n.ins) addSources(in);
+      if (n.kind==NK_Reg) sources.insert(n.outs[0]);
+    }
+    part.sources.assign(sources.begin(),sources.end());
+  }
+}
+
+void ThreadedSimulator::evalPhase(uint p, bool count) {
+  Clock::time_point start = Clock::now();
+  SimPartition& part = parts[p];
+  uint64_t* slots = partSlots[p].data();
+  for (auto slot : part.sources) slots[slot] = state.slots[slot];
+  for (auto nid : part.nodes) evalNode(g->nodes[nid],slots,state);
+  if (count) {
+    SimProfile& prof = partProfiles[p];
+    for (auto nid : part.nodes) prof.evals[nid]++;
+    for (auto slot : part.owned) prof.toggles[slot] += __builtin_popcountll(state.slots[slot] ^ slots[slot]);
+  }
+  for (auto slot : part.owned) state.slots[slot] = slots[slot];
+  part.seconds += secondsSince(start);
+}
+
+void ThreadedSimulator::clockPhase(uint p, bool count) {
+  Clock::time_point start = Clock::now();
+  SimPartition& part = parts[p];
+  const uint64_t* slots = partSlots[p].data();
+  vector<uint64_t>& next = partNext[p];
+  for (uint i=0; i<part.seqNodes.size(); ++i) {
+    next[i] = clockNode(g->nodes[part.seqNodes[i]],slots,state);
+  }
+  //Nobody reads the shared register slots during the clock phase
+  for (uint i=0; i<part.seqNodes.size(); ++i) {
+    const SimNode& n = g->nodes[part.seqNodes[i]];
+    if (count) partProfiles[p].evals[part.seqNodes[i]]++;
+    if (n.kind!=NK_Reg) continue;
+    if (count) partProfiles[p].toggles[n.outs[0]] += __builtin_popcountll(state.slots[n.outs[0]] ^ next[i]);
+    state.slots[n.outs[0]] = next[i];
+  }
+  part.seconds += secondsSince(start);
+}
+
+void ThreadedSimulator::run(uint p, Command c, uint cycles) {
+  //state.cycle only changes between commands
+  if (c==CMD_eval) {
+    evalPhase(p,counting(state.cycle));
+    barrier.wait();
+  }
+  else if (c==CMD_step) {
+    for (uint i=0; i<cycles; ++i) {
+      bool count = counting(state.cycle+i);
+      evalPhase(p,count);
+      barrier.wait();
+      clockPhase(p,count);
+      barrier.wait();
+    }
+  }
+}
+
+void ThreadedSimulator::worker(uint p) {
+  uint64_t seen = 0;
+  while (true) {
+    Command c;
+    uint cycles;
+    {
+      std::unique_lock<std::mutex> lock(cmdMutex);
+      cmdCond.wait(lock,[&]() { return cmdGen!=seen;});
+      seen = cmdGen;
+      c = cmd;
+      cycles = cmdCycles;
+    }
+    if (c==CMD_quit) return;
+    run(p,c,cycles);
+  }
+}
+
+//Every command ends with a barrier, so all workers are idle again on return
+void ThreadedSimulator::command(Command c, uint cycles) {
+  if (!workers.empty()) {
+    {
+      std::lock_guard<std::mutex> lock(cmdMutex);
+      cmd = c;
+      cmdCycles = cycles;
+      cmdGen++;
+    }
+    cmdCond.notify_all();
+  }
+  run(0,c,cycles);
+}
+
+void ThreadedSimulator::setInput(uint idx, uint64_t v) {
+  uint slot = g->inputs[idx];
+  v &= PrimOps::mask(g->slots[slot].width);
+  if (counting(state.cycle)) profile.toggles[slot] += __builtin_popcountll(state.slots[slot] ^ v);
+  state.slots[slot] = v;
+  dirty = true;
+}
+
+uint64_t ThreadedSimulator::getOutput(uint idx) {
+  eval();
+  return readInput(g->outputs[idx],state.slots.data());
+}
+
+void ThreadedSimulator::eval() {
+  if (!dirty) return;
+  command(CMD_eval,0);
+  dirty = false;
+}
+
+void ThreadedSimulator::step(uint n) {
+  if (n==0) return;
+  command(CMD_step,n);
+  for (uint i=0; i<n; ++i) profile.cycles += counting(state.cycle+i);
+  state.cycle += n;
+  dirty = true;
+}
+
+void ThreadedSimulator::reset() {
+  state.reset(g);
+  dirty = true;
+}
+
+void ThreadedSimulator::getState(SimState& s) {
+  eval();
+  s = state;
+}
+
+void ThreadedSimulator::setState(const SimState& s) {
+  state = s;
+  dirty = true;
+}
+
+void ThreadedSimulator::setProfiling(uint interval) {
+  profileInterval = interval;
+  profile.clear(g);
+  partProfiles.assign(parts.size(),profile);
+}
+
+void ThreadedSimulator::getProfile(SimProfile& p) {
+  p = profile;
+  for (auto& part : partProfiles) p.merge(part);
+}
+
+double ThreadedSimulator::getImbalance() {
+  double total = 0, worst = 0;
+  for (auto& part : parts) {
+    total += part.seconds;
+    worst = std::max(worst,part.seconds);
+  }
+  if (total==0) return 1;
+  return worst / (total/parts.size());
+}
+
+void ThreadedSimulator::printImbalance(std::ostream& os) {
+  for (uint p=0; p<parts.size(); ++p) {
+    SimPartition& part = parts[p];
+    os << "partition " << p << ": " << part.nodes.size() << " nodes (" << part.numShared << " shared), ";
+    os << part.seqNodes.size() << " sequential, " << part.seconds << "s" << endl;
+  }
+  os << "imbalance (max/mean time): " << getImbalance() << endl;
+}
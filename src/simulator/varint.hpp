@@ -0,0 +1,45 @@
+#ifndef VARINT_HPP_
+#define VARINT_HPP_
+
+#include "coreir.h"
+
+namespace CoreIR {
+namespace Sim {
+
+//LEB128 encoding used by the binary simulator files (small values take a
+//single byte)
+inline void putVarint(std::string& buf, uint64_t v) {
+  while (v>=0x80) {
+    buf.push_back((char) ((v & 0x7f) | 0x80));
+    v >>= 7;
+  }
+  buf.push_back((char) v);
+}
+
+inline uint64_t getVarint(const std::string& buf, size_t& pos) {
+  uint64_t v = 0;
+  for (uint shift=0; ; shift+=7) {
+    ASSERT(pos<buf.size() && shift<64,"Truncated or corrupt file");
+    uint8_t byte = buf[pos++];
+    v |= ((uint64_t) (byte & 0x7f)) << shift;
+    if (!(byte & 0x80)) break;
+  }
+  return v;
+}
+
+//Fixed 8 bytes, little endian
+inline void putFixed64(std::string& buf, uint64_t v) {
+  for (uint i=0; i<8; ++i) buf.push_back((char) ((v>>(8*i)) & 0xff));
+}
+
+inline uint64_t getFixed64(const std::string& buf, size_t& pos) {
+  ASSERT(pos+8<=buf.size(),"Truncated or corrupt file");
+  uint64_t v = 0;
+  for (uint i=0; i<8; ++i) v |= ((uint64_t) (uint8_t) buf[pos++]) << (8*i);
+  return v;
+}
+
+}//Sim namespace
+}//CoreIR namespace
+
+#endif //VARINT_HPP_
@@ -0,0 +1,401 @@
+#include "coreir.h"
+#include "coreir-sim/waveform.h"
+#include "varint.hpp"
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+namespace {
+
+//Samples the simulator may run ahead of the writer thread
+const uint maxQueued = 256;
+//Bytes buffered before a write to the file
+const uint bufferSize = 1 << 20;
+
+const string blockMagic = "CWAV1\n";
+const string blockEndMagic = "CWAVEND\n";
+
+}
+
+namespace CoreIR {
+namespace Sim {
+
+//Formats events into a file. Only used by the writer thread
+class WaveSink {
+  std::ofstream fout;
+  string buf;
+  uint64_t written = 0;
+  public :
+    explicit WaveSink(string filename) : fout(filename,std::ios::binary) {
+      ASSERT(fout.is_open(),"Cannot open file: " + filename);
+    }
+    virtual ~WaveSink() {}
+    virtual void header(const vector<WaveSignal>& signals)=0;
+    virtual void write(const WaveEvent& e)=0;
+    virtual void finish() {
+      flush();
+      fout.close();
+    }
+  protected :
+    string& out() { return buf;}
+    //Bytes written so far (including the buffer)
+    uint64_t offset() { return written + buf.size();}
+    void maybeFlush() { if (buf.size()>=bufferSize) flush();}
+    void flush() {
+      fout.write(buf.data(),buf.size());
+      written += buf.size();
+      buf.clear();
+    }
+};
+
+class VcdSink : public WaveSink {
+  string top;
+  vector<string> ids;
+  vector<uint> widths;
+  //VCD has a single $dumpvars section, later snapshots are $dumpall
+  bool dumped = false;
+  public :
+    VcdSink(string filename, string top) : WaveSink(filename), top(top) {}
+    void header(const vector<WaveSignal>& signals) override;
+    void write(const WaveEvent& e) override;
+  private :
+    void value(uint sig, uint64_t v);
+};
+
+void VcdSink::header(const vector<WaveSignal>& signals) {
+  string& os = out();
+  os += "$version coreir-sim $end\n";
+  os += "$timescale 1ns $end\n";
+  os += "$scope module " + top + " $end\n";
+  //Signals are sorted by scope, so scopes are opened and closed in order
+  vector<string> cur;
+  for (uint i=0; i<signals.size(); ++i) {
+    const WaveSignal& s = signals[i];
+    uint common = 0;
+    while (common<cur.size() && common<s.scope.size() && cur[common]==s.scope[common]) common++;
+    while (cur.size()>common) {
+      os += "$upscope $end\n";
+      cur.pop_back();
+    }
+    while (cur.size()<s.scope.size()) {
+      cur.push_back(s.scope[cur.size()]);
+      os += "$scope module " + cur.back() + " $end\n";
+    }
+    //Identifiers are base 94 numbers in printable characters
+    string id;
+    uint n = i;
+    do {
+      id.push_back((char) ('!' + n%94));
+      n /= 94;
+    } while (n);
+    ids.push_back(id);
+    widths.push_back(s.width);
+    os += "$var wire " + to_string(s.width) + " " + id + " " + s.name + " $end\n";
+  }
+  for (uint i=0; i<cur.size(); ++i) os += "$upscope $end\n";
+  os += "$upscope $end\n";
+  os += "$enddefinitions $end\n";
+}
+
+void VcdSink::value(uint sig, uint64_t v) {
+  string& os = out();
+  if (widths[sig]==1) {
+    os.push_back(v ? '1' : '0');
+  }
+  else {
+    os.push_back('b');
+    int msb = 63;
+    while (msb>0 && !((v>>msb) & 1)) msb--;
+    for (int i=msb; i>=0; --i) os.push_back(((v>>i) & 1) ? '1' : '0');
+    os.push_back(' ');
+  }
+  os += ids[sig];
+  os.push_back('\n');
+}
+
+void VcdSink::write(const WaveEvent& e) {
+  string& os = out();
+  os += "#" + to_string(e.cycle) + "\n";
+  if (e.snapshot) {
+    os += dumped ? "$dumpall\n" : "$dumpvars\n";
+    dumped = true;
+  }
+  for (auto& change : e.changes) value(change.first,change.second);
+  if (e.snapshot) os += "$end\n";
+  maybeFlush();
+}
+
+//Header: magic, number of signals, then width, name length and name of each
+//Block: first cycle, value of every signal, then records of
+//  cycle delta, number of changes, (signal delta, value) per change
+//Index: number of blocks, then first cycle, last cycle and offset of each
+//Footer: offset of the index (8 bytes little endian) and the end magic
+class BlockSink : public WaveSink {
+  uint blockCycles;
+  vector<uint64_t> cur;
+  struct Entry {
+    uint64_t first;
+    uint64_t last;
+    uint64_t offset;
+  };
+  vector<Entry> index;
+  uint64_t prevCycle = 0;
+  public :
+    BlockSink(string filename, uint blockCycles) : WaveSink(filename), blockCycles(std::max(blockCycles,1u)) {}
+    void header(const vector<WaveSignal>& signals) override;
+    void write(const WaveEvent& e) override;
+    void finish() override;
+};
+
+void BlockSink::header(const vector<WaveSignal>& signals) {
+  string& os = out();
+  os += blockMagic;
+  putVarint(os,signals.size());
+  for (auto& s : signals) {
+    vector<string> path = s.scope;
+    path.push_back(s.name);
+    string name = join(path.begin(),path.end(),string("."));
+    putVarint(os,s.width);
+    putVarint(os,name.size());
+    os += name;
+  }
+  cur.assign(signals.size(),0);
+}
+
+void BlockSink::write(const WaveEvent& e) {
+  string& os = out();
+  for (auto& change : e.changes) cur[change.first] = change.second;
+  if (index.empty() || e.snapshot || e.cycle>=index.back().first+blockCycles) {
+    index.push_back({e.cycle,e.cycle,offset()});
+    putVarint(os,e.cycle);
+    for (auto v : cur) putVarint(os,v);
+  }
+  else {
+    putVarint(os,e.cycle-prevCycle);
+    putVarint(os,e.changes.size());
+    uint prevSig = 0;
+    for (auto& change : e.changes) {
+      putVarint(os,change.first-prevSig);
+      putVarint(os,change.second);
+      prevSig = change.first;
+    }
+    index.back().last = e.cycle;
+  }
+  prevCycle = e.cycle;
+  maybeFlush();
+}
+
+void BlockSink::finish() {
+  string& os = out();
+  uint64_t indexOffset = offset();
+  putVarint(os,index.size());
+  for (auto& entry : index) {
+    putVarint(os,entry.first);
+    putVarint(os,entry.last);
+    putVarint(os,entry.offset);
+  }
+  putFixed64(os,indexOffset);
+  os += blockEndMagic;
+  WaveSink::finish();
+}
+
+}//Sim namespace
+}//CoreIR namespace
+
+WaveformWriter::WaveformWriter(Simulator* sim, string filename, WaveOptions opts) : sim(sim), opts(opts) {
+  SimGraph* g = sim->getGraph();
+  for (uint slot=0; slot<g->slots.size(); ++slot) {
+    const SimSlot& s = g->slots[slot];
+    vector<string> path = splitString<vector<string>>(s.name,'.');
+    //Nets are named <instance path>.<port>, top level inputs self.<port>
+    //and cgralib.IO inputs by their instance path
+    uint scopeLen;
+    if (s.driver>=0) scopeLen = splitString<vector<string>>(g->nodes[s.driver].path,'.').size();
+    else if (path[0]=="self") scopeLen = 1;
+    else scopeLen = path.size()-1;
+    if (!selected(path)) continue;
+    vector<string> scope(path.begin(),path.begin()+scopeLen);
+    if (!scope.empty() && scope[0]=="self") scope.clear();
+    string name = join(path.begin()+scopeLen,path.end(),string("_"));
+    signals.push_back({scope,name,s.width,(int) slot,-1});
+  }
+  for (uint out=0; out<g->outputs.size(); ++out) {
+    vector<string> path = splitString<vector<string>>("self." + g->outputNames[out],'.');
+    if (!selected(path)) continue;
+    string name = join(path.begin()+1,path.end(),string("_"));
+    signals.push_back({{},name,g->outputs[out].width,-1,(int) out});
+  }
+  std::stable_sort(signals.begin(),signals.end(),[](const WaveSignal& a, const WaveSignal& b) {
+    if (a.scope!=b.scope) return a.scope<b.scope;
+    return a.name<b.name;
+  });
+  last.assign(signals.size(),0);
+
+  if (opts.format==WF_VCD) sink = new VcdSink(filename,g->getTop()->getName());
+  else sink = new BlockSink(filename,opts.blockCycles);
+  sink->header(signals);
+  writer = std::thread(&WaveformWriter::writerLoop,this);
+}
+
+WaveformWriter::~WaveformWriter() {
+  close();
+}
+
+bool WaveformWriter::selected(const vector<string>& path) {
+  if (opts.scopes.empty()) return true;
+  for (auto& scope : opts.scopes) {
+    if (scope.size()<=path.size() && std::equal(scope.begin(),scope.end(),path.begin())) return true;
+  }
+  return false;
+}
+
+void WaveformWriter::sample() {
+  ASSERT(!closed,"Waveform already closed");
+  uint64_t cycle = sim->getCycle();
+  bool record = opts.windows.empty();
+  for (auto& w : opts.windows) record |= w.first<=cycle && cycle<w.second;
+  if (!record) {
+    inWindow = false;
+    return;
+  }
+  //Entering a window dumps every value since changes outside were not recorded
+  WaveEvent e;
+  e.cycle = cycle;
+  e.snapshot = !inWindow;
+  for (uint i=0; i<signals.size(); ++i) {
+    const WaveSignal& s = signals[i];
+    uint64_t v = s.slot>=0 ? sim->getSlot(s.slot) : sim->getOutput(s.output);
+    if (e.snapshot || v!=last[i]) e.changes.push_back({i,v});
+    last[i] = v;
+  }
+  inWindow = true;
+  if (e.snapshot || !e.changes.empty()) push(std::move(e));
+}
+
+void WaveformWriter::push(WaveEvent&& e) {
+  std::unique_lock<std::mutex> lock(queueMutex);
+  queueCond.wait(lock,[this]() { return queue.size()<maxQueued;});
+  queue.push_back(std::move(e));
+  queueCond.notify_all();
+}
+
+void WaveformWriter::writerLoop() {
+  while (true) {
+    WaveEvent e;
+    {
+      std::unique_lock<std::mutex> lock(queueMutex);
+      queueCond.wait(lock,[this]() { return !queue.empty() || closing;});
+      if (queue.empty()) return;
+      e = std::move(queue.front());
+      queue.pop_front();
+      queueCond.notify_all();
+    }
+    sink->write(e);
+  }
+}
+
+void WaveformWriter::close() {
+  if (closed) return;
+  {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    closing = true;
+  }
+  queueCond.notify_all();
+  writer.join();
+  sink->finish();
+  delete sink;
+  closed = true;
+}
+
+WaveformReader::WaveformReader(string filename) : fin(filename,std::ios::binary) {
+  ASSERT(fin.is_open(),"Cannot open file: " + filename);
+  fin.seekg(0,std::ios::end);
+  uint64_t size = fin.tellg();
+  uint footer = 8 + blockEndMagic.size();
+  ASSERT(size>=blockMagic.size()+footer,"Not a waveform: " + filename);
+
+  //Footer
+  string tail(footer,0);
+  fin.seekg(size-footer);
+  fin.read(&tail[0],footer);
+  ASSERT(tail.substr(8)==blockEndMagic,"Incomplete waveform: " + filename);
+  size_t pos = 0;
+  uint64_t indexOffset = getFixed64(tail,pos);
+
+  //Index
+  string buf(size-footer-indexOffset,0);
+  fin.seekg(indexOffset);
+  fin.read(&buf[0],buf.size());
+  pos = 0;
+  uint64_t numBlocks = getVarint(buf,pos);
+  for (uint i=0; i<numBlocks; ++i) {
+    Block b;
+    b.first = getVarint(buf,pos);
+    b.last = getVarint(buf,pos);
+    b.offset = getVarint(buf,pos);
+    blocks.push_back(b);
+  }
+  for (uint i=0; i<blocks.size(); ++i) {
+    blocks[i].size = (i+1<blocks.size() ? blocks[i+1].offset : indexOffset) - blocks[i].offset;
+  }
+
+  //Header (everything before the first block)
+  uint64_t headerEnd = blocks.empty() ? indexOffset : blocks[0].offset;
+  buf.assign(headerEnd,0);
+  fin.seekg(0);
+  fin.read(&buf[0],buf.size());
+  ASSERT(buf.substr(0,blockMagic.size())==blockMagic,"Not a waveform: " + filename);
+  pos = blockMagic.size();
+  uint64_t numSignals = getVarint(buf,pos);
+  for (uint i=0; i<numSignals; ++i) {
+    widths.push_back(getVarint(buf,pos));
+    uint64_t len = getVarint(buf,pos);
+    names.push_back(buf.substr(pos,len));
+    pos += len;
+  }
+}
+
+int WaveformReader::getSignal(string name) {
+  for (uint i=0; i<names.size(); ++i) {
+    if (names[i]==name) return i;
+  }
+  return -1;
+}
+
+uint64_t WaveformReader::getFirstCycle() {
+  ASSERT(!blocks.empty(),"Empty waveform");
+  return blocks.front().first;
+}
+
+uint64_t WaveformReader::getLastCycle() {
+  ASSERT(!blocks.empty(),"Empty waveform");
+  return blocks.back().last;
+}
+
+vector<uint64_t> WaveformReader::valuesAt(uint64_t cycle) {
+  ASSERT(!blocks.empty() && cycle>=blocks[0].first,"Cycle " + to_string(cycle) + " is before the waveform");
+  //Last block starting at or before cycle
+  auto it = std::upper_bound(blocks.begin(),blocks.end(),cycle,[](uint64_t c, const Block& b) {
+    return c<b.first;
+  });
+  const Block& b = *(it-1);
+  string buf(b.size,0);
+  fin.clear();
+  fin.seekg(b.offset);
+  fin.read(&buf[0],buf.size());
+  size_t pos = 0;
+  uint64_t t = getVarint(buf,pos);
+  vector<uint64_t> values(names.size());
+  for (auto& v : values) v = getVarint(buf,pos);
+  while (pos<buf.size()) {
+    t += getVarint(buf,pos);
+    if (t>cycle) break;
+    uint64_t num = getVarint(buf,pos);
+    uint sig = 0;
+    for (uint i=0; i<num; ++i) {
+      sig += getVarint(buf,pos);
+      values[sig] = getVarint(buf,pos);
+    }
+  }
+  return values;
+}
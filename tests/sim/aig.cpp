@@ -0,0 +1,174 @@
+#include "coreir.h"
+#include "coreir-sim/equivalence.h"
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+//A module with the interface of the primitive and one instance of it
+Module* primModule(Context* c, string name, string prim, Args genargs) {
+  Type* t = c->getGenerator("coreir." + prim)->getTypeGen()->getType(genargs);
+  Module* m = c->getGlobal()->newModuleDecl(name,t);
+  ModuleDef* def = m->newModuleDef();
+    def->addInstance("p","coreir." + prim,genargs);
+    for (auto field : cast<RecordType>(t)->getFields()) {
+      def->connect("self." + field,"p." + field);
+    }
+  m->setDef(def);
+  return m;
+}
+
+//Registers with every control, constants and wiring prims
+Module* seqModule(Context* c, string name) {
+  Args w8({{"width",c->argInt(8)}});
+  Module* m = c->getGlobal()->newModuleDecl(name,c->Record({
+    {"clk",c->Named("coreir.clkIn")},
+    {"in",c->BitIn()->Arr(8)},
+    {"ctrl",c->BitIn()->Arr(3)},
+    {"out",c->Bit()->Arr(8)},
+    {"swapped",c->Bit()->Arr(8)},
+    {"unused",c->Bit()->Arr(4)},
+    {"lo",c->Bit()->Arr(4)}
+  }));
+  ModuleDef* def = m->newModuleDef();
+    def->addInstance("r","coreir.reg",{{"width",c->argInt(8)},{"en",c->argBool(true)},{"clr",c->argBool(true)}},{{"init",c->argInt(0x5a)}});
+    def->addInstance("r2","coreir.reg",{{"width",c->argInt(4)},{"rst",c->argBool(true)}},{{"init",c->argInt(9)}});
+    def->addInstance("k","coreir.const",w8,{{"value",c->argInt(-3)}});
+    def->addInstance("add","coreir.add",w8);
+    def->addInstance("xor","coreir.xor",w8);
+    def->addInstance("lo","coreir.slice",{{"width",c->argInt(8)},{"lo",c->argInt(0)},{"hi",c->argInt(4)}});
+    def->addInstance("hi","coreir.slice",{{"width",c->argInt(8)},{"lo",c->argInt(4)},{"hi",c->argInt(8)}});
+    def->addInstance("cat","coreir.concat",{{"width0",c->argInt(4)},{"width1",c->argInt(4)}});
+    def->addInstance("pt","coreir.passthrough",{{"type",c->argType(c->Bit()->Arr(8))}});
+    def->addInstance("dead","coreir.mul",w8);
+    def->connect("self.clk","r.clk");
+    def->connect("self.in","add.in0");
+    def->connect("r.out","add.in1");
+    def->connect("add.out","xor.in0");
+    def->connect("k.out","xor.in1");
+    def->connect("xor.out","r.in");
+    def->connect("self.ctrl.0","r.en");
+    def->connect("self.ctrl.1","r.clr");
+    def->connect("self.clk","r2.clk");
+    def->connect("lo.out","r2.in");
+    def->connect("self.ctrl.2","r2.rst");
+    def->connect("r2.out","self.lo");
+    def->connect("r.out","pt.in");
+    def->connect("pt.out","self.out");
+    def->connect("r.out","lo.in");
+    def->connect("r.out","hi.in");
+    def->connect("lo.out","cat.in0");
+    def->connect("hi.out","cat.in1");
+    def->connect("cat.out","self.swapped");
+    def->connect("r.out","dead.in0");
+    def->connect("self.in","dead.in1");
+    def->connect("k.out.0","self.unused.0");
+    def->connect("self.in.0","self.unused.1");
+    def->connect("self.ctrl.2","self.unused.2");
+    def->connect("r.out.7","self.unused.3");
+  m->setDef(def);
+  return m;
+}
+
+//Lowers m, lifts it into a copy and checks both behave the same
+void checkLifted(Module* m, uint cycles) {
+  Aig aig;
+  lowerToAig(m,aig);
+  uint ands = aig.getNumAnds();
+  aig.cleanup();
+  ASSERT(aig.getNumAnds()<=ands,"cleanup added ands");
+  Module* lifted = m->getNamespace()->newModuleDecl(m->getName() + "_aig",m->getType());
+  lifted->setDef(liftAig(aig,lifted));
+  EquivOptions opts;
+  opts.cycles = cycles;
+  EquivResult res = checkEquivalence(m,lifted,opts);
+  ASSERT(res.error=="","Cannot compare " + m->getName() + ": " + res.error);
+  ASSERT(res.equivalent,m->getName() + " lowered to an Aig differs on " + SelectPath2Str(res.output) + " in cycle " + to_string(res.cycle));
+}
+
+int main() {
+  Context* c = newContext();
+
+  //Structural hashing
+  {
+    Aig aig;
+    AigLit a = aig.newInput("a");
+    AigLit b = aig.newInput("b");
+    AigLit ab = aig.And(a,b);
+    ASSERT(aig.And(b,a)==ab && aig.getNumAnds()==1,"Expected the same and");
+    ASSERT(aig.And(a,Aig::Not(a))==Aig::False && aig.And(a,Aig::True)==a && aig.And(a,a)==a,"Expected constant folding");
+    AigLit x = aig.Xor(a,b);
+    ASSERT(aig.Xor(a,b)==x,"Expected the same xor");
+    aig.newOutput("ab",ab);
+    ASSERT(aig.getNumAnds()==4,"Expected 4 ands");
+    aig.cleanup();
+    ASSERT(aig.getNumAnds()==1 && aig.getNumNodes()==4,"Expected the xor to be removed");
+    ASSERT(Aig::node(aig.getOutputs()[0])==3,"Expected the and after the inputs");
+  }
+
+  //Every op (64 random stimuli per cycle)
+  vector<string> ops = {"not","neg","andr","orr","xorr","and","or","xor","dshl","dlshr","dashr","add","sub","mul","udiv","urem","sdiv","srem","smod","eq","slt","sgt","sle","sge","ult","ugt","ule","uge","mux"};
+  for (auto op : ops) {
+    for (uint width : {1,3,8}) {
+      checkLifted(primModule(c,"Aig_" + op + to_string(width),op,{{"width",c->argInt(width)}}),100);
+    }
+  }
+
+  //Sequential logic. The unused multiplier is removed by cleanup
+  Module* seq = seqModule(c,"AigSeq");
+  checkLifted(seq,1000);
+  {
+    Aig aig;
+    lowerToAig(seq,aig);
+    ASSERT(aig.getLatches().size()==12 && aig.getInputs().size()==11 && aig.getOutputs().size()==24,"Bad interface");
+    ASSERT(aig.getInputNames()[0]=="in.0" && aig.getLatchNames()[0]=="r.out.0","Bad names");
+    uint ands = aig.getNumAnds();
+    aig.cleanup();
+    ASSERT(aig.getNumAnds()<ands/2,"Expected the multiplier to be removed");
+  }
+
+  //AIGER round trip
+  {
+    Aig aig;
+    lowerToAig(seq,aig);
+    aig.cleanup();
+    std::stringstream ss;
+    writeAiger(aig,ss);
+    Aig read;
+    readAiger(ss,read);
+    ASSERT(read.getNumAnds()==aig.getNumAnds() && read.getLatchNames()==aig.getLatchNames() && read.getOutputNames()==aig.getOutputNames(),"AIGER changed the Aig");
+    Module* lifted = c->getGlobal()->newModuleDecl("AigRead",seq->getType());
+    lifted->setDef(liftAig(read,lifted));
+    ASSERT(checkEquivalence(seq,lifted).equivalent,"AIGER round trip changed the behavior");
+
+    std::stringstream blif;
+    writeBlif(aig,blif,"AigSeq");
+    string text = blif.str();
+    ASSERT(text.find(".model AigSeq\n")==0 && text.find(".latch aig_l0_next r.out.0 0\n")!=string::npos,"Bad BLIF header");
+    uint names = 0;
+    for (size_t pos=0; (pos=text.find(".names",pos))!=string::npos; ++pos) names++;
+    ASSERT(names==aig.getNumAnds() + aig.getLatches().size() + aig.getOutputs().size(),"Bad BLIF gates");
+  }
+  //Ascii AIGER: a toggling latch with init 1 and an uninitialized one
+  {
+    std::stringstream ss("aag 4 1 2 2 1\n2\n4 5 1\n6 8 6\n4\n9\n8 2 4\ni0 en\no1 y\nc\ncomment\n");
+    Aig aig;
+    readAiger(ss,aig);
+    ASSERT(aig.getInputNames()[0]=="en" && aig.getOutputNames()[0]=="o0" && aig.getOutputNames()[1]=="y","Bad names");
+    ASSERT(aig.getLatchInits()[0] && !aig.getLatchInits()[1] && aig.getLatchNexts()[0]==Aig::Not(aig.getLatches()[0]*2),"Bad latches");
+    ASSERT(aig.getNumAnds()==1 && aig.getOutputs()[1]==Aig::Not(aig.getLatchNexts()[1]),"Bad ands");
+  }
+
+  //bitblast replaces the module in place
+  Module* blasted = seqModule(c,"AigBlasted");
+  c->runPasses({"bitblast"});
+  for (auto imap : blasted->getDef()->getInstances()) {
+    string name = coreirPrimName(imap.second);
+    ASSERT(name=="and" || name=="not" || name=="const" || name=="reg","Unexpected " + name);
+    ASSERT(getInstanceArg(imap.second,"width")->get<ArgInt>()==1,"Expected 1 bit instances");
+  }
+  Module* ref = seqModule(c,"AigRef");
+  ASSERT(checkEquivalence(ref,blasted).equivalent,"bitblast changed the behavior");
+
+  deleteContext(c);
+  return 0;
+}
@@ -0,0 +1,107 @@
+#include "coreir.h"
+#include "coreir-lib/cgralib.h"
+#include "coreir-sim/simulator.h"
+#include "coreir-sim/interpsim.h"
+#include "coreir-sim/bitparallelsim.h"
+#include <random>
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+//Every op at an odd width feeding a register with en and clr
+Module* opsModule(Context* c) {
+  uint n = 11;
+  vector<string> ops = {"not","neg","andr","orr","xorr","and","or","xor","dshl","dlshr","dashr","add","sub","mul","udiv","urem","sdiv","srem","smod","eq","slt","sgt","sle","sge","ult","ugt","ule","uge","mux"};
+  RecordParams rp({{"in0",c->BitIn()->Arr(n)},{"in1",c->BitIn()->Arr(n)},{"ctrl",c->BitIn()->Arr(3)},{"r",c->Bit()->Arr(n)}});
+  for (auto op : ops) rp.push_back({op,c->Bit()->Arr(PrimOps::hasBitOutput(PrimOps::str2Op(op)) ? 1 : n)});
+  Module* m = c->getGlobal()->newModuleDecl("LaneOps",c->Record(rp));
+  ModuleDef* def = m->newModuleDef();
+    for (auto op : ops) {
+      PrimOps::Op pop = PrimOps::str2Op(op);
+      def->addInstance(op,"coreir." + op,{{"width",c->argInt(n)}});
+      if (PrimOps::numOperands(pop)==1) {
+        def->connect("self.in0",op + ".in");
+      }
+      else {
+        def->connect("self.in0",op + ".in0");
+        def->connect("self.in1",op + ".in1");
+      }
+      if (pop==PrimOps::OP_mux) def->connect("self.ctrl.0",op + ".sel");
+      def->connect(op + ".out",PrimOps::hasBitOutput(pop) ? "self." + op + ".0" : "self." + op);
+    }
+    def->addInstance("acc","coreir.reg",{{"width",c->argInt(n)},{"en",c->argBool(true)},{"clr",c->argBool(true)}},{{"init",c->argInt(3)}});
+    def->addInstance("sum","coreir.add",{{"width",c->argInt(n)}});
+    def->connect("acc.out","sum.in0");
+    def->connect("mul.out","sum.in1");
+    def->connect("sum.out","acc.in");
+    def->connect("self.ctrl.1","acc.en");
+    def->connect("self.ctrl.2","acc.clr");
+    def->connect("acc.out","self.r");
+  m->setDef(def);
+  return m;
+}
+
+Module* linebufferModule(Context* c) {
+  Module* top = c->getGlobal()->newModuleDecl("LaneLB",c->Record({
+    {"in",c->BitIn()->Arr(8)},
+    {"out",c->Bit()->Arr(8)->Arr(2)->Arr(3)}
+  }));
+  ModuleDef* def = top->newModuleDef();
+    def->addInstance("lb","cgralib.Linebuffer",{
+      {"stencil_width",c->argInt(2)},
+      {"stencil_height",c->argInt(3)},
+      {"image_width",c->argInt(5)},
+      {"bitwidth",c->argInt(8)}
+    });
+    def->connect("self.in","lb.in");
+    def->connect("lb.out","self.out");
+  top->setDef(def);
+  return top;
+}
+
+//Random stimuli of different lengths
+vector<Trace> randomStimuli(SimGraph* g, uint num, uint cycles) {
+  std::mt19937_64 rng(11);
+  vector<Trace> ret(num);
+  for (uint s=0; s<num; ++s) {
+    ret[s].assign(cycles - s%5,vector<uint64_t>(g->inputs.size()));
+    for (auto& ins : ret[s]) {
+      for (auto& v : ins) v = rng();
+    }
+  }
+  return ret;
+}
+
+int main() {
+  Context* c = newContext();
+  CoreIRLoadLibrary_cgralib(c);
+  for (auto m : {opsModule(c),linebufferModule(c)}) {
+    SimGraph graph(m);
+    //More stimuli than lanes to get a partial second batch
+    vector<Trace> stimuli = randomStimuli(&graph,BitParallelSimulator::numLanes+9,40);
+    InterpSimulator interp(&graph);
+    BitParallelSimulator bits(&graph);
+    ASSERT(bits.getNumLanes()==64,"Expected 64 lanes");
+    vector<Trace> expected = simulateBatch(&interp,stimuli);
+    vector<Trace> got = simulateBatch(&bits,stimuli);
+    for (uint s=0; s<stimuli.size(); ++s) {
+      for (uint cycle=0; cycle<stimuli[s].size(); ++cycle) {
+        for (uint idx=0; idx<graph.outputs.size(); ++idx) {
+          ASSERT(expected[s][cycle][idx]==got[s][cycle][idx],"Mismatch on " + graph.outputNames[idx] + " of stimulus " + to_string(s) + " in cycle " + to_string(cycle));
+        }
+      }
+    }
+  }
+
+  //setInput drives every lane
+  SimGraph graph(c->getGlobal()->getModule("LaneOps"));
+  BitParallelSimulator bits(&graph);
+  bits.setValue("in0",100);
+  bits.setValue("in1",7);
+  for (uint lane : {0,17,63}) {
+    ASSERT(bits.getOutputLane(graph.getOutput("udiv"),lane)==14,"Bad udiv");
+    ASSERT(bits.getOutputLane(graph.getOutput("mul"),lane)==700,"Bad mul");
+  }
+  deleteContext(c);
+  return 0;
+}
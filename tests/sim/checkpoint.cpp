@@ -0,0 +1,117 @@
+#include "coreir.h"
+#include "coreir-lib/cgralib.h"
+#include "coreir-sim/simulator.h"
+#include "coreir-sim/checkpoint.h"
+#include "coreir-sim/compiledsim.h"
+#include <fstream>
+#include <random>
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+//A linebuffer, a counter and a memory written at the counter address
+Module* warmModule(Context* c) {
+  Module* top = c->getGlobal()->newModuleDecl("WarmTop",c->Record({
+    {"in",c->BitIn()->Arr(16)},
+    {"wen",c->BitIn()},
+    {"out",c->Bit()->Arr(16)->Arr(3)->Arr(3)},
+    {"count",c->Bit()->Arr(16)},
+    {"rdata",c->Bit()->Arr(16)}
+  }));
+  ModuleDef* def = top->newModuleDef();
+    def->addInstance("lb","cgralib.Linebuffer",{
+      {"stencil_width",c->argInt(3)},
+      {"stencil_height",c->argInt(3)},
+      {"image_width",c->argInt(8)},
+      {"bitwidth",c->argInt(16)}
+    });
+    def->addInstance("r","coreir.reg",{{"width",c->argInt(16)}},{{"init",c->argInt(3)}});
+    def->addInstance("add","coreir.add",{{"width",c->argInt(16)}});
+    def->addInstance("one","coreir.const",{{"width",c->argInt(16)}},{{"value",c->argInt(1)}});
+    def->addInstance("m","cgralib.Mem",{{"width",c->argInt(16)},{"depth",c->argInt(16)}},{{"mode",c->argString("o")}});
+    def->connect("self.in","lb.in");
+    def->connect("lb.out","self.out");
+    def->connect("r.out","add.in0");
+    def->connect("one.out","add.in1");
+    def->connect("add.out","r.in");
+    def->connect("r.out","self.count");
+    def->connect("r.out","m.addr");
+    def->connect("self.in","m.wdata");
+    def->connect("self.wen","m.wen");
+    def->connect("m.rdata","self.rdata");
+  top->setDef(def);
+  return top;
+}
+
+//Inputs of the cycles after the checkpoint
+Trace stimulus(SimGraph* g, uint cycles) {
+  std::mt19937_64 rng(11);
+  Trace ret;
+  for (uint i=0; i<cycles; ++i) {
+    vector<uint64_t> ins;
+    for (uint in=0; in<g->inputs.size(); ++in) ins.push_back(rng());
+    ret.push_back(ins);
+  }
+  return ret;
+}
+
+Trace run(Simulator* sim, const Trace& ins) {
+  Trace ret;
+  SimGraph* g = sim->getGraph();
+  for (auto& cycle : ins) {
+    for (uint in=0; in<cycle.size(); ++in) sim->setInput(in,cycle[in]);
+    vector<uint64_t> outs;
+    for (uint out=0; out<g->outputs.size(); ++out) outs.push_back(sim->getOutput(out));
+    ret.push_back(outs);
+    sim->step();
+  }
+  return ret;
+}
+
+string readFile(string filename) {
+  std::ifstream fin(filename,std::ios::binary);
+  std::ostringstream buf;
+  buf << fin.rdbuf();
+  return buf.str();
+}
+
+int main() {
+  Context* c = newContext();
+  CoreIRLoadLibrary_cgralib(c);
+  SimGraph graph(warmModule(c));
+
+  //Warm up
+  Simulator* warm = newSimulator(&graph);
+  Trace warmup = stimulus(&graph,50);
+  run(warm,warmup);
+  saveCheckpoint(warm,"_ckpt.bin");
+  Trace ins = stimulus(&graph,20);
+  Trace expected = run(warm,ins);
+  saveCheckpoint(warm,"_ckpt_end.bin");
+
+  for (string engine : {"interp","bitparallel","threaded","hier","compiled"}) {
+    Simulator* sim = engine=="compiled" ? new CompiledSimulator(&graph,"_simcache") : newSimulator(&graph,engine);
+    //Restoring overwrites everything, including state from earlier runs
+    run(sim,stimulus(&graph,7));
+    loadCheckpoint(sim,"_ckpt.bin");
+    ASSERT(sim->getCycle()==50,"Bad cycle after restore with " + engine);
+    ASSERT(run(sim,ins)==expected,"Mismatch after restore with " + engine);
+    ASSERT(sim->getCycle()==70,"Bad cycle with " + engine);
+    //Every engine writes the same checkpoint for the same state
+    saveCheckpoint(sim,"_ckpt_" + engine + ".bin");
+    ASSERT(readFile("_ckpt_" + engine + ".bin")==readFile("_ckpt_end.bin"),"Different checkpoint from " + engine);
+    delete sim;
+  }
+
+  //Every lane continues from the checkpoint
+  Simulator* lanes = newSimulator(&graph,"bitparallel");
+  loadCheckpoint(lanes,"_ckpt.bin");
+  for (uint lane=0; lane<lanes->getNumLanes(); ++lane) {
+    ASSERT(lanes->getOutputLane(graph.getOutput("count"),lane)==53,"Bad lane " + to_string(lane));
+  }
+  delete lanes;
+
+  delete warm;
+  deleteContext(c);
+  return 0;
+}
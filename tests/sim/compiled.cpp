@@ -0,0 +1,116 @@
+#include "coreir.h"
+#include "coreir-lib/cgralib.h"
+#include "coreir-sim/simulator.h"
+#include "coreir-sim/interpsim.h"
+#include "coreir-sim/compiledsim.h"
+#include <random>
+#include <cstdlib>
+#include <sys/stat.h>
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+//Drives both engines with the same random inputs and compares every net
+void compareEngines(SimGraph* g, Simulator* a, Simulator* b, uint cycles) {
+  std::mt19937_64 rng(7);
+  for (uint i=0; i<cycles; ++i) {
+    for (uint in=0; in<g->inputs.size(); ++in) {
+      uint64_t v = rng();
+      a->setInput(in,v);
+      b->setInput(in,v);
+    }
+    for (uint out=0; out<g->outputs.size(); ++out) {
+      ASSERT(a->getOutput(out)==b->getOutput(out),"Mismatch on " + g->outputNames[out] + " in cycle " + to_string(i));
+    }
+    for (uint slot=0; slot<g->slots.size(); ++slot) {
+      ASSERT(a->getSlot(slot)==b->getSlot(slot),"Mismatch on " + g->slots[slot].name + " in cycle " + to_string(i));
+    }
+    a->step();
+    b->step();
+  }
+}
+
+//Every op at an odd width, plus registers with all the optional ports
+Module* opsModule(Context* c) {
+  uint n = 13;
+  vector<string> ops = {"not","neg","andr","orr","xorr","and","or","xor","dshl","dlshr","dashr","add","sub","mul","udiv","urem","sdiv","srem","smod","eq","slt","sgt","sle","sge","ult","ugt","ule","uge","mux"};
+  RecordParams rp({{"in0",c->BitIn()->Arr(n)},{"in1",c->BitIn()->Arr(n)},{"in2",c->BitIn()->Arr(4)},{"r",c->Bit()->Arr(n)}});
+  for (auto op : ops) rp.push_back({op,c->Bit()->Arr(PrimOps::hasBitOutput(PrimOps::str2Op(op)) ? 1 : n)});
+  Module* m = c->getGlobal()->newModuleDecl("AllOps",c->Record(rp));
+  ModuleDef* def = m->newModuleDef();
+    for (auto op : ops) {
+      def->addInstance(op,"coreir." + op,{{"width",c->argInt(n)}});
+      PrimOps::Op pop = PrimOps::str2Op(op);
+      if (PrimOps::numOperands(pop)==1) {
+        def->connect("self.in0",op + ".in");
+      }
+      else {
+        def->connect("self.in0",op + ".in0");
+        def->connect("self.in1",op + ".in1");
+      }
+      if (pop==PrimOps::OP_mux) def->connect("self.in2.0",op + ".sel");
+      if (PrimOps::hasBitOutput(pop)) {
+        def->connect(op + ".out","self." + op + ".0");
+      }
+      else {
+        def->connect(op + ".out","self." + op);
+      }
+    }
+    //r = reg(reg(mul + add))
+    def->addInstance("r0","coreir.reg",{{"width",c->argInt(n)},{"en",c->argBool(true)},{"clr",c->argBool(true)}},{{"init",c->argInt(5)}});
+    def->addInstance("r1","coreir.reg",{{"width",c->argInt(n)},{"rst",c->argBool(true)}},{{"init",c->argInt(9)}});
+    def->addInstance("sum","coreir.add",{{"width",c->argInt(n)}});
+    def->connect("mul.out","sum.in0");
+    def->connect("add.out","sum.in1");
+    def->connect("sum.out","r0.in");
+    def->connect("self.in2.1","r0.en");
+    def->connect("self.in2.2","r0.clr");
+    def->connect("self.in2.3","r1.rst");
+    def->connect("r0.out","r1.in");
+    def->connect("r1.out","self.r");
+  m->setDef(def);
+  return m;
+}
+
+Module* linebufferModule(Context* c) {
+  Module* top = c->getGlobal()->newModuleDecl("LB3x3",c->Record({
+    {"in",c->BitIn()->Arr(16)},
+    {"out",c->Bit()->Arr(16)->Arr(3)->Arr(3)}
+  }));
+  ModuleDef* def = top->newModuleDef();
+    def->addInstance("lb","cgralib.Linebuffer",{
+      {"stencil_width",c->argInt(3)},
+      {"stencil_height",c->argInt(3)},
+      {"image_width",c->argInt(10)},
+      {"bitwidth",c->argInt(16)}
+    });
+    def->connect("self.in","lb.in");
+    def->connect("lb.out","self.out");
+  top->setDef(def);
+  return top;
+}
+
+int main() {
+  Context* c = newContext();
+  CoreIRLoadLibrary_cgralib(c);
+  string cacheDir = "_simcache";
+  for (auto m : {opsModule(c),linebufferModule(c)}) {
+    SimGraph graph(m);
+    InterpSimulator interp(&graph);
+    CompiledSimulator compiled(&graph,cacheDir);
+    compareEngines(&graph,&interp,&compiled,200);
+
+    //The second time the shared object comes from the cache
+    CompiledSimulator again(&graph,cacheDir);
+    ASSERT(again.wasCached(),"Expected a cache hit");
+    ASSERT(again.getLibName()==compiled.getLibName(),"Different cache entries");
+  }
+  //The cache is private to the user
+  struct stat st;
+  ASSERT(stat(cacheDir.c_str(),&st)==0 && !(st.st_mode & 077),"Cache directory accessible by others");
+  unsetenv("COREIR_SIM_CACHE");
+  setenv("XDG_CACHE_HOME","_xdg",1);
+  ASSERT(defaultSimCacheDir()=="_xdg/coreir-sim","Bad default cache directory");
+  deleteContext(c);
+  return 0;
+}
@@ -0,0 +1,149 @@
+#include "coreir.h"
+#include "coreir-sim/equivalence.h"
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+//A hierarchical design with nested port types: an accumulator module used
+//twice (the second one on the difference of the inputs)
+Module* design(Context* c) {
+  Namespace* g = c->getGlobal();
+  Module* acc = g->newModuleDecl("EqAcc",c->Record({
+    {"in",c->Record({{"x",c->BitIn()->Arr(8)},{"y",c->BitIn()->Arr(8)}})},
+    {"out",c->Bit()->Arr(8)}
+  }));
+  ModuleDef* def = acc->newModuleDef();
+    def->addInstance("r","coreir.reg",{{"width",c->argInt(8)}});
+    def->addInstance("add","coreir.add",{{"width",c->argInt(8)}});
+    def->addInstance("mul","coreir.mul",{{"width",c->argInt(8)}});
+    def->connect("self.in.x","mul.in0");
+    def->connect("self.in.y","mul.in1");
+    def->connect("mul.out","add.in0");
+    def->connect("r.out","add.in1");
+    def->connect("add.out","r.in");
+    def->connect("r.out","self.out");
+  acc->setDef(def);
+
+  Module* top = g->newModuleDecl("EqTop",c->Record({
+    {"in",c->BitIn()->Arr(8)->Arr(2)},
+    {"out",c->Bit()->Arr(8)->Arr(2)}
+  }));
+  def = top->newModuleDef();
+    def->addInstance("a0",acc);
+    def->addInstance("a1",acc);
+    def->addInstance("sub","coreir.sub",{{"width",c->argInt(8)}});
+    def->connect("self.in.0","a0.in.x");
+    def->connect("self.in.1","a0.in.y");
+    def->connect("self.in.0","sub.in0");
+    def->connect("self.in.1","sub.in1");
+    def->connect("sub.out","a1.in.x");
+    def->connect("self.in.1","a1.in.y");
+    def->connect("a0.out","self.out.0");
+    def->connect("a1.out","self.out.1");
+  top->setDef(def);
+  return top;
+}
+
+//Constants mixed into logic on the inputs
+Module* constDesign(Context* c) {
+  Args w8({{"width",c->argInt(8)}});
+  Module* top = c->getGlobal()->newModuleDecl("EqConst",c->Record({
+    {"in",c->BitIn()->Arr(8)},
+    {"sel",c->BitIn()},
+    {"out",c->Bit()->Arr(8)->Arr(3)}
+  }));
+  ModuleDef* def = top->newModuleDef();
+    def->addInstance("k0","coreir.const",w8,{{"value",c->argInt(0x0f)}});
+    def->addInstance("k1","coreir.const",w8,{{"value",c->argInt(3)}});
+    def->addInstance("kz","coreir.const",w8,{{"value",c->argInt(0)}});
+    def->addInstance("and","coreir.and",w8);
+    def->addInstance("xor","coreir.xor",w8);
+    def->addInstance("sub","coreir.sub",w8);
+    def->addInstance("mux","coreir.mux",w8);
+    def->addInstance("r","coreir.reg",{{"width",c->argInt(8)},{"en",c->argBool(true)}},{{"init",c->argInt(3)}});
+    def->connect("self.in","and.in0");
+    def->connect("k0.out","and.in1");
+    def->connect("k0.out","sub.in0");
+    def->connect("k1.out","sub.in1");
+    def->connect("and.out","xor.in0");
+    def->connect("kz.out","xor.in1");
+    def->connect("xor.out","mux.in0");
+    def->connect("sub.out","mux.in1");
+    def->connect("self.sel","mux.sel");
+    def->connect("mux.out","self.out.0");
+    def->connect("k1.out","r.in");
+    def->connect("self.sel","r.en");
+    def->connect("r.out","self.out.1");
+    def->connect("sub.out","self.out.2");
+  top->setDef(def);
+  return top;
+}
+
+int main() {
+  Context* c = newContext();
+  Module* top = design(c);
+  saveToFile(c->getGlobal(),"_equiv.json",top);
+
+  //The same design after flatten and flattentypes
+  Context* c2 = newContext();
+  Module* top2;
+  ASSERT(loadFromFile(c2,"_equiv.json",&top2),"Cannot load _equiv.json");
+  c2->runPasses({"rungenerators","flatten","flattentypes"});
+  ASSERT(top2->getDef()->getInstances().count("a0$add"),"Expected a flattened design");
+  ASSERT(cast<RecordType>(top2->getType())->getRecord().count("in_0"),"Expected flattened ports");
+  EquivOptions opts;
+  opts.cycles = 50;
+  opts.runs = 2;
+  EquivResult res = checkEquivalence(top,top2,opts);
+  ASSERT(res.equivalent,"Flattening changed the behavior: " + res.error);
+
+  //Swap an op deep inside: only out.1 reads it. The accumulator starts at
+  //0, so the first difference is in cycle 2
+  Instance* add = top2->getDef()->getInstances()["a1$add"];
+  Instance* sub = top2->getDef()->addInstance("bad","coreir.sub",{{"width",c2->argInt(8)}});
+  for (auto con : add->getLocalConnections()) {
+    top2->getDef()->connect(sub->sel(con.first->getSelectPath().back()),con.second);
+  }
+  top2->getDef()->removeInstance(add);
+  res = checkEquivalence(top,top2,opts);
+  ASSERT(!res.equivalent && res.error=="","Expected a mismatch");
+  ASSERT(res.cycle==2,"Bad cycle of the mismatch: " + to_string(res.cycle));
+  ASSERT(res.output==SelectPath({"self","out","1"}),"Bad output of the mismatch");
+  ASSERT(res.valueA!=res.valueB && res.stimulus.size()==3,"Bad mismatch");
+  //The stimulus reproduces it
+  uint64_t expected = 0;
+  for (uint i=0; i<2; ++i) {
+    uint64_t x = res.stimulus[i][0], y = res.stimulus[i][1];
+    expected += (x-y)*y;
+  }
+  ASSERT(res.valueA==(expected & 0xff),"Bad value of a");
+
+  //Constant folding
+  Module* k = constDesign(c);
+  saveToFile(c->getGlobal(),"_equiv.json",k);
+  Context* c3 = newContext();
+  Module* k3;
+  ASSERT(loadFromFile(c3,"_equiv.json",&k3),"Cannot load _equiv.json");
+  ASSERT(c3->runPasses({"constfold"}),"Expected constfold to modify EqConst");
+  ASSERT(k3->getDef()->getInstances().size()<k->getDef()->getInstances().size(),"Expected fewer instances");
+  res = checkEquivalence(k,k3,opts);
+  ASSERT(res.equivalent,"Constant folding changed the behavior: " + res.error);
+  deleteContext(c3);
+
+  //Interfaces that cannot be matched
+  Module* other = c2->getGlobal()->newModuleDecl("Other",c2->Record({{"in",c2->BitIn()->Arr(8)}}));
+  other->setDef(other->newModuleDef());
+  res = checkEquivalence(top,other,opts);
+  ASSERT(!res.equivalent && res.error!="","Expected an interface error");
+  Module* narrow = c2->getGlobal()->newModuleDecl("Narrow",c2->Record({
+    {"in",c2->BitIn()->Arr(8)->Arr(2)},
+    {"out",c2->Bit()->Arr(4)->Arr(2)}
+  }));
+  narrow->setDef(narrow->newModuleDef());
+  res = checkEquivalence(top,narrow,opts);
+  ASSERT(!res.equivalent && res.error=="Output out.0 has different widths","Expected an output width error: " + res.error);
+
+  deleteContext(c);
+  deleteContext(c2);
+  return 0;
+}
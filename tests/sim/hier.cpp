@@ -0,0 +1,128 @@
+#include "coreir.h"
+#include "coreir-lib/cgralib.h"
+#include "coreir-sim/simulator.h"
+#include "coreir-sim/interpsim.h"
+#include "coreir-sim/hiersim.h"
+#include <random>
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+//A row of numTiles identical tiles, each accumulating a mix of its
+//neighbour's output and the input, followed by a linebuffer
+Module* tiles(Context* c, uint numTiles) {
+  uint n = 16;
+  Namespace* g = c->getGlobal();
+  Module* tile = g->newModuleDecl("HierTile",c->Record({
+    {"in",c->BitIn()->Arr(n)},
+    {"x",c->BitIn()->Arr(n)},
+    {"sel",c->BitIn()},
+    {"out",c->Bit()->Arr(n)}
+  }));
+  ModuleDef* def = tile->newModuleDef();
+    def->addInstance("r","coreir.reg",{{"width",c->argInt(n)}},{{"init",c->argInt(3)}});
+    def->addInstance("mul","coreir.mul",{{"width",c->argInt(n)}});
+    def->addInstance("add","coreir.add",{{"width",c->argInt(n)}});
+    def->addInstance("shr","coreir.dlshr",{{"width",c->argInt(n)}});
+    def->addInstance("mux","coreir.mux",{{"width",c->argInt(n)}});
+    def->connect("self.in","mul.in0");
+    def->connect("r.out","mul.in1");
+    def->connect("mul.out","add.in0");
+    def->connect("self.x","add.in1");
+    def->connect("add.out","shr.in0");
+    def->connect("self.x","shr.in1");
+    def->connect("add.out","mux.in0");
+    def->connect("shr.out","mux.in1");
+    def->connect("self.sel","mux.sel");
+    def->connect("mux.out","r.in");
+    def->connect("r.out","self.out");
+  tile->setDef(def);
+
+  Module* top = g->newModuleDecl("HierTop",c->Record({
+    {"in",c->BitIn()->Arr(n)},
+    {"sel",c->BitIn()},
+    {"out",c->Bit()->Arr(n)},
+    {"stencil",c->Bit()->Arr(n)->Arr(3)->Arr(3)}
+  }));
+  def = top->newModuleDef();
+    string prev = "self.in";
+    for (uint i=0; i<numTiles; ++i) {
+      string t = "t" + to_string(i);
+      def->addInstance(t,tile);
+      def->connect(prev,t + ".in");
+      def->connect("self.in",t + ".x");
+      def->connect("self.sel",t + ".sel");
+      prev = t + ".out";
+    }
+    def->connect(prev,"self.out");
+    def->addInstance("lb","cgralib.Linebuffer",{
+      {"stencil_width",c->argInt(3)},
+      {"stencil_height",c->argInt(3)},
+      {"image_width",c->argInt(8)},
+      {"bitwidth",c->argInt(16)}
+    });
+    def->connect(prev,"lb.in");
+    def->connect("lb.out","self.stencil");
+  top->setDef(def);
+  return top;
+}
+
+int main() {
+  Context* c = newContext();
+  CoreIRLoadLibrary_cgralib(c);
+  uint numTiles = 32;
+  SimGraph graph(tiles(c,numTiles));
+  InterpSimulator ref(&graph);
+  HierSimulator sim(&graph);
+
+  //The tile is elaborated once and its nets inside read the same slots
+  //relative to the instance
+  bool tileNodes = false;
+  for (auto& m : sim.getModules()) {
+    if (m.def->getModule()->getName()!="HierTile") continue;
+    ASSERT(m.numInsts==numTiles && m.nodes.size()==5,"Tile not shared");
+    for (auto t : m.nodes) {
+      const HierNode& h = sim.getNodes()[t];
+      if (h.proto->inst->getInstname()!="mux") continue;
+      //sel comes from the top
+      ASSERT(h.ins[0].shared && h.ins[1].shared && !h.ins[2].shared,"Bad tile inputs");
+    }
+    tileNodes = true;
+  }
+  ASSERT(tileNodes && sim.getNodes().size()<graph.nodes.size()/4,"Too many nodes");
+
+  //Every primitive of the tile is one batch
+  uint tileBatched = 0;
+  for (auto& b : sim.getBatches()) {
+    if (b.size==numTiles) tileBatched += b.size;
+  }
+  ASSERT(tileBatched>=4*numTiles,"Tiles were not batched");
+  ASSERT(sim.getBatches().size()<graph.nodes.size()/4,"Too many batches");
+
+  std::mt19937_64 rng(7);
+  for (uint cycle=0; cycle<200; ++cycle) {
+    for (uint in=0; in<graph.inputs.size(); ++in) {
+      uint64_t v = rng();
+      ref.setInput(in,v);
+      sim.setInput(in,v);
+    }
+    for (uint slot=0; slot<graph.slots.size(); ++slot) {
+      ASSERT(ref.getSlot(slot)==sim.getSlot(slot),"Mismatch on " + graph.slots[slot].name + " in cycle " + to_string(cycle));
+    }
+    for (uint out=0; out<graph.outputs.size(); ++out) {
+      ASSERT(ref.getOutput(out)==sim.getOutput(out),"Mismatch on " + graph.outputNames[out] + " in cycle " + to_string(cycle));
+    }
+    ref.step(cycle%3+1);
+    sim.step(cycle%3+1);
+  }
+  ASSERT(ref.getCycle()==sim.getCycle(),"Bad cycle count");
+
+  //Reset keeps the inputs
+  ref.reset();
+  sim.reset();
+  for (uint slot=0; slot<graph.slots.size(); ++slot) {
+    ASSERT(ref.getSlot(slot)==sim.getSlot(slot),"Mismatch after reset on " + graph.slots[slot].name);
+  }
+  deleteContext(c);
+  return 0;
+}
@@ -0,0 +1,141 @@
+#include "coreir.h"
+#include "coreir-sim/simulator.h"
+#include "coreir-sim/interpsim.h"
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+//Checks every binary op against PrimOps and the hand computed values below
+void checkOps(Context* c) {
+  Namespace* g = c->getGlobal();
+  uint n = 8;
+  vector<string> ops = {"and","or","xor","dshl","dlshr","dashr","add","sub","mul","udiv","urem","sdiv","srem","smod","eq","slt","sgt","sle","sge","ult","ugt","ule","uge"};
+  RecordParams rp({{"in0",c->BitIn()->Arr(n)},{"in1",c->BitIn()->Arr(n)}});
+  for (auto op : ops) rp.push_back({op,c->Bit()->Arr(PrimOps::hasBitOutput(PrimOps::str2Op(op)) ? 1 : n)});
+  Module* m = g->newModuleDecl("Ops",c->Record(rp));
+  ModuleDef* def = m->newModuleDef();
+    for (auto op : ops) {
+      def->addInstance(op,"coreir." + op,{{"width",c->argInt(n)}});
+      def->connect("self.in0",op + ".in0");
+      def->connect("self.in1",op + ".in1");
+      if (PrimOps::hasBitOutput(PrimOps::str2Op(op))) {
+        def->connect(op + ".out","self." + op + ".0");
+      }
+      else {
+        def->connect(op + ".out","self." + op);
+      }
+    }
+  m->setDef(def);
+
+  SimGraph graph(m);
+  Simulator* sim = newSimulator(&graph);
+  for (uint64_t a : {0,1,7,100,128,200,255}) {
+    for (uint64_t b : {0,1,3,9,128,255}) {
+      sim->setValue("in0",a);
+      sim->setValue("in1",b);
+      for (auto op : ops) {
+        uint64_t expected = PrimOps::eval(PrimOps::str2Op(op),n,a,b);
+        ASSERT(sim->getValue(op)==expected,"Wrong " + op);
+      }
+    }
+  }
+  //-56 / 9 and friends
+  sim->setValue("in0",200);
+  sim->setValue("in1",9);
+  ASSERT(sim->getValue("sdiv")==(uint64_t) (-6 & 0xff),"sdiv");
+  ASSERT(sim->getValue("srem")==(uint64_t) (-2 & 0xff),"srem");
+  ASSERT(sim->getValue("smod")==7,"smod");
+  ASSERT(sim->getValue("dashr")==(uint64_t) (-1 & 0xff),"dashr");
+  ASSERT(sim->getValue("slt")==1 && sim->getValue("ult")==0,"compare");
+  delete sim;
+}
+
+//Slices, concats, muxes and bulk connections through a hierarchy
+void checkWiring(Context* c) {
+  Namespace* g = c->getGlobal();
+  //Swaps the two bytes of a 16 bit word
+  Module* swap = g->newModuleDecl("Swap",c->Record({{"in",c->BitIn()->Arr(16)},{"out",c->Bit()->Arr(16)}}));
+  ModuleDef* def = swap->newModuleDef();
+    def->addInstance("lo","coreir.slice",{{"width",c->argInt(16)},{"lo",c->argInt(0)},{"hi",c->argInt(8)}});
+    def->addInstance("hi","coreir.slice",{{"width",c->argInt(16)},{"lo",c->argInt(8)},{"hi",c->argInt(16)}});
+    def->addInstance("cat","coreir.concat",{{"width0",c->argInt(8)},{"width1",c->argInt(8)}});
+    def->connect("self.in","lo.in");
+    def->connect("self.in","hi.in");
+    def->connect("lo.out","cat.in0");
+    def->connect("hi.out","cat.in1");
+    def->connect("cat.out","self.out");
+  swap->setDef(def);
+
+  Type* pairType = c->Record({{"x",c->BitIn()->Arr(16)},{"y",c->BitIn()->Arr(16)}});
+  Module* top = g->newModuleDecl("Wiring",c->Record({
+    {"in",pairType},
+    {"sel",c->BitIn()},
+    {"out",c->Bit()->Arr(16)},
+    {"bits",c->Bit()->Arr(4)}
+  }));
+  def = top->newModuleDef();
+    def->addInstance("s0",swap);
+    def->addInstance("mux","coreir.mux",{{"width",c->argInt(16)}});
+    def->connect("self.in.x","s0.in");
+    def->connect("s0.out","mux.in0");
+    def->connect("self.in.y","mux.in1");
+    def->connect("self.sel","mux.sel");
+    def->connect("mux.out","self.out");
+    def->connect("self.in.x.0","self.bits.3");
+    def->connect("self.in.x.1","self.bits.2");
+    def->connect("self.in.y.0","self.bits.1");
+    def->connect("self.in.y.1","self.bits.0");
+  top->setDef(def);
+
+  SimGraph graph(top);
+  Simulator* sim = newSimulator(&graph);
+  sim->setValue("in.x",0x1234);
+  sim->setValue("in.y",0xabcd);
+  sim->setValue("sel",0);
+  ASSERT(sim->getValue("out")==0x3412,"Bad swap");
+  ASSERT(graph.getSlot("s0.lo.out")==-1,"Slices should not have slots");
+  ASSERT(sim->getValue("bits")==0x2,"Bad bit connections");
+  sim->setValue("sel",1);
+  ASSERT(sim->getValue("out")==0xabcd,"Bad mux");
+  ASSERT(sim->getValue("mux.out")==0xabcd,"Bad net value");
+  delete sim;
+}
+
+//Only nodes downstream of changed nets are evaluated
+void checkIncremental(Context* c) {
+  Namespace* g = c->getGlobal();
+  Module* m = g->newModuleDecl("TwoAdds",c->Record({
+    {"a",c->BitIn()->Arr(8)},
+    {"b",c->BitIn()->Arr(8)},
+    {"outa",c->Bit()->Arr(8)},
+    {"outb",c->Bit()->Arr(8)}
+  }));
+  ModuleDef* def = m->newModuleDef();
+    def->addInstance("one","coreir.const",{{"width",c->argInt(8)}},{{"value",c->argInt(1)}});
+    def->addInstance("adda","coreir.add",{{"width",c->argInt(8)}});
+    def->addInstance("addb","coreir.add",{{"width",c->argInt(8)}});
+    def->connect("self.a","adda.in0");
+    def->connect("one.out","adda.in1");
+    def->connect("adda.out","self.outa");
+    def->connect("self.b","addb.in0");
+    def->connect("one.out","addb.in1");
+    def->connect("addb.out","self.outb");
+  m->setDef(def);
+  SimGraph graph(m);
+  InterpSimulator sim(&graph);
+  sim.eval();
+  uint64_t evals = sim.getNumEvals();
+  ASSERT(evals==3,"Expected every node to be evaluated once");
+  sim.setValue("a",5);
+  ASSERT(sim.getValue("outa")==6 && sim.getValue("outb")==1,"Bad adds");
+  ASSERT(sim.getNumEvals()==evals+1,"Only adda should have been evaluated");
+}
+
+int main() {
+  Context* c = newContext();
+  checkOps(c);
+  checkWiring(c);
+  checkIncremental(c);
+  deleteContext(c);
+  return 0;
+}
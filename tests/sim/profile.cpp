@@ -0,0 +1,107 @@
+#include "coreir.h"
+#include "coreir-sim/simulator.h"
+#include "coreir-sim/interpsim.h"
+#include "coreir-sim/threadedsim.h"
+#include "coreir-sim/profile.h"
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+//Two uses of the same counter module
+Module* counters(Context* c) {
+  Namespace* g = c->getGlobal();
+  Module* counter = g->newModuleDecl("ProfCounter",c->Record({
+    {"inc",c->BitIn()->Arr(8)},
+    {"out",c->Bit()->Arr(8)}
+  }));
+  ModuleDef* def = counter->newModuleDef();
+    def->addInstance("r","coreir.reg",{{"width",c->argInt(8)}});
+    def->addInstance("add","coreir.add",{{"width",c->argInt(8)}});
+    def->connect("r.out","add.in0");
+    def->connect("self.inc","add.in1");
+    def->connect("add.out","r.in");
+    def->connect("r.out","self.out");
+  counter->setDef(def);
+
+  Module* top = g->newModuleDecl("ProfTop",c->Record({
+    {"inc",c->BitIn()->Arr(8)},
+    {"a",c->Bit()->Arr(8)},
+    {"b",c->Bit()->Arr(8)}
+  }));
+  def = top->newModuleDef();
+    def->addInstance("c0",counter);
+    def->addInstance("c1",counter);
+    def->addInstance("zero","coreir.const",{{"width",c->argInt(8)}},{{"value",c->argInt(0)}});
+    def->connect("self.inc","c0.inc");
+    def->connect("zero.out","c1.inc");
+    def->connect("c0.out","self.a");
+    def->connect("c1.out","self.b");
+  top->setDef(def);
+  return top;
+}
+
+void run(Simulator* sim, uint interval, uint cycles) {
+  sim->reset();
+  sim->setProfiling(interval);
+  for (uint i=0; i<cycles; ++i) {
+    sim->setValue("inc",1);
+    sim->step();
+  }
+}
+
+int main() {
+  Context* c = newContext();
+  Module* top = counters(c);
+  SimGraph graph(top);
+  InterpSimulator interp(&graph);
+  ThreadedSimulator threaded(&graph,2);
+  uint c0 = graph.getSlot("c0.r.out");
+  uint c1 = graph.getSlot("c1.r.out");
+  uint inc = graph.getSlot("self.inc");
+
+  //Every cycle: c0 counts 0..20, c1 stays at 0
+  uint64_t expected = 0;
+  for (uint i=0; i<20; ++i) expected += __builtin_popcountll(i ^ (i+1));
+  SimProfile pi, pt;
+  for (Simulator* sim : {(Simulator*) &interp,(Simulator*) &threaded}) {
+    run(sim,1,20);
+    SimProfile& p = sim==&interp ? pi : pt;
+    sim->getProfile(p);
+    ASSERT(p.cycles==20,"Bad number of counted cycles");
+    ASSERT(p.toggles[c0]==expected,"Bad toggles of c0.r.out: " + to_string(p.toggles[c0]));
+    ASSERT(p.toggles[c1]==0 && p.toggles[inc]==1,"Bad toggles");
+    ASSERT(p.evals[graph.slots[c0].driver]==20,"Registers count their clock edges");
+  }
+  //The engines agree on every net
+  ASSERT(pi.toggles==pt.toggles,"Interp and threaded toggles differ");
+  //Only the changes reach the event driven engine
+  ASSERT(pi.evals[graph.slots[graph.getSlot("c1.add.out")].driver]==1,"c1.add should only be evaluated once");
+
+  //Every 4th cycle
+  for (Simulator* sim : {(Simulator*) &interp,(Simulator*) &threaded}) {
+    run(sim,4,20);
+    SimProfile p;
+    sim->getProfile(p);
+    ASSERT(p.cycles==5,"Bad number of sampled cycles");
+    ASSERT(p.toggles[c0]>0 && p.toggles[c0]<expected,"Bad sampled toggles");
+    ASSERT(p.evals[graph.slots[c0].driver]==5,"Bad sampled evaluations");
+  }
+
+  //Metadata, which survives a round trip through json
+  annotateActivity(&graph,pi);
+  Instance* r = cast<Module>(c->getGlobal()->getModule("ProfCounter"))->getDef()->getInstances()["r"];
+  ASSERT(r->getMetaData()["activity"]["evals"]==40 && r->getMetaData()["activity"]["cycles"]==40,"r is shared by c0 and c1");
+  saveToFilePretty(c->getGlobal(),"_profile.json",top);
+  deleteContext(c);
+
+  c = newContext();
+  Module* loaded;
+  ASSERT(loadFromFile(c,"_profile.json",&loaded),"Cannot load _profile.json");
+  ModuleDef* def = c->getGlobal()->getModule("ProfCounter")->getDef();
+  ASSERT(def->getInstances()["r"]->getMetaData()["activity"]["evals"]==40,"Lost instance metadata");
+  json& toggles = def->sel("r.out")->getMetaData()["activity"];
+  ASSERT(toggles["toggles"]==expected && toggles["cycles"]==40,"Lost wire metadata");
+  ASSERT(loaded->getDef()->sel("self.inc")->getMetaData()["activity"]["toggles"]==1,"Lost top level port metadata");
+  deleteContext(c);
+  return 0;
+}
@@ -0,0 +1,88 @@
+#include "coreir.h"
+#include "coreir-lib/cgralib.h"
+#include "coreir-sim/simulator.h"
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+//Counter with enable and synchronous clear
+void checkCounter(Context* c) {
+  Namespace* g = c->getGlobal();
+  Module* counter = g->newModuleDecl("Counter",c->Record({
+    {"en",c->BitIn()},
+    {"clr",c->BitIn()},
+    {"out",c->Bit()->Arr(4)}
+  }));
+  ModuleDef* def = counter->newModuleDef();
+    def->addInstance("r","coreir.reg",{{"width",c->argInt(4)},{"en",c->argBool(true)},{"clr",c->argBool(true)}},{{"init",c->argInt(3)}});
+    def->addInstance("one","coreir.const",{{"width",c->argInt(4)}},{{"value",c->argInt(1)}});
+    def->addInstance("inc","coreir.add",{{"width",c->argInt(4)}});
+    def->connect("r.out","inc.in0");
+    def->connect("one.out","inc.in1");
+    def->connect("inc.out","r.in");
+    def->connect("self.en","r.en");
+    def->connect("self.clr","r.clr");
+    def->connect("r.out","self.out");
+  counter->setDef(def);
+
+  SimGraph graph(counter);
+  Simulator* sim = newSimulator(&graph);
+  ASSERT(sim->getValue("out")==3,"Bad init");
+  sim->setValue("en",1);
+  sim->step(14);
+  ASSERT(sim->getValue("out")==1,"Counter should wrap");
+  ASSERT(sim->getCycle()==14,"Bad cycle count");
+  sim->setValue("en",0);
+  sim->step();
+  ASSERT(sim->getValue("out")==1,"Counter should hold");
+  sim->setValue("en",1);
+  sim->setValue("clr",1);
+  sim->step();
+  ASSERT(sim->getValue("out")==3,"Counter should clear to init");
+  delete sim;
+}
+
+//The cgralib linebuffer generator (registers and linebuffer memories)
+void checkLinebuffer(Context* c) {
+  uint width = 4;
+  Module* top = c->getGlobal()->newModuleDecl("LB",c->Record({
+    {"in",c->BitIn()->Arr(16)},
+    {"out",c->Bit()->Arr(16)->Arr(2)->Arr(2)}
+  }));
+  ModuleDef* def = top->newModuleDef();
+    def->addInstance("lb","cgralib.Linebuffer",{
+      {"stencil_width",c->argInt(2)},
+      {"stencil_height",c->argInt(2)},
+      {"image_width",c->argInt(width)},
+      {"bitwidth",c->argInt(16)}
+    });
+    def->connect("self.in","lb.in");
+    def->connect("lb.out","self.out");
+  top->setDef(def);
+
+  SimGraph graph(top);
+  Simulator* sim = newSimulator(&graph);
+  //Stream pixels 1,2,3,... and look at the 2x2 window
+  for (uint p=1; p<=3*width; ++p) {
+    sim->setValue("in",p);
+    //out.1.1 is the current pixel, out.1.0 the previous one,
+    //out.0.* the same pixels one row up
+    ASSERT(sim->getValue("out.1.1")==p,"Bad current pixel");
+    if (p>1) ASSERT(sim->getValue("out.1.0")==p-1,"Bad previous pixel");
+    if (p>width+1) {
+      ASSERT(sim->getValue("out.0.1")==p-width,"Bad pixel above");
+      ASSERT(sim->getValue("out.0.0")==p-width-1,"Bad pixel above left");
+    }
+    sim->step();
+  }
+  delete sim;
+}
+
+int main() {
+  Context* c = newContext();
+  CoreIRLoadLibrary_cgralib(c);
+  checkCounter(c);
+  checkLinebuffer(c);
+  deleteContext(c);
+  return 0;
+}
@@ -0,0 +1,100 @@
+#include "coreir.h"
+#include "coreir-lib/cgralib.h"
+#include "coreir-sim/simulator.h"
+#include "coreir-sim/interpsim.h"
+#include "coreir-sim/threadedsim.h"
+#include <random>
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+//Registers fed by random ops on other registers and the inputs. Some of the
+//ops are shared by several registers.
+Module* randomRegs(Context* c, uint numRegs) {
+  uint n = 16;
+  Module* m = c->getGlobal()->newModuleDecl("RandomRegs",c->Record({
+    {"a",c->BitIn()->Arr(n)},
+    {"b",c->BitIn()->Arr(n)},
+    {"out",c->Bit()->Arr(n)}
+  }));
+  std::mt19937 rng(3);
+  vector<string> ops = {"add","sub","xor","and","or","mul"};
+  ModuleDef* def = m->newModuleDef();
+    vector<string> values = {"self.a","self.b"};
+    for (uint i=0; i<numRegs; ++i) {
+      string r = "r" + to_string(i);
+      def->addInstance(r,"coreir.reg",{{"width",c->argInt(n)}},{{"init",c->argInt(i)}});
+      values.push_back(r + ".out");
+    }
+    //Shared logic
+    for (uint i=0; i<numRegs; ++i) {
+      string op = "s" + to_string(i);
+      def->addInstance(op,"coreir." + ops[rng()%ops.size()],{{"width",c->argInt(n)}});
+      def->connect(values[rng()%values.size()],op + ".in0");
+      def->connect(values[rng()%values.size()],op + ".in1");
+      values.push_back(op + ".out");
+    }
+    for (uint i=0; i<numRegs; ++i) {
+      string op = "f" + to_string(i);
+      def->addInstance(op,"coreir." + ops[rng()%ops.size()],{{"width",c->argInt(n)}});
+      def->connect(values[rng()%values.size()],op + ".in0");
+      def->connect(values[rng()%values.size()],op + ".in1");
+      def->connect(op + ".out","r" + to_string(i) + ".in");
+    }
+    def->connect("f0.out","self.out");
+  m->setDef(def);
+  return m;
+}
+
+Module* linebufferModule(Context* c) {
+  Module* top = c->getGlobal()->newModuleDecl("ThreadLB",c->Record({
+    {"in",c->BitIn()->Arr(16)},
+    {"out",c->Bit()->Arr(16)->Arr(3)->Arr(3)}
+  }));
+  ModuleDef* def = top->newModuleDef();
+    def->addInstance("lb","cgralib.Linebuffer",{
+      {"stencil_width",c->argInt(3)},
+      {"stencil_height",c->argInt(3)},
+      {"image_width",c->argInt(8)},
+      {"bitwidth",c->argInt(16)}
+    });
+    def->connect("self.in","lb.in");
+    def->connect("lb.out","self.out");
+  top->setDef(def);
+  return top;
+}
+
+void compare(SimGraph* g, uint numThreads) {
+  InterpSimulator ref(g);
+  ThreadedSimulator sim(g,numThreads);
+  uint seqs = 0;
+  for (auto& part : sim.getPartitions()) seqs += part.seqNodes.size();
+  ASSERT(seqs==g->seqNodes.size(),"Every sequential node needs exactly one partition");
+  std::mt19937_64 rng(5);
+  for (uint cycle=0; cycle<100; ++cycle) {
+    for (uint in=0; in<g->inputs.size(); ++in) {
+      uint64_t v = rng();
+      ref.setInput(in,v);
+      sim.setInput(in,v);
+    }
+    for (uint slot=0; slot<g->slots.size(); ++slot) {
+      ASSERT(ref.getSlot(slot)==sim.getSlot(slot),"Mismatch on " + g->slots[slot].name + " with " + to_string(numThreads) + " threads in cycle " + to_string(cycle));
+    }
+    //Run a few cycles at once
+    ref.step(cycle%3+1);
+    sim.step(cycle%3+1);
+  }
+  ASSERT(ref.getCycle()==sim.getCycle(),"Bad cycle count");
+  ASSERT(sim.getImbalance()>=1,"Bad imbalance");
+}
+
+int main() {
+  Context* c = newContext();
+  CoreIRLoadLibrary_cgralib(c);
+  for (auto m : {randomRegs(c,40),linebufferModule(c)}) {
+    SimGraph graph(m);
+    for (uint threads : {1,2,3,8}) compare(&graph,threads);
+  }
+  deleteContext(c);
+  return 0;
+}
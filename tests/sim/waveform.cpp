@@ -0,0 +1,137 @@
+#include "coreir.h"
+#include "coreir-sim/simulator.h"
+#include "coreir-sim/waveform.h"
+#include <fstream>
+
+using namespace CoreIR;
+using namespace CoreIR::Sim;
+
+//Two counters counting by different amounts
+Module* counters(Context* c) {
+  Namespace* g = c->getGlobal();
+  Module* counter = g->newModuleDecl("WaveCounter",c->Record({
+    {"inc",c->BitIn()->Arr(8)},
+    {"out",c->Bit()->Arr(8)}
+  }));
+  ModuleDef* def = counter->newModuleDef();
+    def->addInstance("r","coreir.reg",{{"width",c->argInt(8)}});
+    def->addInstance("add","coreir.add",{{"width",c->argInt(8)}});
+    def->connect("r.out","add.in0");
+    def->connect("self.inc","add.in1");
+    def->connect("add.out","r.in");
+    def->connect("r.out","self.out");
+  counter->setDef(def);
+
+  Module* top = g->newModuleDecl("WaveTop",c->Record({
+    {"inc",c->BitIn()->Arr(8)},
+    {"a",c->Bit()->Arr(8)},
+    {"b",c->Bit()->Arr(8)}
+  }));
+  def = top->newModuleDef();
+    def->addInstance("c0",counter);
+    def->addInstance("c1",counter);
+    def->addInstance("two","coreir.const",{{"width",c->argInt(8)}},{{"value",c->argInt(2)}});
+    def->connect("self.inc","c0.inc");
+    def->connect("two.out","c1.inc");
+    def->connect("c0.out","self.a");
+    def->connect("c1.out","self.b");
+  top->setDef(def);
+  return top;
+}
+
+string readFile(string filename) {
+  std::ifstream fin(filename);
+  std::ostringstream buf;
+  buf << fin.rdbuf();
+  return buf.str();
+}
+
+bool contains(const string& text, string s) {
+  return text.find(s)!=string::npos;
+}
+
+void run(Simulator* sim, WaveformWriter& wave, uint cycles) {
+  sim->reset();
+  for (uint i=0; i<cycles; ++i) {
+    sim->setValue("inc",1);
+    wave.sample();
+    sim->step();
+  }
+  wave.close();
+}
+
+int main() {
+  Context* c = newContext();
+  SimGraph graph(counters(c));
+  Simulator* sim = newSimulator(&graph);
+
+  //Everything
+  {
+    WaveformWriter wave(sim,"_wave.vcd");
+    run(sim,wave,20);
+    string vcd = readFile("_wave.vcd");
+    ASSERT(contains(vcd,"$scope module WaveTop $end"),"Missing top scope");
+    ASSERT(contains(vcd,"$scope module c0 $end") && contains(vcd,"$scope module c1 $end"),"Missing instance scopes");
+    ASSERT(contains(vcd,"$var wire 8 ") && contains(vcd," out $end"),"Missing vars");
+    ASSERT(contains(vcd,"$dumpvars") && contains(vcd,"#0\n") && contains(vcd,"#19\n"),"Missing times");
+    //Constants only show up in the initial dump
+    ASSERT(contains(vcd,"b10 "),"Missing constant");
+  }
+
+  //Only c1 during [5,10)
+  {
+    WaveOptions opts;
+    opts.scopes = {{"c1"}};
+    opts.windows = {{5,10}};
+    WaveformWriter wave(sim,"_wave_c1.vcd",opts);
+    for (auto& s : wave.getSignals()) {
+      ASSERT(!s.scope.empty() && s.scope[0]=="c1","Signal outside of c1: " + s.name);
+    }
+    run(sim,wave,20);
+    string vcd = readFile("_wave_c1.vcd");
+    ASSERT(!contains(vcd,"c0"),"c0 should be filtered out");
+    ASSERT(contains(vcd,"#5\n") && contains(vcd,"#9\n"),"Missing window");
+    ASSERT(!contains(vcd,"#4\n") && !contains(vcd,"#10\n"),"Outside of the window");
+  }
+
+  //Re-entering a window dumps everything again, but only once as $dumpvars
+  {
+    WaveOptions opts;
+    opts.windows = {{0,5},{10,15}};
+    WaveformWriter wave(sim,"_wave_windows.vcd",opts);
+    run(sim,wave,20);
+    string vcd = readFile("_wave_windows.vcd");
+    size_t first = vcd.find("$dumpvars");
+    ASSERT(first!=string::npos && vcd.find("$dumpvars",first+1)==string::npos,"Expected a single $dumpvars");
+    size_t again = vcd.find("$dumpall");
+    ASSERT(again!=string::npos && again>vcd.find("#10\n"),"Expected $dumpall when re-entering the window");
+  }
+
+  //Block format: late cycles are read from their own block
+  {
+    WaveOptions opts;
+    opts.format = WF_Block;
+    opts.blockCycles = 8;
+    opts.windows = {{0,100},{150,300}};
+    WaveformWriter wave(sim,"_wave.cwav",opts);
+    run(sim,wave,300);
+    WaveformReader reader("_wave.cwav");
+    int a = reader.getSignal("c0.r.out");
+    int b = reader.getSignal("c1.add.out");
+    int out = reader.getSignal("a");
+    ASSERT(a>=0 && b>=0 && out>=0,"Missing signals");
+    ASSERT(reader.getFirstCycle()==0 && reader.getLastCycle()==299,"Bad range");
+    ASSERT(reader.getNumBlocks()==13+19,"Bad number of blocks");
+    for (uint cycle : {0,7,8,42,99,150,151,290,299}) {
+      vector<uint64_t> values = reader.valuesAt(cycle);
+      ASSERT(values[a]==(cycle & 0xff),"Bad c0 at " + to_string(cycle));
+      ASSERT(values[b]==((2*cycle+2) & 0xff),"Bad c1 at " + to_string(cycle));
+      ASSERT(values[out]==values[a],"Bad output at " + to_string(cycle));
+    }
+    //Between the windows the last recorded values are kept
+    ASSERT(reader.valuesAt(120)[a]==99,"Bad value between windows");
+  }
+  delete sim;
+  deleteContext(c);
+  return 0;
+}
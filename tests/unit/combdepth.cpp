@@ -0,0 +1,121 @@
+#include "coreir.h"
+#include "coreir-passes/analysis/combdepth.h"
+
+using namespace CoreIR;
+
+bool onPath(const CombPath& p, SelectPath sp) {
+  return std::find(p.path.begin(),p.path.end(),sp)!=p.path.end();
+}
+
+int main() {
+  Context* c = newContext();
+  Namespace* g = c->getGlobal();
+  Args w16({{"width",c->argInt(16)}});
+
+  //out = (a+b)^k, a+b is registered and q = ~r
+  Module* inner = g->newModuleDecl("DepthInner",c->Record({
+    {"a",c->BitIn()->Arr(16)},
+    {"b",c->BitIn()->Arr(16)},
+    {"clk",c->Named("coreir.clkIn")},
+    {"out",c->Bit()->Arr(16)},
+    {"q",c->Bit()->Arr(16)}
+  }));
+  ModuleDef* def = inner->newModuleDef();
+    def->addInstance("k","coreir.const",w16,{{"value",c->argInt(5)}});
+    def->addInstance("add","coreir.add",w16);
+    def->addInstance("xor","coreir.xor",w16);
+    def->addInstance("r","coreir.reg",w16);
+    def->addInstance("not","coreir.not",w16);
+    def->connect("self.a","add.in0");
+    def->connect("self.b","add.in1");
+    def->connect("add.out","xor.in0");
+    def->connect("k.out","xor.in1");
+    def->connect("xor.out","self.out");
+    def->connect("add.out","r.in");
+    def->connect("self.clk","r.clk");
+    def->connect("r.out","not.in");
+    def->connect("not.out","self.q");
+  inner->setDef(def);
+
+  Module* top = g->newModuleDecl("DepthTop",c->Record({
+    {"in",c->BitIn()->Arr(16)},
+    {"clk",c->Named("coreir.clkIn")},
+    {"out",c->Bit()->Arr(16)}
+  }));
+  def = top->newModuleDef();
+    def->addInstance("i0",inner);
+    def->addInstance("i1",inner);
+    def->addInstance("mul","coreir.mul",w16);
+    def->connect("self.in","i0.a");
+    def->connect("self.in","i0.b");
+    def->connect("self.clk","i0.clk");
+    def->connect("i0.out","i1.a");
+    def->connect("i0.q","i1.b");
+    def->connect("self.clk","i1.clk");
+    def->connect("i1.out","mul.in0");
+    def->connect("i1.q","mul.in1");
+    def->connect("mul.out","self.out");
+  top->setDef(def);
+
+  //Cells timed by metadata
+  Module* cell = g->newModuleDecl("DepthCell",c->Record({
+    {"in",c->BitIn()},
+    {"out",c->Bit()}
+  }));
+  cell->getMetaData()["timing"]["delay"] = 3;
+  Module* ff = g->newModuleDecl("DepthFF",c->Record({
+    {"d",c->BitIn()},
+    {"q",c->Bit()}
+  }));
+  ff->getMetaData()["timing"]["sequential"] = true;
+  Module* cells = g->newModuleDecl("DepthCells",c->Record({
+    {"in",c->BitIn()},
+    {"out",c->Bit()}
+  }));
+  def = cells->newModuleDef();
+    def->addInstance("cell",cell);
+    def->addInstance("ff",ff);
+    def->connect("self.in","cell.in");
+    def->connect("cell.out","ff.d");
+    def->connect("ff.q","self.out");
+  cells->setDef(def);
+
+  //A loop through a not
+  Module* loop = g->newModuleDecl("DepthLoop",c->Record({{"out",c->Bit()}}));
+  def = loop->newModuleDef();
+    def->addInstance("not","coreir.not",{{"width",c->argInt(1)}});
+    def->connect("not.out","not.in");
+    def->connect("not.out","self.out");
+  loop->setDef(def);
+
+  c->runPasses({"combdepth"});
+  auto depth = static_cast<Passes::CombDepth*>(c->getPassManager()->getAnalysisPass("combdepth"));
+
+  const CombTiming& t = depth->getTiming(inner);
+  ASSERT(t.arcs.at("a").at("out").depth==2 && t.arcs.at("b").at("out").depth==2,"Bad arcs");
+  ASSERT(!t.arcs.at("a").count("q"),"q does not depend on a combinationally");
+  ASSERT(t.launch.at("q").depth==1 && t.launch.at("out").depth==1,"Bad launches");
+  ASSERT(t.capture.at("a").depth==1 && t.internal.depth==-1,"Bad captures");
+
+  //in -> i0 -> i1 -> mul -> out
+  ASSERT(depth->getDepth(top)==5,"Expected depth 5, got " + to_string(depth->getDepth(top)));
+  CombPath crit = depth->getCriticalPath(top);
+  ASSERT(crit.path.front()==SelectPath({"self","in"}) && crit.path.back()==SelectPath({"self","out"}),"Bad critical path ends");
+  ASSERT(onPath(crit,{"i0","add","out"}) && onPath(crit,{"i1","xor","out"}) && onPath(crit,{"mul","out"}),"Bad critical path");
+  ASSERT(depth->getArrival(top,{"i1","out"})==4 && depth->getArrival(top,{"mul","out","3"})==5 && depth->getArrival(top,{"i1","q"})==1,"Bad arrivals");
+  vector<CombPath> worst = depth->getWorstPaths(top);
+  ASSERT(worst.size()==5 && worst[1].depth==3 && worst[1].path.back()==SelectPath({"i1","r","in"}),"Bad worst paths");
+
+  //Delay table
+  depth->setDelay("mul",4);
+  ASSERT(depth->getDepth(top)==8,"mul delay not used");
+  depth->setDelay("add",16,3);
+  depth->setDelay("add",8,10);
+  ASSERT(depth->getDepth(top)==12,"add width delay not used");
+
+  ASSERT(depth->getTiming(cells).capture.at("in").depth==3 && depth->getTiming(cells).launch.at("out").depth==0,"Bad metadata timing");
+  ASSERT(depth->hasLoops(loop) && !depth->hasLoops(top),"Bad loops");
+
+  deleteContext(c);
+  return 0;
+}
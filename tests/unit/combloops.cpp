@@ -0,0 +1,103 @@
+#include "coreir.h"
+#include "coreir-passes/analysis/combloops.h"
+
+using namespace CoreIR;
+
+int main() {
+  Context* c = newContext();
+  Namespace* g = c->getGlobal();
+  Args w8({{"width",c->argInt(8)}});
+
+  //out depends on in, q only on a register
+  Module* inner = g->newModuleDecl("LoopInner",c->Record({
+    {"in",c->BitIn()->Arr(8)},
+    {"d",c->BitIn()->Arr(8)},
+    {"clk",c->Named("coreir.clkIn")},
+    {"out",c->Bit()->Arr(8)},
+    {"q",c->Bit()->Arr(8)}
+  }));
+  ModuleDef* def = inner->newModuleDef();
+    def->addInstance("not","coreir.not",w8);
+    def->addInstance("r","coreir.reg",w8);
+    def->connect("self.in","not.in");
+    def->connect("not.out","self.out");
+    def->connect("self.d","r.in");
+    def->connect("self.clk","r.clk");
+    def->connect("r.out","self.q");
+  inner->setDef(def);
+
+  //Feeds out back into in (a loop) and q back into d (not a loop)
+  Module* top = g->newModuleDecl("LoopTop",c->Record({
+    {"clk",c->Named("coreir.clkIn")},
+    {"out",c->Bit()->Arr(8)}
+  }));
+  def = top->newModuleDef();
+    def->addInstance("sub",inner);
+    def->connect("sub.out.0","sub.in.1");
+    def->connect("sub.out","self.out");
+    def->connect("sub.q","sub.d");
+    def->connect("self.clk","sub.clk");
+  top->setDef(def);
+
+  //Dependencies go through submodules
+  Module* wrap = g->newModuleDecl("LoopWrap",c->Record({
+    {"x",c->BitIn()->Arr(8)},
+    {"clk",c->Named("coreir.clkIn")},
+    {"y",c->Bit()->Arr(8)},
+    {"z",c->Bit()->Arr(8)}
+  }));
+  def = wrap->newModuleDef();
+    def->addInstance("sub",inner);
+    def->addInstance("add","coreir.add",w8);
+    def->connect("self.x","sub.in");
+    def->connect("self.x","sub.d");
+    def->connect("self.clk","sub.clk");
+    def->connect("sub.out","add.in0");
+    def->connect("sub.q","add.in1");
+    def->connect("add.out","self.y");
+    def->connect("sub.q","self.z");
+  wrap->setDef(def);
+
+  //A loop through two leaf cells next to one broken by a memory like cell
+  Module* mem = g->newModuleDecl("LoopMem",c->Record({
+    {"wdata",c->BitIn()},
+    {"rdata",c->Bit()}
+  }));
+  mem->getMetaData()["timing"]["sequential"] = true;
+  Module* leaf = g->newModuleDecl("LoopLeaf",c->Record({
+    {"a",c->BitIn()},
+    {"out",c->Bit()}
+  }));
+  def = leaf->newModuleDef();
+    def->addInstance("and","coreir.and",{{"width",c->argInt(1)}});
+    def->addInstance("xor","coreir.xor",{{"width",c->argInt(1)}});
+    def->addInstance("mem",mem);
+    def->connect("self.a","and.in0");
+    def->connect("and.out","xor.in0");
+    def->connect("xor.out","and.in1");
+    def->connect("and.out","mem.wdata");
+    def->connect("mem.rdata","xor.in1");
+    def->connect("xor.out","self.out");
+  leaf->setDef(def);
+
+  c->runPasses({"combloops"});
+  auto loops = static_cast<Passes::CombLoops*>(c->getPassManager()->getAnalysisPass("combloops"));
+
+  auto deps = loops->getDependencies(inner);
+  ASSERT(deps.size()==1 && deps["in"]==std::set<string>({"out"}),"Bad dependencies of LoopInner");
+  ASSERT(!loops->hasLoops(inner) && !loops->hasLoops(wrap),"Unexpected loops");
+  deps = loops->getDependencies(wrap);
+  ASSERT(deps.size()==1 && deps["x"]==std::set<string>({"y"}),"Bad dependencies of LoopWrap");
+
+  ASSERT(loops->hasLoops(top) && loops->getLoops(top).size()==1,"Expected one loop in LoopTop");
+  vector<SelectPath> loop = loops->getLoops(top)[0];
+  ASSERT(loop==vector<SelectPath>({{"sub","in"},{"sub","out"}}),"Bad loop in LoopTop");
+
+  ASSERT(loops->getLoops(leaf).size()==1,"Expected one loop in LoopLeaf");
+  loop = loops->getLoops(leaf)[0];
+  ASSERT(loop.size()==4 && loop[0]==SelectPath({"and","in1"}) && loop[1]==SelectPath({"and","out"}),"Bad loop in LoopLeaf");
+  ASSERT(loops->getDependencies(leaf).at("a").count("out"),"Bad dependencies of LoopLeaf");
+
+  deleteContext(c);
+  return 0;
+}
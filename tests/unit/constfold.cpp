@@ -0,0 +1,129 @@
+#include "coreir.h"
+
+using namespace CoreIR;
+
+//The instance driving self.<port> (through a single connection)
+Instance* driverOf(ModuleDef* def, string port) {
+  auto cons = def->sel("self." + port)->getConnectedWireables();
+  ASSERT(cons.size()==1,"Expected one driver of " + port);
+  return cast<Instance>((*cons.begin())->getTopParent());
+}
+
+void checkConst(ModuleDef* def, string port, int value) {
+  Instance* k = driverOf(def,port);
+  ASSERT(coreirPrimName(k)=="const","Expected a constant driving " + port);
+  int v = k->getConfigArgs().at("value")->get<ArgInt>();
+  ASSERT(v==value,"Bad constant " + to_string(v) + " driving " + port);
+}
+
+int main() {
+  Context* c = newContext();
+  Args w16({{"width",c->argInt(16)}});
+  Args w8({{"width",c->argInt(8)}});
+  auto k16 = [c](int v) { return Args({{"value",c->argInt(v)}});};
+
+  Type* t = c->Record({
+    {"in",c->BitIn()->Arr(16)},
+    {"out0",c->Bit()->Arr(16)},
+    {"out1",c->Bit()->Arr(16)},
+    {"out2",c->Bit()->Arr(16)},
+    {"out3",c->Bit()->Arr(16)},
+    {"out4",c->Bit()->Arr(16)},
+    {"out5",c->Bit()->Arr(16)},
+    {"out6",c->Bit()->Arr(16)},
+    {"out7",c->Bit()->Arr(16)},
+    {"out8",c->Bit()->Arr(8)}
+  });
+  Module* m = c->getGlobal()->newModuleDecl("Fold",t);
+  ModuleDef* def = m->newModuleDef();
+    //(5+3)*2
+    def->addInstance("c5","coreir.const",w16,k16(5));
+    def->addInstance("c3","coreir.const",w16,k16(3));
+    def->addInstance("c2","coreir.const",w16,k16(2));
+    def->addInstance("add","coreir.add",w16);
+    def->addInstance("mul","coreir.mul",w16);
+    def->connect("c5.out","add.in0");
+    def->connect("c3.out","add.in1");
+    def->connect("add.out","mul.in0");
+    def->connect("c2.out","mul.in1");
+    def->connect("mul.out","self.out0");
+
+    //in & 0 and in | ~0
+    def->addInstance("zero","coreir.const",w16,k16(0));
+    def->addInstance("ones","coreir.const",w16,k16(-1));
+    def->addInstance("and","coreir.and",w16);
+    def->addInstance("or","coreir.or",w16);
+    def->connect("self.in","and.in0");
+    def->connect("zero.out","and.in1");
+    def->connect("and.out","self.out1");
+    def->connect("ones.out","or.in0");
+    def->connect("self.in","or.in1");
+    def->connect("or.out","self.out2");
+
+    //Mux with a constant select and in + 0
+    def->addInstance("one","coreir.const",{{"width",c->argInt(1)}},k16(1));
+    def->addInstance("sub","coreir.sub",w16);
+    def->addInstance("mux","coreir.mux",w16);
+    def->addInstance("add0","coreir.add",w16);
+    def->connect("self.in","sub.in0");
+    def->connect("c3.out","sub.in1");
+    def->connect("self.in","mux.in0");
+    def->connect("sub.out","mux.in1");
+    def->connect("one.out","mux.sel");
+    def->connect("mux.out","self.out3");
+    def->connect("self.in","add0.in0");
+    def->connect("zero.out","add0.in1");
+    def->connect("add0.out","self.out4");
+
+    //Registers: never enabled, loading their init value and loading something else
+    def->addInstance("rOff","coreir.reg",{{"width",c->argInt(16)},{"en",c->argBool(true)}},{{"init",c->argInt(7)}});
+    def->addInstance("rInit","coreir.reg",w16,{{"init",c->argInt(3)}});
+    def->addInstance("rLoad","coreir.reg",w16,{{"init",c->argInt(0)}});
+    def->addInstance("never","coreir.const",{{"width",c->argInt(1)}},k16(0));
+    def->connect("self.in","rOff.in");
+    def->connect("never.out","rOff.en");
+    def->connect("rOff.out","self.out5");
+    def->connect("c3.out","rInit.in");
+    def->connect("rInit.out","self.out6");
+    def->connect("c5.out","rLoad.in");
+    def->connect("rLoad.out","self.out7");
+
+    //Slice of a concat of constants, partly through single bit connections
+    def->addInstance("hi","coreir.const",w8,k16(0x12));
+    def->addInstance("lo","coreir.const",w8,k16(0x34));
+    def->addInstance("cat","coreir.concat",{{"width0",c->argInt(8)},{"width1",c->argInt(8)}});
+    def->addInstance("slice","coreir.slice",{{"width",c->argInt(16)},{"lo",c->argInt(4)},{"hi",c->argInt(12)}});
+    def->connect("hi.out","cat.in0");
+    for (uint i=0; i<8; ++i) def->connect("lo.out." + to_string(i),"cat.in1." + to_string(i));
+    def->connect("cat.out","slice.in");
+    def->connect("slice.out","self.out8");
+  m->setDef(def);
+
+  ASSERT(c->runPasses({"constfold"}),"Expected constfold to modify Fold");
+  def = m->getDef();
+  auto insts = def->getInstances();
+
+  checkConst(def,"out0",16);
+  checkConst(def,"out1",0);
+  checkConst(def,"out2",0xffff);
+  checkConst(def,"out5",7);
+  checkConst(def,"out6",3);
+  checkConst(def,"out8",0x23);
+  //The constant subgraphs are gone
+  for (auto name : {"add","mul","c2","and","or","ones","one","mux","add0","rOff","rInit","never","hi","lo","cat","slice"}) {
+    ASSERT(insts.count(name)==0 || coreirPrimName(insts[name])=="const","Expected " + string(name) + " to be folded");
+  }
+  for (auto name : {"add","c2","ones","one","never","hi","lo","cat"}) {
+    ASSERT(insts.count(name)==0,"Expected " + string(name) + " to be removed");
+  }
+  //Identities are wires
+  ASSERT(driverOf(def,"out3")==insts["sub"],"Expected sub to drive out3");
+  ASSERT(def->sel("self.out4")->getConnectedWireables().count(def->sel("self.in")),"Expected in to drive out4");
+  ASSERT(driverOf(def,"out7")==insts["rLoad"],"rLoad is not constant");
+  ASSERT(!def->validate(),"Fold is not valid");
+
+  //Nothing left to fold
+  ASSERT(!c->runPasses({"constfold"}),"Expected a fixed point");
+  deleteContext(c);
+  return 0;
+}
@@ -0,0 +1,87 @@
+#include "coreir.h"
+
+using namespace CoreIR;
+
+//The instance driving self.<port> (through a single connection)
+Instance* driverOf(ModuleDef* def, string port) {
+  auto cons = def->sel("self." + port)->getConnectedWireables();
+  ASSERT(cons.size()==1,"Expected one driver of " + port);
+  return cast<Instance>((*cons.begin())->getTopParent());
+}
+
+int main() {
+  Context* c = newContext();
+  Args w16({{"width",c->argInt(16)}});
+  Args w8({{"width",c->argInt(8)}});
+
+  Module* m = c->getGlobal()->newModuleDecl("Dups",c->Record({
+    {"a",c->BitIn()->Arr(16)},
+    {"b",c->BitIn()->Arr(16)},
+    {"out",c->Bit()->Arr(16)->Arr(9)}
+  }));
+  ModuleDef* def = m->newModuleDef();
+    //Two copies of (a+b)^5 with the add operands swapped in the second
+    for (string i : {"0","1"}) {
+      def->addInstance("add" + i,"coreir.add",w16);
+      def->addInstance("k" + i,"coreir.const",w16,{{"value",c->argInt(5)}});
+      def->addInstance("xor" + i,"coreir.xor",w16);
+      def->connect(i=="0" ? "self.a" : "self.b","add" + i + ".in0");
+      def->connect(i=="0" ? "self.b" : "self.a","add" + i + ".in1");
+      def->connect("add" + i + ".out","xor" + i + ".in0");
+      def->connect("k" + i + ".out","xor" + i + ".in1");
+      def->connect("xor" + i + ".out","self.out." + i);
+    }
+    //Not commutative
+    def->addInstance("sub0","coreir.sub",w16);
+    def->addInstance("sub1","coreir.sub",w16);
+    def->connect("self.a","sub0.in0");
+    def->connect("self.b","sub0.in1");
+    def->connect("self.b","sub1.in0");
+    def->connect("self.a","sub1.in1");
+    def->connect("sub0.out","self.out.2");
+    def->connect("sub1.out","self.out.3");
+    //Different args
+    def->addInstance("k2","coreir.const",w16,{{"value",c->argInt(6)}});
+    def->connect("k2.out","self.out.4");
+    //Same drivers through single bit connections
+    def->addInstance("and0","coreir.and",w16);
+    def->addInstance("and1","coreir.and",w16);
+    def->connect("self.a","and0.in0");
+    def->connect("self.b","and0.in1");
+    for (uint i=0; i<16; ++i) {
+      def->connect("self.a." + to_string(i),"and1.in0." + to_string(i));
+      def->connect("self.b." + to_string(i),"and1.in1." + to_string(i));
+    }
+    def->connect("and0.out","self.out.5");
+    def->connect("and1.out.0","self.out.6.0");
+    for (uint i=1; i<16; ++i) def->connect("and1.out." + to_string(i),"self.out.6." + to_string(i));
+    //Registers are not merged
+    def->addInstance("r0","coreir.reg",w16);
+    def->addInstance("r1","coreir.reg",w16);
+    def->connect("add0.out","r0.in");
+    def->connect("add1.out","r1.in");
+    def->connect("r0.out","self.out.7");
+    def->connect("r1.out","self.out.8");
+  m->setDef(def);
+
+  ASSERT(c->runPasses({"cse"}),"Expected cse to modify Dups");
+  def = m->getDef();
+  auto insts = def->getInstances();
+  //One copy of the cone is left
+  ASSERT(insts.count("add0") + insts.count("add1")==1,"Expected one add");
+  ASSERT(insts.count("xor0") + insts.count("xor1")==1,"Expected one xor");
+  ASSERT(insts.count("k0") + insts.count("k1")==1,"Expected one constant 5");
+  ASSERT(driverOf(def,"out.0")==driverOf(def,"out.1"),"Expected the same driver of out.0 and out.1");
+  ASSERT(insts.count("sub0") && insts.count("sub1"),"sub is not commutative");
+  ASSERT(insts.count("k2"),"Constants with other values are different");
+  ASSERT(insts.count("and0") + insts.count("and1")==1,"Expected one and");
+  ASSERT(driverOf(def,"out.5")==driverOf(def,"out.6.0"),"Expected the same driver of out.5 and out.6");
+  ASSERT(insts.count("r0") && insts.count("r1"),"Registers are not merged");
+  Instance* add = insts.count("add0") ? insts["add0"] : insts["add1"];
+  ASSERT(add->sel("out")->getLocalConnections().size()==3,"Expected add to drive xor, r0 and r1");
+  ASSERT(!def->validate(),"Dups is not valid");
+
+  ASSERT(!c->runPasses({"cse"}),"Expected a fixed point");
+  deleteContext(c);
+  return 0;
+}
@@ -0,0 +1,159 @@
+#include "coreir.h"
+
+using namespace CoreIR;
+
+int main() {
+  Context* c = newContext();
+  Namespace* g = c->getGlobal();
+  Args w16({{"width",c->argInt(16)}});
+
+  //b only feeds logic ending in terms
+  Module* inner = g->newModuleDecl("DeadInner",c->Record({
+    {"a",c->BitIn()->Arr(16)},
+    {"b",c->BitIn()->Arr(16)},
+    {"clk",c->Named("coreir.clkIn")},
+    {"out",c->Bit()->Arr(16)}
+  }));
+  ModuleDef* def = inner->newModuleDef();
+    def->addInstance("k","coreir.const",w16,{{"value",c->argInt(1)}});
+    def->addInstance("add","coreir.add",w16);
+    def->addInstance("mul","coreir.mul",w16);
+    def->addInstance("r","coreir.reg",w16);
+    def->addInstance("t0","coreir.term",w16);
+    def->addInstance("t1","coreir.term",w16);
+    def->connect("self.a","add.in0");
+    def->connect("k.out","add.in1");
+    def->connect("add.out","self.out");
+    def->connect("self.b","mul.in0");
+    def->connect("self.b","mul.in1");
+    def->connect("mul.out","t0.in");
+    def->connect("self.b","r.in");
+    def->connect("self.clk","r.clk");
+    def->connect("r.out","t1.in");
+  inner->setDef(def);
+
+  //Has to stay even though nothing reads it
+  Module* sink = g->newModuleDecl("DeadSink",c->Record({{"in",c->BitIn()->Arr(16)}}));
+
+  Module* top = g->newModuleDecl("DeadTop",c->Record({
+    {"in",c->BitIn()->Arr(16)},
+    {"clk",c->Named("coreir.clkIn")},
+    {"unused",c->BitIn()->Arr(16)},
+    {"out",c->Bit()->Arr(16)}
+  }));
+  def = top->newModuleDef();
+    def->addInstance("i0",inner);
+    def->addInstance("i1",inner);
+    def->addInstance("sub","coreir.sub",w16);
+    def->addInstance("xor","coreir.xor",w16);
+    def->addInstance("sink",sink);
+    def->addInstance("t","coreir.term",w16);
+    def->connect("self.in","i0.a");
+    def->connect("self.in","sub.in0");
+    def->connect("self.in","sub.in1");
+    def->connect("sub.out","i0.b");
+    def->connect("self.clk","i0.clk");
+    def->connect("i0.out","self.out");
+    def->connect("self.in","i1.a");
+    def->connect("self.in","i1.b");
+    def->connect("self.clk","i1.clk");
+    def->connect("i1.out","t.in");
+    def->connect("self.in","xor.in0");
+    def->connect("self.in","xor.in1");
+    def->connect("xor.out","sink.in");
+  top->setDef(def);
+
+  //Only o1 is read, so mul only drives an output that goes away
+  Module* outs = g->newModuleDecl("DeadOuts",c->Record({
+    {"a",c->BitIn()->Arr(16)},
+    {"o1",c->Bit()->Arr(16)},
+    {"o2",c->Bit()->Arr(16)}
+  }));
+  def = outs->newModuleDef();
+    def->addInstance("add","coreir.add",w16);
+    def->addInstance("mul","coreir.mul",w16);
+    def->connect("self.a","add.in0");
+    def->connect("self.a","add.in1");
+    def->connect("add.out","self.o1");
+    def->connect("self.a","mul.in0");
+    def->connect("self.a","mul.in1");
+    def->connect("mul.out","self.o2");
+  outs->setDef(def);
+  Module* outsTop = g->newModuleDecl("DeadOutsTop",c->Record({
+    {"in",c->BitIn()->Arr(16)},
+    {"out",c->Bit()->Arr(16)}
+  }));
+  def = outsTop->newModuleDef();
+    def->addInstance("o",outs);
+    def->connect("self.in","o.a");
+    def->connect("o.o1","self.out");
+  outsTop->setDef(def);
+
+  ASSERT(c->runPasses({"deadlogic"}),"Expected deadlogic to modify something");
+  auto insts = inner->getDef()->getInstances();
+  ASSERT(insts.size()==2 && insts.count("add") && insts.count("k"),"Expected only add and k in DeadInner");
+  insts = top->getDef()->getInstances();
+  ASSERT(!insts.count("i1") && !insts.count("t"),"Expected i1 to be removed");
+  ASSERT(insts.count("i0") && insts.count("sub"),"i0 and its drivers are live");
+  ASSERT(insts.count("sink") && insts.count("xor"),"sink has to stay");
+  ASSERT(!inner->getDef()->validate() && !top->getDef()->validate(),"Invalid after deadlogic");
+  ASSERT(!c->runPasses({"deadlogic"}),"Expected a fixed point");
+
+  //b and clk of DeadInner are unused now, which leaves sub dead
+  ASSERT(c->runPasses({"deadlogic-ports"}),"Expected deadlogic-ports to modify something");
+  auto fields = cast<RecordType>(inner->getType())->getRecord();
+  ASSERT(fields.size()==2 && fields.count("a") && fields.count("out"),"Expected DeadInner to only have a and out");
+  insts = top->getDef()->getInstances();
+  ASSERT(!insts.count("sub") && insts.count("i0"),"Expected sub to be removed");
+  ASSERT(cast<RecordType>(top->getType())->getRecord().count("unused"),"The top keeps its ports");
+  ASSERT(!inner->getDef()->validate() && !top->getDef()->validate(),"Invalid after deadlogic-ports");
+  ASSERT(!cast<RecordType>(outs->getType())->getRecord().count("o2") && !outs->getDef()->getInstances().count("mul"),"Expected o2 and mul to be removed");
+  ASSERT(!c->runPasses({"deadlogic"}) && !c->runPasses({"deadlogic-ports"}),"Expected a fixed point after deadlogic-ports");
+  deleteContext(c);
+
+  //o2 is only read by a term in the top, through a middle module. One run
+  //of deadlogic-ports alone removes it
+  c = newContext();
+  g = c->getGlobal();
+  Type* subType = c->Record({
+    {"a",c->BitIn()->Arr(16)},
+    {"o1",c->Bit()->Arr(16)},
+    {"o2",c->Bit()->Arr(16)}
+  });
+  Module* sub = g->newModuleDecl("DeadSub",subType);
+  def = sub->newModuleDef();
+    def->addInstance("add","coreir.add",w16);
+    def->addInstance("mul","coreir.mul",w16);
+    def->connect("self.a","add.in0");
+    def->connect("self.a","add.in1");
+    def->connect("add.out","self.o1");
+    def->connect("self.a","mul.in0");
+    def->connect("self.a","mul.in1");
+    def->connect("mul.out","self.o2");
+  sub->setDef(def);
+  Module* mid = g->newModuleDecl("DeadMid",subType);
+  def = mid->newModuleDef();
+    def->addInstance("s",sub);
+    def->connect("self.a","s.a");
+    def->connect("s.o1","self.o1");
+    def->connect("s.o2","self.o2");
+  mid->setDef(def);
+  Module* termTop = g->newModuleDecl("DeadTermTop",c->Record({
+    {"in",c->BitIn()->Arr(16)},
+    {"out",c->Bit()->Arr(16)}
+  }));
+  def = termTop->newModuleDef();
+    def->addInstance("m",mid);
+    def->addInstance("t","coreir.term",w16);
+    def->connect("self.in","m.a");
+    def->connect("m.o1","self.out");
+    def->connect("m.o2","t.in");
+  termTop->setDef(def);
+  ASSERT(c->runPasses({"deadlogic-ports"}),"Expected deadlogic-ports to modify something");
+  ASSERT(!cast<RecordType>(sub->getType())->getRecord().count("o2") && !sub->getDef()->getInstances().count("mul"),"Expected o2 and mul of DeadSub to be removed");
+  ASSERT(!cast<RecordType>(mid->getType())->getRecord().count("o2") && !termTop->getDef()->getInstances().count("t"),"Expected o2 of DeadMid and t to be removed");
+  ASSERT(!sub->getDef()->validate() && !mid->getDef()->validate() && !termTop->getDef()->validate(),"Invalid after deadlogic-ports");
+  ASSERT(!c->runPasses({"deadlogic-ports"}),"Expected a fixed point after one run of deadlogic-ports");
+  deleteContext(c);
+  return 0;
+}
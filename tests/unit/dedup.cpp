@@ -0,0 +1,115 @@
+#include "coreir.h"
+
+using namespace CoreIR;
+
+//out = reg(a + b), with the instance names prefixed by p
+Module* adder(Namespace* ns, string name, string p, bool swap=false, Params params=Params()) {
+  Context* c = ns->getContext();
+  Args w8({{"width",c->argInt(8)}});
+  Module* m = ns->newModuleDecl(name,c->Record({
+    {"a",c->BitIn()->Arr(8)},
+    {"b",c->BitIn()->Arr(8)},
+    {"out",c->Bit()->Arr(8)}
+  }),params);
+  ModuleDef* def = m->newModuleDef();
+    def->addInstance(p + "add","coreir.add",w8);
+    def->addInstance(p + "reg","coreir.reg",w8);
+    def->connect(swap ? "self.b" : "self.a",p + "add.in0");
+    def->connect(swap ? "self.a" : "self.b",p + "add.in1");
+    def->connect(p + "add.out",p + "reg.in");
+    def->connect(p + "reg.out","self.out");
+  m->setDef(def);
+  return m;
+}
+
+//Two instances of child chained
+Module* chain(Namespace* ns, string name, Module* child) {
+  Module* m = ns->newModuleDecl(name,child->getType());
+  ModuleDef* def = m->newModuleDef();
+    def->addInstance("c0",child);
+    def->addInstance("c1",child);
+    def->connect("self.a","c0.a");
+    def->connect("self.b","c0.b");
+    def->connect("c0.out","c1.a");
+    def->connect("self.b","c1.b");
+    def->connect("c1.out","self.out");
+  m->setDef(def);
+  return m;
+}
+
+int main() {
+  Context* c = newContext();
+  Namespace* g = c->getGlobal();
+  Namespace* lib = c->newNamespace("lib");
+
+  Module* a0 = adder(g,"A0","x");
+  Module* a1 = adder(g,"A1","y");
+  Module* swapped = adder(g,"Swapped","x",true);
+  Module* other = adder(lib,"Other","z");
+  ASSERT(Module::isEqual(a0,a1,true,false,true),"A0 and A1 only differ in instance names");
+  ASSERT(!Module::isEqual(a0,a1,true,true,true),"A0 and A1 have different instance names");
+  ASSERT(!Module::isEqual(a0,swapped),"Swapped connects the operands the other way");
+
+  Module* chain0 = chain(g,"Chain0",a0);
+  Module* chain1 = chain(g,"Chain1",a1);
+  ASSERT(!Module::isEqual(chain0,chain1,true,true,true),"The chains instantiate different modules");
+  Module* top = g->newModuleDecl("Top",c->Record({
+    {"a",c->BitIn()->Arr(8)},
+    {"b",c->BitIn()->Arr(8)},
+    {"out",c->Bit()->Arr(8)->Arr(4)}
+  }));
+  ModuleDef* def = top->newModuleDef();
+    def->addInstance("i0",chain0);
+    def->addInstance("i1",chain1);
+    def->addInstance("i2",swapped);
+    def->addInstance("i3",other);
+    for (uint i=0; i<4; ++i) {
+      string inst = "i" + to_string(i);
+      def->connect("self.a",inst + ".a");
+      def->connect("self.b",inst + ".b");
+      def->connect(inst + ".out","self.out." + to_string(i));
+    }
+  top->setDef(def);
+
+  //Instances relying on the defaults of their config params
+  Module* d0 = adder(g,"D0","x",false,{{"k",AINT}});
+  Module* d1 = adder(g,"D1","x",false,{{"k",AINT}});
+  d0->setDefaultConfigArgs({{"k",c->argInt(1)}});
+  d1->setDefaultConfigArgs({{"k",c->argInt(2)}});
+  ASSERT(!Module::isEqual(d0,d1,true,false,true),"D0 and D1 have different defaults");
+  Module* defaults = g->newModuleDecl("Defaults",c->Record({
+    {"a",c->BitIn()->Arr(8)},
+    {"b",c->BitIn()->Arr(8)},
+    {"out",c->Bit()->Arr(8)->Arr(2)}
+  }));
+  ModuleDef* ddef = defaults->newModuleDef();
+    ddef->addInstance("d0",d0);
+    ddef->addInstance("d1",d1);
+    for (uint i=0; i<2; ++i) {
+      string inst = "d" + to_string(i);
+      ddef->connect("self.a",inst + ".a");
+      ddef->connect("self.b",inst + ".b");
+      ddef->connect(inst + ".out","self.out." + to_string(i));
+    }
+  defaults->setDef(ddef);
+
+  ASSERT(c->runPasses({"dedup"}),"Expected dedup to modify the design");
+  ASSERT(g->hasModule("D0") && g->hasModule("D1"),"Expected D0 and D1 to be kept");
+  ASSERT(ddef->getInstances()["d1"]->getModuleRef()==d1,"Expected d1 to keep the defaults of D1");
+  //A0 and A1 are both merged into lib.Other which is outside of global
+  ASSERT(!g->hasModule("A0") && !g->hasModule("A1"),"Expected A0 and A1 to be deleted");
+  ASSERT(lib->hasModule("Other"),"Modules outside of global are kept");
+  ASSERT(g->hasModule("Swapped"),"Swapped is different");
+  //The chains are equal once their children are merged
+  ASSERT(g->hasModule("Chain0") && !g->hasModule("Chain1"),"Expected Chain1 to be deleted");
+  auto insts = def->getInstances();
+  ASSERT(insts["i0"]->getModuleRef()==chain0 && insts["i1"]->getModuleRef()==chain0,"Expected both chains to be Chain0");
+  ASSERT(insts["i3"]->getModuleRef()==other,"Expected i3 to be unchanged");
+  for (auto imap : chain0->getDef()->getInstances()) {
+    ASSERT(imap.second->getModuleRef()==other,"Expected Chain0 to instantiate lib.Other");
+  }
+  ASSERT(!def->validate(),"Top is not valid");
+  ASSERT(!c->runPasses({"dedup"}),"Expected a fixed point");
+  deleteContext(c);
+  return 0;
+}
@@ -0,0 +1,60 @@
+#include "coreir.h"
+#include "coreir-passes/analysis/firrtl.h"
+
+using namespace CoreIR;
+
+int main() {
+  Context* c = newContext();
+  Namespace* g = c->getGlobal();
+  Generator* add = c->getGenerator("coreir.add");
+  uint n = 16;
+  Type* add2Type = c->Record({
+      {"in",c->Array(2,c->Array(n,c->BitIn()))},
+      {"out",c->Array(n,c->Bit())}
+  });
+  Module* add2 = g->newModuleDecl("Add2",add2Type);
+  ModuleDef* def = add2->newModuleDef();
+    def->addInstance("add",add,{{"width",c->argInt(n)}});
+    def->connect("self.in.0","add.in0");
+    def->connect("self.in.1","add.in1");
+    def->connect("add.out","self.out");
+  add2->setDef(def);
+
+  Type* add4Type = c->Record({
+      {"in",c->Array(4,c->Array(n,c->BitIn()))},
+      {"out",c->Array(n,c->Bit())}
+  });
+  Module* add4 = g->newModuleDecl("Add4",add4Type);
+  def = add4->newModuleDef();
+    def->addInstance("a0",add2);
+    def->addInstance("a1",add2);
+    def->addInstance("a2",add2);
+    def->connect("self.in.0","a0.in.0");
+    def->connect("self.in.1","a0.in.1");
+    def->connect("self.in.2","a1.in.0");
+    def->connect("self.in.3","a1.in.1");
+    def->connect("a0.out","a2.in.0");
+    def->connect("a1.out","a2.in.1");
+    def->connect("a2.out","self.out");
+  add4->setDef(def);
+
+  c->runPasses({"firrtl"});
+  auto fpass = static_cast<Passes::Firrtl*>(c->getPassManager()->getAnalysisPass("firrtl"));
+
+  //Output has to be identical no matter how many threads render it
+  fpass->setNumThreads(1);
+  ostringstream serial;
+  fpass->writeToStream(serial);
+  fpass->setNumThreads(4);
+  ostringstream parallel;
+  fpass->writeToStream(parallel);
+  cout << serial.str() << endl;
+  ASSERT(serial.str()==parallel.str(),"Parallel firrtl output differs from serial output");
+  ASSERT(serial.str().find("module Add4 :")!=string::npos,"Missing Add4");
+  ASSERT(serial.str().find("input in : UInt<16>[4]")!=string::npos,"Bad Add4 ports");
+  ASSERT(serial.str().find("inst a0 of Add2")!=string::npos,"Missing instance");
+  ASSERT(serial.str().find("a2.in[0] <= a0.out")!=string::npos,"Missing connection");
+
+  deleteContext(c);
+  return 0;
+}
@@ -0,0 +1,59 @@
+#include "coreir.h"
+#include <set>
+#include <algorithm>
+
+using namespace CoreIR;
+
+string addName(Args args) {
+  return "add" + to_string(args.at("width")->get<ArgInt>());
+}
+
+//Generates adders (and regs) of the given widths in the given order and
+//returns the names of the generated modules. With injectiveAdd the adders
+//are named add<width> by an injective NameGen_t.
+vector<string> genNames(Context::GenNaming gn, vector<int> widths, bool injectiveAdd=false) {
+  Context* c = newContext();
+  c->setGenNaming(gn);
+  Generator* add = c->getGenerator("coreir.add");
+  if (injectiveAdd) add->setNameGen(addName,true);
+  Generator* reg = c->getGenerator("coreir.reg");
+  std::map<int,string> names;
+  for (auto w : widths) {
+    names[w] = add->getModule({{"width",c->argInt(w)}})->getName();
+    names[-w] = reg->getModule({{"width",c->argInt(w)},{"en",c->argBool(false)},{"clr",c->argBool(false)},{"rst",c->argBool(false)}})->getName();
+  }
+  deleteContext(c);
+  vector<string> ret;
+  for (auto n : names) ret.push_back(n.second);
+  return ret;
+}
+
+int main() {
+  //Unique naming depends on the order
+  ASSERT(genNames(Context::GN_Unique,{8,16}) != genNames(Context::GN_Unique,{16,8}),"Expected order dependent names");
+
+  //Hash naming does not
+  auto h0 = genNames(Context::GN_Hash,{8,16,32});
+  auto h1 = genNames(Context::GN_Hash,{32,16,8});
+  ASSERT(h0==h1,"Hash names depend on the order");
+  ASSERT(std::set<string>(h0.begin(),h0.end()).size()==h0.size(),"Hash names are not unique");
+  for (auto n : h0) cout << n << endl;
+
+  //NameGen uses the name function with the hash appended, as reg_P ignores
+  //the width, so the names do not depend on the order either
+  auto n0 = genNames(Context::GN_NameGen,{8,16});
+  ASSERT(n0==genNames(Context::GN_NameGen,{16,8}),"NameGen names depend on the order");
+  ASSERT(std::set<string>(n0.begin(),n0.end()).size()==n0.size(),"NameGen names are not unique");
+  uint regPs = 0;
+  for (auto n : n0) {
+    cout << n << endl;
+    regPs += n.compare(0,7,"reg_P_H")==0;
+  }
+  ASSERT(regPs==2,"Expected two reg_P_H<hash>");
+
+  //Injective NameGen names are used as they are
+  auto n1 = genNames(Context::GN_NameGen,{8,16},true);
+  ASSERT(n1==genNames(Context::GN_NameGen,{16,8},true),"Injective NameGen names depend on the order");
+  ASSERT(std::count(n1.begin(),n1.end(),"add8") && std::count(n1.begin(),n1.end(),"add16"),"Expected add8 and add16");
+  return 0;
+}
@@ -0,0 +1,146 @@
+#include "coreir.h"
+#include "coreir-passes/analysis/combdepth.h"
+#include "coreir-passes/transform/pipeline.h"
+
+using namespace CoreIR;
+
+uint countRegs(Module* m) {
+  uint regs = 0;
+  for (auto imap : m->getDef()->getInstances()) regs += coreirPrimName(imap.second)=="reg";
+  return regs;
+}
+
+int main() {
+  Context* c = newContext();
+  Namespace* g = c->getGlobal();
+  Args w16({{"width",c->argInt(16)}});
+  Type* ptype = c->Record({
+    {"in",c->BitIn()->Arr(16)},
+    {"clk",c->Named("coreir.clkIn")},
+    {"out",c->Bit()->Arr(16)}
+  });
+
+  //out = (((in+in)+in)+in)+in, every add reads in again
+  Module* chain = g->newModuleDecl("PipeChain",ptype);
+  chain->getMetaData()["timing"]["target"] = 2;
+  ModuleDef* def = chain->newModuleDef();
+    def->addInstance("a0","coreir.add",w16);
+    def->connect("self.in","a0.in0");
+    for (uint i=1; i<4; ++i) {
+      string add = "a" + to_string(i);
+      def->addInstance(add,"coreir.add",w16);
+      def->connect("a" + to_string(i-1) + ".out",add + ".in0");
+      def->connect("self.in",add + ".in1");
+    }
+    def->connect("self.in","a0.in1");
+    def->connect("a3.out","self.out");
+  chain->setDef(def);
+
+  //Four nots ending in a plain register, which can move up
+  Module* move = g->newModuleDecl("PipeMove",ptype);
+  move->getMetaData()["timing"]["target"] = 2;
+  def = move->newModuleDef();
+    for (uint i=0; i<4; ++i) {
+      string n = "n" + to_string(i);
+      def->addInstance(n,"coreir.not",w16);
+      def->connect(i==0 ? "self.in" : "n" + to_string(i-1) + ".out",n + ".in");
+    }
+    def->addInstance("r","coreir.reg",w16);
+    def->connect("n3.out","r.in");
+    def->connect("self.clk","r.clk");
+    def->connect("r.out","self.out");
+  move->setDef(def);
+
+  //out = chain(in) ^ in, with no target of its own
+  Module* top = g->newModuleDecl("PipeTop",ptype);
+  def = top->newModuleDef();
+    def->addInstance("chain",chain);
+    def->addInstance("xor","coreir.xor",w16);
+    def->connect("self.in","chain.in");
+    def->connect("self.clk","chain.clk");
+    def->connect("chain.out","xor.in0");
+    def->connect("self.in","xor.in1");
+    def->connect("xor.out","self.out");
+  top->setDef(def);
+
+  //Four nots in a loop through a register of the module above them
+  Module* loopSub = g->newModuleDecl("PipeLoopSub",ptype);
+  loopSub->getMetaData()["timing"]["target"] = 2;
+  def = loopSub->newModuleDef();
+    for (uint i=0; i<4; ++i) {
+      string n = "n" + to_string(i);
+      def->addInstance(n,"coreir.not",w16);
+      def->connect(i==0 ? "self.in" : "n" + to_string(i-1) + ".out",n + ".in");
+    }
+    def->connect("n3.out","self.out");
+  loopSub->setDef(def);
+  Module* loopTop = g->newModuleDecl("PipeLoopTop",ptype);
+  def = loopTop->newModuleDef();
+    def->addInstance("r","coreir.reg",w16);
+    def->addInstance("x","coreir.xor",w16);
+    def->addInstance("s",loopSub);
+    def->connect("self.in","x.in0");
+    def->connect("r.out","x.in1");
+    def->connect("x.out","s.in");
+    def->connect("self.clk","s.clk");
+    def->connect("s.out","r.in");
+    def->connect("self.clk","r.clk");
+    def->connect("r.out","self.out");
+  loopTop->setDef(def);
+
+  //A Bit[1] slice balanced against two nots
+  Module* narrow = g->newModuleDecl("PipeNarrow",ptype);
+  narrow->getMetaData()["timing"]["target"] = 1;
+  def = narrow->newModuleDef();
+    def->addInstance("s","coreir.slice",{{"width",c->argInt(16)},{"lo",c->argInt(0)},{"hi",c->argInt(1)}});
+    def->addInstance("n0","coreir.not",w16);
+    def->addInstance("n1","coreir.not",w16);
+    def->addInstance("t","coreir.slice",{{"width",c->argInt(16)},{"lo",c->argInt(1)},{"hi",c->argInt(16)}});
+    def->addInstance("cat","coreir.concat",{{"width0",c->argInt(1)},{"width1",c->argInt(15)}});
+    def->connect("self.in","s.in");
+    def->connect("self.in","n0.in");
+    def->connect("n0.out","n1.in");
+    def->connect("n1.out","t.in");
+    def->connect("s.out","cat.in0");
+    def->connect("t.out","cat.in1");
+    def->connect("cat.out","self.out");
+  narrow->setDef(def);
+
+  c->runPasses({"pipeline"});
+  auto pipe = static_cast<Passes::Pipeline*>(c->getPassManager()->getAnalysisPass("pipeline"));
+  auto depth = static_cast<Passes::CombDepth*>(c->getPassManager()->getAnalysisPass("combdepth"));
+
+  //Cut after a1: a2 and a3 read in through a shared register
+  ASSERT(pipe->metTarget(chain) && pipe->getAddedLatency(chain).at("out")==1,"Bad chain latency");
+  ASSERT(depth->getDepth(chain)==2 && countRegs(chain)==2,"Bad chain pipeline");
+  Instance* a3 = chain->getDef()->getInstances().at("a3");
+  Wireable* in1 = *a3->sel("in1")->getConnectedWireables().begin();
+  ASSERT(coreirPrimName(cast<Instance>(in1->getTopParent()))=="reg","Reconvergent input not delayed");
+
+  //r moves between n1 and n2 without adding latency
+  ASSERT(pipe->getAddedLatency(move).at("out")==0 && countRegs(move)==1,"Register not moved");
+  ASSERT(!move->getDef()->getInstances().count("r") && depth->getDepth(move)==2,"Bad moved register");
+
+  //The xor waits a cycle for in
+  ASSERT(pipe->getAddedLatency(top).at("out")==1 && countRegs(top)==1,"Top not balanced");
+  Wireable* xin = *top->getDef()->sel("xor")->sel("in1")->getConnectedWireables().begin();
+  ASSERT(coreirPrimName(cast<Instance>(xin->getTopParent()))=="reg","xor input not delayed");
+
+  //Latency would change the cycles of the loop
+  ASSERT(!pipe->metTarget(loopSub) && countRegs(loopSub)==0 && pipe->getAddedLatency(loopSub).at("out")==0,"Submodule in a loop pipelined");
+  ASSERT(countRegs(loopTop)==1 && pipe->getAddedLatency(loopTop).at("out")==0,"Loop changed");
+
+  //The slice is delayed by a 1 bit register
+  ASSERT(pipe->metTarget(narrow) && pipe->getAddedLatency(narrow).at("out")==1,"Bad narrow latency");
+  ASSERT(depth->getDepth(narrow)==1 && countRegs(narrow)==2,"Bad narrow pipeline");
+
+  //A target for the modules without metadata. The xor gets registered, but
+  //paths inside chain stay at its own target.
+  pipe->setTarget(1);
+  c->runPasses({"pipeline"});
+  ASSERT(pipe->getAddedLatency(chain).at("out")==0 && pipe->getAddedLatency(top).at("out")==1,"Bad added latency");
+  ASSERT(!pipe->metTarget(top) && depth->getDepth(top)==2 && countRegs(top)==3,"Bad target");
+
+  deleteContext(c);
+  return 0;
+}
@@ -0,0 +1,91 @@
+#include "coreir.h"
+#include "coreir-passes/analysis/coreirjson.h"
+
+using namespace CoreIR;
+
+Type* wrapType(Context* c, Args args) {
+  uint width = args.at("width")->get<ArgInt>();
+  return c->Record({
+    {"in",c->BitIn()->Arr(width)},
+    {"out",c->Bit()->Arr(width)}
+  });
+}
+
+//A module with a single instance of child
+Module* wrapper(Namespace* ns, string name, Instantiable* child, Args genargs=Args()) {
+  Context* c = ns->getContext();
+  Module* m = ns->newModuleDecl(name,wrapType(c,{{"width",c->argInt(8)}}));
+  ModuleDef* def = m->newModuleDef();
+    if (auto g = dyn_cast<Generator>(child)) def->addInstance("i",g,genargs);
+    else def->addInstance("i",cast<Module>(child));
+    def->connect("self.in","i.in");
+    def->connect("i.out","self.out");
+  m->setDef(def);
+  return m;
+}
+
+//A design with modules that are not reachable from Top. With withGen the
+//leaf is generated by global.Wrap instead of coreir.not
+Module* design(Context* c, bool withGen) {
+  Namespace* g = c->getGlobal();
+  Args w8({{"width",c->argInt(8)}});
+  if (!withGen) {
+    wrapper(g,"Leaf",c->getGenerator("coreir.not"),w8);
+  }
+  else {
+    g->newTypeGen("WrapType",{{"width",AINT}},wrapType);
+    Generator* wrap = g->newGeneratorDecl("Wrap",g->getTypeGen("WrapType"),{{"width",AINT}});
+    wrap->setGeneratorDefFromFun([](ModuleDef* def,Context* c, Type* t, Args args) {
+      def->addInstance("not",c->getGenerator("coreir.not"),args);
+      def->connect("self.in","not.in");
+      def->connect("not.out","self.out");
+    });
+    wrapper(g,"Leaf",wrap,w8);
+  }
+  Module* used = wrapper(g,"Used",g->getModule("Leaf"));
+  wrapper(g,"Unused",g->getModule("Leaf"));
+  wrapper(g,"UnusedTop",g->getModule("Unused"));
+  return wrapper(g,"Top",used);
+}
+
+int main() {
+  //Passes only visit and emit the modules reachable from the loaded top
+  {
+    Context* c = newContext();
+    Module* top = design(c,false);
+    ASSERT(saveToFile(c->getGlobal(),"_prune.json",top),"Could not save _prune.json");
+    deleteContext(c);
+
+    c = newContext();
+    ASSERT(loadFromFile(c,"_prune.json"),"Could not load _prune.json");
+    ASSERT(c->hasTop() && c->getTop()->getRefName()=="global.Top","Expected the top of the file");
+    c->getPassManager()->setTopOnly(true);
+    c->runPasses({"coreirjson"});
+    std::ostringstream os;
+    static_cast<Passes::CoreIRJson*>(c->getPassManager()->getAnalysisPass("coreirjson"))->writeToStream(os,"global.Top");
+    string json = os.str();
+    ASSERT(json.find("\"Used\"")!=string::npos && json.find("\"Leaf\"")!=string::npos,"Missing reachable modules");
+    ASSERT(json.find("Unused")==string::npos,"Unreachable modules should not be emitted");
+    deleteContext(c);
+  }
+  {
+    Context* c = newContext();
+    c->setTop(design(c,true));
+    //Generated modules that nothing instantiates
+    Generator* wrap = c->getGlobal()->getGenerator("Wrap");
+    wrap->getModule({{"width",c->argInt(4)}});
+    ASSERT(c->runPasses({"rungenerators"}),"Expected rungenerators to modify the design");
+    wrap->getModule({{"width",c->argInt(5)}});
+    ASSERT(c->runPasses({"prune"}),"Expected prune to modify the design");
+    Namespace* g = c->getGlobal();
+    ASSERT(!g->hasModule("Unused") && !g->hasModule("UnusedTop"),"Expected the unreachable modules to be deleted");
+    ASSERT(g->hasModule("Top") && g->hasModule("Used") && g->hasModule("Leaf"),"Expected the reachable modules to be kept");
+    ASSERT(g->hasGenerator("Wrap"),"Generators are kept");
+    //Only the width 8 module generated for Leaf is left
+    auto generated = wrap->getGeneratedModules();
+    ASSERT(generated.size()==1,"Expected one generated module, got " + to_string(generated.size()));
+    ASSERT(!c->runPasses({"prune"}),"Expected a fixed point");
+    deleteContext(c);
+  }
+  return 0;
+}
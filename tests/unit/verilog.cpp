@@ -0,0 +1,104 @@
+#include "coreir.h"
+#include "coreir-passes/analysis/verilog.h"
+#include <fstream>
+
+using namespace CoreIR;
+
+//Builds Add4 out of two levels of Add2 modules so the design has a few modules
+Module* buildAdd4(Context* c, uint n) {
+  Namespace* g = c->getGlobal();
+  Generator* add = c->getGenerator("coreir.add");
+  Type* add2Type = c->Record({
+      {"in0",c->Array(n,c->BitIn())},
+      {"in1",c->Array(n,c->BitIn())},
+      {"out",c->Array(n,c->Bit())}
+  });
+  Module* add2 = g->newModuleDecl("Add2",add2Type);
+  ModuleDef* def = add2->newModuleDef();
+    def->addInstance("add",add,{{"width",c->argInt(n)}});
+    def->connect("self.in0","add.in0");
+    def->connect("self.in1","add.in1");
+    def->connect("add.out","self.out");
+  add2->setDef(def);
+
+  Type* add4Type = c->Record({
+      {"in0",c->Array(n,c->BitIn())},
+      {"in1",c->Array(n,c->BitIn())},
+      {"in2",c->Array(n,c->BitIn())},
+      {"in3",c->Array(n,c->BitIn())},
+      {"out",c->Array(n,c->Bit())}
+  });
+  Module* add4 = g->newModuleDecl("Add4",add4Type);
+  def = add4->newModuleDef();
+    def->addInstance("a0",add2);
+    def->addInstance("a1",add2);
+    def->addInstance("a2",add2);
+    def->connect("self.in0","a0.in0");
+    def->connect("self.in1","a0.in1");
+    def->connect("self.in2","a1.in0");
+    def->connect("self.in3","a1.in1");
+    def->connect("a0.out","a2.in0");
+    def->connect("a1.out","a2.in1");
+    def->connect("a2.out","self.out");
+  add4->setDef(def);
+  return add4;
+}
+
+int main() {
+  Context* c = newContext();
+  buildAdd4(c,16);
+  c->runPasses({"removebulkconnections","flattentypes","verilog"});
+  auto vpass = static_cast<Passes::Verilog*>(c->getPassManager()->getAnalysisPass("verilog"));
+
+  //Output has to be identical no matter how many threads render it
+  vpass->setNumThreads(1);
+  ostringstream serial;
+  vpass->writeToStream(serial);
+  vpass->setNumThreads(4);
+  ostringstream parallel;
+  vpass->writeToStream(parallel);
+  cout << serial.str() << endl;
+  ASSERT(serial.str()==parallel.str(),"Parallel verilog output differs from serial output");
+  ASSERT(serial.str().find("module Add4")!=string::npos,"Missing Add4");
+  ASSERT(serial.str().find("module Add2")!=string::npos,"Missing Add2");
+
+  //One file per module
+  vpass->writeToFiles("_verilog");
+  for (auto mname : {"Add2","Add4"}) {
+    std::ifstream fin(string("_verilog/") + mname + ".v");
+    ASSERT(fin.is_open(),string("Missing file for ") + mname);
+    string text((std::istreambuf_iterator<char>(fin)),std::istreambuf_iterator<char>());
+    ASSERT(serial.str().find(text)!=string::npos,string("Module file differs from stream for ") + mname);
+  }
+
+  //Cached text has to match freshly rendered text
+  vpass->setCacheDir("_emitcache");
+  ostringstream cold;
+  vpass->writeToStream(cold);
+  ostringstream warm;
+  vpass->writeToStream(warm);
+  ASSERT(vpass->getCache()->getHits()>=2,"Expected cache hits");
+  ASSERT(cold.str()==serial.str(),"Cached verilog differs (cold)");
+  ASSERT(warm.str()==serial.str(),"Cached verilog differs (warm)");
+  deleteContext(c);
+
+  //The cache key of a parent has to change with the defaults of its children
+  c = newContext();
+  Namespace* g = c->getGlobal();
+  Type* childType = c->Record({{"in",c->BitIn()},{"out",c->Bit()}});
+  Module* child = g->newModuleDecl("Child",childType,{{"k",AINT}});
+  Module* parent = g->newModuleDecl("Parent",childType);
+  ModuleDef* def = parent->newModuleDef();
+    def->addInstance("ch",child,{{"k",c->argInt(1)}});
+    def->connect("self.in","ch.in");
+    def->connect("ch.out","self.out");
+  parent->setDef(def);
+  uint64_t structural = moduleHash(parent);
+  uint64_t emitted = moduleEmitHash(parent);
+  child->setDefaultConfigArgs({{"k",c->argInt(3)}});
+  ASSERT(moduleHash(parent)==structural,"Parent structure did not change");
+  ASSERT(moduleEmitHash(parent)!=emitted,"Child defaults missing from the cache key");
+
+  deleteContext(c);
+  return 0;
+}